@@ -5,7 +5,7 @@
  * @brief The main entry point for the assembler program.
  *
  * This file contains the `main` function which orchestrates the entire
- * assembly process. It handles command-line arguments, memory allocation,
+ * assembly process. It handles command-line options, memory allocation,
  * and calls the `pre_assemble` and `passes` functions to process each
  * input file. It also manages error handling, file output (object,
  * entry, and external files), and proper memory cleanup.
@@ -20,15 +20,29 @@ int main(int argc, char *argv[])
 		ec,             /* Error Counter: counts the number of errors found. */
 		exc,            /* External Counter: counts the number of external symbols. */
 		lac,            /* Label Counter: counts the number of labels. */
-		argct = argc,   /* Local copy of argument count. */
+		status,         /* Exit status of the language server or the macro precompiler. */
 		isize,          /* Size of the instruction memory table. */
 		dsize,          /* Size of the data memory table. */
 		esize,          /* Size of the error table. */
 		lasize,         /* Size of the label table. */
 		exsize,         /* Size of the external table. */
-		mcro;           /* Status of the pre-assembly process. */
+		mcro,           /* Status of the pre-assembly process. */
+		first_output,   /* The first output record of the current file, for the metrics. */
+		am_written,     /* Whether the `.am` file was written for the current file. */
+		failed,         /* The number of files with errors, for the exit status of `--check`. */
+		record_outputs; /* Whether the output files are listed, for the manifest or the metrics. */
 
-	char *nametmp, *name = NULL;
+	char *nametmp = NULL, *name = NULL;
+	struct options opts;
+
+	/* The start times of the current file and of the current span, for the trace. */
+	double file_span, span;
+
+	/* The bytes of the output files of the current file, for the metrics. */
+	double bytes_out;
+
+	/* The memory budget of line storage and tables, in bytes. */
+	size_t budget;
 	
 	/* Pointers to various data structures used throughout the assembly process. */
 	struct instructionsMemory *instable = NULL;
@@ -37,11 +51,159 @@ int main(int argc, char *argv[])
 	struct dataMemory *datatable = NULL;
 	struct external *extable = NULL;
 	MacroDefinition *macrostable = NULL;
+	ExpandedSource expanded = {NULL, NULL, 0, 0};
+	struct include_deps deps = {NULL, 0, 0};
+
+	/* The output files of the run, for the manifest and the metrics. */
+	struct output_manifest manifest = {NULL, 0, 0};
+
+	/* The words every expanded line allocated, for the size report and the line table. */
+	struct line_size *sizes = NULL;
+
+	/* The blocks the stable layout placed, for the line and cross-reference tables. */
+	struct layout_block *placed = NULL;
+	int num_placed = 0;
+
+	/* Included files are read once per run and shared by every source file. */
+	struct included_file *include_cache = NULL;
+
+	/* The precompiled macro library, mapped once for the whole run. */
+	struct macro_library library;
+
+	/* The format of the object files. */
+	const struct emitter *emitter;
+
+	/* The time and hardware counters of every phase, summed over the files. */
+	struct perf_counters perf;
+
+	/* Split the command line into options and source file names. */
+	if(parse_options(argc, argv, &opts) == EXIT)
+	{
+		exit(1);
+	}
+	COMMAND_LINE_DEFINES = opts.defines;
+	NUM_COMMAND_LINE_DEFINES = opts.num_defines;
+
+	/* In language-server mode the assembler serves an editor instead of assembling files. */
+	if(opts.lsp)
+	{
+		status = lsp_run(stdin, stdout);
+		free_options(&opts);
+		return (status == EXIT) ? 1 : 0;
+	}
 
-	/* Loop through each file provided as a command-line argument. */
-	for(i = 1; i < argct; i++)
+	/* Precompiling a macro library replaces the assembly of source files. */
+	if(opts.precompile != NULL)
 	{
+		status = precompile_macros(opts.precompile, opts.output);
+		free_options(&opts);
+		return (status == 1) ? 0 : 1;
+	}
+
+	/* Looking addresses up in a line table replaces the assembly of source files. */
+	if(opts.addr2line != NULL)
+	{
+		status = print_debug_locations(opts.addr2line, opts.files, opts.num_files);
+		free_options(&opts);
+		return (status == 1) ? 0 : 1;
+	}
+
+	/* Looking symbols up in a cross-reference table replaces the assembly of source files. */
+	if(opts.xref_query != NULL)
+	{
+		status = print_xref_queries(opts.xref_query, opts.files, opts.num_files);
+		free_options(&opts);
+		return (status == 1) ? 0 : 1;
+	}
+
+	/* Choose the object file format. */
+	emitter = find_emitter((opts.format != NULL) ? opts.format : DEFAULT_FORMAT);
+	if(emitter == NULL)
+	{
+		fprintf(stdout, "unknown object format: %s\n", opts.format);
+		free_options(&opts);
+		exit(1);
+	}
+
+	/* Moving finished object files to another load address replaces the assembly of source files. */
+	if(opts.rebase != NULL)
+	{
+		status = rebase_files(opts.rebase, opts.files, opts.num_files, emitter);
+		free_options(&opts);
+		return (status == 1) ? 0 : 1;
+	}
+
+	/* Keep line storage and tables beyond the budget in temporary files. */
+	if(opts.memory_budget != NULL)
+	{
+		if(!parse_memory_budget(opts.memory_budget, &budget))
+		{
+			fprintf(stdout, "invalid memory budget: %s\n", opts.memory_budget);
+			free_options(&opts);
+			exit(1);
+		}
+		spill_open(budget);
+	}
+
+	/* Link identical images to each other, and to the store, instead of writing them again. */
+	if(opts.dedupe && !opts.check && dedupe_open(opts.dedupe_store) == EXIT)
+	{
+		spill_close();
+		free_options(&opts);
+		exit(1);
+	}
+
+	/* Map the precompiled macro library, if one was given. */
+	memset(&library, 0, sizeof(library));
+	if(opts.macros != NULL && load_macro_library(opts.macros, &library) == EXIT)
+	{
+		free_options(&opts);
+		exit(1);
+	}
+
+	/* Record a timeline of the run, written when the run ends. */
+	if(opts.trace != NULL && trace_open() == EXIT)
+	{
+		unload_macro_library(&library);
+		free_options(&opts);
+		exit(1);
+	}
+
+	/* Record the definitions and references of every symbol for the `.xref` tables. */
+	if(opts.xref)
+	{
+		xref_open();
+	}
+
+	/* In check mode the tables only count words and no file is written. */
+	CHECK_ONLY = opts.check;
+	failed = 0;
+	record_outputs = (opts.manifest != NULL || opts.metrics != NULL);
+
+	/* Keep the status file of the run up to date. */
+	if(opts.metrics != NULL && metrics_open(opts.metrics, opts.num_files) == EXIT)
+	{
+		fprintf(stdout, "cannot write metrics file: %s\n", opts.metrics);
+		if(opts.trace != NULL)trace_close();
+		xref_close();
+		unload_macro_library(&library);
+		free_options(&opts);
+		exit(1);
+	}
+
+	/* Open the counters once; without them only the times are reported. */
+	if(opts.perf_counters)
+	{
+		perf_open(&perf);
+	}
+
+	/* Loop through each file provided on the command line. */
+	for(i = 0; i < opts.num_files; i++)
+	{
+		file_span = trace_begin();
+
 		/* Allocate memory for all required tables for the current file. */
+		xref_reset();
 		instable = allocated_memory_table();
 		labeltable = allocated_label_table();
 		errortable = allocated_error_table();
@@ -65,8 +227,8 @@ int main(int argc, char *argv[])
 		exsize = MAX_SIZE_MEMORY;
 		
 		/* Allocate memory for temporary and final file names. */
-		nametmp = (char *)malloc(strlen(argv[i]) + MAX_LEN_OF_STRING_END);
-		name = (char *)malloc(strlen(argv[i]) + MAX_LEN_OF_STRING_END);
+		nametmp = (char *)malloc(strlen(opts.files[i]) + MAX_LEN_OF_STRING_END);
+		name = (char *)malloc(strlen(opts.files[i]) + MAX_LEN_OF_STRING_END);
 		if(name == NULL || nametmp == NULL)
 		{
 			fprintf(stdout, "allocation failed");
@@ -74,56 +236,131 @@ int main(int argc, char *argv[])
 		}
 		
 		/* Copy and append file extensions to the file names. */
-		strcpy(name, argv[i]);
-		strcpy(nametmp, argv[i]);
+		strcpy(name, opts.files[i]);
+		strcpy(nametmp, opts.files[i]);
 		strcat(name, END_SOURCE_FILE_NAME);
 
 		/*
-		 * Pre-assembly pass: handles macros and creates a new file.
+		 * Pre-assembly pass: handles includes and macros and creates a new file.
 		 * 'mcro' holds the status of this pass.
 		 */
-		mcro = pre_assemble(name, errortable, &ec, &esize, &macrostable);
+		first_output = manifest.count;
+		metrics_begin_file(name);
+		if(opts.perf_counters){perf_begin(&perf);}
+		span = trace_begin();
+		mcro = pre_assemble(name, &include_cache, (opts.macros != NULL) ? &library : NULL, &deps, &expanded, &errortable, &ec, &esize, &macrostable);
+		trace_end("pre_assemble", name, span);
+		if(opts.perf_counters){perf_end(&perf, PERF_PRE_ASSEMBLE);}
+		metrics_phase(PERF_PRE_ASSEMBLE);
 		if(mcro == EXIT)
 		{
 			goto cleanup;
 		}
 
-		/* Update file name to the pre-assembled output for the next pass. */
-		strcpy(name, nametmp);
-		strcat(name, END_OF_MACRO_FILE_NAME);
+		/* Pre-assembly errors leave no `.am` file behind, so the passes are skipped. */
+		am_written = (ec == 0 && !opts.check);
+		if(ec == 0)
+		{
+			if(!opts.check && (opts.size_report || opts.debug_info))
+			{
+				sizes = (struct line_size *)calloc((size_t)expanded.count + 1, sizeof(struct line_size));
+				if(sizes == NULL)
+				{
+					fprintf(stdout, "allocation failed");
+					goto cleanup;
+				}
+			}
 
-		/*
-		 * Main assembly passes (first and second).
-		 * Processes instructions, directives, and symbol table management.
-		 */
-		if(passes(name, instable, labeltable, errortable, extable, datatable, macrostable, &ic, &dc, &ec, &lac, &exc, &isize, &dsize, &esize, &lasize, &exsize) == EXIT){goto cleanup;}
+			/*
+			 * Main assembly passes (first and second) on the expanded lines.
+			 * Processes instructions, directives, and symbol table management.
+			 */
+			if(opts.perf_counters){perf_begin(&perf);}
+			if(first_pass_lines(expanded.lines, expanded.count, &instable, &labeltable, &errortable, &extable, &datatable, macrostable, &ic, &dc, &ec, &lac, &exc, &isize, &dsize, &esize, &lasize, &exsize, sizes) == EXIT){goto cleanup;}
+			if(opts.perf_counters){perf_end(&perf, PERF_FIRST_PASS); perf_begin(&perf);}
+			metrics_phase(PERF_FIRST_PASS);
+			if(second_pass_lines(expanded.lines, expanded.count, instable, labeltable, &errortable, &extable, &ec, &lac, &exc, &esize, &exsize) == EXIT){goto cleanup;}
+			if(opts.perf_counters){perf_end(&perf, PERF_SECOND_PASS);}
+			metrics_phase(PERF_SECOND_PASS);
+			annotate_included_errors(errortable, 0, ec, &expanded);
 
-		/* Check if the total memory usage exceeds the maximum allowed size. */
-		if((ic + dc) > 156)
-		{
-			if(add_error(&errortable, &ec, 0, ": the memory is over", &esize) == EXIT){goto cleanup;}
+			/* Attribute every word to its line, label and macro, even when the memory is over. */
+			if(ec == 0 && opts.size_report && !opts.check)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_SIZE_FILE_NAME);
+				strcpy(nametmp + strlen(opts.files[i]), END_SIZE_JSON_FILE_NAME);
+				span = trace_begin();
+				status = print_size_report(name, nametmp, opts.files[i], &expanded, sizes, labeltable, lac, ic, dc);
+				trace_end("print_size_report", name, span);
+				if(status != EXIT && record_outputs && (add_output_record(&manifest, name) == EXIT || add_output_record(&manifest, nametmp) == EXIT)){status = EXIT;}
+				nametmp[strlen(opts.files[i])] = '\0';
+				if(status == EXIT){goto cleanup;}
+			}
+
+			/* Keep blocks at the addresses of the previous build and write the `.map` file. */
+			if(ec == 0 && opts.stable_layout != NULL && !opts.check)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_MAP_FILE_NAME);
+				span = trace_begin();
+				if(stable_layout(name, opts.stable_layout, opts.files[i], &instable, &datatable, labeltable, extable, &ic, &dc, &isize, &dsize, lac, exc, (opts.debug_info || opts.xref) ? &placed : NULL, &num_placed) == EXIT){goto cleanup;}
+				trace_end("stable_layout", name, span);
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
+			}
+
+			/* Check if the total memory usage exceeds the maximum allowed size. */
+			if((ic + dc) > 156)
+			{
+				if(add_error(&errortable, &ec, 0, ": the memory is over", &esize) == EXIT){goto cleanup;}
+			}
 		}
 
 		/* If errors were found, print them and remove the temporary macro file. */
+		if(opts.perf_counters){perf_begin(&perf);}
 		if(ec > 0)
 		{
+			failed++;
 			strcpy(name, nametmp);
 			strcat(name, END_OF_MACRO_FILE_NAME);
+			span = trace_begin();
 			print_error(errortable, ec);
-			if(remove(name) != 0)
+			trace_end("print_error", nametmp, span);
+			if(am_written && remove(name) != 0)
 			{
 				fprintf(stdout, "error remove macro file");
 			}
 		}
-		/* If no errors, generate output files. */
-		else
+		/* If no errors, generate output files, unless the file is only checked. */
+		else if(!opts.check)
 		{
+			if(record_outputs)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_OF_MACRO_FILE_NAME);
+				if(add_output_record(&manifest, name) == EXIT){goto cleanup;}
+			}
+
+			/* Compare with the previous build first, since its files may be overwritten below. */
+			if(opts.delta_from != NULL)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_DELTA_FILE_NAME);
+				span = trace_begin();
+				if(print_delta(name, opts.delta_from, opts.files[i], (emitter->emit == emit_packed) ? emitter->suffix : END_OBJECT_FILE_NAME, instable, datatable, labeltable, extable, ic, dc, lac, exc) == EXIT){goto cleanup;}
+				trace_end("print_delta", name, span);
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
+			}
+
 			/* Generate `.ext` file if external symbols exist. */
 			if(exc > 0)
 			{
 				strcpy(name, nametmp);
 				strcat(name, END_EX_FILE_NAME);
+				span = trace_begin();
 				if(print_extern(name, extable, exc) == EXIT){goto cleanup;}
+				trace_end("print_extern", name, span);
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
 			}
 			
 			/* Generate `.ent` file if entry labels exist. */
@@ -131,41 +368,222 @@ int main(int argc, char *argv[])
 			{
 				strcpy(name, nametmp);
 				strcat(name, END_EN_FILE_NAME);
+				span = trace_begin();
 				if(print_entry(name, labeltable, &lac) == EXIT){goto cleanup;}
+				trace_end("print_entry", name, span);
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
 			}
 
-			/* Generate the `.ob` (object) file. */
+			/* Generate the object file in the chosen format. */
 			strcpy(name, nametmp);
-			strcat(name, END_OBJECT_FILE_NAME);
-			if(print_object(name, instable, datatable, ic, dc) == EXIT){goto cleanup;}
+			strcat(name, emitter->suffix);
+			span = trace_begin();
+			if(write_object(name, emitter, instable, datatable, ic, dc) == EXIT){goto cleanup;}
+			trace_end("write_object", name, span);
+			if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
+
+			/* Generate the `.rel` list of relocatable words for rebasing. */
+			if(opts.relocs)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_RELOC_FILE_NAME);
+				span = trace_begin();
+				if(print_relocations(name, instable, ic, dc) == EXIT){goto cleanup;}
+				trace_end("print_relocations", name, span);
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
+			}
+
+			/* Generate the `.dbg` line table from the words every line allocated. */
+			if(opts.debug_info)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_DEBUG_FILE_NAME);
+				strcat(nametmp, END_SOURCE_FILE_NAME);
+				span = trace_begin();
+				status = print_debug_info(name, nametmp, &expanded, sizes, placed, num_placed);
+				nametmp[strlen(opts.files[i])] = '\0';
+				trace_end("print_debug_info", name, span);
+				if(status == EXIT){goto cleanup;}
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
+			}
+
+			/* Generate the `.xref` table from the label table and the recorded sites. */
+			if(opts.xref)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_XREF_FILE_NAME);
+				strcat(nametmp, END_SOURCE_FILE_NAME);
+				span = trace_begin();
+				status = print_xref(name, nametmp, &expanded, labeltable, lac, placed, num_placed);
+				nametmp[strlen(opts.files[i])] = '\0';
+				trace_end("print_xref", name, span);
+				if(status == EXIT){goto cleanup;}
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
+			}
+
+			/* Generate the `.d` file listing the source and its included files. */
+			if(opts.deps)
+			{
+				strcpy(name, nametmp);
+				strcat(name, END_DEPENDENCY_FILE_NAME);
+				span = trace_begin();
+				if(print_dependencies(name, nametmp, &deps) == EXIT){goto cleanup;}
+				trace_end("print_dependencies", name, span);
+				if(record_outputs && add_output_record(&manifest, name) == EXIT){goto cleanup;}
+			}
+		}
+		if(opts.perf_counters){perf_end(&perf, PERF_OUTPUT);}
+		metrics_phase(PERF_OUTPUT);
+		trace_end("file", opts.files[i], file_span);
+
+		/* Count the bytes of the outputs; without a manifest their records are only kept for this. */
+		if(opts.metrics != NULL)
+		{
+			bytes_out = 0;
+			for(; first_output < manifest.count; first_output++)
+			{
+				bytes_out += manifest.records[first_output].size;
+			}
+			metrics_end_file(expanded.count, ec, bytes_out);
+			if(opts.manifest == NULL)
+			{
+				free_manifest(&manifest);
+			}
 		}
 		
 		/* Free all dynamically allocated memory for the current file. */
-		free(instable);
-		free(labeltable);
+		spill_free(instable);
+		spill_free(labeltable);
 		free(errortable);
 		free(extable);
-		free(datatable);
+		spill_free(datatable);
 		free_macro_definitions(&macrostable);
+		free_expanded_source(&expanded);
+		free_dependencies(&deps);
+		free(sizes);
+		free(placed);
 		free(nametmp);
 		free(name);
+		sizes = NULL;
+		placed = NULL;
+		num_placed = 0;
+		nametmp = NULL;
+		name = NULL;
 	}
 	
-	/* Return success code. */
-	return 0;	
+	/* Report every phase of the run. */
+	if(opts.perf_counters)
+	{
+		print_perf_report(stdout, &perf);
+		perf_close(&perf);
+	}
+
+	/* Report the images that were linked instead of written. */
+	if(DEDUPE.enabled)
+	{
+		print_dedupe_report(stdout);
+		dedupe_close();
+	}
+
+	/* List the outputs of the run, so build tools can tell whether anything changed. */
+	if(opts.manifest != NULL)
+	{
+		status = print_manifest(opts.manifest, &manifest);
+		free_manifest(&manifest);
+		if(status == EXIT)
+		{
+			if(opts.trace != NULL)trace_close();
+			xref_close();
+			free_include_cache(&include_cache);
+			free_instruction_cache(&INSTRUCTION_CACHE);
+			free_label_index();
+			spill_close();
+			unload_macro_library(&library);
+			free_options(&opts);
+			exit(1);
+		}
+	}
+
+	/* Write the final status file, with no file queued. */
+	if(opts.metrics != NULL)
+	{
+		status = write_metrics();
+		metrics_close();
+		if(status == EXIT)
+		{
+			fprintf(stdout, "cannot write metrics file: %s\n", opts.metrics);
+			if(opts.trace != NULL)trace_close();
+			xref_close();
+			free_include_cache(&include_cache);
+			free_instruction_cache(&INSTRUCTION_CACHE);
+			free_label_index();
+			spill_close();
+			unload_macro_library(&library);
+			free_options(&opts);
+			exit(1);
+		}
+	}
+
+	/* Write the timeline of the run. */
+	if(opts.trace != NULL)
+	{
+		status = write_trace(opts.trace);
+		trace_close();
+		if(status == EXIT)
+		{
+			xref_close();
+			free_include_cache(&include_cache);
+			free_instruction_cache(&INSTRUCTION_CACHE);
+			free_label_index();
+			spill_close();
+			unload_macro_library(&library);
+			free_options(&opts);
+			exit(1);
+		}
+	}
+
+	/* Return success code; a check fails if any file has errors. */
+	xref_close();
+	free_include_cache(&include_cache);
+	free_instruction_cache(&INSTRUCTION_CACHE);
+	free_label_index();
+	spill_close();
+	unload_macro_library(&library);
+	free_options(&opts);
+	return (opts.check && failed > 0) ? 1 : 0;
 
 	/*
 	 * Cleanup block: A `goto` label for centralized memory deallocation
 	 * in case of a critical error.
 	 */
 	cleanup:
-		if(instable)free(instable);
-		if(labeltable)free(labeltable);
+		if(instable)spill_free(instable);
+		if(labeltable)spill_free(labeltable);
 		if(errortable)free(errortable);
 		if(extable)free(extable);
-		if(datatable)free(datatable);
+		if(datatable)spill_free(datatable);
 		if(macrostable)free_macro_definitions(&macrostable);
 		if(nametmp)free(nametmp);
 		if(name)free(name);
+		free_expanded_source(&expanded);
+		free_dependencies(&deps);
+		free(sizes);
+		free(placed);
+		free_manifest(&manifest);
+		metrics_close();
+		dedupe_close();
+		xref_close();
+		free_include_cache(&include_cache);
+		free_instruction_cache(&INSTRUCTION_CACHE);
+		free_label_index();
+		spill_close();
+		unload_macro_library(&library);
+		if(opts.perf_counters)perf_close(&perf);
+		if(opts.trace != NULL)
+		{
+			write_trace(opts.trace);
+			trace_close();
+		}
+		free_options(&opts);
 		exit(1); /* Exit with an error code. */
 }
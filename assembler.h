@@ -23,6 +23,23 @@
 #include "data.h"           /* Custom data structures for the assembler. */
 #include "pre_assembler.h"  /* Prototypes and definitions for the pre-assembler stage. */
 #include "code.h"           /* Definitions related to code and instruction handling. */
+#include "include.h"        /* The `.include` directive and its file cache. */
+#include "macrolib.h"       /* Precompiled macro libraries. */
+#include "emitter.h"        /* Object file formats. */
+#include "options.h"        /* Command-line options. */
+#include "lsp.h"            /* Language-server mode. */
+#include "delta.h"          /* Delta object output. */
+#include "layout.h"         /* Layout-stable assembly. */
+#include "size_report.h"    /* Code-size attribution report. */
+#include "perf.h"           /* Per-phase hardware performance counters. */
+#include "trace.h"          /* Chrome trace-event timeline. */
+#include "output.h"         /* Write-if-changed outputs and the output manifest. */
+#include "debug_info.h"     /* Address-to-source line tables. */
+#include "xref.h"           /* Symbol cross-reference tables. */
+#include "reloc.h"          /* Relocation records and rebasing. */
+#include "metrics.h"        /* Live progress metrics. */
+#include "spill.h"          /* Memory budget and spill-to-disk storage. */
+#include "dedupe.h"         /* Deduplication of output images with hard links. */
 
 /* --- File Extension Constants --- */
 #define END_EN_FILE_NAME ".ent"         /**< Suffix for the entry file. */
@@ -32,7 +49,7 @@
 #define END_OF_MACRO_FILE_NAME ".am"    /**< Suffix for the pre-assembled (macro-expanded) file. */
 
 /* --- Other Constants --- */
-#define MAX_LEN_OF_STRING_END 4         /**< The maximum length of a file extension string. */
+#define MAX_LEN_OF_STRING_END 16        /**< The room for a file extension string and its terminator. */
 #define EXIT 10000                      /**< A custom return value to indicate a critical exit condition. */
 
 /**
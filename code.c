@@ -14,7 +14,7 @@
  *
  * @param str The string to be validated as a label.
  * @param word2 The second word on the line, typically the command.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param labeltable A pointer to the label memory table.
  * @param macrostable A pointer to the macro definitions table.
  * @param ec A pointer to the error counter.
@@ -23,61 +23,58 @@
  * @param lac A pointer to the number of labels in the label table.
  * @return 1 if the label is valid, 0 if it's invalid, or EXIT on memory error.
  */
-int valid_label(char str[], char word2[], struct error *errortable, struct labelMemory *labeltable, MacroDefinition *macrostable, int *ec, int *cl,  int *esize, int *lac)
+int valid_label(char str[], char word2[], struct error **errortable, struct labelMemory *labeltable, MacroDefinition *macrostable, int *ec, int *cl,  int *esize, int *lac)
 {
 	int i = 0, begin;
 	begin = begin_of_string(str);
 	if((str[begin] >= '0' && str[begin] <= '9') || str[begin] == '_')
 	{
-		if(add_error(&errortable, ec, *cl, ": error! Label starts with a digit or an underscore", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! Label starts with a digit or an underscore", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	if(strlen(str) - begin > MAX_SIZE_LABEL)
 	{
-		if(add_error(&errortable, ec, *cl, ": error! Label too long (max 30 characters)", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! Label too long (max 30 characters)", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	for(; i < strlen(str); i++)
 	{
 		if(isalnum(str[i]) == 0 && str[i] != '_')
 		{
-			if(add_error(&errortable, ec, *cl, ": error! Label with non-alphanumeric characters", esize) == EXIT){return EXIT;}
+			if(add_error(errortable, ec, *cl, ": error! Label with non-alphanumeric characters", esize) == EXIT){return EXIT;}
 			return 0;
 		}
 	}
-	for(i = 0; i < *lac; i++)
+	if(lsp_note_name(LSP_NAME_CHECK, str, *ec) == EXIT){return EXIT;}
+	for(i = find_label(labeltable, *lac, str); i >= 0; i = next_label(labeltable, *lac, i))
 	{
-		if(strcmp(labeltable[i].name, str) == 0)
+		if(labeltable[i].en == ENTRY)
 		{
-			if(labeltable[i].en == ENTRY)
+			if(labeltable[i].type != 0 || labeltable[i].index != 0)
 			{
-				if(labeltable[i].type != 0 || labeltable[i].index != 0)
-				{
-					if(add_error(&errortable, ec, *cl, ": error! Label name already defined", esize) == EXIT){return EXIT;}
-					return 0;
-				}
-			}
-			else if(labeltable[i].en == EXTERN)
-			{
-				if(add_error(&errortable, ec, *cl, ": error! Label name already defined as external", esize) == EXIT){return EXIT;}
-				return 0;
-			}
-			else
-			{
-				if(add_error(&errortable, ec, *cl, ": error! Label name already defined", esize) == EXIT){return EXIT;}
+				if(add_error(errortable, ec, *cl, ": error! Label name already defined", esize) == EXIT){return EXIT;}
 				return 0;
 			}
 		}
-		
+		else if(labeltable[i].en == EXTERN)
+		{
+			if(add_error(errortable, ec, *cl, ": error! Label name already defined as external", esize) == EXIT){return EXIT;}
+			return 0;
+		}
+		else
+		{
+			if(add_error(errortable, ec, *cl, ": error! Label name already defined", esize) == EXIT){return EXIT;}
+			return 0;
+		}
 	}
 	if(is_reserved_word(str) == 1)
 	{
-		if(add_error(&errortable, ec, *cl, ": error! The label name is a reserved word", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! The label name is a reserved word", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	if(same_name_as_macro(macrostable, str) == 1)
 	{
-		if(add_error(&errortable, ec, *cl, ": error! The label name has already been defined as a macro", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! The label name has already been defined as a macro", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	return 1;
@@ -109,7 +106,7 @@ int is_label(char str[])
  * directives, and entry/extern commands to classify its type.
  *
  * @param str The command string to check.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
  * @param check_for_valid A flag indicating whether to add an error if the type is not recognized.
@@ -117,14 +114,14 @@ int is_label(char str[])
  * @return An integer representing the type (DIRECTIVE, INSTRUCTION, ENTRY, EXTERN),
  * -1 if unrecognized, or EXIT on memory error.
  */
-int which_type(char str[], struct error *errortable, int *ec, int *cl, int check_for_valid, int *esize)
+int which_type(char str[], struct error **errortable, int *ec, int *cl, int check_for_valid, int *esize)
 {
 	if (str == NULL)
 	{
-		if(add_error(&errortable, ec, *cl, ": error! Unrecognized command name", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! Unrecognized command name", esize) == EXIT){return EXIT;}
 		return -1;
 	}
-	if(strcmp(str,".data")==0||strcmp(str,".string")==0||strcmp(str,".mat")==0)
+	if(strcmp(str,".data")==0||strcmp(str,".string")==0||strcmp(str,".mat")==0||strcmp(str,INCBIN_DIRECTIVE)==0)
 	{
 		return DIRECTIVE;
 	}
@@ -142,7 +139,7 @@ int which_type(char str[], struct error *errortable, int *ec, int *cl, int check
 	}
 	if(check_for_valid == UPDATE)
 	{
-		if(add_error(&errortable, ec, *cl, ": error! Unrecognized command name", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! Unrecognized command name", esize) == EXIT){return EXIT;}
 	}
 	return -1;
 
@@ -156,10 +153,10 @@ int which_type(char str[], struct error *errortable, int *ec, int *cl, int check
  * instruction and data counter (`ic` and `dc`) values.
  *
  * @param str The line of assembly code to process.
- * @param instable A pointer to the instruction memory table.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
- * @param labeltable A pointer to the label memory table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param labeltable The address of the pointer to the label memory table.
  * @param extable A pointer to the external labels table.
  * @param macrostable A pointer to the macro definitions table.
  * @param lac A pointer to the label counter.
@@ -175,7 +172,7 @@ int which_type(char str[], struct error *errortable, int *ec, int *cl, int check
  * @param isize A pointer to the size of the instruction table.
  * @return 1 on success, 0 on an invalid line (with error logged), or EXIT on a critical memory error.
  */
-int first_pass(char str[], struct instructionsMemory *instable, struct dataMemory *datatable, struct error *errortable, struct labelMemory *labeltable, struct external *extable, MacroDefinition *macrostable, int *lac, int *ic, int *dc, int *ec, int *cl, int *exc, int *esize, int *lasize, int *exsize, int *dsize, int *isize)
+int first_pass(char str[], struct instructionsMemory **instable, struct dataMemory **datatable, struct error **errortable, struct labelMemory **labeltable, struct external *extable, MacroDefinition *macrostable, int *lac, int *ic, int *dc, int *ec, int *cl, int *exc, int *esize, int *lasize, int *exsize, int *dsize, int *isize)
 {
 	char *word = (char *)malloc(strlen(str) + 1);
 	char *word1 = NULL;
@@ -205,7 +202,7 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
 	{
 		if(word[i] == ':' && word[i + 1] != ' ' && word[i + 1] != '\t')
 		{
-			if(add_error(&errortable, ec, *cl, ": error! there must be a space or tab after a label", esize) == EXIT){goto clean_first;}
+			if(add_error(errortable, ec, *cl, ": error! there must be a space or tab after a label", esize) == EXIT){goto clean_first;}
 			goto clean_and_return_zero;
 		}
 	}
@@ -213,12 +210,12 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
 	{
 		word1[strlen(word1)-1] = '\0';
 		type = which_type(word2, errortable, ec, cl, UPDATE, esize);
-		valid = valid_label(word1, word2, errortable, labeltable, macrostable, ec, cl, esize, lac);
+		valid = valid_label(word1, word2, errortable, *labeltable, macrostable, ec, cl, esize, lac);
 		if(!valid|| type == -1){goto clean_and_return_zero;}
 		else if(valid == EXIT || type == EXIT){goto clean_first;}
 		if(type != EXTERN && type != ENTRY)
 		{
-			if(add_label(&labeltable, lac, word1, lasize, type, *ic, *dc) == EXIT){goto clean_first;}
+			if(add_label(labeltable, lac, word1, lasize, type, *ic, *dc) == EXIT || xref_define(word1, *cl) == EXIT || lsp_note_name(type, word1, *ec) == EXIT){goto clean_first;}
 		}
 		strptr = string_without_first_word(str, delimiters);
 		type = which_type(word2, errortable, ec, cl, UPDATE, esize);
@@ -247,7 +244,7 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
 	}
 	else if(type == INSTRUCTION)
 	{
-		if(instruction(strptr, instable, errortable, ic, ec, cl, isize, esize) == EXIT){goto clean_first;}
+		if(cached_instruction(strptr, instable, errortable, ic, ec, cl, isize, esize) == EXIT){goto clean_first;}
 	}
 	else if(type == EXTERN)
 	{
@@ -256,11 +253,11 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
 		word3 = strtok(NULL, delims);
 		if(word3 != NULL)
 		{
-			if(add_error(&errortable, ec, *cl, ": error! invalid external label", esize) == EXIT){goto clean_first;}
+			if(add_error(errortable, ec, *cl, ": error! invalid external label", esize) == EXIT){goto clean_first;}
 		}
 		else
 		{
-			if(add_label(&labeltable, lac, word2, lasize, EXTERN, 0, 0) == EXIT){goto clean_first;}
+			if(add_label(labeltable, lac, word2, lasize, EXTERN, 0, 0) == EXIT || xref_define(word2, *cl) == EXIT || lsp_note_name(EXTERN, word2, *ec) == EXIT){goto clean_first;}
 		}
 	}
 	else if(type == ENTRY)
@@ -270,11 +267,11 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
 		word3 = strtok(NULL, delims);
 		if(word3 != NULL)
 		{
-			if(add_error(&errortable, ec, *cl, ": error! invalid enternal label", esize) == EXIT){goto clean_first;}
+			if(add_error(errortable, ec, *cl, ": error! invalid enternal label", esize) == EXIT){goto clean_first;}
 		}
 		else
 		{
-			if(search_entery_and_update(word2, labeltable, errortable, lac, ec, cl, lasize, esize) == EXIT){goto clean_first;}
+			if(lsp_note_name(ENTRY, word2, *ec) == EXIT || search_entery_and_update(word2, labeltable, errortable, lac, ec, cl, lasize, esize) == EXIT){goto clean_first;}
 		}
 	}
 	free(word);
@@ -298,17 +295,15 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
 /**
  * @brief Manages the two-pass assembly process.
  *
- * This function orchestrates the assembly by first reading the entire file into memory.
- * It then calls `first_pass` for each line to build the symbol table and calculate
- * memory sizes. After updating symbol table indices, it calls `second_pass` to
- * encode the instructions and data.
+ * This function reads the entire file into memory and hands the lines to
+ * `passes_lines`, which runs the first and second passes over them.
  *
  * @param namefile The name of the file to process (typically the .am file).
- * @param instable A pointer to the instruction memory table.
- * @param labeltable A pointer to the label memory table.
- * @param errortable A pointer to the error table.
- * @param extable A pointer to the external labels table.
- * @param datatable A pointer to the data memory table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param datatable The address of the pointer to the data memory table.
  * @param macrostable A pointer to the macro definitions table.
  * @param ic A pointer to the instruction counter.
  * @param dc A pointer to the data counter.
@@ -322,50 +317,159 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
  * @param exsize A pointer to the size of the external table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int passes(char namefile[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct error *errortable, struct external *extable, struct dataMemory *datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize)
+int passes(char namefile[], struct instructionsMemory **instable, struct labelMemory **labeltable, struct error **errortable, struct external **extable, struct dataMemory **datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize)
 {
-	int numline = 0, i = 0, ic2 = 0;
+	int numline = 0, status;
 	char **command = read_file(namefile, &numline, errortable, ec, esize);
 	if(command == NULL)
 	{
 		return EXIT;
 	}
+	status = passes_lines(command, numline, instable, labeltable, errortable, extable, datatable, macrostable, ic, dc, ec, lac, exc, isize, dsize, esize, lasize, exsize, NULL);
+	free_lines(command, numline);
+	return status;
+}
+
+/**
+ * @brief Runs the two assembly passes over lines held in memory.
+ *
+ * The passes are also available separately, as `first_pass_lines` and
+ * `second_pass_lines`, for callers that measure them one at a time.
+ *
+ * @param command The lines of the pre-assembled source.
+ * @param numline The number of lines.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param macrostable A pointer to the macro definitions table.
+ * @param ic A pointer to the instruction counter.
+ * @param dc A pointer to the data counter.
+ * @param ec A pointer to the error counter.
+ * @param lac A pointer to the label counter.
+ * @param exc A pointer to the external counter.
+ * @param isize A pointer to the size of the instruction table.
+ * @param dsize A pointer to the size of the data table.
+ * @param esize A pointer to the size of the error table.
+ * @param lasize A pointer to the size of the label table.
+ * @param exsize A pointer to the size of the external table.
+ * @param sizes An array that receives the words allocated for every line, or NULL.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int passes_lines(char **command, int numline, struct instructionsMemory **instable, struct labelMemory **labeltable, struct error **errortable, struct external **extable, struct dataMemory **datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize, struct line_size *sizes)
+{
+	if(first_pass_lines(command, numline, instable, labeltable, errortable, extable, datatable, macrostable, ic, dc, ec, lac, exc, isize, dsize, esize, lasize, exsize, sizes) == EXIT){return EXIT;}
+	return second_pass_lines(command, numline, *instable, *labeltable, errortable, extable, ec, lac, exc, esize, exsize);
+}
+
+/**
+ * @brief Runs the first pass over lines held in memory and resolves the label addresses.
+ *
+ * It calls `first_pass` for each line to build the symbol table and calculate
+ * memory sizes, then updates the symbol table indices. Lines longer than the
+ * maximum line length are reported and skipped, as `read_file` does for lines
+ * read from a file. When `sizes` is given, the words every line adds to `ic`
+ * and `dc` are recorded for the size report.
+ *
+ * @param command The lines of the pre-assembled source.
+ * @param numline The number of lines.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param macrostable A pointer to the macro definitions table.
+ * @param ic A pointer to the instruction counter.
+ * @param dc A pointer to the data counter.
+ * @param ec A pointer to the error counter.
+ * @param lac A pointer to the label counter.
+ * @param exc A pointer to the external counter.
+ * @param isize A pointer to the size of the instruction table.
+ * @param dsize A pointer to the size of the data table.
+ * @param esize A pointer to the size of the error table.
+ * @param lasize A pointer to the size of the label table.
+ * @param exsize A pointer to the size of the external table.
+ * @param sizes An array that receives the words allocated for every line, or NULL.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int first_pass_lines(char **command, int numline, struct instructionsMemory **instable, struct labelMemory **labeltable, struct error **errortable, struct external **extable, struct dataMemory **datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize, struct line_size *sizes)
+{
+	int i = 0, line, before_ic, before_dc;
+	double start = trace_begin();
 	for(; i < numline; i++)
 	{
+		if(i % METRICS_POLL_LINES == 0)
+		{
+			metrics_poll();
+		}
 		if(command[i] != NULL)
 		{
-			if(!only_spaces_and_tabs(command[i]) && command[i][0] != ';')
+			if(strlen(command[i]) > MAX_LINE_LENGTH)
 			{
-				if(first_pass(command[i], instable, datatable, errortable, labeltable, extable, macrostable, lac, ic, dc, ec, &i, exc, esize, lasize, exsize, dsize, isize) == EXIT){goto clean_command;}
+				if(add_error(errortable, ec, i, ": line is longer than 80 characters", esize) == EXIT){return EXIT;}
+			}
+			else if(!only_spaces_and_tabs(command[i]) && command[i][0] != ';')
+			{
+				line = i;
+				before_ic = *ic;
+				before_dc = *dc;
+				if(first_pass(command[i], instable, datatable, errortable, labeltable, *extable, macrostable, lac, ic, dc, ec, &i, exc, esize, lasize, exsize, dsize, isize) == EXIT){return EXIT;}
+				if(sizes != NULL)
+				{
+					sizes[line].ic += *ic - before_ic;
+					sizes[line].dc += *dc - before_dc;
+				}
 			}
 		}
 	}
-	index_update(labeltable, lac, ic);
+	trace_end("first pass", NULL, start);
+	start = trace_begin();
+	index_update(*labeltable, lac, ic);
+	trace_end("index_update", NULL, start);
+	return 1;
+}
+
+/**
+ * @brief Runs the second pass over lines held in memory.
+ *
+ * It calls `second_pass` for each line the first pass accepted, to encode the
+ * label operands and record the external references.
+ *
+ * @param command The lines of the pre-assembled source.
+ * @param numline The number of lines.
+ * @param instable A pointer to the instruction memory table.
+ * @param labeltable A pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param ec A pointer to the error counter.
+ * @param lac A pointer to the label counter.
+ * @param exc A pointer to the external counter.
+ * @param esize A pointer to the size of the error table.
+ * @param exsize A pointer to the size of the external table.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int second_pass_lines(char **command, int numline, struct instructionsMemory *instable, struct labelMemory *labeltable, struct error **errortable, struct external **extable, int *ec, int *lac, int *exc, int *esize, int *exsize)
+{
+	int i, ic2 = 0;
+	double start = trace_begin();
 	for(i = 0; i < numline; i++)
 	{
-		if(command[i] != NULL)
+		if(i % METRICS_POLL_LINES == 0)
+		{
+			metrics_poll();
+		}
+		if(command[i] != NULL && strlen(command[i]) <= MAX_LINE_LENGTH)
 		{
 			if(!only_spaces_and_tabs(command[i]) && command[i][0] != ';')
 			{
-				if(second_pass(command[i], instable, labeltable, errortable, extable, ec, lac, exsize, esize, exc, &i, &ic2) == EXIT){goto clean_command;}
+				if(second_pass(command[i], instable, labeltable, errortable, extable, ec, lac, exsize, esize, exc, &i, &ic2) == EXIT){return EXIT;}
 			}
 		}
 
 	}
-	for(i = 0; i < numline; i++)
-	{
-		free(command[i]);
-	}
-	free(command);
+	trace_end("second pass", NULL, start);
 	return 1;
-
-	clean_command:
-			for(i = 0; i < numline; i++)
-			{
-				free(command[i]);
-			}
-			free(command);
-			return EXIT;
 }
 
 /**
@@ -377,8 +481,8 @@ int passes(char namefile[], struct instructionsMemory *instable, struct labelMem
  * as an EXTERN or ENTRY.
  *
  * @param str The name of the entry label to search for.
- * @param labeltable A pointer to the label memory table.
- * @param errortable A pointer to the error table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param lac A pointer to the label counter.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
@@ -386,30 +490,27 @@ int passes(char namefile[], struct instructionsMemory *instable, struct labelMem
  * @param esize A pointer to the size of the error table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int search_entery_and_update(char str[], struct labelMemory *labeltable, struct error *errortable, int *lac, int *ec, int *cl, int *lasize, int *esize)
+int search_entery_and_update(char str[], struct labelMemory **labeltable, struct error **errortable, int *lac, int *ec, int *cl, int *lasize, int *esize)
 {
-	int i = 0, flag = 0;
-	for(; i < (*lac); i++)
+	int i, flag = 0;
+	for(i = find_label(*labeltable, *lac, str); i >= 0; i = next_label(*labeltable, *lac, i))
 	{
-		if(strcmp(labeltable[i].name, str) == 0)
+		if((*labeltable)[i].en != ENTRY && (*labeltable)[i].en != EXTERN)
 		{
-			if(labeltable[i].en != ENTRY && labeltable[i].en != EXTERN)
-			{
-				labeltable[i].en = ENTRY;
-				flag = 1;
-			}
-			else
+			(*labeltable)[i].en = ENTRY;
+			flag = 1;
+		}
+		else
+		{
+			if(add_error(errortable, ec, *cl, ": error! invalid enternal label", esize) == EXIT)
 			{
-				if(add_error(&errortable, ec, *cl, ": error! invalid enternal label", esize) == EXIT)
-				{
-					return EXIT;
-				}
+				return EXIT;
 			}
 		}
 	}
 	if(flag == 0)
 	{
-		if(add_label(&labeltable, lac, str, lasize, ENTRY, 0, 0) == EXIT)
+		if(add_label(labeltable, lac, str, lasize, ENTRY, 0, 0) == EXIT)
 		{
 			return EXIT;
 		}
@@ -74,7 +74,7 @@
  * @brief Validates a given label name.
  * @param str The string to be validated as a label.
  * @param word2 The second word on the line, typically the command.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param labeltable A pointer to the label memory table.
  * @param macrostable A pointer to the macro definitions table.
  * @param ec A pointer to the error counter.
@@ -83,7 +83,7 @@
  * @param lac A pointer to the number of labels in the label table.
  * @return 1 if the label is valid, 0 if it's invalid, or EXIT on memory error.
  */
-int valid_label(char str[], char word2[], struct error *errortable, struct labelMemory *labeltable, MacroDefinition *macrostable, int *ec, int *cl,  int *esize, int *lac);
+int valid_label(char str[], char word2[], struct error **errortable, struct labelMemory *labeltable, MacroDefinition *macrostable, int *ec, int *cl,  int *esize, int *lac);
 
 /**
  * @brief Checks if a string is a label by looking for a colon at the end.
@@ -95,20 +95,20 @@ int is_label(char str[]);
 /**
  * @brief Determines the type of a command or directive string.
  * @param str The command string to check.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
  * @param check_for_valid A flag indicating whether to add an error if the type is not recognized.
  * @param esize A pointer to the size of the error table.
  * @return An integer representing the type (DIRECTIVE, INSTRUCTION, etc.), -1 if unrecognized, or EXIT on memory error.
  */
-int which_type(char str[], struct error *errortable, int *ec, int *cl, int check_for_valid, int *esize);
+int which_type(char str[], struct error **errortable, int *ec, int *cl, int check_for_valid, int *esize);
 
 /**
  * @brief Searches for and updates an entry label in the label table.
  * @param str The name of the entry label to search for.
- * @param labeltable A pointer to the label memory table.
- * @param errortable A pointer to the error table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param lac A pointer to the label counter.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
@@ -116,15 +116,15 @@ int which_type(char str[], struct error *errortable, int *ec, int *cl, int check
  * @param esize A pointer to the size of the error table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int search_entery_and_update(char str[], struct labelMemory *labeltable, struct error *errortable, int *lac, int *ec, int *cl, int *lasize, int *esize);
+int search_entery_and_update(char str[], struct labelMemory **labeltable, struct error **errortable, int *lac, int *ec, int *cl, int *lasize, int *esize);
 
 /**
  * @brief Performs the first pass of the assembler.
  * @param str The line of assembly code to process.
- * @param instable A pointer to the instruction memory table.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
- * @param labeltable A pointer to the label memory table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param labeltable The address of the pointer to the label memory table.
  * @param extable A pointer to the external labels table.
  * @param macrostable A pointer to the macro definitions table.
  * @param lac A pointer to the label counter.
@@ -140,16 +140,40 @@ int search_entery_and_update(char str[], struct labelMemory *labeltable, struct
  * @param isize A pointer to the size of the instruction table.
  * @return 1 on success, 0 on an invalid line (with error logged), or EXIT on a critical memory error.
  */
-int first_pass(char str[], struct instructionsMemory *instable, struct dataMemory *datatable, struct error *errortable, struct labelMemory *labeltable, struct external *extable, MacroDefinition *macrostable, int *lac, int *ic, int *dc, int *ec, int *cl, int *exc, int *esize, int *lasize, int *exsize, int *dsize, int *isize);
+int first_pass(char str[], struct instructionsMemory **instable, struct dataMemory **datatable, struct error **errortable, struct labelMemory **labeltable, struct external *extable, MacroDefinition *macrostable, int *lac, int *ic, int *dc, int *ec, int *cl, int *exc, int *esize, int *lasize, int *exsize, int *dsize, int *isize);
 
 /**
  * @brief Manages the two-pass assembly process.
  * @param namefile The name of the file to process (typically the .am file).
- * @param instable A pointer to the instruction memory table.
- * @param labeltable A pointer to the label memory table.
- * @param errortable A pointer to the error table.
- * @param extable A pointer to the external labels table.
- * @param datatable A pointer to the data memory table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param macrostable A pointer to the macro definitions table.
+ * @param ic A pointer to the instruction counter.
+ * @param dc A pointer to the data counter.
+ * @param ec A pointer to the error counter.
+ * @param lac A pointer to the label counter.
+ * @param exc A pointer to the external counter.
+ * @param isize A pointer to the size of the instruction table.
+ * @param dsize A pointer to the size of the data table.
+ * @param esize A pointer to the size of the error table.
+ * @param lasize A pointer to the size of the label table.
+ * @param exsize A pointer to the size of the external table.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int passes(char namefile[], struct instructionsMemory **instable, struct labelMemory **labeltable, struct error **errortable, struct external **extable, struct dataMemory **datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize);
+
+/**
+ * @brief Runs the two assembly passes over lines held in memory.
+ * @param command The lines of the pre-assembled source.
+ * @param numline The number of lines.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param datatable The address of the pointer to the data memory table.
  * @param macrostable A pointer to the macro definitions table.
  * @param ic A pointer to the instruction counter.
  * @param dc A pointer to the data counter.
@@ -161,9 +185,52 @@ int first_pass(char str[], struct instructionsMemory *instable, struct dataMemor
  * @param esize A pointer to the size of the error table.
  * @param lasize A pointer to the size of the label table.
  * @param exsize A pointer to the size of the external table.
+ * @param sizes An array that receives the words allocated for every line, or NULL.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int passes_lines(char **command, int numline, struct instructionsMemory **instable, struct labelMemory **labeltable, struct error **errortable, struct external **extable, struct dataMemory **datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize, struct line_size *sizes);
+
+/**
+ * @brief Runs the first pass over lines held in memory and resolves the label addresses.
+ * @param command The lines of the pre-assembled source.
+ * @param numline The number of lines.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param labeltable The address of the pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param macrostable A pointer to the macro definitions table.
+ * @param ic A pointer to the instruction counter.
+ * @param dc A pointer to the data counter.
+ * @param ec A pointer to the error counter.
+ * @param lac A pointer to the label counter.
+ * @param exc A pointer to the external counter.
+ * @param isize A pointer to the size of the instruction table.
+ * @param dsize A pointer to the size of the data table.
+ * @param esize A pointer to the size of the error table.
+ * @param lasize A pointer to the size of the label table.
+ * @param exsize A pointer to the size of the external table.
+ * @param sizes An array that receives the words allocated for every line, or NULL.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int first_pass_lines(char **command, int numline, struct instructionsMemory **instable, struct labelMemory **labeltable, struct error **errortable, struct external **extable, struct dataMemory **datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize, struct line_size *sizes);
+
+/**
+ * @brief Runs the second pass over lines held in memory.
+ * @param command The lines of the pre-assembled source.
+ * @param numline The number of lines.
+ * @param instable A pointer to the instruction memory table.
+ * @param labeltable A pointer to the label memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param ec A pointer to the error counter.
+ * @param lac A pointer to the label counter.
+ * @param exc A pointer to the external counter.
+ * @param esize A pointer to the size of the error table.
+ * @param exsize A pointer to the size of the external table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int passes(char namefile[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct error *errortable, struct external *extable, struct dataMemory *datatable, MacroDefinition *macrostable, int *ic, int *dc, int *ec, int *lac, int *exc, int *isize, int *dsize, int *esize, int *lasize, int *exsize);
+int second_pass_lines(char **command, int numline, struct instructionsMemory *instable, struct labelMemory *labeltable, struct error **errortable, struct external **extable, int *ec, int *lac, int *exc, int *esize, int *exsize);
 
 /**
  * @brief Extracts a string without its first word.
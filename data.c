@@ -1,5 +1,9 @@
 #include "data.h"
 
+int CHECK_ONLY = 0;
+
+struct label_index LABEL_INDEX;
+
 /**
  * @brief Allocates memory for the instruction table.
  *
@@ -28,7 +32,8 @@ struct instructionsMemory* allocated_memory_table()
  *
  * This function dynamically allocates an array of `struct labelMemory`
  * to store information about all labels (symbols) defined in the assembly
- * source file. The memory is initialized to zero.
+ * source file. The memory is initialized to zero, and the label index is
+ * emptied for the new table.
  *
  * @return A pointer to the newly allocated label table, or NULL if
  * memory allocation fails.
@@ -42,6 +47,7 @@ struct labelMemory* allocated_label_table()
 		fprintf(stdout,"Memory allocation failed");
 		return NULL;
 	}
+	reset_label_index();
 	return labeltable;
 }
 
@@ -173,7 +179,7 @@ int add_label(struct labelMemory **labeltable, int *lac, char str[], int *lasize
 	if(*lac >= *lasize)
 	{
 		(*lasize) = (*lasize) * DOUBLE;
-		new_labeltable = (struct labelMemory*)realloc(*labeltable, (*lasize) * sizeof(struct labelMemory));
+		new_labeltable = (struct labelMemory*)spill_resize(*labeltable, ((*lasize) / DOUBLE) * sizeof(struct labelMemory), (*lasize) * sizeof(struct labelMemory));
 		if(new_labeltable == NULL)
 		{
 			fprintf(stdout,"Memory allocation failed");
@@ -212,7 +218,8 @@ int add_label(struct labelMemory **labeltable, int *lac, char str[], int *lasize
  *
  * This function stores an integer value into the data memory table. The value
  * typically comes from a `.data` or `.string` directive. It handles
- * reallocation if the table reaches its capacity.
+ * reallocation if the table reaches its capacity. In `--check` mode it only
+ * counts the value.
  *
  * @param datatable A pointer to a pointer to the data table.
  * @param val The integer value to be stored.
@@ -223,10 +230,15 @@ int add_label(struct labelMemory **labeltable, int *lac, char str[], int *lasize
 int add_data(struct dataMemory **datatable, int val,int *dc,int *dsize)
 {
 	struct dataMemory *new_datatable;
+	if(CHECK_ONLY)
+	{
+		(*dc)++;
+		return 1;
+	}
 	if(*dc >= *dsize)
 	{
 		(*dsize) = (*dsize) * DOUBLE;
-		new_datatable = (struct dataMemory*)realloc(*datatable, (*dsize) * sizeof(struct dataMemory));
+		new_datatable = (struct dataMemory*)spill_resize(*datatable, ((*dsize) / DOUBLE) * sizeof(struct dataMemory), (*dsize) * sizeof(struct dataMemory));
 		if(new_datatable == NULL)
 		{
 			fprintf(stdout,"Memory allocation failed");
@@ -239,13 +251,61 @@ int add_data(struct dataMemory **datatable, int val,int *dc,int *dsize)
 	return 1;
 }
 
+/**
+ * @brief Adds a block of data values to the data memory table with one capacity check.
+ *
+ * This is `add_data` for the values of a bulk read such as `.incbin`: the
+ * table grows once to fit the whole block instead of being checked for every
+ * value. In `--check` mode it only counts the values.
+ *
+ * @param datatable A pointer to a pointer to the data table.
+ * @param values The values to be stored, already range-checked.
+ * @param count The number of values.
+ * @param dc A pointer to the data counter.
+ * @param dsize A pointer to the current size of the data table.
+ * @return 1 on success, or EXIT on a memory reallocation failure.
+ */
+int add_data_block(struct dataMemory **datatable, const int *values, int count, int *dc, int *dsize)
+{
+	struct dataMemory *new_datatable, *slot;
+	int size = *dsize, i;
+	if(CHECK_ONLY)
+	{
+		(*dc) += count;
+		return 1;
+	}
+	while(*dc + count > size)
+	{
+		size *= DOUBLE;
+	}
+	if(size != *dsize)
+	{
+		new_datatable = (struct dataMemory*)spill_resize(*datatable, (*dsize) * sizeof(struct dataMemory), size * sizeof(struct dataMemory));
+		if(new_datatable == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		*datatable = new_datatable;
+		*dsize = size;
+	}
+	slot = *datatable + *dc;
+	for(i = 0; i < count; i++)
+	{
+		slot[i].address = values[i];
+	}
+	(*dc) += count;
+	return 1;
+}
+
 /**
  * @brief Adds an instruction or operand word to the instruction table.
  *
  * This is a versatile function that adds a new machine code word to the
  * instruction table. It handles three types of records: command words,
  * register words, and address words, each with its specific data structure.
- * It also manages memory reallocation if the table fills up.
+ * It also manages memory reallocation if the table fills up. In `--check`
+ * mode it only counts the word.
  *
  * @param instable A pointer to a pointer to the instruction table.
  * @param ic A pointer to the instruction counter.
@@ -261,10 +321,15 @@ int add_data(struct dataMemory **datatable, int val,int *dc,int *dsize)
 int add_ins(struct instructionsMemory **instable, int *ic, int *isize, enum RecordType type, int val, int operand1, int operand2, int are, int address)
 {
 	struct instructionsMemory *new_instable;
+	if(CHECK_ONLY)
+	{
+		(*ic)++;
+		return 1;
+	}
 	if(*ic >= *isize)
 	{
 		(*isize) = (*isize) * DOUBLE;
-		new_instable = (struct instructionsMemory*)realloc(*instable, (*isize) * sizeof(struct instructionsMemory));
+		new_instable = (struct instructionsMemory*)spill_resize(*instable, ((*isize) / DOUBLE) * sizeof(struct instructionsMemory), (*isize) * sizeof(struct instructionsMemory));
 		if(new_instable == NULL)
 		{
 			fprintf(stdout,"Memory allocation failed");
@@ -297,6 +362,49 @@ int add_ins(struct instructionsMemory **instable, int *ic, int *isize, enum Reco
 	return 1;
 }
 
+/**
+ * @brief Adds a block of finished instruction words to the instruction table with one capacity check.
+ *
+ * This is `add_ins` for the words of a line found in the instruction cache:
+ * they are copied as they are, after the table has grown once to fit them.
+ * In `--check` mode it only counts the words.
+ *
+ * @param instable A pointer to a pointer to the instruction table.
+ * @param words The words to copy.
+ * @param count The number of words.
+ * @param ic A pointer to the instruction counter.
+ * @param isize A pointer to the current size of the instruction table.
+ * @return 1 on success, or EXIT on a memory reallocation failure.
+ */
+int add_ins_block(struct instructionsMemory **instable, const struct instructionsMemory *words, int count, int *ic, int *isize)
+{
+	struct instructionsMemory *new_instable;
+	int size = *isize;
+	if(CHECK_ONLY)
+	{
+		(*ic) += count;
+		return 1;
+	}
+	while(*ic + count > size)
+	{
+		size *= DOUBLE;
+	}
+	if(size != *isize)
+	{
+		new_instable = (struct instructionsMemory*)spill_resize(*instable, (*isize) * sizeof(struct instructionsMemory), size * sizeof(struct instructionsMemory));
+		if(new_instable == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		*instable = new_instable;
+		*isize = size;
+	}
+	memcpy(*instable + *ic, words, count * sizeof(struct instructionsMemory));
+	(*ic) += count;
+	return 1;
+}
+
 /**
  * @brief Adds an external label to the external table.
  *
@@ -357,7 +465,7 @@ void print_error(struct error *errortable, int ec)
  * This function generates the `.ent` output file. It iterates through the
  * label table and prints the name and final memory address of any label
  * that is marked as `entry`. The address is converted to a special
- * base-4 format.
+ * base-4 format. The file is only replaced if its contents changed.
  *
  * @param name The name of the output file.
  * @param labeltable A pointer to the label table.
@@ -369,7 +477,7 @@ int print_entry(char name[], struct labelMemory *labeltable, int *lac)
 	FILE *fileptr;
 	int i = 0;
 	char *word;
-	fileptr = fopen(name, "wb");
+	fileptr = open_image(name, "wb");
 	if (fileptr == NULL)
 	{
 		fprintf(stdout,"error opening file!\n");
@@ -385,10 +493,15 @@ int print_entry(char name[], struct labelMemory *labeltable, int *lac)
 			free(word);
 		}
 	}
-	fclose(fileptr);
-	return 1;
+	if(fclose(fileptr) != 0)
+	{
+		discard_image(name);
+		return EXIT;
+	}
+	return (commit_image(name) == EXIT) ? EXIT : 1;
 	clean:
 		fclose(fileptr);
+		discard_image(name);
 		free(word);
 		return EXIT;
 }
@@ -399,7 +512,7 @@ int print_entry(char name[], struct labelMemory *labeltable, int *lac)
  * This function generates the `.ext` output file. It iterates through the
  * external table and prints the name of each external label along with the
  * memory address where it was referenced. The address is converted to a
- * special base-4 format.
+ * special base-4 format. The file is only replaced if its contents changed.
  *
  * @param name The name of the output file.
  * @param extable A pointer to the external table.
@@ -411,7 +524,7 @@ int print_extern(char name[], struct external *extable, int exc)
 	FILE *fileptr;
 	int i = 0;
 	char *word;
-	fileptr = fopen(name, "wb");
+	fileptr = open_image(name, "wb");
 	if (fileptr == NULL)
 	{
 		printf("error opening file!\n");
@@ -424,10 +537,15 @@ int print_extern(char name[], struct external *extable, int exc)
 		fprintf(fileptr, "%s	%s\n", extable[i].name, word);
 		free(word);
 	}
-	fclose(fileptr);
-	return 1;
+	if(fclose(fileptr) != 0)
+	{
+		discard_image(name);
+		return EXIT;
+	}
+	return (commit_image(name) == EXIT) ? EXIT : 1;
 	clean:
 		fclose(fileptr);
+		discard_image(name);
 		free(word);
 		return EXIT;
 }
@@ -437,8 +555,8 @@ int print_extern(char name[], struct external *extable, int exc)
  *
  * This is the main function for generating the `.ob` output file. It prints
  * the final instruction and data counter values, followed by the machine code
- * for all instructions and data. The addresses and code are converted to a
- * special base-4 format before being written to the file.
+ * for all instructions and data, in the special base-4 format. The tables are
+ * encoded into machine words once and written by the `base4` emitter.
  *
  * @param name The name of the output file.
  * @param instable A pointer to the instruction table.
@@ -449,101 +567,7 @@ int print_extern(char name[], struct external *extable, int exc)
  */
 int print_object(char name[], struct instructionsMemory *instable, struct dataMemory *datatable, int ic, int dc)
 {
-	FILE *fileptr;
-	int i = 0, j = 0, c = 0, d = 0;
-	char *index, *word1, *word2, *word3, *word4;
-	fileptr = fopen(name, "wb");
-	if (fileptr == NULL)
-	{
-		fprintf(stdout,"error opening file!\n");
-		return EXIT;
-	}
-	word1 = int_to_special_base4(ic, NUM_8);
-	word2 = int_to_special_base4(dc, NUM_8);
-	if(word1 == NULL || word2 == NULL){goto cn;}
-	while(word1[c] == 'a')
-	{
-		c++;
-	}
-	while(word2[d] == 'a')
-	{
-		d++;
-	}
-	word3 = (char *)malloc(strlen(word1) - c + 1);
-	word4 = (char *)malloc(strlen(word2) - d + 1);
-	if (word3 == NULL || word4 == NULL)
-	{
-		fprintf(stdout,"error allocate!\n");
-		goto cn;
-	}
-	strcpy(word3, word1 + c);
-	strcpy(word4, word2 + d);
-	fprintf(fileptr, " %s %s\n", word3, word4);
-	free(word1);
-	free(word2);
-	free(word3);
-	free(word4);
-	for(; i < ic; i++)
-	{
-		index = int_to_special_base4((i + MEMORY_START), NUM_4);
-		if (index == NULL){goto cn;}
-		if(instable[i].type == RECORD_TYPE_COMMAND)
-		{
-			word1 = int_to_special_base4(instable[i].data.command.opcode, NUM_2);
-			word2 = int_to_special_base4(instable[i].data.command.operand1, NUM_1);
-			word3 = int_to_special_base4(instable[i].data.command.operand2, NUM_1);
-			word4 = int_to_special_base4(instable[i].data.command.ARE, NUM_1);
-			if(word1 == NULL || word2 == NULL || word3 == NULL || word4 == NULL){goto cn;}
-			fprintf(fileptr, "%s	%s%s%s%s\n", index, word1, word2, word3, word4);
-			free(word1);
-			free(word2);
-			free(word3);
-			free(word4);
-		}
-		else if(instable[i].type == RECORD_TYPE_REGISTER)
-		{
-			word1 = int_to_special_base4(instable[i].data.reg.operand1, NUM_2);
-			word2 = int_to_special_base4(instable[i].data.reg.operand2, NUM_2);
-			word3 = int_to_special_base4(instable[i].data.reg.ARE, NUM_1);
-			if(word1 == NULL || word2 == NULL || word3 == NULL){goto cn;}
-			fprintf(fileptr, "%s	%s%s%s\n", index, word1, word2, word3);
-			free(word1);
-			free(word2);
-			free(word3);
-		}
-		else if(instable[i].type == RECORD_TYPE_ADDRESS)
-		{
-			word1 = int_to_special_base4(instable[i].data.addr.address, NUM_4);
-			word2 = int_to_special_base4(instable[i].data.addr.ARE, NUM_1);
-			if (word1 == NULL || word2 == NULL){goto cn;}
-			fprintf(fileptr, "%s	%s%s\n", index, word1, word2);
-			free(word1);
-			free(word2);
-		}
-		free(index);
-
-	}
-	for(; j < dc; j++)
-	{
-		index = int_to_special_base4((i + MEMORY_START), NUM_4);
-		word1 = int_to_special_base4(datatable[j].address, NUM_5);
-		if (word1 == NULL || index == NULL){goto cn;}
-		fprintf(fileptr, "%s	%s\n", index, word1);
-		i++;
-		free(index);
-		free(word1);
-	}
-	fclose(fileptr);
-	return 1;
-
-	cn:
-	if(word1)free(word1);
-	if(word2)free(word2);
-	if(word3)free(word3);
-	if(word4)free(word4);
-	if(index)free(index);
-	fclose(fileptr);
-	return EXIT;
+	return write_object(name, find_emitter(DEFAULT_FORMAT), instable, datatable, ic, dc);
 }
 
 /**
@@ -588,39 +612,170 @@ int have_entry(struct labelMemory *labeltable, int *lac)
  */
 int search_label(struct labelMemory *labeltable, int *lac, char *str, int *lasize, int type, int ic, int dc)
 {
-	int i = 0;
-	for(; i < *lac; i++)
+	int i;
+	for(i = find_label(labeltable, *lac, str); i >= 0; i = next_label(labeltable, *lac, i))
 	{
-		if(strcmp(labeltable[i].name, str) == 0)
+		if(type == EXTERN)
 		{
-			if(type == EXTERN)
-			{
-				labeltable[i].en = EXTERN;
-				return 1;
-			}
-			else if(type == ENTRY)
-			{
-				labeltable[i].en = ENTRY;
-				return 1;
-			}
-			else if(type == INSTRUCTION || type == DIRECTIVE)
+			labeltable[i].en = EXTERN;
+			return 1;
+		}
+		else if(type == ENTRY)
+		{
+			labeltable[i].en = ENTRY;
+			return 1;
+		}
+		else if(type == INSTRUCTION || type == DIRECTIVE)
+		{
+			if(labeltable[i].en == ENTRY)
 			{
-				if(labeltable[i].en == ENTRY)
+				labeltable[i].type = (type);
+				if(type == DIRECTIVE)
 				{
-					labeltable[i].type = (type);
-					if(type == DIRECTIVE)
-					{
-						labeltable[i].index = (dc);
-						return 1;
-					}
-					else if(type == INSTRUCTION)
-					{
-						labeltable[i].index = (ic);
-						return 1;
-					}
+					labeltable[i].index = (dc);
+					return 1;
+				}
+				else if(type == INSTRUCTION)
+				{
+					labeltable[i].index = (ic);
+					return 1;
 				}
 			}
 		}
 	}
 	return 0;
 }
+
+/**
+ * @brief Computes the 32-bit FNV-1a hash of a string.
+ *
+ * @param str The string to hash.
+ * @return The hash value.
+ */
+unsigned long hash_string(const char *str)
+{
+	unsigned long hash = FNV_OFFSET_BASIS;
+	while(*str != '\0')
+	{
+		hash ^= (unsigned char)*str++;
+		hash = (hash * FNV_PRIME) & HASH_MASK;
+	}
+	return hash;
+}
+
+/**
+ * @brief Empties the label index, for a new label table.
+ *
+ * The buckets are cleared when the index is next brought up to date.
+ */
+void reset_label_index(void)
+{
+	LABEL_INDEX.table = NULL;
+	LABEL_INDEX.count = 0;
+}
+
+/**
+ * @brief Brings the label index up to date with a label table.
+ *
+ * The entries added to the table since the last call are appended to their
+ * buckets. A table other than the indexed one, or one with fewer entries, is
+ * indexed from the start; this happens when a growing table moves.
+ *
+ * @param labeltable The label table.
+ * @param lac The number of labels in the table.
+ * @return 1 if the index can be used, or 0 on a memory allocation failure.
+ */
+int sync_label_index(const struct labelMemory *labeltable, int lac)
+{
+	int *new_next, bucket, i;
+	if(LABEL_INDEX.table != labeltable || LABEL_INDEX.count > lac)
+	{
+		for(i = 0; i < LABEL_INDEX_BUCKETS; i++)
+		{
+			LABEL_INDEX.buckets[i] = -1;
+			LABEL_INDEX.tails[i] = -1;
+		}
+		LABEL_INDEX.table = labeltable;
+		LABEL_INDEX.count = 0;
+	}
+	if(lac > LABEL_INDEX.capacity)
+	{
+		new_next = (int *)realloc(LABEL_INDEX.next, (size_t)lac * DOUBLE * sizeof(int));
+		if(new_next == NULL)
+		{
+			LABEL_INDEX.table = NULL;
+			return 0;
+		}
+		LABEL_INDEX.next = new_next;
+		LABEL_INDEX.capacity = lac * DOUBLE;
+	}
+	for(i = LABEL_INDEX.count; i < lac; i++)
+	{
+		bucket = (int)(hash_string(labeltable[i].name) & (LABEL_INDEX_BUCKETS - 1));
+		LABEL_INDEX.next[i] = -1;
+		if(LABEL_INDEX.tails[bucket] < 0)
+		{
+			LABEL_INDEX.buckets[bucket] = i;
+		}
+		else
+		{
+			LABEL_INDEX.next[LABEL_INDEX.tails[bucket]] = i;
+		}
+		LABEL_INDEX.tails[bucket] = i;
+	}
+	LABEL_INDEX.count = lac;
+	return 1;
+}
+
+/**
+ * @brief Finds the first entry of the label table with a name.
+ *
+ * If the index cannot grow, the table is scanned instead.
+ *
+ * @param labeltable The label table.
+ * @param lac The number of labels in the table.
+ * @param name The name to look for.
+ * @return The index of the entry, or -1 if no label has the name.
+ */
+int find_label(const struct labelMemory *labeltable, int lac, const char *name)
+{
+	int i;
+	if(!sync_label_index(labeltable, lac))
+	{
+		for(i = 0; i < lac && strcmp(labeltable[i].name, name) != 0; i++);
+		return (i < lac) ? i : -1;
+	}
+	for(i = LABEL_INDEX.buckets[hash_string(name) & (LABEL_INDEX_BUCKETS - 1)]; i >= 0 && strcmp(labeltable[i].name, name) != 0; i = LABEL_INDEX.next[i]);
+	return i;
+}
+
+/**
+ * @brief Finds the next entry of the label table with the same name as an entry.
+ *
+ * @param labeltable The label table.
+ * @param lac The number of labels in the table.
+ * @param i The index of the entry.
+ * @return The index of the next entry, or -1 if there is none.
+ */
+int next_label(const struct labelMemory *labeltable, int lac, int i)
+{
+	const char *name = labeltable[i].name;
+	if(!sync_label_index(labeltable, lac))
+	{
+		for(i++; i < lac && strcmp(labeltable[i].name, name) != 0; i++);
+		return (i < lac) ? i : -1;
+	}
+	for(i = LABEL_INDEX.next[i]; i >= 0 && strcmp(labeltable[i].name, name) != 0; i = LABEL_INDEX.next[i]);
+	return i;
+}
+
+/**
+ * @brief Frees the label index.
+ */
+void free_label_index(void)
+{
+	free(LABEL_INDEX.next);
+	LABEL_INDEX.next = NULL;
+	LABEL_INDEX.capacity = 0;
+	reset_label_index();
+}
@@ -56,6 +56,24 @@
 #define NUM_1 1
 #define NUM_8 8
 
+/**
+ * @def FNV_OFFSET_BASIS
+ * @brief The initial value of the 32-bit FNV-1a hash.
+ */
+#define FNV_OFFSET_BASIS 2166136261UL
+
+/**
+ * @def FNV_PRIME
+ * @brief The multiplier of the 32-bit FNV-1a hash.
+ */
+#define FNV_PRIME 16777619UL
+
+/**
+ * @def HASH_MASK
+ * @brief Keeps a hash value to 32 bits on platforms with a wider `unsigned long`.
+ */
+#define HASH_MASK 0xFFFFFFFFUL
+
 /**
  * @enum RecordType
  * @brief An enumeration to differentiate between different types of machine code words.
@@ -189,10 +207,70 @@ struct dataMemory
 	unsigned int address;
 };
 
+/**
+ * @struct line_size
+ * @brief The number of words the first pass allocated for one line.
+ *
+ * - `ic`: The number of instruction words.
+ * - `dc`: The number of data words.
+ */
+struct line_size
+{
+	int ic;
+	int dc;
+};
+
+/**
+ * @def LABEL_INDEX_BUCKETS
+ * @brief The number of buckets of the label index (a power of two).
+ */
+#define LABEL_INDEX_BUCKETS 8192
+
+/**
+ * @struct label_index
+ * @brief A hash index over the names of the label table being built.
+ *
+ * Every label definition and every label operand looks a name up in the label
+ * table. The index chains the entries of each bucket in table order, so a
+ * lookup finds the entries a scan from the start would, in the same order. It
+ * follows the table lazily: the entries appended since the last lookup are
+ * added then, and a table that moved or was replaced is indexed again.
+ *
+ * - `table`: The table the index was built for, or NULL.
+ * - `count`: The number of entries indexed.
+ * - `buckets`: The first entry of every bucket, or -1.
+ * - `tails`: The last entry of every bucket, or -1.
+ * - `next`: The next entry of the same bucket, for every indexed entry, or -1.
+ * - `capacity`: The allocated size of `next`.
+ */
+struct label_index
+{
+	const struct labelMemory *table;
+	int count;
+	int buckets[LABEL_INDEX_BUCKETS];
+	int tails[LABEL_INDEX_BUCKETS];
+	int *next;
+	int capacity;
+};
+
 #include "directive.h"
 #include "second_pass.h"
 #include "assembler.h"
 
+/**
+ * @brief Non-zero in `--check` mode, where only the diagnostics are wanted.
+ *
+ * The tables then only count words: `add_ins` and `add_data` store nothing,
+ * `search_and_update` only checks that a label exists, and the pre-assembler
+ * writes no `.am` file.
+ */
+extern int CHECK_ONLY;
+
+/**
+ * @brief The index of the label table being built.
+ */
+extern struct label_index LABEL_INDEX;
+
 /* --- Function Prototypes --- */
 
 /**
@@ -243,12 +321,24 @@ int add_label(struct labelMemory **labeltable, int *lac, char str[], int *lasize
  */
 int add_data(struct dataMemory **datatable, int val,int *dc,int *dsize);
 
+/**
+ * @brief Adds a block of data values to the data memory table with one capacity check.
+ * @return 1 on success, EXIT on reallocation failure.
+ */
+int add_data_block(struct dataMemory **datatable, const int *values, int count, int *dc, int *dsize);
+
 /**
  * @brief Adds an instruction word to the instruction memory table.
  * @return 1 on success, EXIT on reallocation failure.
  */
 int add_ins(struct instructionsMemory **instable, int *ic, int *isize, enum RecordType type, int val, int operand1, int operand2, int are, int address);
 
+/**
+ * @brief Adds a block of finished instruction words to the instruction table with one capacity check.
+ * @return 1 on success, EXIT on reallocation failure.
+ */
+int add_ins_block(struct instructionsMemory **instable, const struct instructionsMemory *words, int count, int *ic, int *isize);
+
 /**
  * @brief Adds an external label reference to the external table.
  * @return 1 on success, EXIT on reallocation failure.
@@ -292,4 +382,47 @@ int have_entry(struct labelMemory *labeltable, int *lac);
  */
 int search_label(struct labelMemory *labeltable, int *lac, char *str, int *lasize, int type, int ic, int dc);
 
+/**
+ * @brief Computes the 32-bit FNV-1a hash of a string.
+ * @param str The string to hash.
+ * @return The hash value.
+ */
+unsigned long hash_string(const char *str);
+
+/**
+ * @brief Empties the label index, for a new label table.
+ */
+void reset_label_index(void);
+
+/**
+ * @brief Brings the label index up to date with a label table.
+ * @param labeltable The label table.
+ * @param lac The number of labels in the table.
+ * @return 1 if the index can be used, or 0 on a memory allocation failure.
+ */
+int sync_label_index(const struct labelMemory *labeltable, int lac);
+
+/**
+ * @brief Finds the first entry of the label table with a name.
+ * @param labeltable The label table.
+ * @param lac The number of labels in the table.
+ * @param name The name to look for.
+ * @return The index of the entry, or -1 if no label has the name.
+ */
+int find_label(const struct labelMemory *labeltable, int lac, const char *name);
+
+/**
+ * @brief Finds the next entry of the label table with the same name as an entry.
+ * @param labeltable The label table.
+ * @param lac The number of labels in the table.
+ * @param i The index of the entry.
+ * @return The index of the next entry, or -1 if there is none.
+ */
+int next_label(const struct labelMemory *labeltable, int lac, int i);
+
+/**
+ * @brief Frees the label index.
+ */
+void free_label_index(void);
+
 #endif
@@ -0,0 +1,533 @@
+#include "debug_info.h"
+
+/**
+ * @brief Writes an unsigned LEB128 number.
+ *
+ * Seven bits go into every byte, lowest first; the high bit of a byte is set
+ * when more bytes follow. Small numbers, which most rows hold, take one byte.
+ *
+ * @param bytes Receives up to `DEBUG_MAX_VARINT` bytes.
+ * @param value The number.
+ * @return The number of bytes written.
+ */
+int put_varint(unsigned char *bytes, unsigned long value)
+{
+	int count = 0;
+	do
+	{
+		bytes[count] = (unsigned char)(value & 0x7F);
+		value >>= 7;
+		if(value != 0)
+		{
+			bytes[count] |= 0x80;
+		}
+		count++;
+	} while(value != 0);
+	return count;
+}
+
+/**
+ * @brief Reads an unsigned LEB128 number.
+ *
+ * @param bytes A pointer to the position in the stream, advanced past the number.
+ * @param end The end of the stream.
+ * @param value Receives the number.
+ * @return 1 on success, or 0 if the number runs past the end or is too long.
+ */
+int get_varint(const unsigned char **bytes, const unsigned char *end, unsigned long *value)
+{
+	const unsigned char *p = *bytes;
+	int shift = 0;
+	*value = 0;
+	while(p < end && shift < DEBUG_MAX_VARINT * 7)
+	{
+		*value |= (unsigned long)(*p & 0x7F) << shift;
+		shift += 7;
+		if((*p++ & 0x80) == 0)
+		{
+			*bytes = p;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Finds or adds a name in the string table.
+ *
+ * Names are compared by content, so the same macro or file always gets the
+ * same index. A file has only a handful of distinct names, so a linear search
+ * is enough.
+ *
+ * @param table A pointer to the table.
+ * @param text The name.
+ * @param index Receives the string index.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int intern_debug_string(struct debug_table *table, const char *text, int *index)
+{
+	const char **temp;
+	int i;
+	for(i = 0; i < table->num_strings; i++)
+	{
+		if(strcmp(table->strings[i], text) == 0)
+		{
+			*index = i;
+			return 1;
+		}
+	}
+	if(table->num_strings == table->strings_capacity)
+	{
+		temp = (const char **)realloc((void *)table->strings, (table->strings_capacity + MAX_SIZE_MEMORY) * sizeof(const char *));
+		if(temp == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		table->strings = temp;
+		table->strings_capacity += MAX_SIZE_MEMORY;
+	}
+	table->strings[table->num_strings] = text;
+	*index = table->num_strings++;
+	return 1;
+}
+
+/**
+ * @brief Orders rows by address (a `qsort` comparator).
+ *
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_debug_rows(const void *a, const void *b)
+{
+	return ((const struct debug_row *)a)->address - ((const struct debug_row *)b)->address;
+}
+
+/**
+ * @brief Builds the rows of the line table from the words every line allocated.
+ *
+ * The addresses follow from the word counts as in the size report: every
+ * line's instruction words start where the previous line's ended, and data
+ * words follow all instruction words. A line from an included file is
+ * attributed to that file and line; any other line to the source file and
+ * its line there, which for a macro expansion is the invocation. With the
+ * stable layout, every address is translated through the placed blocks.
+ * The rows come out in line order, where a data line before a code line
+ * gets the higher address, so they are sorted by address at the end.
+ *
+ * @param table A pointer to an empty table.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param sizes The words the first pass allocated for every expanded line.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int collect_debug_rows(struct debug_table *table, const char *source, const ExpandedSource *expanded, const struct line_size *sizes, const struct layout_block *placed, int num_placed)
+{
+	const LineOrigin *origin;
+	const char *last_file = NULL, *last_macro = NULL;
+	struct debug_row *row;
+	int i, code, words, file = 0, macro = 0, source_index, code_address = MEMORY_START, data_address = MEMORY_START;
+
+	for(i = 0; i < expanded->count; i++)
+	{
+		data_address += sizes[i].ic;
+	}
+	table->rows = (struct debug_row *)malloc((2 * expanded->count + 1) * sizeof(struct debug_row));
+	if(table->rows == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	if(intern_debug_string(table, source, &source_index) == EXIT){return EXIT;}
+
+	for(i = 0; i < expanded->count; i++)
+	{
+		if(sizes[i].ic == 0 && sizes[i].dc == 0)
+		{
+			continue;
+		}
+		/* Consecutive lines mostly share their file and macro, so the last lookup is reused. */
+		origin = &expanded->origins[i];
+		if(origin->file == NULL)
+		{
+			file = source_index;
+		}
+		else if(origin->file != last_file)
+		{
+			if(intern_debug_string(table, origin->file, &file) == EXIT){return EXIT;}
+			last_file = origin->file;
+		}
+		if(origin->macro == NULL)
+		{
+			macro = 0;
+		}
+		else if(origin->macro != last_macro)
+		{
+			if(intern_debug_string(table, origin->macro, &macro) == EXIT){return EXIT;}
+			macro++;
+			last_macro = origin->macro;
+		}
+		for(code = 1; code >= 0; code--)
+		{
+			words = code ? sizes[i].ic : sizes[i].dc;
+			if(words == 0)
+			{
+				continue;
+			}
+			row = &table->rows[table->num_rows++];
+			row->address = code ? code_address : data_address;
+			row->words = words;
+			row->line = (origin->file != NULL) ? origin->file_line : origin->line;
+			row->file = file;
+			row->macro = macro;
+			if(placed != NULL)
+			{
+				row->address = map_layout_address(placed, num_placed, row->address);
+			}
+			if(code)
+			{
+				code_address += words;
+			}
+			else
+			{
+				data_address += words;
+			}
+		}
+	}
+	qsort(table->rows, (size_t)table->num_rows, sizeof(struct debug_row), compare_debug_rows);
+	return 1;
+}
+
+/**
+ * @brief Serializes a line table into the `.dbg` format.
+ *
+ * The rows are encoded into a scratch buffer first, noting where every block
+ * starts, since their size is only known once they are encoded; the image is
+ * then laid out in one allocation.
+ *
+ * @param table A pointer to the table, with its rows in address order.
+ * @param size Receives the size of the image.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned char *build_debug_image(const struct debug_table *table, size_t *size)
+{
+	unsigned char *stream = NULL, *image = NULL;
+	unsigned long *starts = NULL;
+	unsigned long num_blocks, b, stream_size = 0, pool_size = 0, pool_pos = 0;
+	unsigned long blocks_off, stream_off, strings_off, pool_off, line_delta;
+	const struct debug_row *row;
+	int i, previous_address = 0, previous_line = 0;
+
+	num_blocks = ((unsigned long)table->num_rows + DEBUG_BLOCK_ROWS - 1) / DEBUG_BLOCK_ROWS;
+	for(i = 0; i < table->num_strings; i++)
+	{
+		pool_size += strlen(table->strings[i]) + 1;
+	}
+	stream = (unsigned char *)malloc((size_t)table->num_rows * DEBUG_ROW_FIELDS * DEBUG_MAX_VARINT + 1);
+	starts = (unsigned long *)malloc((num_blocks + 1) * sizeof(unsigned long));
+	if(stream == NULL || starts == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		goto clean_image;
+	}
+
+	for(i = 0; i < table->num_rows; i++)
+	{
+		row = &table->rows[i];
+		if(i % DEBUG_BLOCK_ROWS == 0)
+		{
+			starts[i / DEBUG_BLOCK_ROWS] = stream_size;
+			previous_address = row->address;
+			previous_line = 0;
+		}
+		line_delta = (row->line >= previous_line) ? (unsigned long)(row->line - previous_line) * 2 : (unsigned long)(previous_line - row->line) * 2 - 1;
+		stream_size += put_varint(stream + stream_size, (unsigned long)(row->address - previous_address));
+		stream_size += put_varint(stream + stream_size, (unsigned long)row->words);
+		stream_size += put_varint(stream + stream_size, line_delta);
+		stream_size += put_varint(stream + stream_size, (unsigned long)row->file);
+		stream_size += put_varint(stream + stream_size, (unsigned long)row->macro);
+		previous_address = row->address;
+		previous_line = row->line;
+	}
+
+	blocks_off = MACRO_LIBRARY_WORD * (1 + DEBUG_HEADER_WORDS);
+	stream_off = blocks_off + num_blocks * DEBUG_BLOCK_WORDS * MACRO_LIBRARY_WORD;
+	strings_off = stream_off + stream_size;
+	pool_off = strings_off + (unsigned long)table->num_strings * MACRO_LIBRARY_WORD;
+	*size = pool_off + pool_size;
+	image = (unsigned char *)calloc(*size, 1);
+	if(image == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		goto clean_image;
+	}
+
+	memcpy(image, DEBUG_INFO_MAGIC, MACRO_LIBRARY_WORD);
+	write_word(image + MACRO_LIBRARY_WORD, (unsigned long)table->num_rows);
+	write_word(image + 2 * MACRO_LIBRARY_WORD, num_blocks);
+	write_word(image + 3 * MACRO_LIBRARY_WORD, (unsigned long)table->num_strings);
+	write_word(image + 4 * MACRO_LIBRARY_WORD, blocks_off);
+	write_word(image + 5 * MACRO_LIBRARY_WORD, stream_off);
+	write_word(image + 6 * MACRO_LIBRARY_WORD, strings_off);
+	write_word(image + 7 * MACRO_LIBRARY_WORD, pool_off);
+	write_word(image + 8 * MACRO_LIBRARY_WORD, pool_size);
+
+	for(b = 0; b < num_blocks; b++)
+	{
+		write_word(image + blocks_off + b * DEBUG_BLOCK_WORDS * MACRO_LIBRARY_WORD, (unsigned long)table->rows[b * DEBUG_BLOCK_ROWS].address);
+		write_word(image + blocks_off + (b * DEBUG_BLOCK_WORDS + 1) * MACRO_LIBRARY_WORD, starts[b]);
+	}
+	memcpy(image + stream_off, stream, stream_size);
+
+	for(i = 0; i < table->num_strings; i++)
+	{
+		write_word(image + strings_off + (unsigned long)i * MACRO_LIBRARY_WORD, pool_pos);
+		strcpy((char *)image + pool_off + pool_pos, table->strings[i]);
+		pool_pos += strlen(table->strings[i]) + 1;
+	}
+
+	clean_image:
+		free(stream);
+		free(starts);
+		return image;
+}
+
+/**
+ * @brief Writes the `.dbg` line table of a file, if it changed.
+ *
+ * @param name The name of the `.dbg` file.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param sizes The words the first pass allocated for every expanded line.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_debug_info(const char *name, const char *source, const ExpandedSource *expanded, const struct line_size *sizes, const struct layout_block *placed, int num_placed)
+{
+	struct debug_table table = {NULL, 0, NULL, 0, 0};
+	unsigned char *image = NULL;
+	size_t size;
+	FILE *fileptr;
+	int status = EXIT;
+
+	if(collect_debug_rows(&table, source, expanded, sizes, placed, num_placed) == EXIT){goto clean;}
+	image = build_debug_image(&table, &size);
+	if(image == NULL){goto clean;}
+	fileptr = open_output(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	if(fwrite(image, 1, size, fileptr) != size)
+	{
+		fprintf(stdout,"error writing file!\n");
+		fclose(fileptr);
+		discard_output(name);
+		goto clean;
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(name);
+		goto clean;
+	}
+	if(commit_output(name) == EXIT){goto clean;}
+	status = 1;
+
+	clean:
+		free(image);
+		free(table.rows);
+		free((void *)table.strings);
+		return status;
+}
+
+/**
+ * @brief Maps a `.dbg` line table into memory and checks its structure.
+ *
+ * Like a macro library, the file is mapped with `map_file` and its
+ * tables are checked against the file size once. The rows themselves are
+ * checked while they are decoded.
+ *
+ * @param name The name of the `.dbg` file.
+ * @param info A pointer to the line table to fill.
+ * @return 1 on success, or EXIT if the file cannot be mapped or is not a valid line table.
+ */
+int load_debug_info(const char *name, struct debug_info *info)
+{
+	const unsigned char *data;
+	unsigned long blocks_off, stream_off, strings_off, pool_off, pool_size, i;
+
+	memset(info, 0, sizeof(struct debug_info));
+	data = map_file(name, &info->size);
+	if(data == NULL)
+	{
+		return EXIT;
+	}
+	info->data = data;
+
+	if(info->size < MACRO_LIBRARY_WORD * (1 + DEBUG_HEADER_WORDS) || memcmp(data, DEBUG_INFO_MAGIC, MACRO_LIBRARY_WORD) != 0){goto invalid_debug_info;}
+	info->num_rows = read_word(data + MACRO_LIBRARY_WORD);
+	info->num_blocks = read_word(data + 2 * MACRO_LIBRARY_WORD);
+	info->num_strings = read_word(data + 3 * MACRO_LIBRARY_WORD);
+	blocks_off = read_word(data + 4 * MACRO_LIBRARY_WORD);
+	stream_off = read_word(data + 5 * MACRO_LIBRARY_WORD);
+	strings_off = read_word(data + 6 * MACRO_LIBRARY_WORD);
+	pool_off = read_word(data + 7 * MACRO_LIBRARY_WORD);
+	pool_size = read_word(data + 8 * MACRO_LIBRARY_WORD);
+
+	if(info->num_rows >= info->size || info->num_blocks >= info->size || info->num_strings >= info->size){goto invalid_debug_info;}
+	if(info->num_blocks != (info->num_rows + DEBUG_BLOCK_ROWS - 1) / DEBUG_BLOCK_ROWS){goto invalid_debug_info;}
+	if(blocks_off + info->num_blocks * DEBUG_BLOCK_WORDS * MACRO_LIBRARY_WORD > stream_off || stream_off > strings_off){goto invalid_debug_info;}
+	if(strings_off + info->num_strings * MACRO_LIBRARY_WORD > pool_off){goto invalid_debug_info;}
+	if(pool_size == 0 || pool_off + pool_size != info->size || data[info->size - 1] != '\0'){goto invalid_debug_info;}
+
+	info->blocks = data + blocks_off;
+	info->stream = data + stream_off;
+	info->stream_size = strings_off - stream_off;
+	info->strings = data + strings_off;
+	info->pool = (const char *)data + pool_off;
+
+	for(i = 0; i < info->num_blocks; i++)
+	{
+		if(read_word(info->blocks + (i * DEBUG_BLOCK_WORDS + 1) * MACRO_LIBRARY_WORD) >= info->stream_size){goto invalid_debug_info;}
+	}
+	for(i = 0; i < info->num_strings; i++)
+	{
+		if(read_word(info->strings + i * MACRO_LIBRARY_WORD) >= pool_size){goto invalid_debug_info;}
+	}
+	return 1;
+
+	invalid_debug_info:
+		fprintf(stdout, "invalid debug info: %s\n", name);
+		unload_debug_info(info);
+		return EXIT;
+}
+
+/**
+ * @brief Unmaps a line table.
+ *
+ * @param info A pointer to the line table.
+ */
+void unload_debug_info(struct debug_info *info)
+{
+	unmap_file(info->data, info->size);
+	memset(info, 0, sizeof(struct debug_info));
+}
+
+/**
+ * @brief Finds where the word at an address came from.
+ *
+ * The last block that starts at or before the address is found by binary
+ * search, and its rows are decoded up to the address.
+ *
+ * @param info A pointer to the line table.
+ * @param address The address.
+ * @param location Receives the location.
+ * @return 1 if the address belongs to a line, 0 otherwise.
+ */
+int find_debug_location(const struct debug_info *info, int address, struct debug_location *location)
+{
+	const unsigned char *p, *end = info->stream + info->stream_size;
+	unsigned long low = 0, high, mid, b, fields[DEBUG_ROW_FIELDS];
+	long row_address, line = 0;
+	int i, j, rows, found = 0;
+
+	if(info->num_blocks == 0 || address < (long)read_word(info->blocks))
+	{
+		return 0;
+	}
+	high = info->num_blocks - 1;
+	while(low < high)
+	{
+		mid = (low + high + 1) / 2;
+		if((long)read_word(info->blocks + mid * DEBUG_BLOCK_WORDS * MACRO_LIBRARY_WORD) <= address)
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+	b = low;
+	row_address = (long)read_word(info->blocks + b * DEBUG_BLOCK_WORDS * MACRO_LIBRARY_WORD);
+	p = info->stream + read_word(info->blocks + (b * DEBUG_BLOCK_WORDS + 1) * MACRO_LIBRARY_WORD);
+	rows = (info->num_rows - b * DEBUG_BLOCK_ROWS < DEBUG_BLOCK_ROWS) ? (int)(info->num_rows - b * DEBUG_BLOCK_ROWS) : DEBUG_BLOCK_ROWS;
+
+	for(i = 0; i < rows; i++)
+	{
+		for(j = 0; j < DEBUG_ROW_FIELDS; j++)
+		{
+			if(!get_varint(&p, end, &fields[j]))
+			{
+				return 0;
+			}
+		}
+		row_address += (long)fields[0];
+		line += (fields[2] & 1) ? -(long)((fields[2] + 1) / 2) : (long)(fields[2] / 2);
+		if(row_address > address)
+		{
+			break;
+		}
+		if(fields[3] >= info->num_strings || fields[4] > info->num_strings)
+		{
+			return 0;
+		}
+		location->address = (int)row_address;
+		location->words = (int)fields[1];
+		location->line = (int)line;
+		location->file = info->pool + read_word(info->strings + fields[3] * MACRO_LIBRARY_WORD);
+		location->macro = (fields[4] == 0) ? NULL : info->pool + read_word(info->strings + (fields[4] - 1) * MACRO_LIBRARY_WORD);
+		found = 1;
+	}
+	return found && address < location->address + location->words;
+}
+
+/**
+ * @brief Prints the source location of every address given on the command line.
+ *
+ * Every address gets one line on stdout: the address, `file:line`, and the
+ * macro if the word came from a macro expansion.
+ *
+ * @param name The name of the `.dbg` file.
+ * @param addresses The addresses, in decimal.
+ * @param count The number of addresses.
+ * @return 1 on success, 0 if an address is invalid or has no location, or EXIT if the file cannot be mapped.
+ */
+int print_debug_locations(const char *name, char **addresses, int count)
+{
+	struct debug_info info;
+	struct debug_location location;
+	char *end;
+	long address;
+	int i, status = 1;
+
+	if(load_debug_info(name, &info) == EXIT)
+	{
+		return EXIT;
+	}
+	for(i = 0; i < count; i++)
+	{
+		address = strtol(addresses[i], &end, 10);
+		if(*addresses[i] == '\0' || *end != '\0' || !find_debug_location(&info, (int)address, &location))
+		{
+			fprintf(stdout, "%s\t??\n", addresses[i]);
+			status = 0;
+		}
+		else if(location.macro != NULL)
+		{
+			fprintf(stdout, "%ld\t%s:%d\t%s\n", address, location.file, location.line, location.macro);
+		}
+		else
+		{
+			fprintf(stdout, "%ld\t%s:%d\n", address, location.file, location.line);
+		}
+	}
+	unload_debug_info(&info);
+	return status;
+}
@@ -0,0 +1,271 @@
+#ifndef DEBUG_INFO_H
+#define DEBUG_INFO_H
+
+/**
+ * @file debug_info.h
+ * @brief This header file declares the address-to-source line table.
+ *
+ * With `--debug-info`, every object file gets a `.dbg` sidecar that maps each
+ * address back to the source file and line its word came from, and to the
+ * macro whose expansion produced it. The first pass already counts the words
+ * of every expanded line and the pre-assembler already records the origin of
+ * every expanded line, so building the table only walks those two arrays.
+ *
+ * All numbers are 32-bit little-endian, as in a macro library, and all
+ * references are offsets from the start of the file:
+ *
+ * - Header: the magic "DBG1", then the number of rows, blocks and strings,
+ *   the offsets of the block table, the row stream, the string table and the
+ *   string pool, and the size of the string pool.
+ * - Blocks: for every `DEBUG_BLOCK_ROWS` rows, the address of the first row
+ *   and the offset of the first row in the row stream.
+ * - Rows: every row, in address order, as five unsigned LEB128 numbers: the
+ *   distance from the previous row's address, the number of words, the
+ *   change of line number (zigzag encoded), the string index of the file and
+ *   the string index of the macro plus one (zero for none). The first row of
+ *   a block is relative to its block's address and to line zero.
+ * - Strings: the pool offset of every file and macro name; string 0 is the
+ *   source file.
+ * - Pool: null-terminated strings.
+ *
+ * A reader maps the file with one `mmap`, finds the block by binary search
+ * and decodes at most `DEBUG_BLOCK_ROWS` rows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "pre_assembler.h"
+#include "macrolib.h"
+#include "layout.h"
+#include "assembler.h"
+
+/* The blocks of the stable layout are declared in layout.h. */
+struct layout_block;
+
+/**
+ * @def END_DEBUG_FILE_NAME
+ * @brief Suffix for the address-to-source line table.
+ */
+#define END_DEBUG_FILE_NAME ".dbg"
+
+/**
+ * @def DEBUG_INFO_MAGIC
+ * @brief The four bytes every line table starts with.
+ */
+#define DEBUG_INFO_MAGIC "DBG1"
+
+/**
+ * @def DEBUG_HEADER_WORDS
+ * @brief The number of words in the header, after the magic.
+ */
+#define DEBUG_HEADER_WORDS 8
+
+/**
+ * @def DEBUG_BLOCK_WORDS
+ * @brief The number of words in every entry of the block table.
+ */
+#define DEBUG_BLOCK_WORDS 2
+
+/**
+ * @def DEBUG_BLOCK_ROWS
+ * @brief The number of rows a block table entry covers.
+ */
+#define DEBUG_BLOCK_ROWS 16
+
+/**
+ * @def DEBUG_ROW_FIELDS
+ * @brief The number of LEB128 numbers in every row.
+ */
+#define DEBUG_ROW_FIELDS 5
+
+/**
+ * @def DEBUG_MAX_VARINT
+ * @brief The most bytes a 32-bit LEB128 number takes.
+ */
+#define DEBUG_MAX_VARINT 5
+
+/**
+ * @struct debug_row
+ * @brief The words one expanded line allocated in one segment.
+ *
+ * - `address`: The address of the first word.
+ * - `words`: The number of words.
+ * - `line`: The line in the file.
+ * - `file`: The string index of the file.
+ * - `macro`: The string index of the macro plus one, or 0 for none.
+ */
+struct debug_row
+{
+	int address;
+	int words;
+	int line;
+	int file;
+	int macro;
+};
+
+/**
+ * @struct debug_table
+ * @brief The line table while it is built.
+ *
+ * - `rows`: The rows, in address order once they are sorted.
+ * - `num_rows`: The number of rows.
+ * - `strings`: The file and macro names; they point into the expanded source.
+ * - `num_strings`: The number of names.
+ * - `strings_capacity`: The allocated number of names.
+ */
+struct debug_table
+{
+	struct debug_row *rows;
+	int num_rows;
+	const char **strings;
+	int num_strings;
+	int strings_capacity;
+};
+
+/**
+ * @struct debug_info
+ * @brief A line table mapped into memory.
+ *
+ * - `data`: The mapped file.
+ * - `size`: The size of the file.
+ * - `num_rows`, `num_blocks`, `num_strings`: The sizes of the tables.
+ * - `blocks`: The block table.
+ * - `stream`: The row stream.
+ * - `stream_size`: The size of the row stream.
+ * - `strings`: The string table.
+ * - `pool`: The string pool.
+ */
+struct debug_info
+{
+	const unsigned char *data;
+	size_t size;
+	unsigned long num_rows;
+	unsigned long num_blocks;
+	unsigned long num_strings;
+	const unsigned char *blocks;
+	const unsigned char *stream;
+	unsigned long stream_size;
+	const unsigned char *strings;
+	const char *pool;
+};
+
+/**
+ * @struct debug_location
+ * @brief Where the word at an address came from.
+ *
+ * - `address`: The address of the first word of the line.
+ * - `words`: The number of words of the line.
+ * - `file`: The file.
+ * - `line`: The line in the file.
+ * - `macro`: The macro whose expansion produced the word, or NULL.
+ */
+struct debug_location
+{
+	int address;
+	int words;
+	const char *file;
+	int line;
+	const char *macro;
+};
+
+/**
+ * @brief Writes an unsigned LEB128 number.
+ * @param bytes Receives up to `DEBUG_MAX_VARINT` bytes.
+ * @param value The number.
+ * @return The number of bytes written.
+ */
+int put_varint(unsigned char *bytes, unsigned long value);
+
+/**
+ * @brief Reads an unsigned LEB128 number.
+ * @param bytes A pointer to the position in the stream, advanced past the number.
+ * @param end The end of the stream.
+ * @param value Receives the number.
+ * @return 1 on success, or 0 if the number runs past the end or is too long.
+ */
+int get_varint(const unsigned char **bytes, const unsigned char *end, unsigned long *value);
+
+/**
+ * @brief Finds or adds a name in the string table.
+ * @param table A pointer to the table.
+ * @param text The name.
+ * @param index Receives the string index.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int intern_debug_string(struct debug_table *table, const char *text, int *index);
+
+/**
+ * @brief Orders rows by address (a `qsort` comparator).
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_debug_rows(const void *a, const void *b);
+
+/**
+ * @brief Builds the rows of the line table from the words every line allocated.
+ * @param table A pointer to an empty table.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param sizes The words the first pass allocated for every expanded line.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int collect_debug_rows(struct debug_table *table, const char *source, const ExpandedSource *expanded, const struct line_size *sizes, const struct layout_block *placed, int num_placed);
+
+/**
+ * @brief Serializes a line table into the `.dbg` format.
+ * @param table A pointer to the table, with its rows in address order.
+ * @param size Receives the size of the image.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned char *build_debug_image(const struct debug_table *table, size_t *size);
+
+/**
+ * @brief Writes the `.dbg` line table of a file, if it changed.
+ * @param name The name of the `.dbg` file.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param sizes The words the first pass allocated for every expanded line.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_debug_info(const char *name, const char *source, const ExpandedSource *expanded, const struct line_size *sizes, const struct layout_block *placed, int num_placed);
+
+/**
+ * @brief Maps a `.dbg` line table into memory and checks its structure.
+ * @param name The name of the `.dbg` file.
+ * @param info A pointer to the line table to fill.
+ * @return 1 on success, or EXIT if the file cannot be mapped or is not a valid line table.
+ */
+int load_debug_info(const char *name, struct debug_info *info);
+
+/**
+ * @brief Unmaps a line table.
+ * @param info A pointer to the line table.
+ */
+void unload_debug_info(struct debug_info *info);
+
+/**
+ * @brief Finds where the word at an address came from.
+ * @param info A pointer to the line table.
+ * @param address The address.
+ * @param location Receives the location.
+ * @return 1 if the address belongs to a line, 0 otherwise.
+ */
+int find_debug_location(const struct debug_info *info, int address, struct debug_location *location);
+
+/**
+ * @brief Prints the source location of every address given on the command line.
+ * @param name The name of the `.dbg` file.
+ * @param addresses The addresses, in decimal.
+ * @param count The number of addresses.
+ * @return 1 on success, 0 if an address is invalid or has no location, or EXIT if the file cannot be mapped.
+ */
+int print_debug_locations(const char *name, char **addresses, int count);
+
+#endif /* DEBUG_INFO_H */
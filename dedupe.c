@@ -0,0 +1,375 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "dedupe.h"
+#include "output.h"
+#include "instruction.h"
+
+struct dedupe_index DEDUPE;
+
+/**
+ * @brief Starts deduplicating images.
+ *
+ * @param store The store directory, or NULL; it is created if it does not exist.
+ * @return 1 on success, or EXIT if the store cannot be created.
+ */
+int dedupe_open(const char *store)
+{
+	int i;
+	memset(&DEDUPE, 0, sizeof(DEDUPE));
+	for(i = 0; i < DEDUPE_BUCKETS; i++)
+	{
+		DEDUPE.buckets[i] = -1;
+	}
+	if(store != NULL && mkdir(store, 0777) != 0 && errno != EEXIST)
+	{
+		fprintf(stdout, "cannot create dedupe store: %s\n", store);
+		return EXIT;
+	}
+	DEDUPE.store = store;
+	DEDUPE.enabled = 1;
+	return 1;
+}
+
+/**
+ * @brief Opens an image for writing, in memory when images are deduplicated.
+ *
+ * Without `--dedupe` this is `open_output`. With it, the image goes to a
+ * memory stream whose bytes `commit_image` finds in `DEDUPE` once the writer
+ * has closed it.
+ *
+ * @param name The name of the output file.
+ * @param mode The `fopen` mode.
+ * @return The open stream, or NULL on an error.
+ */
+FILE *open_image(const char *name, const char *mode)
+{
+	if(!DEDUPE.enabled)
+	{
+		return open_output(name, mode);
+	}
+	free(DEDUPE.buffer);
+	DEDUPE.buffer = NULL;
+	DEDUPE.size = 0;
+	return open_memstream(&DEDUPE.buffer, &DEDUPE.size);
+}
+
+/**
+ * @brief Writes, links or keeps an image whose stream was closed.
+ *
+ * The image is linked to an output of the run with the same bytes if there
+ * is one, else to the copy in the store, else written. An image the store
+ * does not hold yet is linked into it afterwards.
+ *
+ * @param name The name of the output file.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or EXIT on a file or memory error.
+ */
+int commit_image(const char *name)
+{
+	struct dedupe_entry *entry;
+	char *buffer = DEDUPE.buffer, *store_name = NULL;
+	size_t size = DEDUPE.size;
+	unsigned long hash;
+	int status = 0, in_store = 0;
+
+	if(!DEDUPE.enabled)
+	{
+		return commit_output(name);
+	}
+	DEDUPE.buffer = NULL;
+	DEDUPE.size = 0;
+	hash = hash_text(buffer, size);
+	entry = find_dedupe_entry(hash, buffer, size);
+	if(DEDUPE.store != NULL)
+	{
+		store_name = dedupe_store_name(hash, size);
+		if(store_name == NULL)
+		{
+			status = EXIT;
+			goto done;
+		}
+	}
+
+	/* Link to an output of the run, then to the store, and only then write. */
+	if(entry != NULL && strcmp(entry->name, name) != 0)
+	{
+		status = link_output(entry->name, name);
+		if(status == OUTPUT_CHANGED)
+		{
+			DEDUPE.linked_run++;
+			DEDUPE.saved += size;
+		}
+	}
+	if(store_name != NULL)
+	{
+		in_store = same_buffer_contents(store_name, buffer, size);
+		if(status == 0 && in_store)
+		{
+			status = link_output(store_name, name);
+			if(status == OUTPUT_CHANGED)
+			{
+				DEDUPE.linked_store++;
+				DEDUPE.saved += size;
+			}
+		}
+	}
+	if(status == 0)
+	{
+		status = write_output_buffer(name, buffer, size);
+		if(status == EXIT)
+		{
+			goto done;
+		}
+		if(status == OUTPUT_CHANGED)
+		{
+			DEDUPE.written++;
+		}
+	}
+	if(status == OUTPUT_UNCHANGED)
+	{
+		DEDUPE.unchanged++;
+	}
+
+	/* A name that is taken (a hash collision) is left alone. */
+	if(store_name != NULL && !in_store)
+	{
+		link(name, store_name);
+	}
+	if(entry == NULL && add_dedupe_entry(hash, size, name) == EXIT)
+	{
+		status = EXIT;
+	}
+
+	done:
+		free(buffer);
+		free(store_name);
+		return status;
+}
+
+/**
+ * @brief Drops an image that could not be rendered.
+ *
+ * @param name The name of the output file.
+ */
+void discard_image(const char *name)
+{
+	if(!DEDUPE.enabled)
+	{
+		discard_output(name);
+		return;
+	}
+	free(DEDUPE.buffer);
+	DEDUPE.buffer = NULL;
+	DEDUPE.size = 0;
+}
+
+/**
+ * @brief Compares a file with bytes in memory.
+ *
+ * @param name The name of the file.
+ * @param buffer The bytes.
+ * @param size The number of bytes.
+ * @return 1 if the file exists and holds the same bytes, 0 otherwise.
+ */
+int same_buffer_contents(const char *name, const char *buffer, size_t size)
+{
+	char block[BUFSIZ];
+	size_t len, offset = 0;
+	int same = 1;
+	FILE *fileptr = fopen(name, "rb");
+	if(fileptr == NULL)
+	{
+		return 0;
+	}
+	while(same && (len = fread(block, 1, sizeof(block), fileptr)) > 0)
+	{
+		same = (offset + len <= size && memcmp(block, buffer + offset, len) == 0);
+		offset += len;
+	}
+	fclose(fileptr);
+	return same && offset == size;
+}
+
+/**
+ * @brief Writes bytes in memory to an output file, if they changed.
+ *
+ * @param name The name of the output file.
+ * @param buffer The bytes.
+ * @param size The number of bytes.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or EXIT on a file or memory error.
+ */
+int write_output_buffer(const char *name, const char *buffer, size_t size)
+{
+	FILE *fileptr = open_output(name, "wb");
+	int status;
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		return EXIT;
+	}
+	status = (size == 0 || fwrite(buffer, 1, size, fileptr) == size);
+	if(fclose(fileptr) != 0 || !status)
+	{
+		discard_output(name);
+		return EXIT;
+	}
+	return commit_output(name);
+}
+
+/**
+ * @brief Replaces an output file with a hard link to another file.
+ *
+ * An output that already is the other file, or holds the same bytes, is kept
+ * with its modification time. Otherwise the link is made under the `.new`
+ * name and renamed over the output.
+ *
+ * @param source The file to link to.
+ * @param name The name of the output file.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or 0 if the link cannot be made.
+ */
+int link_output(const char *source, const char *name)
+{
+	struct stat source_stat, name_stat;
+	char *temp;
+	int status = OUTPUT_CHANGED;
+	if(stat(source, &source_stat) != 0)
+	{
+		return 0;
+	}
+	if(stat(name, &name_stat) == 0 && ((source_stat.st_dev == name_stat.st_dev && source_stat.st_ino == name_stat.st_ino) || same_file_contents(source, name)))
+	{
+		return OUTPUT_UNCHANGED;
+	}
+	temp = output_temp_name(name);
+	if(temp == NULL)
+	{
+		return 0;
+	}
+	remove(temp);
+	if(link(source, temp) != 0)
+	{
+		status = 0;
+	}
+	else if(rename(temp, name) != 0)
+	{
+		remove(temp);
+		status = 0;
+	}
+	free(temp);
+	return status;
+}
+
+/**
+ * @brief Finds an image of the run with the given bytes.
+ *
+ * Entries with the same hash and size are compared byte by byte with their
+ * file, so a hash collision is never linked.
+ *
+ * @param hash The hash of the bytes.
+ * @param buffer The bytes.
+ * @param size The number of bytes.
+ * @return The entry, or NULL if no image of the run holds the bytes.
+ */
+struct dedupe_entry *find_dedupe_entry(unsigned long hash, const char *buffer, size_t size)
+{
+	struct dedupe_entry *entry;
+	int i;
+	for(i = DEDUPE.buckets[hash & (DEDUPE_BUCKETS - 1)]; i >= 0; i = entry->next)
+	{
+		entry = &DEDUPE.entries[i];
+		if(entry->hash == hash && entry->size == size && same_buffer_contents(entry->name, buffer, size))
+		{
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Adds an image to the index of the run.
+ *
+ * @param hash The hash of the bytes.
+ * @param size The number of bytes.
+ * @param name The name of the output that holds them.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_dedupe_entry(unsigned long hash, size_t size, const char *name)
+{
+	struct dedupe_entry *temp, *entry;
+	if(DEDUPE.count == DEDUPE.capacity)
+	{
+		temp = (struct dedupe_entry *)realloc(DEDUPE.entries, (DEDUPE.capacity + MAX_SIZE_MEMORY) * sizeof(struct dedupe_entry));
+		if(temp == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		DEDUPE.entries = temp;
+		DEDUPE.capacity += MAX_SIZE_MEMORY;
+	}
+	entry = &DEDUPE.entries[DEDUPE.count];
+	entry->name = (char *)malloc(strlen(name) + 1);
+	if(entry->name == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	strcpy(entry->name, name);
+	entry->hash = hash;
+	entry->size = size;
+	entry->next = DEDUPE.buckets[hash & (DEDUPE_BUCKETS - 1)];
+	DEDUPE.buckets[hash & (DEDUPE_BUCKETS - 1)] = DEDUPE.count;
+	DEDUPE.count++;
+	return 1;
+}
+
+/**
+ * @brief Builds the name of an image in the store.
+ *
+ * @param hash The hash of the bytes.
+ * @param size The number of bytes.
+ * @return A dynamically allocated name, or NULL on a memory allocation failure.
+ */
+char *dedupe_store_name(unsigned long hash, size_t size)
+{
+	char *name = (char *)malloc(strlen(DEDUPE.store) + DEDUPE_KEY_LENGTH);
+	if(name == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return NULL;
+	}
+	sprintf(name, "%s/%08lx-%lx", DEDUPE.store, hash, (unsigned long)size);
+	return name;
+}
+
+/**
+ * @brief Writes the dedupe report of the run.
+ *
+ * @param fileptr The file to write to.
+ */
+void print_dedupe_report(FILE *fileptr)
+{
+	fprintf(fileptr, "dedupe: %ld images, %ld written, %ld linked (%ld in the run, %ld from the store), %ld unchanged, %.0f bytes not written\n",
+		DEDUPE.written + DEDUPE.linked_run + DEDUPE.linked_store + DEDUPE.unchanged, DEDUPE.written,
+		DEDUPE.linked_run + DEDUPE.linked_store, DEDUPE.linked_run, DEDUPE.linked_store, DEDUPE.unchanged, DEDUPE.saved);
+}
+
+/**
+ * @brief Stops deduplicating and frees the index.
+ */
+void dedupe_close(void)
+{
+	int i;
+	for(i = 0; i < DEDUPE.count; i++)
+	{
+		free(DEDUPE.entries[i].name);
+	}
+	free(DEDUPE.entries);
+	free(DEDUPE.buffer);
+	DEDUPE.entries = NULL;
+	DEDUPE.buffer = NULL;
+	DEDUPE.count = 0;
+	DEDUPE.capacity = 0;
+	DEDUPE.enabled = 0;
+}
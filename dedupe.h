@@ -0,0 +1,187 @@
+#ifndef DEDUPE_H
+#define DEDUPE_H
+
+/**
+ * @file dedupe.h
+ * @brief This header file declares the deduplication of object images with hard links.
+ *
+ * With `--dedupe`, the object, `.ent` and `.ext` files are rendered into
+ * memory instead of a `.new` copy, and hashed (FNV-1a) before anything is
+ * written. If a file with the same hash, size and bytes was already written
+ * in the run, the new file becomes a hard link to it. With `--dedupe-store
+ * DIR`, images are also looked up in, and added to, a store directory shared
+ * between runs, where every image is a hard link named by its hash and size.
+ * Only images that are new to both are written.
+ *
+ * A link is made under the `.new` name and renamed over the output, so an
+ * output is replaced as atomically as a written one, and an output that
+ * already holds the same bytes is left alone, as `commit_output` does. Since
+ * every output is replaced by a rename and never rewritten in place, changing
+ * one name never changes the files it shares its bytes with. A link that
+ * cannot be made (the store is on another file system) falls back to writing
+ * the image.
+ *
+ * When the run ends, a report lists how many images were written, linked and
+ * left unchanged, and how many bytes the links saved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @def DEDUPE_BUCKETS
+ * @brief The number of buckets of the index of images written in the run (a power of two).
+ */
+#define DEDUPE_BUCKETS 4096
+
+/**
+ * @def DEDUPE_KEY_LENGTH
+ * @brief The size of the name of an image in the store: the hash and the size, in hexadecimal.
+ */
+#define DEDUPE_KEY_LENGTH 40
+
+/**
+ * @struct dedupe_entry
+ * @brief An image written or linked in the run.
+ *
+ * - `hash`: The hash of the bytes.
+ * - `size`: The number of bytes.
+ * - `name`: The name of the output that holds them.
+ * - `next`: The index of the next entry of the bucket, or -1.
+ */
+struct dedupe_entry
+{
+	unsigned long hash;
+	size_t size;
+	char *name;
+	int next;
+};
+
+/**
+ * @struct dedupe_index
+ * @brief The images of the run, the store and the image being rendered.
+ *
+ * - `enabled`: Non-zero while images are deduplicated.
+ * - `store`: The store directory, or NULL.
+ * - `buckets`: The first entry of every bucket, or -1.
+ * - `entries`: The images of the run.
+ * - `count`, `capacity`: The used and allocated number of entries.
+ * - `buffer`, `size`: The image rendered by the last `open_image`, valid once its stream is closed.
+ * - `written`, `linked_run`, `linked_store`, `unchanged`: The number of images of each outcome.
+ * - `saved`: The bytes the links did not write.
+ */
+struct dedupe_index
+{
+	int enabled;
+	const char *store;
+	int buckets[DEDUPE_BUCKETS];
+	struct dedupe_entry *entries;
+	int count;
+	int capacity;
+	char *buffer;
+	size_t size;
+	long written;
+	long linked_run;
+	long linked_store;
+	long unchanged;
+	double saved;
+};
+
+/**
+ * @brief The images of the run.
+ */
+extern struct dedupe_index DEDUPE;
+
+/**
+ * @brief Starts deduplicating images.
+ * @param store The store directory, or NULL; it is created if it does not exist.
+ * @return 1 on success, or EXIT if the store cannot be created.
+ */
+int dedupe_open(const char *store);
+
+/**
+ * @brief Opens an image for writing, in memory when images are deduplicated.
+ * @param name The name of the output file.
+ * @param mode The `fopen` mode.
+ * @return The open stream, or NULL on an error.
+ */
+FILE *open_image(const char *name, const char *mode);
+
+/**
+ * @brief Writes, links or keeps an image whose stream was closed.
+ * @param name The name of the output file.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or EXIT on a file or memory error.
+ */
+int commit_image(const char *name);
+
+/**
+ * @brief Drops an image that could not be rendered.
+ * @param name The name of the output file.
+ */
+void discard_image(const char *name);
+
+/**
+ * @brief Compares a file with bytes in memory.
+ * @param name The name of the file.
+ * @param buffer The bytes.
+ * @param size The number of bytes.
+ * @return 1 if the file exists and holds the same bytes, 0 otherwise.
+ */
+int same_buffer_contents(const char *name, const char *buffer, size_t size);
+
+/**
+ * @brief Writes bytes in memory to an output file, if they changed.
+ * @param name The name of the output file.
+ * @param buffer The bytes.
+ * @param size The number of bytes.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or EXIT on a file or memory error.
+ */
+int write_output_buffer(const char *name, const char *buffer, size_t size);
+
+/**
+ * @brief Replaces an output file with a hard link to another file.
+ * @param source The file to link to.
+ * @param name The name of the output file.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or 0 if the link cannot be made.
+ */
+int link_output(const char *source, const char *name);
+
+/**
+ * @brief Finds an image of the run with the given bytes.
+ * @param hash The hash of the bytes.
+ * @param buffer The bytes.
+ * @param size The number of bytes.
+ * @return The entry, or NULL if no image of the run holds the bytes.
+ */
+struct dedupe_entry *find_dedupe_entry(unsigned long hash, const char *buffer, size_t size);
+
+/**
+ * @brief Adds an image to the index of the run.
+ * @param hash The hash of the bytes.
+ * @param size The number of bytes.
+ * @param name The name of the output that holds them.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_dedupe_entry(unsigned long hash, size_t size, const char *name);
+
+/**
+ * @brief Builds the name of an image in the store.
+ * @param hash The hash of the bytes.
+ * @param size The number of bytes.
+ * @return A dynamically allocated name, or NULL on a memory allocation failure.
+ */
+char *dedupe_store_name(unsigned long hash, size_t size);
+
+/**
+ * @brief Writes the dedupe report of the run.
+ * @param fileptr The file to write to.
+ */
+void print_dedupe_report(FILE *fileptr);
+
+/**
+ * @brief Stops deduplicating and frees the index.
+ */
+void dedupe_close(void);
+
+#endif /* DEDUPE_H */
@@ -0,0 +1,388 @@
+#include "delta.h"
+
+/**
+ * @brief Converts special base-4 digits into a value.
+ *
+ * This is the reverse of `word_to_base4`: 'a' to 'd' stand for 0 to 3, most
+ * significant digit first.
+ *
+ * @param digits The digits.
+ * @param len The number of digits.
+ * @param value Receives the value.
+ * @return 1 on success, or 0 if a character is not a base-4 digit.
+ */
+int base4_to_value(const char *digits, size_t len, unsigned long *value)
+{
+	size_t i;
+	*value = 0;
+	for(i = 0; i < len; i++)
+	{
+		if(digits[i] < 'a' || digits[i] > 'd')
+		{
+			return 0;
+		}
+		*value = (*value << 2) | (unsigned long)(digits[i] - 'a');
+	}
+	return 1;
+}
+
+/**
+ * @brief Reads the image of a previous object file.
+ *
+ * A file that starts with `PACKED_MAGIC` is unpacked with `load_packed_image`.
+ * Any other file is decoded as `.ob` text: the counters on the first line give
+ * the number of words, and every following line gives the address and value
+ * of one word. A file that does not exist is an empty image.
+ *
+ * @param name The name of the `.ob` or `packed` object file.
+ * @param words Receives the dynamically allocated words (NULL if the file does not exist).
+ * @param count Receives the number of words (0 if the file does not exist).
+ * @return 1 on success, or EXIT if the file is malformed or memory allocation fails.
+ */
+int load_object_image(const char *name, unsigned int **words, int *count)
+{
+	FILE *fileptr;
+	char magic[MACRO_LIBRARY_WORD], **lines = NULL, *space;
+	unsigned long ic, dc, address, value;
+	int i, num_lines = 0, load_address, old_ic, old_dc;
+
+	*words = NULL;
+	*count = 0;
+	fileptr = fopen(name, "rb");
+	if(fileptr == NULL)
+	{
+		return 1;
+	}
+	if(fread(magic, 1, MACRO_LIBRARY_WORD, fileptr) == MACRO_LIBRARY_WORD && memcmp(magic, PACKED_MAGIC, MACRO_LIBRARY_WORD) == 0)
+	{
+		fclose(fileptr);
+		if(load_packed_image(name, words, &old_ic, &old_dc, &load_address) == EXIT)
+		{
+			return EXIT;
+		}
+		if(load_address != MEMORY_START)
+		{
+			fprintf(stdout, "invalid object file: %s\n", name);
+			free(*words);
+			*words = NULL;
+			return EXIT;
+		}
+		*count = old_ic + old_dc;
+		return 1;
+	}
+	fclose(fileptr);
+
+	lines = read_raw_lines(name, &num_lines);
+	if(lines == NULL)
+	{
+		fprintf(stdout, "error opening file!\n");
+		return EXIT;
+	}
+	/* The header is " ic dc", where a zero counter is written with no digits at all. */
+	if(num_lines == 0 || lines[0][0] != ' ' || (space = strchr(lines[0] + 1, ' ')) == NULL)
+	{
+		goto invalid_object;
+	}
+	if(!base4_to_value(lines[0] + 1, (size_t)(space - lines[0] - 1), &ic) || !base4_to_value(space + 1, strlen(space + 1), &dc) || ic + dc > MAX_SIZE_IMAGE || (unsigned long)(num_lines - 1) != ic + dc)
+	{
+		goto invalid_object;
+	}
+	*words = (unsigned int *)malloc((ic + dc + 1) * sizeof(unsigned int));
+	if(*words == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		free_lines(lines, num_lines);
+		return EXIT;
+	}
+	for(i = 1; i < num_lines; i++)
+	{
+		if(strlen(lines[i]) != NUM_4 + 1 + WORD_DIGITS || lines[i][NUM_4] != '\t' || !base4_to_value(lines[i], NUM_4, &address) || !base4_to_value(lines[i] + NUM_4 + 1, WORD_DIGITS, &value) || address != (unsigned long)(MEMORY_START + i - 1))
+		{
+			goto invalid_object;
+		}
+		(*words)[i - 1] = (unsigned int)value;
+	}
+	*count = (int)(ic + dc);
+	free_lines(lines, num_lines);
+	return 1;
+
+	invalid_object:
+		fprintf(stdout, "invalid object file: %s\n", name);
+		free_lines(lines, num_lines);
+		free(*words);
+		*words = NULL;
+		return EXIT;
+}
+
+/**
+ * @brief Reads the labels of a previous `.ent` or `.ext` file.
+ *
+ * Every line holds a label name, a tab and a 4-digit base-4 address, as
+ * written by `print_entry` and `print_extern`. A file that does not exist has
+ * no labels; the assembler does not write these files when they would be
+ * empty.
+ *
+ * @param name The name of the file.
+ * @param refs Receives the dynamically allocated labels (NULL if the file does not exist).
+ * @param count Receives the number of labels (0 if the file does not exist).
+ * @return 1 on success, or EXIT if the file is malformed or memory allocation fails.
+ */
+int load_symbol_file(const char *name, struct external **refs, int *count)
+{
+	FILE *fileptr;
+	char **lines, *tab;
+	unsigned long address;
+	int i, num_lines = 0;
+
+	*refs = NULL;
+	*count = 0;
+	fileptr = fopen(name, "r");
+	if(fileptr == NULL)
+	{
+		return 1;
+	}
+	fclose(fileptr);
+	lines = read_raw_lines(name, &num_lines);
+	if(lines == NULL)
+	{
+		fprintf(stdout, "error opening file!\n");
+		return EXIT;
+	}
+	*refs = (struct external *)malloc((num_lines + 1) * sizeof(struct external));
+	if(*refs == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		free_lines(lines, num_lines);
+		return EXIT;
+	}
+	for(i = 0; i < num_lines; i++)
+	{
+		tab = strchr(lines[i], '\t');
+		if(tab == NULL || tab == lines[i] || tab - lines[i] > MAX_SIZE_LABEL || !base4_to_value(tab + 1, strlen(tab + 1), &address))
+		{
+			fprintf(stdout, "invalid symbol file: %s\n", name);
+			free_lines(lines, num_lines);
+			free(*refs);
+			*refs = NULL;
+			return EXIT;
+		}
+		memcpy((*refs)[i].name, lines[i], (size_t)(tab - lines[i]));
+		(*refs)[i].name[tab - lines[i]] = '\0';
+		(*refs)[i].index = (int)address;
+	}
+	*count = num_lines;
+	free_lines(lines, num_lines);
+	return 1;
+}
+
+/**
+ * @brief Orders labels by name, then by address (a `qsort` comparator).
+ *
+ * @param a A pointer to the first label.
+ * @param b A pointer to the second label.
+ * @return A negative, zero or positive value.
+ */
+int compare_symbol_refs(const void *a, const void *b)
+{
+	const struct external *first = (const struct external *)a;
+	const struct external *second = (const struct external *)b;
+	int cmp = strcmp(first->name, second->name);
+	if(cmp != 0)
+	{
+		return cmp;
+	}
+	return first->index - second->index;
+}
+
+/**
+ * @brief Writes the label lines of the delta file.
+ *
+ * Both lists are sorted, so a single merge finds the labels that only one
+ * build has. A label whose address changed shows up as removed at its old
+ * address and added at its new one.
+ *
+ * @param fileptr The delta file.
+ * @param keyword `DELTA_ENTRY` or `DELTA_EXTERN`.
+ * @param old_refs The labels of the previous build, sorted.
+ * @param old_count The number of labels of the previous build.
+ * @param new_refs The labels of the new build, sorted.
+ * @param new_count The number of labels of the new build.
+ */
+void print_symbol_delta(FILE *fileptr, const char *keyword, const struct external *old_refs, int old_count, const struct external *new_refs, int new_count)
+{
+	char address[NUM_4 + 1];
+	int i = 0, j = 0, cmp;
+	address[NUM_4] = '\0';
+	while(i < old_count || j < new_count)
+	{
+		if(i >= old_count)
+		{
+			cmp = 1;
+		}
+		else if(j >= new_count)
+		{
+			cmp = -1;
+		}
+		else
+		{
+			cmp = compare_symbol_refs(&old_refs[i], &new_refs[j]);
+		}
+		if(cmp < 0)
+		{
+			word_to_base4((unsigned long)old_refs[i].index, NUM_4, address);
+			fprintf(fileptr, "-%s\t%s\t%s\n", keyword, old_refs[i].name, address);
+			i++;
+		}
+		else if(cmp > 0)
+		{
+			word_to_base4((unsigned long)new_refs[j].index, NUM_4, address);
+			fprintf(fileptr, "+%s\t%s\t%s\n", keyword, new_refs[j].name, address);
+			j++;
+		}
+		else
+		{
+			i++;
+			j++;
+		}
+	}
+}
+
+/**
+ * @brief Compares a new build with a previous one and writes the `.delta` file.
+ *
+ * The new image is encoded once and compared word by word with the previous
+ * image; words past the end of the previous image always count as changed.
+ * Every maximal run of changed words becomes one line. The entries and
+ * external references of both builds are then sorted and compared.
+ *
+ * This must run before the new object, `.ent` and `.ext` files are written,
+ * because the previous build may live under the same names.
+ *
+ * @param name The name of the delta file.
+ * @param directory The directory of the previous build (its object file, `.ent` and `.ext` are read).
+ * @param base The base name of the source file; only its last path component is used inside `directory`.
+ * @param suffix The suffix of the previous object file.
+ * @param instable A pointer to the instruction table.
+ * @param datatable A pointer to the data table.
+ * @param labeltable A pointer to the label table.
+ * @param extable A pointer to the external table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @param lac The number of labels.
+ * @param exc The number of external references.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_delta(const char *name, const char *directory, const char *base, const char *suffix, struct instructionsMemory *instable, struct dataMemory *datatable, struct labelMemory *labeltable, struct external *extable, int ic, int dc, int lac, int exc)
+{
+	FILE *fileptr = NULL;
+	unsigned int *words = NULL, *old_words = NULL;
+	struct external *old_entries = NULL, *old_externs = NULL, *entries = NULL, *externs = NULL;
+	char *path = NULL, *end, digits[NUM_8 + 1];
+	int i, j, skip, old_count = 0, old_entry_count = 0, old_extern_count = 0, entry_count = 0, status = EXIT;
+
+	if(strrchr(base, '/') != NULL)
+	{
+		base = strrchr(base, '/') + 1;
+	}
+	path = (char *)malloc(strlen(directory) + strlen(base) + MAX_LEN_OF_STRING_END + 1);
+	words = encode_image(instable, datatable, ic, dc);
+	entries = (struct external *)malloc((lac + 1) * sizeof(struct external));
+	externs = (struct external *)malloc((exc + 1) * sizeof(struct external));
+	if(path == NULL || words == NULL || entries == NULL || externs == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		goto clean;
+	}
+
+	/* Read the previous build. */
+	strcpy(path, directory);
+	strcat(path, "/");
+	strcat(path, base);
+	end = path + strlen(path);
+	strcpy(end, suffix);
+	if(load_object_image(path, &old_words, &old_count) == EXIT){goto clean;}
+	strcpy(end, END_EN_FILE_NAME);
+	if(load_symbol_file(path, &old_entries, &old_entry_count) == EXIT){goto clean;}
+	strcpy(end, END_EX_FILE_NAME);
+	if(load_symbol_file(path, &old_externs, &old_extern_count) == EXIT){goto clean;}
+
+	/* Collect and sort the labels of both builds. */
+	for(i = 0; i < lac; i++)
+	{
+		if(labeltable[i].en == ENTRY)
+		{
+			strcpy(entries[entry_count].name, labeltable[i].name);
+			entries[entry_count].index = labeltable[i].index;
+			entry_count++;
+		}
+	}
+	memcpy(externs, extable, (size_t)exc * sizeof(struct external));
+	qsort(entries, (size_t)entry_count, sizeof(struct external), compare_symbol_refs);
+	qsort(externs, (size_t)exc, sizeof(struct external), compare_symbol_refs);
+	if(old_entries != NULL)
+	{
+		qsort(old_entries, (size_t)old_entry_count, sizeof(struct external), compare_symbol_refs);
+	}
+	if(old_externs != NULL)
+	{
+		qsort(old_externs, (size_t)old_extern_count, sizeof(struct external), compare_symbol_refs);
+	}
+
+	fileptr = open_output(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+
+	/* The header holds the new counters, as in the `.ob` file. */
+	digits[NUM_8] = '\0';
+	word_to_base4((unsigned long)ic, NUM_8, digits);
+	for(skip = 0; digits[skip] == 'a'; skip++);
+	fprintf(fileptr, " %s", digits + skip);
+	word_to_base4((unsigned long)dc, NUM_8, digits);
+	for(skip = 0; digits[skip] == 'a'; skip++);
+	fprintf(fileptr, " %s\n", digits + skip);
+
+	/* One line for every run of changed words. */
+	digits[WORD_DIGITS] = '\0';
+	for(i = 0; i < ic + dc; i = j)
+	{
+		if(i < old_count && old_words[i] == words[i])
+		{
+			j = i + 1;
+			continue;
+		}
+		word_to_base4((unsigned long)(i + MEMORY_START), NUM_4, digits);
+		digits[NUM_4] = '\0';
+		fprintf(fileptr, "%s\t", digits);
+		digits[WORD_DIGITS] = '\0';
+		for(j = i; j < ic + dc && (j >= old_count || old_words[j] != words[j]); j++)
+		{
+			word_to_base4(words[j], WORD_DIGITS, digits);
+			fprintf(fileptr, (j == i) ? "%s" : " %s", digits);
+		}
+		fprintf(fileptr, "\n");
+	}
+
+	print_symbol_delta(fileptr, DELTA_ENTRY, old_entries, old_entry_count, entries, entry_count);
+	print_symbol_delta(fileptr, DELTA_EXTERN, old_externs, old_extern_count, externs, exc);
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(name);
+		goto clean;
+	}
+	if(commit_output(name) == EXIT){goto clean;}
+	status = 1;
+
+	clean:
+		free(path);
+		free(words);
+		free(old_words);
+		free(old_entries);
+		free(old_externs);
+		free(entries);
+		free(externs);
+		return status;
+}
@@ -0,0 +1,116 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+/**
+ * @file delta.h
+ * @brief This header file declares the delta object output.
+ *
+ * When a program is rebuilt, only a few words of its image usually change. A
+ * delta file lists just those words, compared with the image of a previous
+ * build, so a loader can patch a deployed image instead of reloading it.
+ *
+ * The previous object is read back from its `.ob` base-4 text or from a
+ * `packed` binary image, and its `.ent` and `.ext` files are read from next to
+ * it. The `.delta` file is text in the same special base-4 as the `.ob` file:
+ *
+ * - The first line holds the new ic and dc, as in the `.ob` file.
+ * - Every run of consecutive changed words is one line: the address of the
+ *   first word, a tab, and the new words separated by spaces.
+ * - Every entry or external reference that appeared or disappeared is one
+ *   line: `+` or `-`, `.entry` or `.extern`, the label name and its address.
+ *
+ * A previous build that does not exist counts as an empty image, so its delta
+ * holds the whole program.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "emitter.h"
+#include "file.h"
+#include "assembler.h"
+
+/**
+ * @def END_DELTA_FILE_NAME
+ * @brief Suffix for the delta file.
+ */
+#define END_DELTA_FILE_NAME ".delta"
+
+/**
+ * @def DELTA_ENTRY
+ * @brief The keyword of an entry line in the delta file.
+ */
+#define DELTA_ENTRY ".entry"
+
+/**
+ * @def DELTA_EXTERN
+ * @brief The keyword of an external reference line in the delta file.
+ */
+#define DELTA_EXTERN ".extern"
+
+/**
+ * @brief Converts special base-4 digits into a value.
+ * @param digits The digits.
+ * @param len The number of digits.
+ * @param value Receives the value.
+ * @return 1 on success, or 0 if a character is not a base-4 digit.
+ */
+int base4_to_value(const char *digits, size_t len, unsigned long *value);
+
+/**
+ * @brief Reads the image of a previous object file.
+ * @param name The name of the `.ob` or `packed` object file.
+ * @param words Receives the dynamically allocated words (NULL if the file does not exist).
+ * @param count Receives the number of words (0 if the file does not exist).
+ * @return 1 on success, or EXIT if the file is malformed or memory allocation fails.
+ */
+int load_object_image(const char *name, unsigned int **words, int *count);
+
+/**
+ * @brief Reads the labels of a previous `.ent` or `.ext` file.
+ * @param name The name of the file.
+ * @param refs Receives the dynamically allocated labels (NULL if the file does not exist).
+ * @param count Receives the number of labels (0 if the file does not exist).
+ * @return 1 on success, or EXIT if the file is malformed or memory allocation fails.
+ */
+int load_symbol_file(const char *name, struct external **refs, int *count);
+
+/**
+ * @brief Orders labels by name, then by address (a `qsort` comparator).
+ * @param a A pointer to the first label.
+ * @param b A pointer to the second label.
+ * @return A negative, zero or positive value.
+ */
+int compare_symbol_refs(const void *a, const void *b);
+
+/**
+ * @brief Writes the label lines of the delta file.
+ * @param fileptr The delta file.
+ * @param keyword `DELTA_ENTRY` or `DELTA_EXTERN`.
+ * @param old_refs The labels of the previous build, sorted.
+ * @param old_count The number of labels of the previous build.
+ * @param new_refs The labels of the new build, sorted.
+ * @param new_count The number of labels of the new build.
+ */
+void print_symbol_delta(FILE *fileptr, const char *keyword, const struct external *old_refs, int old_count, const struct external *new_refs, int new_count);
+
+/**
+ * @brief Compares a new build with a previous one and writes the `.delta` file.
+ * @param name The name of the delta file.
+ * @param directory The directory of the previous build (its object file, `.ent` and `.ext` are read).
+ * @param base The base name of the source file; only its last path component is used inside `directory`.
+ * @param suffix The suffix of the previous object file.
+ * @param instable A pointer to the instruction table.
+ * @param datatable A pointer to the data table.
+ * @param labeltable A pointer to the label table.
+ * @param extable A pointer to the external table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @param lac The number of labels.
+ * @param exc The number of external references.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_delta(const char *name, const char *directory, const char *base, const char *suffix, struct instructionsMemory *instable, struct dataMemory *datatable, struct labelMemory *labeltable, struct external *extable, int ic, int dc, int lac, int exc);
+
+#endif /* DELTA_H */
@@ -4,12 +4,12 @@
  * @brief Processes a line containing a directive command.
  *
  * This function parses a line to identify the specific directive type (`.data`,
- * `.string`, or `.mat`) and then calls the appropriate helper function to handle
+ * `.string`, `.mat` or `.incbin`) and then calls the appropriate helper function to handle
  * the directive's arguments. It also handles memory allocation and error checking.
  *
  * @param str The line of assembly code containing the directive.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -17,7 +17,7 @@
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int directive(char str[], struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
+int directive(char str[], struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
 {
 	char *word1, *word2;
 	const char *delimiters = " \t";
@@ -30,8 +30,12 @@ int directive(char str[], struct dataMemory *datatable, struct error *errortable
 	strcpy(str_cpy, str);
 	word1 = strtok(str_cpy, delimiters);
 	word2 = string_without_first_word(str, delimiters);
-	if(strcmp(word2, EXIT_C) == 0){goto clean_directive;}
-	if(strcmp(word1, ".data") == 0)
+	if(word2 != NULL && strcmp(word2, EXIT_C) == 0){goto clean_directive;}
+	if(word2 == NULL)
+	{
+		if(add_error(errortable, ec, *cl, ": error! the directive has no operands", esize) == EXIT){goto clean_directive;}
+	}
+	else if(strcmp(word1, ".data") == 0)
 	{
 		if(data_update(word2, datatable, errortable, ec, dc, cl, esize, dsize) == EXIT){goto clean_directive;}
 	}
@@ -43,9 +47,13 @@ int directive(char str[], struct dataMemory *datatable, struct error *errortable
 	{
 		if(mat_update(word2, datatable, errortable, ec, dc, cl, esize, dsize) == EXIT){goto clean_directive;}
 	}
+	else if(strcmp(word1, INCBIN_DIRECTIVE) == 0)
+	{
+		if(incbin_update(word2, datatable, errortable, ec, dc, cl, esize, dsize) == EXIT){goto clean_directive;}
+	}
 	else
 	{
-		if(add_error(&errortable, ec, *cl, ": error! unknown directive command name", esize) == EXIT){goto clean_directive;}
+		if(add_error(errortable, ec, *cl, ": error! unknown directive command name", esize) == EXIT){goto clean_directive;}
 	}
 	if(word2)free(word2);
 	if(str_cpy)free(str_cpy);
@@ -65,8 +73,8 @@ int directive(char str[], struct dataMemory *datatable, struct error *errortable
  * number formats or out-of-range values.
  *
  * @param word The string containing the numbers.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -74,7 +82,7 @@ int directive(char str[], struct dataMemory *datatable, struct error *errortable
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int data_update(char *word, struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
+int data_update(char *word, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
 {
 	char *str = NULL;
 	char *delimiters = "	 ,", *endptr = NULL;
@@ -93,7 +101,7 @@ int data_update(char *word, struct dataMemory *datatable, struct error *errortab
 		str_cpy[end] = '\0';
 		if(!(is_valid_numbers(str_cpy)))
 		{
-			if(add_error(&errortable, ec, *cl, ": error! invalid data string", esize) == EXIT){goto clean_data;}
+			if(add_error(errortable, ec, *cl, ": error! invalid data string", esize) == EXIT){goto clean_data;}
 		}
 		else
 		{
@@ -108,14 +116,14 @@ int data_update(char *word, struct dataMemory *datatable, struct error *errortab
 					break;
 				}
 				if(tmp == EXIT){goto clean_data;}
-				if(add_data(&datatable, val, dc, dsize) == EXIT){goto clean_data;}
+				if(add_data(datatable, val, dc, dsize) == EXIT){goto clean_data;}
 				str = strtok(NULL, delimiters);
 			}
 		}
 	}
 	else
 	{
-		if(add_error(&errortable, ec, *cl, ": error! invalid data string, data string should have values", esize) == EXIT){goto clean_data;}
+		if(add_error(errortable, ec, *cl, ": error! invalid data string, data string should have values", esize) == EXIT){goto clean_data;}
 	}
 	free(str_cpy);
 	return 1;
@@ -134,8 +142,8 @@ int data_update(char *word, struct dataMemory *datatable, struct error *errortab
  * initial values.
  *
  * @param word The string containing the matrix definition.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -143,7 +151,7 @@ int data_update(char *word, struct dataMemory *datatable, struct error *errortab
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, 0 on an invalid matrix, or EXIT on a critical memory error.
  */
-int mat_update(char word[], struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
+int mat_update(char word[], struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
 {
 	char *str1 = NULL;
 	char *str2 = NULL;
@@ -164,7 +172,7 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
 	if(strcmp(str3,EXIT_C) == 0 || strcmp(str4,EXIT_C) == 0){goto clean_mat;}
 	if(str1 == NULL)
 	{
-		if(add_error(&errortable, ec, *cl, ": error! invalid data matrix", esize) == EXIT){goto clean_mat;}
+		if(add_error(errortable, ec, *cl, ": error! invalid data matrix", esize) == EXIT){goto clean_mat;}
 		goto clean;
 	}
 	str2 = strtok(NULL, delimiters);
@@ -180,7 +188,7 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
 			{
 				while(num != (val1 * val2))
 				{
-					if(add_data(&datatable, 0, dc, dsize) == EXIT){goto clean_mat;}
+					if(add_data(datatable, 0, dc, dsize) == EXIT){goto clean_mat;}
 					num++;
 				}
 			}
@@ -190,7 +198,7 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
 				str4[end] = '\0';
 				if(!is_valid_numbers(str4))
 				{
-					if(add_error(&errortable, ec, *cl, ": error! invalid numbers string", esize) == EXIT){goto clean_mat;}
+					if(add_error(errortable, ec, *cl, ": error! invalid numbers string", esize) == EXIT){goto clean_mat;}
 					goto clean;
 				}
 				str1 = strtok(str4, delimiters);
@@ -200,20 +208,20 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
 					tmp =  is_conversion_successful(str1, endptr, val, errortable, ec, cl, esize);
 					if(!tmp){goto clean;}
 					else if(tmp == EXIT){goto clean_mat;}
-					if(add_data(&datatable, val, dc, dsize) == EXIT){goto clean_mat;}
+					if(add_data(datatable, val, dc, dsize) == EXIT){goto clean_mat;}
 					num++;
 					str1 = strtok(NULL, delimiters);
 				}
 				if(str1 != NULL && num > (val1 * val2))
 				{
-					if(add_error(&errortable, ec, *cl, ": error! more values than specified", esize) == EXIT){goto clean_mat;}
+					if(add_error(errortable, ec, *cl, ": error! more values than specified", esize) == EXIT){goto clean_mat;}
 					goto clean;
 				}
 				if(num < (val1 * val2))
 				{
 					while(num <= (val1 * val2))
 					{
-						if(add_data(&datatable, 0, dc, dsize) == EXIT){goto clean_mat;}
+						if(add_data(datatable, 0, dc, dsize) == EXIT){goto clean_mat;}
 						num++;
 					}
 				}
@@ -228,7 +236,7 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
 	}
 	else
 	{
-		if(add_error(&errortable, ec, *cl, ": error! an ill-defined matrix", esize) == EXIT){goto clean_mat;}
+		if(add_error(errortable, ec, *cl, ": error! an ill-defined matrix", esize) == EXIT){goto clean_mat;}
 		goto clean;
 	}
 	clean:
@@ -251,8 +259,8 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
  * terminator at the end. It reports errors for invalid string formats.
  *
  * @param word The string literal to be processed.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -260,7 +268,7 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int string_update(char *word, struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
+int string_update(char *word, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
 {
 	int i = 1, end, valid;
 	end = end_of_string(word);
@@ -269,16 +277,260 @@ int string_update(char *word, struct dataMemory *datatable, struct error *errort
 	{
 		while(i < (end -1))
 		{
-			if(add_data(&datatable, (int)word[i], dc, dsize) == EXIT){return EXIT;}
+			if(add_data(datatable, (int)word[i], dc, dsize) == EXIT){return EXIT;}
 			i++;
 		}
-		if(add_data(&datatable, '\0', dc, dsize) == EXIT){return EXIT;}
+		if(add_data(datatable, '\0', dc, dsize) == EXIT){return EXIT;}
 
 	}
 	if(valid == EXIT){return EXIT;}
 	return 1;
 }
 
+/**
+ * @brief Handles the .incbin directive.
+ *
+ * This function parses the quoted file name and the optional `text` format,
+ * opens the file and streams its values into the data memory table with
+ * `incbin_binary` or `incbin_text`. The name is relative to the working
+ * directory. It reports errors for a malformed directive, a file that cannot
+ * be opened, an empty file, or an invalid value; the values before an invalid
+ * one are kept, as with `.data`.
+ *
+ * @param word The operands: a file name in double quotes, optionally followed by `, text`.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ec A pointer to the error counter.
+ * @param dc A pointer to the data counter.
+ * @param cl A pointer to the current line number.
+ * @param esize A pointer to the size of the error table.
+ * @param dsize A pointer to the size of the data table.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int incbin_update(char *word, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
+{
+	char *name = NULL, *p, *end;
+	FILE *file;
+	int text = 0, count;
+	size_t len = strlen(INCBIN_TEXT_FORMAT);
+	p = word + begin_of_string(word);
+	end = (*p == '"') ? strchr(p + 1, '"') : NULL;
+	if(end != NULL && end != p + 1)
+	{
+		for(p = end + 1; *p == ' ' || *p == '\t'; p++);
+		if(*p == ',')
+		{
+			for(p++; *p == ' ' || *p == '\t'; p++);
+			if(strncmp(p, INCBIN_TEXT_FORMAT, len) == 0)
+			{
+				text = 1;
+				p += len;
+			}
+			else
+			{
+				p = NULL;
+			}
+		}
+		if(p != NULL && only_spaces_and_tabs(p))
+		{
+			p = word + begin_of_string(word) + 1;
+			name = (char *)malloc(end - p + 1);
+			if(name == NULL)
+			{
+				fprintf(stdout,"Failed to allocate memory\n");
+				return EXIT;
+			}
+			memcpy(name, p, end - p);
+			name[end - p] = '\0';
+		}
+	}
+	if(name == NULL)
+	{
+		if(add_error(errortable, ec, *cl, ": error! .incbin expects a file name in double quotes, optionally followed by , text", esize) == EXIT){return EXIT;}
+		return 1;
+	}
+	file = fopen(name, text ? "r" : "rb");
+	free(name);
+	if(file == NULL)
+	{
+		if(add_error(errortable, ec, *cl, ": error! cannot open the .incbin file", esize) == EXIT){return EXIT;}
+		return 1;
+	}
+	count = text ? incbin_text(file, datatable, errortable, ec, dc, cl, esize, dsize) : incbin_binary(file, datatable, errortable, ec, dc, cl, esize, dsize);
+	fclose(file);
+	if(count == EXIT){return EXIT;}
+	if(count == 0)
+	{
+		if(add_error(errortable, ec, *cl, ": error! the .incbin file has no values", esize) == EXIT){return EXIT;}
+	}
+	return 1;
+}
+
+/**
+ * @brief Streams 16-bit little-endian words from a file into the data memory table.
+ *
+ * The file is read `INCBIN_CHUNK` bytes at a time; every pair of bytes is a
+ * two's complement word that must lie between `MIN_VAL` and `MAX_VAL`, and
+ * every chunk is added with one `add_data_block`. A trailing odd byte is an
+ * error.
+ *
+ * @param file The open file.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ec A pointer to the error counter.
+ * @param dc A pointer to the data counter.
+ * @param cl A pointer to the current line number.
+ * @param esize A pointer to the size of the error table.
+ * @param dsize A pointer to the size of the data table.
+ * @return The number of values added, -1 after an invalid value, or EXIT on a critical memory error.
+ */
+int incbin_binary(FILE *file, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
+{
+	unsigned char bytes[INCBIN_CHUNK];
+	int values[INCBIN_CHUNK / 2];
+	size_t have = 0, got, i;
+	int num, val, total = 0;
+	while((got = fread(bytes + have, 1, INCBIN_CHUNK - have, file)) > 0)
+	{
+		have += got;
+		num = 0;
+		for(i = 0; i + 1 < have; i += 2)
+		{
+			val = bytes[i] | (bytes[i + 1] << 8);
+			if(val & 0x8000)
+			{
+				val -= 0x10000;
+			}
+			if(val > MAX_VAL || val < MIN_VAL)
+			{
+				if(add_data_block(datatable, values, num, dc, dsize) == EXIT){return EXIT;}
+				if(add_error(errortable, ec, *cl, ": error! the value is too large or too small", esize) == EXIT){return EXIT;}
+				return -1;
+			}
+			values[num++] = val;
+		}
+		if(add_data_block(datatable, values, num, dc, dsize) == EXIT){return EXIT;}
+		total += num;
+		/* An odd byte left over is the low byte of the first word of the next chunk. */
+		if(i < have)
+		{
+			bytes[0] = bytes[i];
+		}
+		have -= i;
+	}
+	if(have != 0)
+	{
+		if(add_error(errortable, ec, *cl, ": error! the .incbin file ends in the middle of a word", esize) == EXIT){return EXIT;}
+		return -1;
+	}
+	return total;
+}
+
+/**
+ * @brief Streams decimal numbers from a text file into the data memory table.
+ *
+ * The file is read `INCBIN_CHUNK` bytes at a time and scanned once, without
+ * copying lines: a number is an optional sign followed by digits, and numbers
+ * are separated by whitespace or by single commas, as in `.data`. A number
+ * may span two chunks. Every
+ * value must lie between `MIN_VAL` and `MAX_VAL`, and every chunk is added
+ * with one `add_data_block`.
+ *
+ * @param file The open file.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ec A pointer to the error counter.
+ * @param dc A pointer to the data counter.
+ * @param cl A pointer to the current line number.
+ * @param esize A pointer to the size of the error table.
+ * @param dsize A pointer to the size of the data table.
+ * @return The number of values added, -1 after an invalid value, or EXIT on a critical memory error.
+ */
+int incbin_text(FILE *file, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize)
+{
+	char chars[INCBIN_CHUNK];
+	int values[INCBIN_CHUNK / 2 + 1];
+	const char *error = NULL;
+	size_t got, i;
+	int num, total = 0, sign = 0, digits = 0, magnitude = 0, comma = 0, c;
+	while(error == NULL)
+	{
+		got = fread(chars, 1, INCBIN_CHUNK, file);
+		if(got == 0)
+		{
+			chars[0] = ' ';
+		}
+		num = 0;
+		for(i = 0; i < ((got > 0) ? got : 1) && error == NULL; i++)
+		{
+			c = (unsigned char)chars[i];
+			if(isdigit(c))
+			{
+				if(magnitude <= MAX_VAL + 1)
+				{
+					magnitude = magnitude * DECIMAL + (c - '0');
+				}
+				digits++;
+			}
+			else if((c == '-' || c == '+') && sign == 0 && digits == 0)
+			{
+				sign = (c == '-') ? -1 : 1;
+			}
+			else if(c == ',' || isspace(c))
+			{
+				if(digits > 0)
+				{
+					magnitude = (sign < 0) ? -magnitude : magnitude;
+					if(magnitude > MAX_VAL || magnitude < MIN_VAL)
+					{
+						error = ": error! the value is too large or too small";
+					}
+					else
+					{
+						values[num++] = magnitude;
+					}
+					comma = 0;
+				}
+				else if(sign != 0)
+				{
+					error = ": error! invalid characters";
+				}
+				if(c == ',')
+				{
+					if(comma || total + num == 0)
+					{
+						error = ": error! invalid data string";
+					}
+					comma = 1;
+				}
+				sign = 0;
+				digits = 0;
+				magnitude = 0;
+			}
+			else
+			{
+				error = ": error! invalid characters";
+			}
+		}
+		if(add_data_block(datatable, values, num, dc, dsize) == EXIT){return EXIT;}
+		total += num;
+		if(got == 0)
+		{
+			if(comma && error == NULL)
+			{
+				error = ": error! invalid data string";
+			}
+			break;
+		}
+	}
+	if(error != NULL)
+	{
+		if(add_error(errortable, ec, *cl, error, esize) == EXIT){return EXIT;}
+		return -1;
+	}
+	return total;
+}
+
 /**
  * @brief Validates a string literal format.
  *
@@ -286,27 +538,27 @@ int string_update(char *word, struct dataMemory *datatable, struct error *errort
  * contains only printable ASCII characters.
  *
  * @param str The string to validate.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the string is valid, 0 if it's invalid, or EXIT on a memory error.
  */
-int is_valid_string(char str[], struct error *errortable, int *ec, int *cl, int *esize)
+int is_valid_string(char str[], struct error **errortable, int *ec, int *cl, int *esize)
 {
 	int i;
 	int end = end_of_string(str);
 	int begin = begin_of_string(str);
 	if(str[begin] != '"' || str[end-1] != '"')
 	{
-		if(add_error(&errortable, ec, *cl, ": error! String must start and end with quotes", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! String must start and end with quotes", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	for(i = begin + 1; i < end; i++)
 	{
 		if(str[i] > '~' || str[i] < ' ')
 		{
-			if(add_error(&errortable, ec, *cl, ": error! illegal characters in a string", esize) == EXIT){return EXIT;}
+			if(add_error(errortable, ec, *cl, ": error! illegal characters in a string", esize) == EXIT){return EXIT;}
 			return 0;
 		}
 	}
@@ -323,23 +575,23 @@ int is_valid_string(char str[], struct error *errortable, int *ec, int *cl, int
  * @param str The original string that was converted.
  * @param endptr A pointer to the character that stopped the conversion.
  * @param val The integer value resulting from the conversion.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the conversion is valid, 0 if it failed or the value is out of range,
  * or EXIT on a memory error.
  */
-int is_conversion_successful(char str[], char* endptr, int val, struct error *errortable, int *ec, int* cl, int *esize)
+int is_conversion_successful(char str[], char* endptr, int val, struct error **errortable, int *ec, int* cl, int *esize)
 {
 	if (endptr == str || *endptr != '\0')
 	{
-		if(add_error(&errortable, ec, *cl, ": error! invalid characters", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! invalid characters", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	if (val > MAX_VAL || val < MIN_VAL)
 	{
-		if(add_error(&errortable, ec, *cl, ": error! the value is too large or too small", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": error! the value is too large or too small", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	return 1;
@@ -6,8 +6,14 @@
  * @brief This header file declares functions and defines constants for processing directives.
  *
  * It provides the interface for handling assembly directives such as `.data`,
- * `.string`, and `.mat`. The functions declared here are responsible for parsing
- * arguments, validating data, and updating the program's data memory.
+ * `.string`, `.mat` and `.incbin`. The functions declared here are responsible
+ * for parsing arguments, validating data, and updating the program's data memory.
+ *
+ * `.incbin "file"` streams the values of a file into the data segment instead
+ * of parsing `.data` lines: by default the file holds 16-bit little-endian
+ * two's complement words, and with `.incbin "file", text` it holds decimal
+ * numbers separated by commas or whitespace. Every value is still checked
+ * against `MIN_VAL` and `MAX_VAL`.
  */
 
 #include "data.h"
@@ -42,12 +48,30 @@
  */
 #define NUTHING 1000
 
+/**
+ * @def INCBIN_DIRECTIVE
+ * @brief The directive that streams the values of a file into the data segment.
+ */
+#define INCBIN_DIRECTIVE ".incbin"
+
+/**
+ * @def INCBIN_TEXT_FORMAT
+ * @brief The optional operand of `.incbin` that selects a numeric text file.
+ */
+#define INCBIN_TEXT_FORMAT "text"
+
+/**
+ * @def INCBIN_CHUNK
+ * @brief The number of bytes `.incbin` reads from the file at a time.
+ */
+#define INCBIN_CHUNK 4096
+
 /**
  * @brief Processes a line containing a directive command.
  *
  * @param str The line of assembly code containing the directive.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -55,14 +79,14 @@
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int directive(char str[], struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
+int directive(char str[], struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
 
 /**
  * @brief Handles the .data directive.
  *
  * @param word The string containing the numbers.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -70,14 +94,14 @@ int directive(char str[], struct dataMemory *datatable, struct error *errortable
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int data_update(char *word, struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
+int data_update(char *word, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
 
 /**
  * @brief Handles the .mat directive.
  *
  * @param word The string containing the matrix definition.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -85,14 +109,29 @@ int data_update(char *word, struct dataMemory *datatable, struct error *errortab
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, 0 on an invalid matrix, or EXIT on a critical memory error.
  */
-int mat_update(char word[], struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
+int mat_update(char word[], struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
 
 /**
  * @brief Handles the .string directive.
  *
  * @param word The string literal to be processed.
- * @param datatable A pointer to the data memory table.
- * @param errortable A pointer to the error table.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ec A pointer to the error counter.
+ * @param dc A pointer to the data counter.
+ * @param cl A pointer to the current line number.
+ * @param esize A pointer to the size of the error table.
+ * @param dsize A pointer to the size of the data table.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int string_update(char *word, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
+
+/**
+ * @brief Handles the .incbin directive.
+ *
+ * @param word The operands: a file name in double quotes, optionally followed by `, text`.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param dc A pointer to the data counter.
  * @param cl A pointer to the current line number.
@@ -100,19 +139,49 @@ int mat_update(char word[], struct dataMemory *datatable, struct error *errortab
  * @param dsize A pointer to the size of the data table.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int string_update(char *word, struct dataMemory *datatable, struct error *errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
+int incbin_update(char *word, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
+
+/**
+ * @brief Streams 16-bit little-endian words from a file into the data memory table.
+ *
+ * @param file The open file.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ec A pointer to the error counter.
+ * @param dc A pointer to the data counter.
+ * @param cl A pointer to the current line number.
+ * @param esize A pointer to the size of the error table.
+ * @param dsize A pointer to the size of the data table.
+ * @return The number of values added, -1 after an invalid value, or EXIT on a critical memory error.
+ */
+int incbin_binary(FILE *file, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
+
+/**
+ * @brief Streams decimal numbers from a text file into the data memory table.
+ *
+ * @param file The open file.
+ * @param datatable The address of the pointer to the data memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ec A pointer to the error counter.
+ * @param dc A pointer to the data counter.
+ * @param cl A pointer to the current line number.
+ * @param esize A pointer to the size of the error table.
+ * @param dsize A pointer to the size of the data table.
+ * @return The number of values added, -1 after an invalid value, or EXIT on a critical memory error.
+ */
+int incbin_text(FILE *file, struct dataMemory **datatable, struct error **errortable, int *ec, int *dc, int* cl, int *esize, int *dsize);
 
 /**
  * @brief Validates a string literal format.
  *
  * @param str The string to validate.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the string is valid, 0 if it's invalid, or EXIT on a memory error.
  */
-int is_valid_string(char str[], struct error *errortable, int *ec, int *cl, int *esize);
+int is_valid_string(char str[], struct error **errortable, int *ec, int *cl, int *esize);
 
 /**
  * @brief Checks if a string-to-integer conversion was successful.
@@ -120,14 +189,14 @@ int is_valid_string(char str[], struct error *errortable, int *ec, int *cl, int
  * @param str The original string that was converted.
  * @param endptr A pointer to the character that stopped the conversion.
  * @param val The integer value resulting from the conversion.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the conversion is valid, 0 if it failed or the value is out of range,
  * or EXIT on a memory error.
  */
-int is_conversion_successful(char str[], char* endptr, int val, struct error *errortable, int *ec, int* cl, int *esize);
+int is_conversion_successful(char str[], char* endptr, int val, struct error **errortable, int *ec, int* cl, int *esize);
 
 /**
  * @brief Checks for invalid number separators in a string.
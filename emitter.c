@@ -0,0 +1,358 @@
+#include "emitter.h"
+
+/**
+ * @brief The table of available emitters, ended by an entry with a NULL name.
+ */
+const struct emitter EMITTERS[] =
+{
+	{"base4", END_OBJECT_FILE_NAME, "wb", emit_base4},
+	{"packed", ".bin", "wb", emit_packed},
+	{"ihex", ".hex", "wb", emit_ihex},
+	{NULL, NULL, NULL, NULL}
+};
+
+/**
+ * @brief Finds an emitter by name.
+ *
+ * @param name The name of the format.
+ * @return A pointer to the emitter, or NULL if there is no such format.
+ */
+const struct emitter *find_emitter(const char *name)
+{
+	int i;
+	for(i = 0; EMITTERS[i].name != NULL; i++)
+	{
+		if(strcmp(EMITTERS[i].name, name) == 0)
+		{
+			return &EMITTERS[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Encodes one entry of the instruction table into a 10-bit machine word.
+ *
+ * The fields are laid out as in the base-4 text: a command word holds the
+ * opcode (4 bits), the source and destination addressing types (2 bits each)
+ * and ARE (2 bits); a register word holds two 4-bit registers and ARE; an
+ * address word holds an 8-bit address and ARE. Every field keeps only its low
+ * bits, as the base-4 conversion does for values that do not fit.
+ *
+ * @param word A pointer to the entry.
+ * @return The machine word.
+ */
+unsigned int encode_word(const struct instructionsMemory *word)
+{
+	if(word->type == RECORD_TYPE_COMMAND)
+	{
+		return ((word->data.command.opcode & 0xFU) << 6) | ((word->data.command.operand1 & 0x3U) << 4) | ((word->data.command.operand2 & 0x3U) << 2) | (word->data.command.ARE & 0x3U);
+	}
+	if(word->type == RECORD_TYPE_REGISTER)
+	{
+		return ((word->data.reg.operand1 & 0xFU) << 6) | ((word->data.reg.operand2 & 0xFU) << 2) | (word->data.reg.ARE & 0x3U);
+	}
+	return ((word->data.addr.address & 0xFFU) << 2) | (word->data.addr.ARE & 0x3U);
+}
+
+/**
+ * @brief Encodes the instruction and data tables into an image of machine words.
+ *
+ * @param instable A pointer to the instruction table.
+ * @param datatable A pointer to the data table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned int *encode_image(struct instructionsMemory *instable, struct dataMemory *datatable, int ic, int dc)
+{
+	unsigned int *words = (unsigned int *)malloc((ic + dc + 1) * sizeof(unsigned int));
+	int i;
+	if(words == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return NULL;
+	}
+	for(i = 0; i < ic; i++)
+	{
+		words[i] = encode_word(&instable[i]);
+	}
+	for(i = 0; i < dc; i++)
+	{
+		words[ic + i] = datatable[i].address & WORD_MASK;
+	}
+	return words;
+}
+
+/**
+ * @brief Writes the object file in the format of an emitter.
+ *
+ * The file is only replaced if its contents changed.
+ *
+ * @param name The name of the object file.
+ * @param emitter A pointer to the emitter.
+ * @param instable A pointer to the instruction table.
+ * @param datatable A pointer to the data table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_object(const char *name, const struct emitter *emitter, struct instructionsMemory *instable, struct dataMemory *datatable, int ic, int dc)
+{
+	FILE *fileptr;
+	unsigned int *words;
+	int status;
+	words = encode_image(instable, datatable, ic, dc);
+	if(words == NULL)
+	{
+		return EXIT;
+	}
+	fileptr = open_image(name, emitter->mode);
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		free(words);
+		return EXIT;
+	}
+	status = emitter->emit(fileptr, words, ic, dc);
+	if(fclose(fileptr) != 0)
+	{
+		status = EXIT;
+	}
+	free(words);
+	if(status == EXIT)
+	{
+		discard_image(name);
+		return EXIT;
+	}
+	return (commit_image(name) == EXIT) ? EXIT : status;
+}
+
+/**
+ * @brief Writes the low digits of a value in special base-4, without a terminator.
+ *
+ * Keeping the low digits of the value gives the same result as
+ * `int_to_special_base4`, including the complement form of negative numbers.
+ *
+ * @param value The value.
+ * @param digits The number of digits to write.
+ * @param out The buffer that receives the digits.
+ */
+void word_to_base4(unsigned long value, int digits, char *out)
+{
+	while(digits > 0)
+	{
+		digits--;
+		out[digits] = (char)('a' + (value & 0x3UL));
+		value >>= 2;
+	}
+}
+
+/**
+ * @brief Writes an image as special base-4 text.
+ *
+ * The first line holds ic and dc without leading zero digits. Every following
+ * line holds a 4-digit address and a 5-digit word, exactly as `print_object`
+ * always wrote them.
+ *
+ * @param fileptr The output file.
+ * @param words The encoded image.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a write error.
+ */
+int emit_base4(FILE *fileptr, const unsigned int *words, int ic, int dc)
+{
+	char counters[NUM_8 + 1], line[NUM_4 + WORD_DIGITS + 3];
+	int i, skip;
+
+	counters[NUM_8] = '\0';
+	word_to_base4((unsigned long)ic, NUM_8, counters);
+	for(skip = 0; counters[skip] == 'a'; skip++);
+	fprintf(fileptr, " %s", counters + skip);
+	word_to_base4((unsigned long)dc, NUM_8, counters);
+	for(skip = 0; counters[skip] == 'a'; skip++);
+	fprintf(fileptr, " %s\n", counters + skip);
+
+	line[NUM_4] = '\t';
+	line[NUM_4 + 1 + WORD_DIGITS] = '\n';
+	for(i = 0; i < ic + dc; i++)
+	{
+		word_to_base4((unsigned long)(i + MEMORY_START), NUM_4, line);
+		word_to_base4(words[i], WORD_DIGITS, line + NUM_4 + 1);
+		if(fwrite(line, 1, NUM_4 + WORD_DIGITS + 2, fileptr) != NUM_4 + WORD_DIGITS + 2)
+		{
+			fprintf(stdout,"error writing file!\n");
+			return EXIT;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Writes an image as a packed binary image.
+ *
+ * The header holds the magic, the load address, ic and dc as 32-bit
+ * little-endian numbers. The words follow, 10 bits each, packed from the
+ * lowest bit of the first byte upwards; the last byte is padded with zeros.
+ *
+ * @param fileptr The output file.
+ * @param words The encoded image.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a write or memory error.
+ */
+int emit_packed(FILE *fileptr, const unsigned int *words, int ic, int dc)
+{
+	unsigned char header[PACKED_HEADER_SIZE], *packed;
+	unsigned long bits = 0;
+	size_t size = ((size_t)(ic + dc) * WORD_BITS + 7) / 8, pos = 0;
+	int i, count = 0, status = 1;
+
+	memcpy(header, PACKED_MAGIC, MACRO_LIBRARY_WORD);
+	write_word(header + MACRO_LIBRARY_WORD, MEMORY_START);
+	write_word(header + 2 * MACRO_LIBRARY_WORD, (unsigned long)ic);
+	write_word(header + 3 * MACRO_LIBRARY_WORD, (unsigned long)dc);
+	packed = (unsigned char *)malloc(size + 1);
+	if(packed == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	for(i = 0; i < ic + dc; i++)
+	{
+		bits |= (unsigned long)(words[i] & WORD_MASK) << count;
+		count += WORD_BITS;
+		while(count >= 8)
+		{
+			packed[pos++] = (unsigned char)(bits & 0xFF);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+	if(count > 0)
+	{
+		packed[pos++] = (unsigned char)(bits & 0xFF);
+	}
+	if(fwrite(header, 1, PACKED_HEADER_SIZE, fileptr) != PACKED_HEADER_SIZE || fwrite(packed, 1, size, fileptr) != size)
+	{
+		fprintf(stdout,"error writing file!\n");
+		status = EXIT;
+	}
+	free(packed);
+	return status;
+}
+
+/**
+ * @brief Writes an image as Intel-HEX records.
+ *
+ * Every word is stored as two bytes, high byte first, at byte address
+ * `2 * word address`. Data records hold up to `IHEX_RECORD_WORDS` words and
+ * the file ends with an end-of-file record.
+ *
+ * @param fileptr The output file.
+ * @param words The encoded image.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a write error.
+ */
+int emit_ihex(FILE *fileptr, const unsigned int *words, int ic, int dc)
+{
+	unsigned int address, sum;
+	int i, j, count;
+	for(i = 0; i < ic + dc; i += IHEX_RECORD_WORDS)
+	{
+		count = (ic + dc - i < IHEX_RECORD_WORDS) ? ic + dc - i : IHEX_RECORD_WORDS;
+		address = (unsigned int)(i + MEMORY_START) * 2;
+		sum = (unsigned int)count * 2 + (address >> 8) + (address & 0xFF);
+		fprintf(fileptr, ":%02X%04X00", count * 2, address);
+		for(j = 0; j < count; j++)
+		{
+			fprintf(fileptr, "%02X%02X", words[i + j] >> 8, words[i + j] & 0xFF);
+			sum += (words[i + j] >> 8) + (words[i + j] & 0xFF);
+		}
+		fprintf(fileptr, "%02X\n", (0x100 - (sum & 0xFF)) & 0xFF);
+	}
+	if(fprintf(fileptr, ":00000001FF\n") < 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		return EXIT;
+	}
+	return 1;
+}
+
+/**
+ * @brief Reads a packed binary image back into machine words.
+ *
+ * The whole file is read at once and the words are unpacked in a single pass.
+ *
+ * @param name The name of the image file.
+ * @param words Receives the dynamically allocated words.
+ * @param ic Receives the number of instruction words.
+ * @param dc Receives the number of data words.
+ * @param load_address Receives the address of the first word.
+ * @return 1 on success, or EXIT if the file cannot be read or is not a packed image.
+ */
+int load_packed_image(const char *name, unsigned int **words, int *ic, int *dc, int *load_address)
+{
+	FILE *fileptr;
+	unsigned char header[PACKED_HEADER_SIZE], *packed = NULL;
+	unsigned long bits = 0, n;
+	size_t size, pos = 0;
+	int i, count = 0;
+
+	*words = NULL;
+	fileptr = fopen(name, "rb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		return EXIT;
+	}
+	if(fread(header, 1, PACKED_HEADER_SIZE, fileptr) != PACKED_HEADER_SIZE || memcmp(header, PACKED_MAGIC, MACRO_LIBRARY_WORD) != 0)
+	{
+		goto invalid_image;
+	}
+	*load_address = (int)read_word(header + MACRO_LIBRARY_WORD);
+	*ic = (int)read_word(header + 2 * MACRO_LIBRARY_WORD);
+	*dc = (int)read_word(header + 3 * MACRO_LIBRARY_WORD);
+	n = read_word(header + 2 * MACRO_LIBRARY_WORD) + read_word(header + 3 * MACRO_LIBRARY_WORD);
+	if(*ic < 0 || *dc < 0 || n > MAX_SIZE_IMAGE)
+	{
+		goto invalid_image;
+	}
+	size = (n * WORD_BITS + 7) / 8;
+	packed = (unsigned char *)malloc(size + 1);
+	*words = (unsigned int *)malloc((n + 1) * sizeof(unsigned int));
+	if(packed == NULL || *words == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		goto clean_image;
+	}
+	if(fread(packed, 1, size, fileptr) != size)
+	{
+		goto invalid_image;
+	}
+	for(i = 0; i < (int)n; i++)
+	{
+		while(count < WORD_BITS)
+		{
+			bits |= (unsigned long)packed[pos++] << count;
+			count += 8;
+		}
+		(*words)[i] = (unsigned int)(bits & WORD_MASK);
+		bits >>= WORD_BITS;
+		count -= WORD_BITS;
+	}
+	free(packed);
+	fclose(fileptr);
+	return 1;
+
+	invalid_image:
+		fprintf(stdout, "invalid packed image: %s\n", name);
+	clean_image:
+		free(packed);
+		free(*words);
+		*words = NULL;
+		fclose(fileptr);
+		return EXIT;
+}
@@ -0,0 +1,185 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+/**
+ * @file emitter.h
+ * @brief This header file declares the object file emitters.
+ *
+ * The instruction and data tables are first encoded into an image of 10-bit
+ * machine words. An emitter then writes that image in one output format:
+ *
+ * - `base4`: The special base-4 text of the `.ob` file.
+ * - `packed`: A binary image with the 10-bit words bit-packed after a small
+ *   header, about eight times smaller than the text and loaded with a single
+ *   read and a bit unpack.
+ * - `ihex`: Intel-HEX records, with every word stored as two bytes, for
+ *   programmer tools.
+ *
+ * Every emitter writes straight from the encoded words, without building
+ * intermediate strings.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "second_pass.h"
+#include "macrolib.h"
+#include "assembler.h"
+
+/**
+ * @def WORD_BITS
+ * @brief The number of bits in a machine word.
+ */
+#define WORD_BITS 10
+
+/**
+ * @def WORD_MASK
+ * @brief Keeps the low `WORD_BITS` bits of a value.
+ */
+#define WORD_MASK 0x3FFU
+
+/**
+ * @def WORD_DIGITS
+ * @brief The number of base-4 digits in a machine word.
+ */
+#define WORD_DIGITS 5
+
+/**
+ * @def DEFAULT_FORMAT
+ * @brief The name of the object format written when no format is chosen.
+ */
+#define DEFAULT_FORMAT "base4"
+
+/**
+ * @def MAX_SIZE_IMAGE
+ * @brief The largest number of words a packed image may hold (the 16-bit address space).
+ */
+#define MAX_SIZE_IMAGE 65536UL
+
+/**
+ * @def PACKED_MAGIC
+ * @brief The four bytes every packed binary image starts with.
+ */
+#define PACKED_MAGIC "OB10"
+
+/**
+ * @def PACKED_HEADER_SIZE
+ * @brief The size of the packed image header: the magic, the load address, ic and dc.
+ */
+#define PACKED_HEADER_SIZE 16
+
+/**
+ * @def IHEX_RECORD_WORDS
+ * @brief The number of machine words in one Intel-HEX data record.
+ */
+#define IHEX_RECORD_WORDS 8
+
+/**
+ * @struct emitter
+ * @brief An object file format.
+ *
+ * - `name`: The name used to choose the format on the command line.
+ * - `suffix`: The suffix of the object file.
+ * - `mode`: The `fopen` mode of the object file.
+ * - `emit`: Writes an encoded image (`ic` instruction words, then `dc` data words).
+ */
+struct emitter
+{
+	const char *name;
+	const char *suffix;
+	const char *mode;
+	int (*emit)(FILE *fileptr, const unsigned int *words, int ic, int dc);
+};
+
+/**
+ * @brief The table of available emitters, ended by an entry with a NULL name.
+ */
+extern const struct emitter EMITTERS[];
+
+/**
+ * @brief Finds an emitter by name.
+ * @param name The name of the format.
+ * @return A pointer to the emitter, or NULL if there is no such format.
+ */
+const struct emitter *find_emitter(const char *name);
+
+/**
+ * @brief Encodes one entry of the instruction table into a 10-bit machine word.
+ * @param word A pointer to the entry.
+ * @return The machine word.
+ */
+unsigned int encode_word(const struct instructionsMemory *word);
+
+/**
+ * @brief Encodes the instruction and data tables into an image of machine words.
+ * @param instable A pointer to the instruction table.
+ * @param datatable A pointer to the data table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned int *encode_image(struct instructionsMemory *instable, struct dataMemory *datatable, int ic, int dc);
+
+/**
+ * @brief Writes the object file in the format of an emitter.
+ * @param name The name of the object file.
+ * @param emitter A pointer to the emitter.
+ * @param instable A pointer to the instruction table.
+ * @param datatable A pointer to the data table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_object(const char *name, const struct emitter *emitter, struct instructionsMemory *instable, struct dataMemory *datatable, int ic, int dc);
+
+/**
+ * @brief Writes the low digits of a value in special base-4, without a terminator.
+ * @param value The value.
+ * @param digits The number of digits to write.
+ * @param out The buffer that receives the digits.
+ */
+void word_to_base4(unsigned long value, int digits, char *out);
+
+/**
+ * @brief Writes an image as special base-4 text.
+ * @param fileptr The output file.
+ * @param words The encoded image.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a write error.
+ */
+int emit_base4(FILE *fileptr, const unsigned int *words, int ic, int dc);
+
+/**
+ * @brief Writes an image as a packed binary image.
+ * @param fileptr The output file.
+ * @param words The encoded image.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a write or memory error.
+ */
+int emit_packed(FILE *fileptr, const unsigned int *words, int ic, int dc);
+
+/**
+ * @brief Writes an image as Intel-HEX records.
+ * @param fileptr The output file.
+ * @param words The encoded image.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a write error.
+ */
+int emit_ihex(FILE *fileptr, const unsigned int *words, int ic, int dc);
+
+/**
+ * @brief Reads a packed binary image back into machine words.
+ * @param name The name of the image file.
+ * @param words Receives the dynamically allocated words.
+ * @param ic Receives the number of instruction words.
+ * @param dc Receives the number of data words.
+ * @param load_address Receives the address of the first word.
+ * @return 1 on success, or EXIT if the file cannot be read or is not a packed image.
+ */
+int load_packed_image(const char *name, unsigned int **words, int *ic, int *dc, int *load_address);
+
+#endif /* EMITTER_H */
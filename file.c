@@ -10,13 +10,13 @@
  * @param name The name of the file to be read.
  * @param out_num_line A pointer to an integer where the number of lines read
  * will be stored.
- * @param errortable A pointer to the error table structure.
+ * @param errortable The address of the pointer to the error table structure.
  * @param ec A pointer to the error counter.
  * @param esize A pointer to the size of the error table.
  * @return A dynamically allocated array of strings (char**) containing the
  * file's content, or NULL if an error occurred or the file is empty.
  */
-char ** read_file(const char *name, int *out_num_line, struct error *errortable, int *ec, int *esize)
+char ** read_file(const char *name, int *out_num_line, struct error **errortable, int *ec, int *esize)
 {
 	FILE *file_ptr = NULL;
 	char **lines_array = NULL;
@@ -45,7 +45,7 @@ char ** read_file(const char *name, int *out_num_line, struct error *errortable,
 	if (file_ptr == NULL)
 	{
 		/* Add an error if the file cannot be opened */
-		add_error(&errortable, ec, 0, ": error opening file", esize);
+		add_error(errortable, ec, 0, ": error opening file", esize);
 		free(lines_array);
 		return NULL;
 	}
@@ -59,7 +59,7 @@ char ** read_file(const char *name, int *out_num_line, struct error *errortable,
 		if (len > 0 && temp_line_buffer[len - 1] != '\n' && !feof(file_ptr))
 		{
 			/* Add an error and clear the rest of the line from the stream */
-			add_error(&errortable, ec, num_lines, ": line is longer than 80 characters", esize);
+			add_error(errortable, ec, num_lines, ": line is longer than 80 characters", esize);
 			while ((c = fgetc(file_ptr)) != '\n' && c != EOF);
 			
 			/* Allocate an empty string to mark the line as an error */
@@ -154,3 +154,196 @@ char ** read_file(const char *name, int *out_num_line, struct error *errortable,
 	*out_num_line = num_lines;
 	return lines_array;
 }
+
+/**
+ * @brief Appends a copy of a text segment to a dynamic array of lines.
+ *
+ * This helper is shared by `read_raw_lines` and `split_lines`. It copies `len`
+ * characters of `text` into a new string and grows the array when it is full.
+ *
+ * @param lines_array A pointer to the array of lines.
+ * @param num_lines A pointer to the number of lines in the array.
+ * @param capacity A pointer to the capacity of the array.
+ * @param text The start of the segment to copy.
+ * @param len The number of characters to copy.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int append_line(char ***lines_array, int *num_lines, int *capacity, const char *text, size_t len)
+{
+	char **temp_ptr;
+	char *line;
+	if (*num_lines >= *capacity)
+	{
+		temp_ptr = (char **)spill_resize(*lines_array, (*capacity) * sizeof(char *), (*capacity) * DOUBLE * sizeof(char *));
+		if (temp_ptr == NULL)
+		{
+			fprintf(stdout,"Failed to reallocate memory for lines_array");
+			return EXIT;
+		}
+		*capacity = (*capacity) * DOUBLE;
+		*lines_array = temp_ptr;
+	}
+	line = (char *)spill_alloc(len + 1);
+	if (line == NULL)
+	{
+		fprintf(stdout,"Failed to allocate memory for line");
+		return EXIT;
+	}
+	memcpy(line, text, len);
+	line[len] = '\0';
+	(*lines_array)[*num_lines] = line;
+	(*num_lines)++;
+	return 1;
+}
+
+/**
+ * @brief Reads a file into a dynamic array of whole lines.
+ *
+ * The file is read in fixed-size blocks and split on newline characters, so
+ * lines longer than the buffer are kept whole. Length validation is left to
+ * the caller.
+ *
+ * @param name The name of the file to be read.
+ * @param out_num_line A pointer to an integer where the number of lines read
+ * will be stored.
+ * @return A dynamically allocated array of strings, or NULL if the file cannot
+ * be opened or memory allocation fails.
+ */
+char ** read_raw_lines(const char *name, int *out_num_line)
+{
+	FILE *file_ptr = NULL;
+	char **lines_array = NULL;
+	char buffer[BUFSIZ];
+	char *pending = NULL, *temp;
+	size_t pending_len = 0, n, i, start;
+	int num_lines = 0;
+	int current_capacity = MAX_SIZE_MEMORY;
+	double start_time = trace_begin(), read_time;
+
+	*out_num_line = 0;
+	file_ptr = fopen(name, "r");
+	if (file_ptr == NULL)
+	{
+		return NULL;
+	}
+	lines_array = (char **)malloc(current_capacity * sizeof(char *));
+	if (lines_array == NULL)
+	{
+		fprintf(stdout, "Failed to allocate initial memory for lines_array");
+		fclose(file_ptr);
+		return NULL;
+	}
+	for (;;)
+	{
+		/* Time every block read on its own, so waits for the disk stand out. */
+		read_time = trace_begin();
+		n = fread(buffer, 1, sizeof(buffer), file_ptr);
+		trace_end("read", name, read_time);
+		if (n == 0){break;}
+		start = 0;
+		for (i = 0; i < n; i++)
+		{
+			if (buffer[i] != '\n')
+			{
+				continue;
+			}
+			if (pending_len > 0)
+			{
+				/* The line began in an earlier block: join it with this one. */
+				temp = (char *)realloc(pending, pending_len + (i - start));
+				if (temp == NULL){goto clean_read;}
+				pending = temp;
+				memcpy(pending + pending_len, buffer + start, i - start);
+				if (append_line(&lines_array, &num_lines, &current_capacity, pending, pending_len + (i - start)) == EXIT){goto clean_read;}
+				pending_len = 0;
+			}
+			else if (append_line(&lines_array, &num_lines, &current_capacity, buffer + start, i - start) == EXIT){goto clean_read;}
+			start = i + 1;
+		}
+		if (start < n)
+		{
+			/* Keep the unterminated tail for the next block. */
+			temp = (char *)realloc(pending, pending_len + (n - start));
+			if (temp == NULL){goto clean_read;}
+			pending = temp;
+			memcpy(pending + pending_len, buffer + start, n - start);
+			pending_len += n - start;
+		}
+	}
+	if (pending_len > 0)
+	{
+		if (append_line(&lines_array, &num_lines, &current_capacity, pending, pending_len) == EXIT){goto clean_read;}
+	}
+	free(pending);
+	fclose(file_ptr);
+	*out_num_line = num_lines;
+	trace_end("read_file", name, start_time);
+	return lines_array;
+
+	clean_read:
+		free(pending);
+		free_lines(lines_array, num_lines);
+		fclose(file_ptr);
+		return NULL;
+}
+
+/**
+ * @brief Splits a text buffer into a dynamic array of lines.
+ *
+ * @param text The null-terminated text to split.
+ * @param out_num_line A pointer to an integer where the number of lines
+ * will be stored.
+ * @return A dynamically allocated array of strings, or NULL if memory
+ * allocation fails.
+ */
+char ** split_lines(const char *text, int *out_num_line)
+{
+	char **lines_array = NULL;
+	const char *start = text, *end;
+	int num_lines = 0;
+	int current_capacity = MAX_SIZE_MEMORY;
+
+	*out_num_line = 0;
+	lines_array = (char **)malloc(current_capacity * sizeof(char *));
+	if (lines_array == NULL)
+	{
+		fprintf(stdout, "Failed to allocate initial memory for lines_array");
+		return NULL;
+	}
+	while (*start != '\0')
+	{
+		end = strchr(start, '\n');
+		if (end == NULL)
+		{
+			end = start + strlen(start);
+		}
+		if (append_line(&lines_array, &num_lines, &current_capacity, start, end - start) == EXIT)
+		{
+			free_lines(lines_array, num_lines);
+			return NULL;
+		}
+		start = (*end == '\n') ? end + 1 : end;
+	}
+	*out_num_line = num_lines;
+	return lines_array;
+}
+
+/**
+ * @brief Frees an array of lines and every line it holds.
+ *
+ * @param lines The array of lines (may be NULL).
+ * @param num_line The number of lines in the array.
+ */
+void free_lines(char **lines, int num_line)
+{
+	int i;
+	if (lines == NULL)
+	{
+		return;
+	}
+	for (i = 0; i < num_line; i++)
+	{
+		spill_free(lines[i]);
+	}
+	spill_free(lines);
+}
@@ -33,14 +33,61 @@
  * @param name The name of the file to be read.
  * @param out_num_line A pointer to an integer that will store the total number of
  * lines successfully read.
- * @param errortable A pointer to the error table where any encountered errors will be logged.
+ * @param errortable The address of the pointer to the error table where any encountered errors will be logged.
  * @param ec A pointer to the error counter.
  * @param esize A pointer to the current allocated size of the error table.
  * @return A pointer to a dynamically allocated array of strings. Each string
  * represents a line from the file. Returns NULL if the file is empty, cannot be
  * opened, or if a memory allocation failure occurs.
  */
-char ** read_file(const char *name, int *out_num_line, struct error *errortable, int *ec, int *esize);
+char ** read_file(const char *name, int *out_num_line, struct error **errortable, int *ec, int *esize);
+
+/**
+ * @brief Appends a copy of a text segment to a dynamic array of lines.
+ *
+ * @param lines_array A pointer to the array of lines.
+ * @param num_lines A pointer to the number of lines in the array.
+ * @param capacity A pointer to the capacity of the array.
+ * @param text The start of the segment to copy.
+ * @param len The number of characters to copy.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int append_line(char ***lines_array, int *num_lines, int *capacity, const char *text, size_t len);
+
+/**
+ * @brief Reads a file into a dynamically allocated array of strings without any length checks.
+ *
+ * Unlike `read_file`, lines of any length are kept whole and no errors are logged.
+ * The trailing newline of every line is removed. This is the raw view of a source
+ * file that the pre-assembler validates itself.
+ *
+ * @param name The name of the file to be read.
+ * @param out_num_line A pointer to an integer that will store the number of lines read.
+ * @return A pointer to a dynamically allocated array of strings (possibly holding zero
+ * lines), or NULL if the file cannot be opened or a memory allocation failure occurs.
+ */
+char ** read_raw_lines(const char *name, int *out_num_line);
+
+/**
+ * @brief Splits an in-memory text buffer into a dynamically allocated array of strings.
+ *
+ * The buffer is split on newline characters exactly as `read_raw_lines` would split
+ * the same bytes read from a file.
+ *
+ * @param text The null-terminated text to split.
+ * @param out_num_line A pointer to an integer that will store the number of lines.
+ * @return A pointer to a dynamically allocated array of strings, or NULL if a memory
+ * allocation failure occurs.
+ */
+char ** split_lines(const char *text, int *out_num_line);
+
+/**
+ * @brief Frees an array of lines returned by `read_file`, `read_raw_lines` or `split_lines`.
+ *
+ * @param lines The array of lines (may be NULL).
+ * @param num_line The number of lines in the array.
+ */
+void free_lines(char **lines, int num_line);
 
 
 #endif /* FILE_H */
@@ -0,0 +1,438 @@
+#define _DEFAULT_SOURCE
+#include <sys/stat.h>
+#include "include.h"
+
+/**
+ * @brief Finds an included file in the cache, reading it on first use.
+ *
+ * A file included by several sources of the same run, or several times by one
+ * source, is read and split into lines only once. Files are matched by device
+ * and inode, so `sub/../b.as` finds `b.as`. The cached lines are never
+ * modified, so every user shares them.
+ *
+ * @param cache A pointer to the head of the cache.
+ * @param path The path of the file.
+ * @return A pointer to the cached file, or NULL if it cannot be opened or memory runs out.
+ */
+struct included_file *load_included_file(struct included_file **cache, const char *path)
+{
+	struct included_file *file;
+	struct stat path_stat;
+	if(stat(path, &path_stat) != 0)
+	{
+		return NULL;
+	}
+	for(file = *cache; file != NULL; file = file->next)
+	{
+		if(file->device == (unsigned long)path_stat.st_dev && file->inode == (unsigned long)path_stat.st_ino)
+		{
+			return file;
+		}
+	}
+	file = (struct included_file *)malloc(sizeof(struct included_file));
+	if(file == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return NULL;
+	}
+	file->lines = read_raw_lines(path, &file->num_lines);
+	if(file->lines == NULL)
+	{
+		free(file);
+		return NULL;
+	}
+	file->path = my_strdup(path);
+	if(file->path == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		free_lines(file->lines, file->num_lines);
+		free(file);
+		return NULL;
+	}
+	file->device = (unsigned long)path_stat.st_dev;
+	file->inode = (unsigned long)path_stat.st_ino;
+	file->next = *cache;
+	*cache = file;
+	return file;
+}
+
+/**
+ * @brief Tells whether two paths name the same file.
+ *
+ * The paths are compared by device and inode. A path that cannot be found,
+ * such as an editor buffer that was never saved, is compared as a string.
+ *
+ * @param first The first path.
+ * @param second The second path.
+ * @return 1 if they name the same file, 0 otherwise.
+ */
+int same_source_file(const char *first, const char *second)
+{
+	struct stat first_stat, second_stat;
+	if(stat(first, &first_stat) != 0 || stat(second, &second_stat) != 0)
+	{
+		return strcmp(first, second) == 0;
+	}
+	return first_stat.st_dev == second_stat.st_dev && first_stat.st_ino == second_stat.st_ino;
+}
+
+/**
+ * @brief Frees every file in the cache.
+ *
+ * @param cache A pointer to the head of the cache.
+ */
+void free_include_cache(struct included_file **cache)
+{
+	struct included_file *file = *cache, *next;
+	while(file != NULL)
+	{
+		next = file->next;
+		free(file->path);
+		free_lines(file->lines, file->num_lines);
+		free(file);
+		file = next;
+	}
+	*cache = NULL;
+}
+
+/**
+ * @brief Records an included file as a dependency, once.
+ *
+ * @param deps A pointer to the dependency list.
+ * @param path The path of the included file (owned by the cache).
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_dependency(struct include_deps *deps, const char *path)
+{
+	const char **new_paths;
+	int i;
+	for(i = 0; i < deps->count; i++)
+	{
+		if(strcmp(deps->paths[i], path) == 0)
+		{
+			return 1;
+		}
+	}
+	if(deps->count >= deps->capacity)
+	{
+		deps->capacity = (deps->capacity == 0) ? MAX_INCLUDE_DEPTH : deps->capacity * DOUBLE;
+		new_paths = (const char **)realloc((void *)deps->paths, deps->capacity * sizeof(const char *));
+		if(new_paths == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		deps->paths = new_paths;
+	}
+	deps->paths[deps->count] = path;
+	deps->count++;
+	return 1;
+}
+
+/**
+ * @brief Frees a dependency list and resets it to empty.
+ *
+ * @param deps A pointer to the dependency list.
+ */
+void free_dependencies(struct include_deps *deps)
+{
+	free((void *)deps->paths);
+	deps->paths = NULL;
+	deps->count = 0;
+	deps->capacity = 0;
+}
+
+/**
+ * @brief Builds the path of an included file relative to the file that includes it.
+ *
+ * An absolute name is kept as is. Otherwise the directory part of the including
+ * file's path is put in front of the name, so a source and the files it
+ * includes can be moved together.
+ *
+ * @param including The path of the including file.
+ * @param name The file name written in the `.include` directive.
+ * @return The dynamically allocated path, or NULL on a memory allocation failure.
+ */
+char *resolve_include_path(const char *including, const char *name)
+{
+	const char *slash = strrchr(including, '/');
+	size_t dir_len = (name[0] != '/' && slash != NULL) ? (size_t)(slash - including) + 1 : 0;
+	char *path = (char *)malloc(dir_len + strlen(name) + 1);
+	if(path == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return NULL;
+	}
+	memcpy(path, including, dir_len);
+	strcpy(path + dir_len, name);
+	return path;
+}
+
+/**
+ * @brief Extracts the quoted file name of an `.include` line.
+ *
+ * The directive must be the first token of the line and be followed by a file
+ * name in double quotes. Only whitespace or a comment may follow the name.
+ *
+ * @param line The source line.
+ * @param name Receives the dynamically allocated file name, or NULL if the line is malformed.
+ * @return 1 if the line is an `.include` directive, 0 otherwise, or EXIT on a memory allocation failure.
+ */
+int parse_include_line(const char *line, char **name)
+{
+	const char *p = line, *end;
+	size_t len = strlen(INCLUDE_DIRECTIVE);
+	*name = NULL;
+	while(isspace((unsigned char)*p))
+	{
+		p++;
+	}
+	if(strncmp(p, INCLUDE_DIRECTIVE, len) != 0 || (p[len] != '\0' && p[len] != '"' && !isspace((unsigned char)p[len])))
+	{
+		return 0;
+	}
+	p += len;
+	while(isspace((unsigned char)*p))
+	{
+		p++;
+	}
+	if(*p != '"')
+	{
+		return 1;
+	}
+	p++;
+	end = strchr(p, '"');
+	if(end == NULL || end == p)
+	{
+		return 1;
+	}
+	len = end - p;
+	for(end++; isspace((unsigned char)*end); end++);
+	if(*end != '\0' && *end != COMMENT_START_CHAR)
+	{
+		return 1;
+	}
+	*name = (char *)malloc(len + 1);
+	if(*name == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	memcpy(*name, p, len);
+	(*name)[len] = '\0';
+	return 1;
+}
+
+/**
+ * @brief Replaces the `.include` lines of a source with the lines of the included files.
+ *
+ * Lines are copied to `out` in order. An `.include` line is replaced by the
+ * flattened lines of the named file, found through the cache. A file that is
+ * already being flattened, under any path (an include cycle), a nesting
+ * deeper than `MAX_INCLUDE_DEPTH`, a malformed directive or a file that cannot
+ * be opened is reported as an error on the `.include` line, and the line is
+ * dropped.
+ *
+ * @param path The path of the file whose lines are flattened.
+ * @param lines The lines of the file.
+ * @param num_lines The number of lines.
+ * @param parent The origin of the `.include` line that brought the file in, or NULL for the main file.
+ * @param stack The paths of the files being flattened, outermost first; it must hold `MAX_INCLUDE_DEPTH` entries.
+ * @param depth The number of paths in `stack`.
+ * @param cache A pointer to the head of the include cache.
+ * @param deps A pointer to the dependency list, or NULL.
+ * @param out A pointer to the flattened source.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success (errors are reported through the error table), or EXIT on a critical failure.
+ */
+int flatten_includes(const char *path, char **lines, int num_lines, const LineOrigin *parent, const char **stack, int depth, struct included_file **cache, struct include_deps *deps, ExpandedSource *out, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr)
+{
+	struct included_file *file;
+	LineOrigin origin;
+	char *name = NULL, *resolved = NULL;
+	int k, i, status;
+
+	for(k = 0; k < num_lines; k++)
+	{
+		origin.line = (parent != NULL) ? parent->line : k + 1;
+		origin.file = (parent != NULL) ? path : NULL;
+		origin.file_line = k + 1;
+		origin.macro = NULL;
+
+		status = parse_include_line(lines[k], &name);
+		if(status == EXIT)
+		{
+			return EXIT;
+		}
+		if(status == 0)
+		{
+			if(add_expanded_line(out, lines[k], &origin) == EXIT){return EXIT;}
+			continue;
+		}
+		if(name == NULL)
+		{
+			if(add_source_error(errortable_ptr, ec_ptr, &origin, ": error! .include expects a file name in double quotes", esize_ptr) == EXIT){return EXIT;}
+			continue;
+		}
+		resolved = resolve_include_path(path, name);
+		free(name);
+		name = NULL;
+		if(resolved == NULL)
+		{
+			return EXIT;
+		}
+
+		for(i = 0; i < depth; i++)
+		{
+			if(same_source_file(stack[i], resolved))
+			{
+				break;
+			}
+		}
+		if(i < depth)
+		{
+			status = add_source_error(errortable_ptr, ec_ptr, &origin, ": error! the file includes itself (include cycle)", esize_ptr);
+		}
+		else if(depth >= MAX_INCLUDE_DEPTH)
+		{
+			status = add_source_error(errortable_ptr, ec_ptr, &origin, ": error! included files are nested too deeply", esize_ptr);
+		}
+		else if((file = load_included_file(cache, resolved)) == NULL)
+		{
+			status = add_source_error(errortable_ptr, ec_ptr, &origin, ": error! cannot open the included file", esize_ptr);
+		}
+		else
+		{
+			status = (deps != NULL) ? add_dependency(deps, file->path) : 1;
+			if(status != EXIT)
+			{
+				stack[depth] = file->path;
+				status = flatten_includes(file->path, file->lines, file->num_lines, &origin, stack, depth + 1, cache, deps, out, errortable_ptr, ec_ptr, esize_ptr);
+			}
+		}
+		free(resolved);
+		resolved = NULL;
+		if(status == EXIT)
+		{
+			return EXIT;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Adds an error on a source line, naming the included file and line if there is one.
+ *
+ * The error is reported on the line of the main source file; for a line of an
+ * included file that is the line of the outermost `.include` directive.
+ *
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param origin The origin of the line the error is on.
+ * @param message The error message.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_source_error(struct error **errortable_ptr, int *ec_ptr, const LineOrigin *origin, const char *message, int *esize_ptr)
+{
+	char full_message[MAX_SIZE_MASAGE];
+	strncpy(full_message, message, MAX_SIZE_MASAGE - 1);
+	full_message[MAX_SIZE_MASAGE - 1] = '\0';
+	append_include_origin(full_message, origin);
+	return add_error(errortable_ptr, ec_ptr, origin->line - 1, full_message, esize_ptr);
+}
+
+/**
+ * @brief Appends the included file and line of an origin to an error message, if it fits.
+ *
+ * The suffix has the form " (in FILE line N)". Nothing is appended for a line
+ * of the main source file, or if the message would no longer fit.
+ *
+ * @param message The error message buffer, `MAX_SIZE_MASAGE` characters long.
+ * @param origin The origin of the line the error is on.
+ */
+void append_include_origin(char *message, const LineOrigin *origin)
+{
+	char number[MAX_SIZE_LABEL];
+	if(origin->file == NULL)
+	{
+		return;
+	}
+	sprintf(number, "%d", origin->file_line);
+	if(strlen(message) + strlen(origin->file) + strlen(number) + 12 >= MAX_SIZE_MASAGE)
+	{
+		return;
+	}
+	strcat(message, " (in ");
+	strcat(message, origin->file);
+	strcat(message, " line ");
+	strcat(message, number);
+	strcat(message, ")");
+}
+
+/**
+ * @brief Names the included file and line in the messages of errors raised on included lines.
+ *
+ * The assembly passes number their errors by expanded line. Errors whose
+ * line came from an included file get the file and its line appended.
+ *
+ * @param errortable A pointer to the error table.
+ * @param first The index of the first error to annotate.
+ * @param ec The number of errors.
+ * @param expanded The expanded source the errors refer to.
+ */
+void annotate_included_errors(struct error *errortable, int first, int ec, const ExpandedSource *expanded)
+{
+	int i, line;
+	for(i = first; i < ec; i++)
+	{
+		line = errortable[i].line;
+		if(line >= 0 && line < expanded->count)
+		{
+			append_include_origin(errortable[i].error, &expanded->origins[line]);
+		}
+	}
+}
+
+/**
+ * @brief Writes a make rule listing the source and included files of an object file.
+ *
+ * The rule makes the object file depend on its source and on every file it
+ * includes. Each included file also gets an empty rule, so make does not fail
+ * when an included file is deleted.
+ *
+ * @param name The name of the dependency file.
+ * @param base The base name of the source and object files.
+ * @param deps A pointer to the dependency list.
+ * @return 1 on success, or EXIT on a file error.
+ */
+int print_dependencies(const char *name, const char *base, const struct include_deps *deps)
+{
+	FILE *fileptr;
+	int i;
+	fileptr = open_output(name, "w");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		return EXIT;
+	}
+	fprintf(fileptr, "%s%s: %s%s", base, END_OBJECT_FILE_NAME, base, END_SOURCE_FILE_NAME);
+	for(i = 0; i < deps->count; i++)
+	{
+		fprintf(fileptr, " %s", deps->paths[i]);
+	}
+	fprintf(fileptr, "\n");
+	for(i = 0; i < deps->count; i++)
+	{
+		fprintf(fileptr, "\n%s:\n", deps->paths[i]);
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(name);
+		return EXIT;
+	}
+	return (commit_output(name) == EXIT) ? EXIT : 1;
+}
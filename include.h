@@ -0,0 +1,183 @@
+#ifndef INCLUDE_H
+#define INCLUDE_H
+
+/**
+ * @file include.h
+ * @brief This header file declares the `.include` directive of the pre-assembler.
+ *
+ * A line of the form `.include "file"` is replaced by the lines of the named
+ * file before macros are collected, so shared constant tables and macro
+ * libraries can live in their own source files. Included files are read once
+ * per run and kept in a cache that every source file of the run shares. Every
+ * flattened line remembers the file and line it came from, so errors inside an
+ * included file can name it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "file.h"
+#include "pre_assembler.h"
+#include "assembler.h"
+
+/**
+ * @def INCLUDE_DIRECTIVE
+ * @brief The directive that inserts the lines of another source file.
+ */
+#define INCLUDE_DIRECTIVE ".include"
+
+/**
+ * @def MAX_INCLUDE_DEPTH
+ * @brief The maximum nesting depth of included files.
+ */
+#define MAX_INCLUDE_DEPTH 16
+
+/**
+ * @def END_DEPENDENCY_FILE_NAME
+ * @brief Suffix for the make dependency file.
+ */
+#define END_DEPENDENCY_FILE_NAME ".d"
+
+/**
+ * @struct included_file
+ * @brief A cached included file.
+ *
+ * - `path`: The path the file was first opened with.
+ * - `device`, `inode`: The identity of the file, which any path to it shares.
+ * - `lines`: The lines of the file, read once per run.
+ * - `num_lines`: The number of lines.
+ * - `next`: The next cached file.
+ */
+struct included_file
+{
+	char *path;
+	unsigned long device;
+	unsigned long inode;
+	char **lines;
+	int num_lines;
+	struct included_file *next;
+};
+
+/**
+ * @struct include_deps
+ * @brief The included files a single source file depends on, without repeats.
+ *
+ * - `paths`: The paths of the included files (owned by the cache).
+ * - `count`: The number of paths.
+ * - `capacity`: The allocated size of `paths`.
+ */
+struct include_deps
+{
+	const char **paths;
+	int count;
+	int capacity;
+};
+
+/**
+ * @brief Finds an included file in the cache, reading it on first use.
+ * @param cache A pointer to the head of the cache.
+ * @param path The path of the file.
+ * @return A pointer to the cached file, or NULL if it cannot be opened or memory runs out.
+ */
+struct included_file *load_included_file(struct included_file **cache, const char *path);
+
+/**
+ * @brief Tells whether two paths name the same file.
+ * @param first The first path.
+ * @param second The second path.
+ * @return 1 if they name the same file, 0 otherwise.
+ */
+int same_source_file(const char *first, const char *second);
+
+/**
+ * @brief Frees every file in the cache.
+ * @param cache A pointer to the head of the cache.
+ */
+void free_include_cache(struct included_file **cache);
+
+/**
+ * @brief Records an included file as a dependency, once.
+ * @param deps A pointer to the dependency list.
+ * @param path The path of the included file.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_dependency(struct include_deps *deps, const char *path);
+
+/**
+ * @brief Frees a dependency list and resets it to empty.
+ * @param deps A pointer to the dependency list.
+ */
+void free_dependencies(struct include_deps *deps);
+
+/**
+ * @brief Builds the path of an included file relative to the file that includes it.
+ * @param including The path of the including file.
+ * @param name The file name written in the `.include` directive.
+ * @return The dynamically allocated path, or NULL on a memory allocation failure.
+ */
+char *resolve_include_path(const char *including, const char *name);
+
+/**
+ * @brief Extracts the quoted file name of an `.include` line.
+ * @param line The source line.
+ * @param name Receives the dynamically allocated file name, or NULL if the line is malformed.
+ * @return 1 if the line is an `.include` directive, 0 otherwise, or EXIT on a memory allocation failure.
+ */
+int parse_include_line(const char *line, char **name);
+
+/**
+ * @brief Replaces the `.include` lines of a source with the lines of the included files.
+ * @param path The path of the file whose lines are flattened.
+ * @param lines The lines of the file.
+ * @param num_lines The number of lines.
+ * @param parent The origin of the `.include` line that brought the file in, or NULL for the main file.
+ * @param stack The paths of the files being flattened, outermost first.
+ * @param depth The number of paths in `stack`.
+ * @param cache A pointer to the head of the include cache.
+ * @param deps A pointer to the dependency list, or NULL.
+ * @param out A pointer to the flattened source.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success (errors are reported through the error table), or EXIT on a critical failure.
+ */
+int flatten_includes(const char *path, char **lines, int num_lines, const LineOrigin *parent, const char **stack, int depth, struct included_file **cache, struct include_deps *deps, ExpandedSource *out, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr);
+
+/**
+ * @brief Adds an error on a source line, naming the included file and line if there is one.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param origin The origin of the line the error is on.
+ * @param message The error message.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_source_error(struct error **errortable_ptr, int *ec_ptr, const LineOrigin *origin, const char *message, int *esize_ptr);
+
+/**
+ * @brief Appends the included file and line of an origin to an error message, if it fits.
+ * @param message The error message buffer, `MAX_SIZE_MASAGE` characters long.
+ * @param origin The origin of the line the error is on.
+ */
+void append_include_origin(char *message, const LineOrigin *origin);
+
+/**
+ * @brief Names the included file and line in the messages of errors raised on included lines.
+ * @param errortable A pointer to the error table.
+ * @param first The index of the first error to annotate.
+ * @param ec The number of errors.
+ * @param expanded The expanded source the errors refer to.
+ */
+void annotate_included_errors(struct error *errortable, int first, int ec, const ExpandedSource *expanded);
+
+/**
+ * @brief Writes a make rule listing the source and included files of an object file.
+ * @param name The name of the dependency file.
+ * @param base The base name of the source and object files.
+ * @param deps A pointer to the dependency list.
+ * @return 1 on success, or EXIT on a file error.
+ */
+int print_dependencies(const char *name, const char *base, const struct include_deps *deps);
+
+#endif /* INCLUDE_H */
@@ -1,5 +1,7 @@
 #include "instruction.h"
 
+struct instruction_cache INSTRUCTION_CACHE = {NULL, 0, 0, 0};
+
 /**
  * @brief Processes an assembly instruction and determines its opcode and operand types.
  *
@@ -11,8 +13,8 @@
  * @param str The instruction name (e.g., "mov", "add", "jmp").
  * @param operand1 The type of the first operand (IMMEDIATE, DIRECT, REGISTER, etc.).
  * @param operand2 The type of the second operand.
- * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ic A pointer to the instruction counter.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
@@ -20,7 +22,7 @@
  * @param esize A pointer to the size of the error table.
  * @return 0 on success, or EXIT on a critical memory error.
  */
-int word(char str[], int operand1, int operand2, struct instructionsMemory* instable, struct error* errortable, int* ic, int* ec, int* cl, int *isize, int *esize)
+int word(char str[], int operand1, int operand2, struct instructionsMemory**instable, struct error**errortable, int* ic, int* ec, int* cl, int *isize, int *esize)
 {
 	if(strcmp(str,"mov")==0)
 	{
@@ -52,7 +54,7 @@ int word(char str[], int operand1, int operand2, struct instructionsMemory* inst
 		{
 			SET_OPCODE_2_AND_TYPE2(instable, ic, LEA, operand1, operand2, isize);
 		}
-		if(add_error(&errortable, ec, *cl, ": illegal address in operand", esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *cl, ": illegal address in operand", esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	else if(strcmp(str,"not")==0)
@@ -166,8 +168,8 @@ int which_type_operand(char str[])
  * It also handles memory allocation and error reporting.
  *
  * @param str The instruction line.
- * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ic A pointer to the instruction counter.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
@@ -175,7 +177,7 @@ int which_type_operand(char str[])
  * @param esize A pointer to the size of the error table.
  * @return 1 on success, 0 on a syntax error, or EXIT on a critical memory error.
  */
-int instruction(char str[], struct instructionsMemory *instable, struct error *errortable, int *ic, int *ec, int *lc, int *isize, int *esize)
+int instruction(char str[], struct instructionsMemory **instable, struct error **errortable, int *ic, int *ec, int *lc, int *isize, int *esize)
 {
 	char *word1 = NULL;
 	char *word2 = NULL;
@@ -210,7 +212,7 @@ int instruction(char str[], struct instructionsMemory *instable, struct error *e
 	}
 	if(word4 != NULL)
 	{
-		if(add_error(&errortable, ec, *lc, ": error! More operands than allowed" , esize) == EXIT){goto clean_ins;}
+		if(add_error(errortable, ec, *lc, ": error! More operands than allowed" , esize) == EXIT){goto clean_ins;}
 		if(tmp)free(tmp);
 		free(str_copy);
 		return 0;
@@ -259,8 +261,8 @@ int instruction(char str[], struct instructionsMemory *instable, struct error *e
  * @param word2 The second operand string (optional).
  * @param operand1 The type of the first operand.
  * @param operand2 The type of the second operand.
- * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ic A pointer to the instruction counter.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
@@ -268,7 +270,7 @@ int instruction(char str[], struct instructionsMemory *instable, struct error *e
  * @param esize A pointer to the size of the error table.
  * @return 1 on success, 0 on an invalid operand, or EXIT on a critical memory error.
  */
-int update(char word1[], char word2[], int operand1, int operand2, struct instructionsMemory* instable, struct error *errortable, int* ic, int* ec, int *lc, int *isize, int *esize)
+int update(char word1[], char word2[], int operand1, int operand2, struct instructionsMemory**instable, struct error **errortable, int* ic, int* ec, int *lc, int *isize, int *esize)
 {
 	char *reg1mat = NULL;
 	char *reg2mat = NULL;
@@ -307,7 +309,7 @@ int update(char word1[], char word2[], int operand1, int operand2, struct instru
 			num = strtol(str_p1, &ptr, DECIMAL);
 			if(*ptr != '\0')
 			{
-				if(add_error(&errortable, ec, *lc, ": error! an immediate operand must contain a number." , esize) == EXIT){goto clean_up;}
+				if(add_error(errortable, ec, *lc, ": error! an immediate operand must contain a number." , esize) == EXIT){goto clean_up;}
 				free(str);
 				free(str1);
 				if(str2)free(str2);
@@ -344,7 +346,7 @@ int update(char word1[], char word2[], int operand1, int operand2, struct instru
 			SET_REGISTE_AND_TYPE(instable, ic, atoi(str_p1), 0, ABSOLUTE, isize)
 			break;
 		default:
-			if(add_error(&errortable, ec, *lc, ": error! unknown operand", esize) == EXIT){goto clean_up;}
+			if(add_error(errortable, ec, *lc, ": error! unknown operand", esize) == EXIT){goto clean_up;}
 			goto clean_up_zero;
 			break;
 	}
@@ -373,13 +375,13 @@ int update(char word1[], char word2[], int operand1, int operand2, struct instru
  * It reports errors for malformed matrix definitions.
  *
  * @param str The matrix operand string.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the matrix is valid, 0 if it's invalid, or EXIT on a critical memory error.
  */
-int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int *esize)
+int is_valid_matrix(char str[], struct error **errortable, int* ec, int *lc, int *esize)
 {
 	int i = 0;
 	int len = 0;
@@ -394,7 +396,7 @@ int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int
 	}
 	if (!isalpha(str[i]))
 	{
-		if(add_error(&errortable, ec, *lc, ": error! Invalid matrix. Matrix name must appear and begin with a letter" , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! Invalid matrix. Matrix name must appear and begin with a letter" , esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	i++;
@@ -404,7 +406,7 @@ int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int
 	}
 	if (i >= len || str[i] != '[')
 	{
-		if(add_error(&errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	i++;
@@ -414,7 +416,7 @@ int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int
 	}
 	if (i >= len || str[i] != 'r' || i + 1 >= len || !isdigit(str[i+1]) || (str[i+1] < '0' || str[i+1] > '7'))
 	{
-		if(add_error(&errortable, ec, *lc, ": error! Invalid matrix a valid register must appear" , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! Invalid matrix a valid register must appear" , esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	i += 2;
@@ -424,13 +426,13 @@ int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int
 	}
 	if (i >= len || str[i] != ']')
 	{
-		if(add_error(&errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	i++;
 	if (i >= len || str[i] != '[')
 	{
-		if(add_error(&errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
 		return 1;
 	}
 	i++;
@@ -440,7 +442,7 @@ int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int
 	}
 	if (i >= len || str[i] != 'r' || i + 1 >= len || !isdigit(str[i+1]) || (str[i+1] < '0' || str[i+1] > '7'))
 	{
-		if(add_error(&errortable, ec, *lc, ": error! Invalid matrix a valid register must appear" , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! Invalid matrix a valid register must appear" , esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	i += 2;
@@ -450,7 +452,7 @@ int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int
 	}
 	if (i >= len || str[i] != ']')
 	{
-		if(add_error(&errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
 		return 0;
 	}
 	i++;
@@ -458,7 +460,7 @@ int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int
 	{
 		if (!isspace(str[i]) && str[i] != ',')
 		{
-			if(add_error(&errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
+			if(add_error(errortable, ec, *lc, ": error! Invalid matrix" , esize) == EXIT){return EXIT;}
 			return 0;
 		}
 		i++;
@@ -505,14 +507,14 @@ int is_matrix(char str[])
  * or multiple commas.
  *
  * @param ops_str The string containing the operands.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the operand syntax is valid, 0 if it's invalid, or EXIT on a
  * critical memory error.
  */
-int parse_ops(char *ops_str, struct error *errortable, int *ec, int *lc, int *esize)
+int parse_ops(char *ops_str, struct error **errortable, int *ec, int *lc, int *esize)
 {
 	char *str = ops_str;
 	char *comma_ptr = NULL;
@@ -542,7 +544,7 @@ int parse_ops(char *ops_str, struct error *errortable, int *ec, int *lc, int *es
 	comma_ptr = strchr(str, ',');
 	if (comma_ptr != NULL && strchr(comma_ptr + 1, ',') != NULL)
 	{
-		if(add_error(&errortable, ec, *lc, ": error! there must be only one comma between operands." , esize) == EXIT){return EXIT;}
+		if(add_error(errortable, ec, *lc, ": error! there must be only one comma between operands." , esize) == EXIT){return EXIT;}
 		return 0;
 	}
 
@@ -562,7 +564,7 @@ int parse_ops(char *ops_str, struct error *errortable, int *ec, int *lc, int *es
 			last_bracket = strrchr(str, ']');
 			if (last_bracket == NULL || space_ptr > last_bracket)
 			{
-				if(add_error(&errortable, ec, *lc, ": error! there must be a comma between operands.", esize) == EXIT){return EXIT;}
+				if(add_error(errortable, ec, *lc, ": error! there must be a comma between operands.", esize) == EXIT){return EXIT;}
 				return 0;
 			}
 		}
@@ -584,7 +586,7 @@ int parse_ops(char *ops_str, struct error *errortable, int *ec, int *lc, int *es
 		}
 		if (strlen(op1_start) == 0)
 		{
-			if(add_error(&errortable, ec, *lc, ": error! a comma cannot be placed at the start or end of the line.", esize) == EXIT){return EXIT;}
+			if(add_error(errortable, ec, *lc, ": error! a comma cannot be placed at the start or end of the line.", esize) == EXIT){return EXIT;}
 			return 0;
 		}
 
@@ -596,10 +598,156 @@ int parse_ops(char *ops_str, struct error *errortable, int *ec, int *lc, int *es
 		}
 		if (strlen(op2_start) == 0)
 		{
-			if(add_error(&errortable, ec, *lc, ": error! a comma cannot be placed at the start or end of the line.", esize) == EXIT){return EXIT;}
+			if(add_error(errortable, ec, *lc, ": error! a comma cannot be placed at the start or end of the line.", esize) == EXIT){return EXIT;}
 			return 0;
 		}
 	}
 
 	return 1;
 }
+
+/**
+ * @brief Hashes a text of known length with FNV-1a, as `hash_string` does.
+ *
+ * @param text The text.
+ * @param length The length of the text.
+ * @return The hash value.
+ */
+unsigned long hash_text(const char *text, size_t length)
+{
+	unsigned long hash = FNV_OFFSET_BASIS;
+	size_t i;
+	for(i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash = (hash * FNV_PRIME) & HASH_MASK;
+	}
+	return hash;
+}
+
+/**
+ * @brief Finds the slot of an instruction text in the cache.
+ *
+ * The table is probed linearly from the slot the hash selects; it is never
+ * more than half full, so an empty slot ends every probe.
+ *
+ * @param cache A pointer to the cache.
+ * @param text The trimmed text.
+ * @param length The length of the text.
+ * @param hash The hash of the text.
+ * @return The slot holding the text, or the empty slot where it belongs.
+ */
+struct cached_instruction_entry *find_cached_instruction(struct instruction_cache *cache, const char *text, size_t length, unsigned long hash)
+{
+	struct cached_instruction_entry *entry;
+	unsigned long slot = hash & (INSTRUCTION_CACHE_BUCKETS - 1);
+	for(;;)
+	{
+		entry = &cache->slots[slot];
+		if(entry->text == NULL || (entry->hash == hash && entry->length == length && memcmp(entry->text, text, length) == 0))
+		{
+			return entry;
+		}
+		slot = (slot + 1) & (INSTRUCTION_CACHE_BUCKETS - 1);
+	}
+}
+
+/**
+ * @brief Encodes an instruction line in the first pass, reusing the words of an identical earlier line.
+ *
+ * The line is trimmed of surrounding whitespace and looked up by its hash. On
+ * a hit its words are copied with `add_ins_block`. On a miss it goes through
+ * `instruction`, and if that succeeded without reporting an error, the words
+ * it added are stored under the text, until the cache holds
+ * `INSTRUCTION_CACHE_LIMIT` texts. Symbolic operands need nothing more: their
+ * placeholder words are part of the copy, and the second pass fills them in
+ * from the line as usual. A line with an error is never stored, so every
+ * occurrence reports it.
+ *
+ * @param str The instruction line, without its label.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ic A pointer to the instruction counter.
+ * @param ec A pointer to the error counter.
+ * @param lc A pointer to the current line number.
+ * @param isize A pointer to the size of the instruction table.
+ * @param esize A pointer to the size of the error table.
+ * @return 1 on success, 0 on an invalid line, or EXIT on a critical memory error.
+ */
+int cached_instruction(char str[], struct instructionsMemory **instable, struct error **errortable, int *ic, int *ec, int *lc, int *isize, int *esize)
+{
+	struct instruction_cache *cache = &INSTRUCTION_CACHE;
+	struct cached_instruction_entry *entry;
+	const char *text = str;
+	size_t length;
+	unsigned long hash;
+	int first_ic = *ic, first_ec = *ec, status;
+
+	if(cache->slots == NULL)
+	{
+		cache->slots = (struct cached_instruction_entry *)calloc(INSTRUCTION_CACHE_BUCKETS, sizeof(struct cached_instruction_entry));
+		if(cache->slots == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+	}
+	while(*text == ' ' || *text == '\t')
+	{
+		text++;
+	}
+	length = strlen(text);
+	while(length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t'))
+	{
+		length--;
+	}
+	hash = hash_text(text, length);
+	entry = find_cached_instruction(cache, text, length, hash);
+	if(entry->text != NULL)
+	{
+		cache->hits++;
+		return add_ins_block(instable, entry->words, entry->count, ic, isize);
+	}
+	cache->misses++;
+	status = instruction(str, instable, errortable, ic, ec, lc, isize, esize);
+	if(status == 1 && *ec == first_ec && *ic - first_ic <= MAX_INSTRUCTION_WORDS && cache->count < INSTRUCTION_CACHE_LIMIT)
+	{
+		entry->text = (char *)malloc(length + 1);
+		if(entry->text == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		memcpy(entry->text, text, length);
+		entry->text[length] = '\0';
+		entry->length = length;
+		entry->hash = hash;
+		entry->count = *ic - first_ic;
+		if(!CHECK_ONLY)
+		{
+			memcpy(entry->words, *instable + first_ic, entry->count * sizeof(struct instructionsMemory));
+		}
+		cache->count++;
+	}
+	return status;
+}
+
+/**
+ * @brief Frees the instruction cache.
+ *
+ * @param cache A pointer to the cache.
+ */
+void free_instruction_cache(struct instruction_cache *cache)
+{
+	int i;
+	if(cache->slots != NULL)
+	{
+		for(i = 0; i < INSTRUCTION_CACHE_BUCKETS; i++)
+		{
+			free(cache->slots[i].text);
+		}
+		free(cache->slots);
+	}
+	cache->slots = NULL;
+	cache->count = 0;
+}
@@ -10,6 +10,12 @@
  * validate operands, and update the instruction memory table. It also defines
  * key constants for operand types, addressing modes, and opcodes, along with
  * macros to simplify the process of adding instruction words to memory.
+ *
+ * The words the first pass produces for an instruction depend only on its
+ * text: a symbolic operand gets a placeholder word that the second pass fills
+ * in. `cached_instruction` therefore keeps the words of every valid
+ * instruction text in a hash table, and a repeated text (typically a line of
+ * a macro body) is one lookup and one copy instead of a full parse.
  */
 
 #include "data.h"
@@ -110,7 +116,7 @@ enum command{MOV=0,CMP,ADD,SUB,LEA,CLR,NOT,INC,DEC,JMP,BNE,JSR,RED,PRN,RTS, STOP
  */
 #define SET_OPCODE_2_AND_TYPE2(instable, idx, val, operand1, operand2, isize)\
 do{\
-	if(add_ins(&instable, idx, isize, RECORD_TYPE_COMMAND, val, operand1, operand2, 0, 0) == EXIT){return EXIT;}\
+	if(add_ins(instable, idx, isize, RECORD_TYPE_COMMAND, val, operand1, operand2, 0, 0) == EXIT){return EXIT;}\
 	return 1;\
 }while(0);
 
@@ -129,7 +135,7 @@ do{\
  */
 #define SET_OPCODE_1_AND_TYPE1(instable, idx, val, operand, isize)\
 do{\
-	if(add_ins(&instable, idx, isize, RECORD_TYPE_COMMAND, val, 0, operand, 0, 0) == EXIT){return EXIT;}\
+	if(add_ins(instable, idx, isize, RECORD_TYPE_COMMAND, val, 0, operand, 0, 0) == EXIT){return EXIT;}\
 	return 1;\
 }while(0);
 
@@ -147,7 +153,7 @@ do{\
  */
 #define SET_OPCODE_0_AND_TYPE0(instable, idx, val, isize)\
 do{\
-	if(add_ins(&instable, idx, isize, RECORD_TYPE_COMMAND, val, 0, 0, 0, 0) == EXIT){return EXIT;}\
+	if(add_ins(instable, idx, isize, RECORD_TYPE_COMMAND, val, 0, 0, 0, 0) == EXIT){return EXIT;}\
 	return 1;\
 }while(0);
 
@@ -166,7 +172,7 @@ do{\
  */
 #define SET_REGISTE_AND_TYPE(instable, idx, reg1, reg2, are, isize)\
 do{\
-	if(add_ins(&instable, idx, isize, RECORD_TYPE_REGISTER, 0, reg1, reg2, are, 0) == EXIT){goto clean_up;}\
+	if(add_ins(instable, idx, isize, RECORD_TYPE_REGISTER, 0, reg1, reg2, are, 0) == EXIT){goto clean_up;}\
 }while(0);
 
 /**
@@ -183,7 +189,7 @@ do{\
  */
 #define SET_ADDRESS_AND_TYPE(instable, idx, add, are, isize)\
 do{\
-	if(add_ins(&instable, idx, isize, RECORD_TYPE_ADDRESS, 0, 0, 0, are, add) == EXIT){goto clean_up;}\
+	if(add_ins(instable, idx, isize, RECORD_TYPE_ADDRESS, 0, 0, 0, are, add) == EXIT){goto clean_up;}\
 }while(0);
 
 /**
@@ -203,7 +209,7 @@ do{\
 do { \
 	if (operand1 == NO_OPERAND || operand2 == NO_OPERAND) \
 	{ \
-		if (add_error(&errortable, ec_p, *cl_p, ": error! there must be 2 operands", esize) == EXIT) {return EXIT;}\
+		if (add_error(errortable, ec_p, *cl_p, ": error! there must be 2 operands", esize) == EXIT) {return EXIT;}\
 		return 0;\
 	} \
 } while(0);
@@ -224,7 +230,7 @@ do { \
 do{ \
 	if(operand_p == IMMEDIATE) \
 	{ \
-		if(add_error(&errortable, ec_p, *cl_p, ": error! illegal address in operand", esize) == EXIT){return EXIT;}\
+		if(add_error(errortable, ec_p, *cl_p, ": error! illegal address in operand", esize) == EXIT){return EXIT;}\
 		return 0;\
 	}\
 }while(0);
@@ -246,7 +252,7 @@ do{ \
 do{ \
 	if(((operand1 == NO_OPERAND) && (operand2 == NO_OPERAND)) || ((operand1 != NO_OPERAND) && (operand2 != NO_OPERAND))) \
 	{ \
-		if(add_error(&errortable, ec_p, *cl_p, ": error! there must be 1 operand", esize) == EXIT){return EXIT;}\
+		if(add_error(errortable, ec_p, *cl_p, ": error! there must be 1 operand", esize) == EXIT){return EXIT;}\
 		return 0;\
 	}\
 }while(0);
@@ -268,7 +274,7 @@ do{ \
 do{ \
 	if((operand1 != NO_OPERAND || operand2 != NO_OPERAND)) \
 	{ \
-		if(add_error(&errortable, ec_p, *cl_p, ": error! there must be 0 operands", esize) == EXIT){return EXIT;}\
+		if(add_error(errortable, ec_p, *cl_p, ": error! there must be 0 operands", esize) == EXIT){return EXIT;}\
 		return 0;\
 	}\
 }while(0);
@@ -280,8 +286,8 @@ do{ \
  * @param str The instruction name (e.g., "mov", "add").
  * @param operand1 The type of the first operand.
  * @param operand2 The type of the second operand.
- * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ic A pointer to the instruction counter.
  * @param ec A pointer to the error counter.
  * @param cl A pointer to the current line number.
@@ -289,7 +295,7 @@ do{ \
  * @param esize A pointer to the size of the error table.
  * @return 0 on success, or EXIT on a critical memory error.
  */
-int word(char str[], int operand1, int operand2, struct instructionsMemory* instable, struct error* errortable, int* ic, int* ec, int* cl, int *isize, int *esize);
+int word(char str[], int operand1, int operand2, struct instructionsMemory**instable, struct error**errortable, int* ic, int* ec, int* cl, int *isize, int *esize);
 
 /**
  * @brief Determines the addressing type of an operand string.
@@ -303,8 +309,8 @@ int which_type_operand(char str[]);
  * @brief Processes an instruction line during the first pass.
  *
  * @param str The instruction line.
- * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ic A pointer to the instruction counter.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
@@ -312,7 +318,7 @@ int which_type_operand(char str[]);
  * @param esize A pointer to the size of the error table.
  * @return 1 on success, 0 on a syntax error, or EXIT on a critical memory error.
  */
-int instruction(char str[], struct instructionsMemory *instable, struct error *errortable, int *ic, int *ec, int *lc, int *isize, int *esize);
+int instruction(char str[], struct instructionsMemory **instable, struct error **errortable, int *ic, int *ec, int *lc, int *isize, int *esize);
 
 /**
  * @brief Updates the instruction memory with operand information.
@@ -321,8 +327,8 @@ int instruction(char str[], struct instructionsMemory *instable, struct error *e
  * @param word2 The second operand string (optional).
  * @param operand1 The type of the first operand.
  * @param operand2 The type of the second operand.
- * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
  * @param ic A pointer to the instruction counter.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
@@ -330,19 +336,19 @@ int instruction(char str[], struct instructionsMemory *instable, struct error *e
  * @param esize A pointer to the size of the error table.
  * @return 1 on success, 0 on an invalid operand, or EXIT on a critical memory error.
  */
-int update(char word1[], char word2[], int operand1, int operand2, struct instructionsMemory* instable, struct error *errortable, int* ic, int* ec, int *lc, int *isize, int *esize);
+int update(char word1[], char word2[], int operand1, int operand2, struct instructionsMemory**instable, struct error **errortable, int* ic, int* ec, int *lc, int *isize, int *esize);
 
 /**
  * @brief Validates the format of a matrix operand.
  *
  * @param str The matrix operand string.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the matrix is valid, 0 if it's invalid, or EXIT on a critical memory error.
  */
-int is_valid_matrix(char str[], struct error *errortable, int* ec, int *lc, int *esize);
+int is_valid_matrix(char str[], struct error **errortable, int* ec, int *lc, int *esize);
 
 /**
  * @brief Checks if a string contains matrix-style brackets.
@@ -356,12 +362,108 @@ int is_matrix(char str[]);
  * @brief Parses and validates operand syntax, including commas and spaces.
  *
  * @param ops_str The string containing the operands.
- * @param errortable A pointer to the error table.
+ * @param errortable The address of the pointer to the error table.
  * @param ec A pointer to the error counter.
  * @param lc A pointer to the current line number.
  * @param esize A pointer to the size of the error table.
  * @return 1 if the operand syntax is valid, 0 if it's invalid, or EXIT on a critical memory error.
  */
-int parse_ops(char *ops_str, struct error *errortable, int *ec, int *lc, int *esize);
+int parse_ops(char *ops_str, struct error **errortable, int *ec, int *lc, int *esize);
+
+/**
+ * @def INSTRUCTION_CACHE_BUCKETS
+ * @brief The number of slots of the instruction cache (a power of two).
+ */
+#define INSTRUCTION_CACHE_BUCKETS 8192
+
+/**
+ * @def INSTRUCTION_CACHE_LIMIT
+ * @brief The most texts the instruction cache holds; later texts are parsed every time.
+ */
+#define INSTRUCTION_CACHE_LIMIT (INSTRUCTION_CACHE_BUCKETS / 2)
+
+/**
+ * @def MAX_INSTRUCTION_WORDS
+ * @brief The most words one instruction line encodes to.
+ */
+#define MAX_INSTRUCTION_WORDS 5
+
+/**
+ * @struct cached_instruction_entry
+ * @brief The words of one instruction text.
+ *
+ * - `hash`: The hash of the text.
+ * - `text`: The trimmed text, or NULL for an empty slot.
+ * - `length`: The length of the text.
+ * - `words`: The words the first pass produced (unused in `--check` mode).
+ * - `count`: The number of words.
+ */
+struct cached_instruction_entry
+{
+	unsigned long hash;
+	char *text;
+	size_t length;
+	struct instructionsMemory words[MAX_INSTRUCTION_WORDS];
+	int count;
+};
+
+/**
+ * @struct instruction_cache
+ * @brief The words of the instruction texts seen so far in the run.
+ *
+ * - `slots`: An open-addressing table of `INSTRUCTION_CACHE_BUCKETS` entries, or NULL until first used.
+ * - `count`: The number of texts in the table.
+ * - `hits`, `misses`: The number of lookups that found and did not find their text.
+ */
+struct instruction_cache
+{
+	struct cached_instruction_entry *slots;
+	int count;
+	long hits;
+	long misses;
+};
+
+/**
+ * @brief The instruction cache of the run.
+ */
+extern struct instruction_cache INSTRUCTION_CACHE;
+
+/**
+ * @brief Hashes a text of known length with FNV-1a, as `hash_string` does.
+ * @param text The text.
+ * @param length The length of the text.
+ * @return The hash value.
+ */
+unsigned long hash_text(const char *text, size_t length);
+
+/**
+ * @brief Finds the slot of an instruction text in the cache.
+ * @param cache A pointer to the cache.
+ * @param text The trimmed text.
+ * @param length The length of the text.
+ * @param hash The hash of the text.
+ * @return The slot holding the text, or the empty slot where it belongs.
+ */
+struct cached_instruction_entry *find_cached_instruction(struct instruction_cache *cache, const char *text, size_t length, unsigned long hash);
+
+/**
+ * @brief Encodes an instruction line in the first pass, reusing the words of an identical earlier line.
+ * @param str The instruction line, without its label.
+ * @param instable The address of the pointer to the instruction memory table.
+ * @param errortable The address of the pointer to the error table.
+ * @param ic A pointer to the instruction counter.
+ * @param ec A pointer to the error counter.
+ * @param lc A pointer to the current line number.
+ * @param isize A pointer to the size of the instruction table.
+ * @param esize A pointer to the size of the error table.
+ * @return 1 on success, 0 on an invalid line, or EXIT on a critical memory error.
+ */
+int cached_instruction(char str[], struct instructionsMemory **instable, struct error **errortable, int *ic, int *ec, int *lc, int *isize, int *esize);
+
+/**
+ * @brief Frees the instruction cache.
+ * @param cache A pointer to the cache.
+ */
+void free_instruction_cache(struct instruction_cache *cache);
 
 #endif /* INSTRUCTION_H */
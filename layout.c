@@ -0,0 +1,451 @@
+#include "layout.h"
+
+/**
+ * @brief Reads the `.map` file of a previous build.
+ *
+ * Every line holds a label, the start address of its block and the size of
+ * the block, separated by tabs. Only the label and the address are kept; the
+ * labels are sorted so blocks can be looked up with `bsearch`. A build that
+ * has no `.map` file has no blocks.
+ *
+ * @param name The name of the `.map` file.
+ * @param refs Receives the blocks as labels with addresses, sorted by name (NULL if the file does not exist).
+ * @param count Receives the number of blocks (0 if the file does not exist).
+ * @return 1 on success, or EXIT if the file is malformed or memory allocation fails.
+ */
+int load_layout_map(const char *name, struct external **refs, int *count)
+{
+	FILE *fileptr;
+	char **lines, *tab, *size_tab;
+	unsigned long address, size;
+	int i, num_lines = 0;
+
+	*refs = NULL;
+	*count = 0;
+	fileptr = fopen(name, "r");
+	if(fileptr == NULL)
+	{
+		return 1;
+	}
+	fclose(fileptr);
+	lines = read_raw_lines(name, &num_lines);
+	if(lines == NULL)
+	{
+		fprintf(stdout, "error opening file!\n");
+		return EXIT;
+	}
+	*refs = (struct external *)malloc((num_lines + 1) * sizeof(struct external));
+	if(*refs == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		free_lines(lines, num_lines);
+		return EXIT;
+	}
+	for(i = 0; i < num_lines; i++)
+	{
+		tab = strchr(lines[i], '\t');
+		size_tab = (tab != NULL) ? strchr(tab + 1, '\t') : NULL;
+		if(size_tab == NULL || tab == lines[i] || tab - lines[i] > MAX_SIZE_LABEL || !base4_to_value(tab + 1, (size_t)(size_tab - tab - 1), &address) || !base4_to_value(size_tab + 1, strlen(size_tab + 1), &size))
+		{
+			fprintf(stdout, "invalid layout map: %s\n", name);
+			free_lines(lines, num_lines);
+			free(*refs);
+			*refs = NULL;
+			return EXIT;
+		}
+		memcpy((*refs)[i].name, lines[i], (size_t)(tab - lines[i]));
+		(*refs)[i].name[tab - lines[i]] = '\0';
+		(*refs)[i].index = (int)address;
+	}
+	*count = num_lines;
+	free_lines(lines, num_lines);
+	qsort(*refs, (size_t)num_lines, sizeof(struct external), compare_symbol_names);
+	return 1;
+}
+
+/**
+ * @brief Orders labels by name only (a `qsort` and `bsearch` comparator).
+ *
+ * @param a A pointer to the first label.
+ * @param b A pointer to the second label.
+ * @return A negative, zero or positive value.
+ */
+int compare_symbol_names(const void *a, const void *b)
+{
+	return strcmp(((const struct external *)a)->name, ((const struct external *)b)->name);
+}
+
+/**
+ * @brief Orders addresses (a `qsort` comparator).
+ *
+ * @param a A pointer to the first address.
+ * @param b A pointer to the second address.
+ * @return A negative, zero or positive value.
+ */
+int compare_addresses(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/**
+ * @brief Cuts the dense image into blocks at every label.
+ *
+ * A block starts at the first code word, at the first data word and at every
+ * address that a code or data label points to, and ends where the next one
+ * starts. A code block remembers whether its last instruction is `jmp`, `rts`
+ * or `stop`, since only then can padding follow it.
+ *
+ * @param instable A pointer to the instruction table.
+ * @param labeltable A pointer to the label table.
+ * @param lac The number of labels.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @param count Receives the number of blocks.
+ * @return The dynamically allocated blocks in address order, or NULL on a memory allocation failure.
+ */
+struct layout_block *split_layout_blocks(struct instructionsMemory *instable, struct labelMemory *labeltable, int lac, int ic, int dc, int *count)
+{
+	struct layout_block *blocks;
+	int *starts, num_starts = 0, end = MEMORY_START + ic + dc, i, j, k, opcode;
+
+	*count = 0;
+	starts = (int *)malloc((lac + 2) * sizeof(int));
+	blocks = (struct layout_block *)malloc((lac + 2) * sizeof(struct layout_block));
+	if(starts == NULL || blocks == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		free(starts);
+		free(blocks);
+		return NULL;
+	}
+	if(ic > 0)
+	{
+		starts[num_starts++] = MEMORY_START;
+	}
+	if(dc > 0)
+	{
+		starts[num_starts++] = MEMORY_START + ic;
+	}
+	for(i = 0; i < lac; i++)
+	{
+		if(labeltable[i].en != EXTERN && labeltable[i].index >= MEMORY_START && labeltable[i].index < end)
+		{
+			starts[num_starts++] = labeltable[i].index;
+		}
+	}
+	qsort(starts, (size_t)num_starts, sizeof(int), compare_addresses);
+
+	for(i = 0; i < num_starts; i++)
+	{
+		if(i > 0 && starts[i] == starts[i - 1])
+		{
+			continue;
+		}
+		blocks[*count].name = NULL;
+		blocks[*count].start = starts[i];
+		blocks[*count].previous = -1;
+		blocks[*count].code = (starts[i] < MEMORY_START + ic);
+		blocks[*count].transfer = 0;
+		(*count)++;
+	}
+	for(k = 0; k < *count; k++)
+	{
+		blocks[k].size = ((k + 1 < *count) ? blocks[k + 1].start : end) - blocks[k].start;
+		if(blocks[k].code && blocks[k].start + blocks[k].size > MEMORY_START + ic)
+		{
+			blocks[k].size = MEMORY_START + ic - blocks[k].start;
+		}
+		blocks[k].new_start = blocks[k].start;
+
+		/* Name the block after its first label of the same segment. */
+		for(i = 0; i < lac; i++)
+		{
+			if(labeltable[i].en != EXTERN && labeltable[i].index == blocks[k].start && (labeltable[i].type == INSTRUCTION) == blocks[k].code)
+			{
+				blocks[k].name = labeltable[i].name;
+				break;
+			}
+		}
+
+		/* Find the opcode of the last instruction of a code block. */
+		if(blocks[k].code)
+		{
+			opcode = -1;
+			for(j = blocks[k].start - MEMORY_START; j < blocks[k].start - MEMORY_START + blocks[k].size; j++)
+			{
+				if(instable[j].type == RECORD_TYPE_COMMAND)
+				{
+					opcode = instable[j].data.command.opcode;
+				}
+			}
+			blocks[k].transfer = (opcode == JMP || opcode == RTS || opcode == STOP);
+		}
+	}
+	free(starts);
+	return blocks;
+}
+
+/**
+ * @brief Chooses the address of every block.
+ *
+ * The blocks are placed in order. A block keeps its previous address when that
+ * address is not below the end of the block before it and the gap may be
+ * padded; otherwise it is placed right after the block before it, and its
+ * slack. The first code block always starts at `MEMORY_START`, where
+ * execution begins.
+ *
+ * The slack after a block is only reserved when the next block may be padded,
+ * so no instruction runs into it, and never after the last block. A block that
+ * grew by no more than its slack since the previous build leaves the next
+ * block where it was.
+ *
+ * @param blocks The blocks in address order.
+ * @param count The number of blocks.
+ * @param padding Non-zero to keep blocks at their previous addresses with padding.
+ * @param slack The words to reserve after a block in front of one that may be padded (ignored without padding).
+ * @param ic Receives the number of instruction words of the new layout.
+ * @param dc Receives the number of data words of the new layout.
+ * @return The number of words of blocks of the previous build that moved.
+ */
+int place_layout_blocks(struct layout_block *blocks, int count, int padding, int slack, int *ic, int *dc)
+{
+	int k, cursor = MEMORY_START, moved = 0, can_pad;
+	*ic = 0;
+	for(k = 0; k < count; k++)
+	{
+		can_pad = padding && (!blocks[k].code || (k > 0 && blocks[k - 1].transfer));
+		if(blocks[k].previous == cursor || (can_pad && blocks[k].previous > cursor))
+		{
+			blocks[k].new_start = blocks[k].previous;
+		}
+		else
+		{
+			blocks[k].new_start = (can_pad && k > 0) ? cursor + slack : cursor;
+		}
+		if(blocks[k].previous >= 0 && blocks[k].new_start != blocks[k].previous)
+		{
+			moved += blocks[k].size;
+		}
+		cursor = blocks[k].new_start + blocks[k].size;
+		if(blocks[k].code)
+		{
+			*ic = cursor - MEMORY_START;
+		}
+	}
+	*dc = cursor - MEMORY_START - *ic;
+	return moved;
+}
+
+/**
+ * @brief Translates a dense address into the stable layout.
+ *
+ * The block that holds the address is found by binary search; an address past
+ * the last block keeps its distance from the end of the image.
+ *
+ * @param blocks The placed blocks in address order.
+ * @param count The number of blocks.
+ * @param address The address in the dense layout.
+ * @return The address in the stable layout.
+ */
+int map_layout_address(const struct layout_block *blocks, int count, int address)
+{
+	int low = 0, high = count - 1, mid;
+	if(count == 0 || address < blocks[0].start)
+	{
+		return address;
+	}
+	while(low < high)
+	{
+		mid = (low + high + 1) / 2;
+		if(blocks[mid].start <= address)
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+	return address - blocks[low].start + blocks[low].new_start;
+}
+
+/**
+ * @brief Lays the image out with the blocks at their previous addresses and writes the `.map` file.
+ *
+ * This runs after the second pass, on the dense image. When the layout
+ * changes, the code and data words are copied into new tables with zero words
+ * in the gaps, and every relocatable address word, label address and external
+ * reference address is translated. The number of words that moved is
+ * reported on stdout.
+ *
+ * @param name The name of the `.map` file to write.
+ * @param directory The directory of the previous build, whose `.map` file is read.
+ * @param base The base name of the source file; only its last path component is used inside `directory`.
+ * @param instable A pointer to the pointer to the instruction table (it may be replaced).
+ * @param datatable A pointer to the pointer to the data table (it may be replaced).
+ * @param labeltable A pointer to the label table.
+ * @param extable A pointer to the external table.
+ * @param ic A pointer to the number of instruction words.
+ * @param dc A pointer to the number of data words.
+ * @param isize A pointer to the size of the instruction table.
+ * @param dsize A pointer to the size of the data table.
+ * @param lac The number of labels.
+ * @param exc The number of external references.
+ * @param placed Receives the placed blocks, for translating other dense addresses with `map_layout_address`, or NULL.
+ * @param num_placed Receives the number of placed blocks, or NULL.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int stable_layout(const char *name, const char *directory, const char *base, struct instructionsMemory **instable, struct dataMemory **datatable, struct labelMemory *labeltable, struct external *extable, int *ic, int *dc, int *isize, int *dsize, int lac, int exc, struct layout_block **placed, int *num_placed)
+{
+	FILE *fileptr;
+	struct layout_block *blocks = NULL;
+	struct external *previous = NULL, key, *found;
+	struct instructionsMemory *new_instable = NULL;
+	struct dataMemory *new_datatable = NULL;
+	char *path = NULL, address[NUM_4 + 1], size[NUM_4 + 1];
+	int i, j, k, count = 0, num_previous = 0, new_ic, new_dc, moved, status = EXIT;
+
+	if(strrchr(base, '/') != NULL)
+	{
+		base = strrchr(base, '/') + 1;
+	}
+	path = (char *)malloc(strlen(directory) + strlen(base) + MAX_LEN_OF_STRING_END + 1);
+	if(path == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	strcpy(path, directory);
+	strcat(path, "/");
+	strcat(path, base);
+	strcat(path, END_MAP_FILE_NAME);
+	if(load_layout_map(path, &previous, &num_previous) == EXIT){goto clean;}
+	blocks = split_layout_blocks(*instable, labeltable, lac, *ic, *dc, &count);
+	if(blocks == NULL){goto clean;}
+
+	/* Look up where the previous build placed every block. */
+	for(k = 0; k < count; k++)
+	{
+		if(blocks[k].name != NULL && previous != NULL)
+		{
+			strcpy(key.name, blocks[k].name);
+			key.index = -1;
+			found = (struct external *)bsearch(&key, previous, (size_t)num_previous, sizeof(struct external), compare_symbol_names);
+			if(found != NULL)
+			{
+				blocks[k].previous = found->index;
+			}
+		}
+	}
+
+	/* Slack, then padding, must not push the image over the memory the dense layout fits in. */
+	moved = place_layout_blocks(blocks, count, 1, LAYOUT_BLOCK_SLACK, &new_ic, &new_dc);
+	if(new_ic + new_dc > MAX_SIZE_MEMORY && *ic + *dc <= MAX_SIZE_MEMORY)
+	{
+		moved = place_layout_blocks(blocks, count, 1, 0, &new_ic, &new_dc);
+	}
+	if(new_ic + new_dc > MAX_SIZE_MEMORY && *ic + *dc <= MAX_SIZE_MEMORY)
+	{
+		moved = place_layout_blocks(blocks, count, 0, 0, &new_ic, &new_dc);
+	}
+
+	/* Copy the blocks to their new addresses and translate every address. */
+	if(new_ic != *ic || new_dc != *dc)
+	{
+		new_instable = (struct instructionsMemory *)calloc((size_t)new_ic + 1, sizeof(struct instructionsMemory));
+		new_datatable = (struct dataMemory *)calloc((size_t)new_dc + 1, sizeof(struct dataMemory));
+		if(new_instable == NULL || new_datatable == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			goto clean;
+		}
+		for(j = 0; j < new_ic; j++)
+		{
+			new_instable[j].type = RECORD_TYPE_ADDRESS;
+		}
+		for(k = 0; k < count; k++)
+		{
+			for(j = 0; j < blocks[k].size; j++)
+			{
+				if(blocks[k].code)
+				{
+					new_instable[blocks[k].new_start - MEMORY_START + j] = (*instable)[blocks[k].start - MEMORY_START + j];
+				}
+				else
+				{
+					new_datatable[blocks[k].new_start - MEMORY_START - new_ic + j] = (*datatable)[blocks[k].start - MEMORY_START - *ic + j];
+				}
+			}
+		}
+		for(j = 0; j < new_ic; j++)
+		{
+			if(new_instable[j].type == RECORD_TYPE_ADDRESS && new_instable[j].data.addr.ARE == RELOCATABLE)
+			{
+				new_instable[j].data.addr.address = map_layout_address(blocks, count, new_instable[j].data.addr.address);
+			}
+		}
+		for(i = 0; i < lac; i++)
+		{
+			if(labeltable[i].en != EXTERN && (labeltable[i].type == INSTRUCTION || labeltable[i].type == DIRECTIVE))
+			{
+				labeltable[i].index = map_layout_address(blocks, count, labeltable[i].index);
+			}
+		}
+		for(i = 0; i < exc; i++)
+		{
+			extable[i].index = map_layout_address(blocks, count, extable[i].index);
+		}
+		spill_free(*instable);
+		spill_free(*datatable);
+		*instable = new_instable;
+		*datatable = new_datatable;
+		new_instable = NULL;
+		new_datatable = NULL;
+		*isize = new_ic + 1;
+		*dsize = new_dc + 1;
+		*ic = new_ic;
+		*dc = new_dc;
+	}
+
+	/* Write the layout for the next build. */
+	fileptr = open_output(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	address[NUM_4] = '\0';
+	size[NUM_4] = '\0';
+	for(k = 0; k < count; k++)
+	{
+		if(blocks[k].name != NULL)
+		{
+			word_to_base4((unsigned long)blocks[k].new_start, NUM_4, address);
+			word_to_base4((unsigned long)blocks[k].size, NUM_4, size);
+			fprintf(fileptr, "%s\t%s\t%s\n", blocks[k].name, address, size);
+		}
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(name);
+		goto clean;
+	}
+	if(commit_output(name) == EXIT){goto clean;}
+	status = 1;
+	fprintf(stdout, "%s: %d words moved\n", base, moved);
+	if(placed != NULL)
+	{
+		*placed = blocks;
+		*num_placed = count;
+		blocks = NULL;
+	}
+
+	clean:
+		free(path);
+		free(previous);
+		free(blocks);
+		free(new_instable);
+		free(new_datatable);
+		return status;
+}
@@ -0,0 +1,150 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+/**
+ * @file layout.h
+ * @brief This header file declares the layout-stable assembly mode.
+ *
+ * Normally the code is laid out word after word and the data follows right
+ * after the code, so inserting a single word shifts every later label. In
+ * layout-stable mode the image is cut into blocks, one at every label, and
+ * every block whose label the previous build placed at an address that is
+ * still free keeps that address. Zero words pad the gap in front of it.
+ *
+ * Padding is only inserted where no instruction falls through into it: in
+ * front of a data block, or in front of a code block whose preceding block
+ * ends with `jmp`, `rts` or `stop`. Wherever it is allowed, `LAYOUT_BLOCK_SLACK`
+ * words are reserved after a block, so the next build can grow it a little
+ * without moving what follows. A block that cannot keep its address moves
+ * down to the next free one. If the slack would overflow the memory it is
+ * left out, and if padding still would, the dense layout is kept.
+ *
+ * The block layout of every build is written to a `.map` file that the next
+ * build reads: one line per labeled block with the label, the start address
+ * and the size, in special base-4.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "second_pass.h"
+#include "instruction.h"
+#include "delta.h"
+#include "assembler.h"
+
+/**
+ * @def END_MAP_FILE_NAME
+ * @brief Suffix for the block layout file.
+ */
+#define END_MAP_FILE_NAME ".map"
+
+/**
+ * @def LAYOUT_BLOCK_SLACK
+ * @brief The zero words reserved after a block where padding is allowed, so it can grow without moving the next one.
+ */
+#define LAYOUT_BLOCK_SLACK 2
+
+/**
+ * @struct layout_block
+ * @brief A run of words that starts at a label and moves as a whole.
+ *
+ * - `name`: The first label at the start of the block, or NULL if it has none.
+ * - `start`: The address of the block in the dense layout.
+ * - `size`: The number of words in the block.
+ * - `new_start`: The address of the block in the stable layout.
+ * - `previous`: The address of the block in the previous build, or -1 if it is new.
+ * - `code`: Non-zero for a code block, zero for a data block.
+ * - `transfer`: Non-zero if the last instruction of a code block never falls through.
+ */
+struct layout_block
+{
+	const char *name;
+	int start;
+	int size;
+	int new_start;
+	int previous;
+	int code;
+	int transfer;
+};
+
+/**
+ * @brief Reads the `.map` file of a previous build.
+ * @param name The name of the `.map` file.
+ * @param refs Receives the blocks as labels with addresses, sorted by name (NULL if the file does not exist).
+ * @param count Receives the number of blocks (0 if the file does not exist).
+ * @return 1 on success, or EXIT if the file is malformed or memory allocation fails.
+ */
+int load_layout_map(const char *name, struct external **refs, int *count);
+
+/**
+ * @brief Orders labels by name only (a `qsort` and `bsearch` comparator).
+ * @param a A pointer to the first label.
+ * @param b A pointer to the second label.
+ * @return A negative, zero or positive value.
+ */
+int compare_symbol_names(const void *a, const void *b);
+
+/**
+ * @brief Orders addresses (a `qsort` comparator).
+ * @param a A pointer to the first address.
+ * @param b A pointer to the second address.
+ * @return A negative, zero or positive value.
+ */
+int compare_addresses(const void *a, const void *b);
+
+/**
+ * @brief Cuts the dense image into blocks at every label.
+ * @param instable A pointer to the instruction table.
+ * @param labeltable A pointer to the label table.
+ * @param lac The number of labels.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @param count Receives the number of blocks.
+ * @return The dynamically allocated blocks in address order, or NULL on a memory allocation failure.
+ */
+struct layout_block *split_layout_blocks(struct instructionsMemory *instable, struct labelMemory *labeltable, int lac, int ic, int dc, int *count);
+
+/**
+ * @brief Chooses the address of every block.
+ * @param blocks The blocks in address order.
+ * @param count The number of blocks.
+ * @param padding Non-zero to keep blocks at their previous addresses with padding.
+ * @param slack The words to reserve after a block in front of one that may be padded (ignored without padding).
+ * @param ic Receives the number of instruction words of the new layout.
+ * @param dc Receives the number of data words of the new layout.
+ * @return The number of words of blocks of the previous build that moved.
+ */
+int place_layout_blocks(struct layout_block *blocks, int count, int padding, int slack, int *ic, int *dc);
+
+/**
+ * @brief Translates a dense address into the stable layout.
+ * @param blocks The placed blocks in address order.
+ * @param count The number of blocks.
+ * @param address The address in the dense layout.
+ * @return The address in the stable layout.
+ */
+int map_layout_address(const struct layout_block *blocks, int count, int address);
+
+/**
+ * @brief Lays the image out with the blocks at their previous addresses and writes the `.map` file.
+ * @param name The name of the `.map` file to write.
+ * @param directory The directory of the previous build, whose `.map` file is read.
+ * @param base The base name of the source file; only its last path component is used inside `directory`.
+ * @param instable A pointer to the pointer to the instruction table (it may be replaced).
+ * @param datatable A pointer to the pointer to the data table (it may be replaced).
+ * @param labeltable A pointer to the label table.
+ * @param extable A pointer to the external table.
+ * @param ic A pointer to the number of instruction words.
+ * @param dc A pointer to the number of data words.
+ * @param isize A pointer to the size of the instruction table.
+ * @param dsize A pointer to the size of the data table.
+ * @param lac The number of labels.
+ * @param exc The number of external references.
+ * @param placed Receives the placed blocks, for translating other dense addresses with `map_layout_address`, or NULL.
+ * @param num_placed Receives the number of placed blocks, or NULL.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int stable_layout(const char *name, const char *directory, const char *base, struct instructionsMemory **instable, struct dataMemory **datatable, struct labelMemory *labeltable, struct external *extable, int *ic, int *dc, int *isize, int *dsize, int lac, int exc, struct layout_block **placed, int *num_placed);
+
+#endif /* LAYOUT_H */
@@ -0,0 +1,2188 @@
+#include "lsp.h"
+
+struct lsp_trace LSP_TRACE;
+
+/**
+ * @brief Runs the language server until the client sends `exit` or closes the input.
+ *
+ * Each message is decoded just enough to find its method, id and parameters.
+ * Opening or changing a document (with whole texts or ranges) updates its
+ * lines and, when they differ from the stored ones, re-runs the checks in
+ * memory, where possible on the changed lines only, and publishes the errors.
+ * No `.am`, `.ob`, `.ent` or `.ext` file is ever written in this mode.
+ *
+ * @param in The stream the client writes requests to.
+ * @param out The stream the server writes responses and notifications to.
+ * @return 1 on a clean exit, or EXIT on a critical memory error.
+ */
+int lsp_run(FILE *in, FILE *out)
+{
+	struct lsp_document *docs = NULL, *doc, *next;
+	struct lsp_edit edit;
+	char *body, *method = NULL, *id = NULL, *uri = NULL, *text = NULL;
+	const char *value;
+	int changed, line, character, done = 0, status = 1;
+
+	while(!done && (body = lsp_read_message(in)) != NULL)
+	{
+		value = json_find_key(body, "method");
+		method = (value != NULL) ? json_string_value(value) : NULL;
+		value = json_find_key(body, "id");
+		id = (value != NULL) ? json_raw_value(value) : NULL;
+		value = json_find_key(body, "uri");
+		uri = (value != NULL) ? json_string_value(value) : NULL;
+
+		if(method == NULL)
+		{
+			/* A response from the client: nothing to do. */
+		}
+		else if(strcmp(method, "initialize") == 0)
+		{
+			if(lsp_respond(out, id, "{\"capabilities\":{\"textDocumentSync\":2,\"definitionProvider\":true}}") == EXIT){goto clean_lsp;}
+		}
+		else if(strcmp(method, "shutdown") == 0)
+		{
+			if(lsp_respond(out, id, "null") == EXIT){goto clean_lsp;}
+		}
+		else if(strcmp(method, "exit") == 0)
+		{
+			done = 1;
+		}
+		else if(strcmp(method, "textDocument/didOpen") == 0 && uri != NULL)
+		{
+			value = json_find_key(body, "text");
+			text = (value != NULL) ? json_string_value(value) : NULL;
+			if(text != NULL)
+			{
+				changed = lsp_update_document(&docs, uri, text, &doc, &edit);
+				if(changed == EXIT){goto clean_lsp;}
+				if(changed && (lsp_apply_edit(doc, &edit) == EXIT || lsp_refresh_document(doc) == EXIT)){goto clean_lsp;}
+				if(lsp_publish_diagnostics(out, uri, doc) == EXIT){goto clean_lsp;}
+			}
+		}
+		else if(strcmp(method, "textDocument/didChange") == 0 && uri != NULL && (doc = lsp_find_document(docs, uri)) != NULL)
+		{
+			changed = lsp_apply_changes(doc, json_find_key(body, "contentChanges"));
+			if(changed == EXIT){goto clean_lsp;}
+			if(changed && lsp_refresh_document(doc) == EXIT){goto clean_lsp;}
+			if(lsp_publish_diagnostics(out, uri, doc) == EXIT){goto clean_lsp;}
+		}
+		else if(strcmp(method, "textDocument/didClose") == 0 && uri != NULL)
+		{
+			lsp_close_document(&docs, uri);
+			if(lsp_publish_diagnostics(out, uri, NULL) == EXIT){goto clean_lsp;}
+		}
+		else if(strcmp(method, "textDocument/definition") == 0 && id != NULL)
+		{
+			value = json_find_key(body, "line");
+			line = (value != NULL) ? atoi(value) : -1;
+			value = json_find_key(body, "character");
+			character = (value != NULL) ? atoi(value) : -1;
+			doc = (uri != NULL) ? lsp_find_document(docs, uri) : NULL;
+			if(lsp_definition(out, id, doc, line, character) == EXIT){goto clean_lsp;}
+		}
+		else if(id != NULL)
+		{
+			if(lsp_respond_error(out, id, LSP_METHOD_NOT_FOUND, "method not found") == EXIT){goto clean_lsp;}
+		}
+
+		free(body);
+		free(method);
+		free(id);
+		free(uri);
+		free(text);
+		method = id = uri = text = NULL;
+	}
+	goto free_docs;
+
+	clean_lsp:
+		free(body);
+		free(method);
+		free(id);
+		free(uri);
+		free(text);
+		status = EXIT;
+	free_docs:
+		for(doc = docs; doc != NULL; doc = next)
+		{
+			next = doc->next;
+			lsp_free_document(doc);
+		}
+		free(LSP_TRACE.entries);
+		LSP_TRACE.entries = NULL;
+		LSP_TRACE.capacity = 0;
+		return status;
+}
+
+/**
+ * @brief Reads one protocol message (headers and body) from a stream.
+ *
+ * Header lines are read until an empty line. The `Content-Length` header gives
+ * the number of body bytes to read after it.
+ *
+ * @param in The input stream.
+ * @return The dynamically allocated, null-terminated body, or NULL at the end
+ * of the input or on a memory allocation failure.
+ */
+char *lsp_read_message(FILE *in)
+{
+	char header[LSP_MAX_HEADER_LINE];
+	long length = -1;
+	char *body;
+	while(fgets(header, sizeof(header), in) != NULL)
+	{
+		if(strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0)
+		{
+			if(length < 0)
+			{
+				continue;
+			}
+			body = (char *)malloc(length + 1);
+			if(body == NULL)
+			{
+				fprintf(stderr, "Memory allocation failed");
+				return NULL;
+			}
+			if(fread(body, 1, length, in) != (size_t)length)
+			{
+				free(body);
+				return NULL;
+			}
+			body[length] = '\0';
+			return body;
+		}
+		if(strncmp(header, LSP_CONTENT_LENGTH, strlen(LSP_CONTENT_LENGTH)) == 0)
+		{
+			length = atol(header + strlen(LSP_CONTENT_LENGTH));
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Writes one protocol message with its `Content-Length` header.
+ *
+ * @param out The output stream.
+ * @param body The message body.
+ */
+void lsp_write_message(FILE *out, struct lsp_buffer *body)
+{
+	fprintf(out, "Content-Length: %lu\r\n\r\n", (unsigned long)body->len);
+	fwrite(body->data, 1, body->len, out);
+	fflush(out);
+}
+
+/**
+ * @brief Finds the value of a key anywhere in a JSON text, skipping string contents.
+ *
+ * The text is scanned token by token. A string followed by a colon is a key;
+ * the first key equal to `key` wins. Because string contents are skipped as a
+ * whole, a document text that happens to contain `"key":` is never matched.
+ *
+ * @param json The JSON text.
+ * @param key The key to look for.
+ * @return A pointer to the first character of the value, or NULL if the key is absent.
+ */
+const char *json_find_key(const char *json, const char *key)
+{
+	const char *p = json, *start, *after;
+	size_t key_len = strlen(key);
+	while(*p != '\0')
+	{
+		if(*p != '"')
+		{
+			p++;
+			continue;
+		}
+		start = ++p;
+		while(*p != '\0' && *p != '"')
+		{
+			if(*p == '\\' && p[1] != '\0')
+			{
+				p++;
+			}
+			p++;
+		}
+		if(*p == '\0')
+		{
+			return NULL;
+		}
+		after = p + 1;
+		while(isspace((unsigned char)*after))
+		{
+			after++;
+		}
+		if(*after == ':' && (size_t)(p - start) == key_len && strncmp(start, key, key_len) == 0)
+		{
+			after++;
+			while(isspace((unsigned char)*after))
+			{
+				after++;
+			}
+			return after;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Decodes a JSON string value.
+ *
+ * Standard escapes are decoded. A `\u` escape outside the ASCII range, which
+ * cannot appear in a valid source line, is replaced by a question mark.
+ *
+ * @param value A pointer to the opening quote of the string.
+ * @return The dynamically allocated, unescaped string, or NULL if the value is
+ * not a string or memory allocation fails.
+ */
+char *json_string_value(const char *value)
+{
+	const char *p;
+	char *str, *dst, hex[5];
+	long code;
+	if(value == NULL || *value != '"')
+	{
+		return NULL;
+	}
+	for(p = value + 1; *p != '\0' && *p != '"'; p++)
+	{
+		if(*p == '\\' && p[1] != '\0')
+		{
+			p++;
+		}
+	}
+	str = (char *)malloc((p - value) + 1);
+	if(str == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return NULL;
+	}
+	dst = str;
+	for(p = value + 1; *p != '\0' && *p != '"'; p++)
+	{
+		if(*p != '\\' || p[1] == '\0')
+		{
+			*dst++ = *p;
+			continue;
+		}
+		p++;
+		switch(*p)
+		{
+			case 'n': *dst++ = '\n'; break;
+			case 'r': *dst++ = '\r'; break;
+			case 't': *dst++ = '\t'; break;
+			case 'b': *dst++ = '\b'; break;
+			case 'f': *dst++ = '\f'; break;
+			case 'u':
+				strncpy(hex, p + 1, 4);
+				hex[4] = '\0';
+				code = strtol(hex, NULL, 16);
+				*dst++ = (code > 0 && code < 0x80) ? (char)code : '?';
+				p += strlen(hex);
+				break;
+			default: *dst++ = *p; break;
+		}
+	}
+	*dst = '\0';
+	return str;
+}
+
+/**
+ * @brief Copies a JSON number or string token as it appears in the text.
+ *
+ * This is used for request ids, which must be echoed back unchanged.
+ *
+ * @param value A pointer to the first character of the value.
+ * @return The dynamically allocated token, or NULL on a memory allocation failure.
+ */
+char *json_raw_value(const char *value)
+{
+	const char *p = value;
+	char *token;
+	if(*p == '"')
+	{
+		for(p++; *p != '\0' && *p != '"'; p++)
+		{
+			if(*p == '\\' && p[1] != '\0')
+			{
+				p++;
+			}
+		}
+		if(*p == '"')
+		{
+			p++;
+		}
+	}
+	else
+	{
+		while(*p != '\0' && *p != ',' && *p != '}' && *p != ']' && !isspace((unsigned char)*p))
+		{
+			p++;
+		}
+	}
+	token = (char *)malloc((p - value) + 1);
+	if(token == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return NULL;
+	}
+	memcpy(token, value, p - value);
+	token[p - value] = '\0';
+	return token;
+}
+
+/**
+ * @brief Skips a JSON value of any type.
+ *
+ * Objects and arrays are skipped up to their matching bracket, with string
+ * contents skipped as a whole.
+ *
+ * @param value A pointer to the first character of the value.
+ * @return A pointer to the first character after the value.
+ */
+const char *json_skip_value(const char *value)
+{
+	const char *p = value;
+	int depth = 0;
+	do
+	{
+		if(*p == '"')
+		{
+			for(p++; *p != '\0' && *p != '"'; p++)
+			{
+				if(*p == '\\' && p[1] != '\0')
+				{
+					p++;
+				}
+			}
+			if(*p == '"')
+			{
+				p++;
+			}
+		}
+		else if(*p == '{' || *p == '[')
+		{
+			depth++;
+			p++;
+		}
+		else if(*p == '}' || *p == ']')
+		{
+			depth--;
+			p++;
+		}
+		else if(depth == 0)
+		{
+			while(*p != '\0' && *p != ',' && *p != '}' && *p != ']' && !isspace((unsigned char)*p))
+			{
+				p++;
+			}
+		}
+		else
+		{
+			p++;
+		}
+	} while(*p != '\0' && depth > 0);
+	return p;
+}
+
+/**
+ * @brief Reads the integer value of a key.
+ *
+ * @param json The JSON text.
+ * @param key The key to look for.
+ * @return The value, or 0 if the key is absent.
+ */
+int json_int_value(const char *json, const char *key)
+{
+	const char *value = json_find_key(json, key);
+	return (value != NULL) ? atoi(value) : 0;
+}
+
+/**
+ * @brief Appends text to a buffer, growing it by doubling when needed.
+ *
+ * @param buf A pointer to the buffer.
+ * @param text The text to append.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int buffer_append(struct lsp_buffer *buf, const char *text)
+{
+	size_t len = strlen(text);
+	char *new_data;
+	if(buf->len + len + 1 > buf->cap)
+	{
+		while(buf->len + len + 1 > buf->cap)
+		{
+			buf->cap = (buf->cap == 0) ? LSP_MAX_HEADER_LINE : buf->cap * DOUBLE;
+		}
+		new_data = (char *)realloc(buf->data, buf->cap);
+		if(new_data == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			return EXIT;
+		}
+		buf->data = new_data;
+	}
+	memcpy(buf->data + buf->len, text, len + 1);
+	buf->len += len;
+	return 1;
+}
+
+/**
+ * @brief Appends an integer to a buffer.
+ *
+ * @param buf A pointer to the buffer.
+ * @param num The integer to append.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int buffer_append_int(struct lsp_buffer *buf, int num)
+{
+	char number[LSP_MAX_NUMBER];
+	sprintf(number, "%d", num);
+	return buffer_append(buf, number);
+}
+
+/**
+ * @brief Appends text to a buffer as a quoted JSON string.
+ *
+ * Quotes, backslashes and control characters are escaped.
+ *
+ * @param buf A pointer to the buffer.
+ * @param text The text to quote and escape.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int buffer_append_json_string(struct lsp_buffer *buf, const char *text)
+{
+	char piece[LSP_MAX_NUMBER];
+	const char *p;
+	if(buffer_append(buf, "\"") == EXIT){return EXIT;}
+	for(p = text; *p != '\0'; p++)
+	{
+		if(*p == '"' || *p == '\\')
+		{
+			sprintf(piece, "\\%c", *p);
+		}
+		else if((unsigned char)*p < ' ')
+		{
+			sprintf(piece, "\\u%04x", (unsigned int)(unsigned char)*p);
+		}
+		else
+		{
+			piece[0] = *p;
+			piece[1] = '\0';
+		}
+		if(buffer_append(buf, piece) == EXIT){return EXIT;}
+	}
+	return buffer_append(buf, "\"");
+}
+
+/**
+ * @brief Finds an open document by its URI.
+ *
+ * @param docs The list of open documents.
+ * @param uri The URI to look for.
+ * @return A pointer to the document, or NULL if it is not open.
+ */
+struct lsp_document *lsp_find_document(struct lsp_document *docs, const char *uri)
+{
+	while(docs != NULL)
+	{
+		if(strcmp(docs->uri, uri) == 0)
+		{
+			return docs;
+		}
+		docs = docs->next;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Opens a document or replaces its text.
+ *
+ * A document that is not open yet is added to the list with no lines, so the
+ * whole text shows up as an edit of its lines.
+ *
+ * @param docs A pointer to the list of open documents.
+ * @param uri The URI of the document.
+ * @param text The full text of the document.
+ * @param updated Receives a pointer to the document.
+ * @param edit Receives the lines that changed.
+ * @return 1 if the lines changed, 0 if the text is unchanged, or EXIT on a memory error.
+ */
+int lsp_update_document(struct lsp_document **docs, const char *uri, const char *text, struct lsp_document **updated, struct lsp_edit *edit)
+{
+	struct lsp_document *doc = lsp_find_document(*docs, uri);
+	if(doc == NULL)
+	{
+		doc = (struct lsp_document *)calloc(1, sizeof(struct lsp_document));
+		if(doc == NULL || (doc->uri = my_strdup(uri)) == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			free(doc);
+			return EXIT;
+		}
+		doc->next = *docs;
+		*docs = doc;
+	}
+	*updated = doc;
+	return lsp_replace_text(doc, text, edit);
+}
+
+/**
+ * @brief Replaces the whole text of a document.
+ *
+ * The new text is split into lines and every line is hashed. The lines the old
+ * and the new text share at their start and at their end are left out of the
+ * edit, so a client that always sends the whole text still has only the lines
+ * it changed analyzed again.
+ *
+ * @param doc A pointer to the document.
+ * @param text The new text.
+ * @param edit Receives the lines that changed.
+ * @return 1 if the lines changed, 0 if they are unchanged, or EXIT on a memory error.
+ */
+int lsp_replace_text(struct lsp_document *doc, const char *text, struct lsp_edit *edit)
+{
+	char **lines;
+	unsigned long *line_hash;
+	size_t len = strlen(text);
+	int num_lines, i, first, last;
+
+	lines = split_lines(text, &num_lines);
+	if(lines == NULL)
+	{
+		return EXIT;
+	}
+	line_hash = (unsigned long *)malloc((num_lines + 1) * sizeof(unsigned long));
+	if(line_hash == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		free_lines(lines, num_lines);
+		return EXIT;
+	}
+	for(i = 0; i < num_lines; i++)
+	{
+		line_hash[i] = hash_string(lines[i]);
+	}
+	for(first = 0; first < num_lines && first < doc->num_lines && line_hash[first] == doc->line_hash[first] && strcmp(lines[first], doc->lines[first]) == 0; first++);
+	for(last = 0; last < num_lines - first && last < doc->num_lines - first && line_hash[num_lines - 1 - last] == doc->line_hash[doc->num_lines - 1 - last] && strcmp(lines[num_lines - 1 - last], doc->lines[doc->num_lines - 1 - last]) == 0; last++);
+	doc->trailing_newline = (len > 0 && text[len - 1] == '\n');
+	if(first == num_lines && first == doc->num_lines)
+	{
+		free(line_hash);
+		free_lines(lines, num_lines);
+		return 0;
+	}
+	edit->first = first;
+	edit->removed = doc->num_lines - first - last;
+	edit->added = num_lines - first - last;
+	free_lines(doc->lines, doc->num_lines);
+	free(doc->line_hash);
+	doc->lines = lines;
+	doc->line_hash = line_hash;
+	doc->num_lines = num_lines;
+	return 1;
+}
+
+/**
+ * @brief Replaces a range of a document's text.
+ *
+ * Positions count lines and bytes as the editor sees the text: a text that
+ * ends with a newline, and an empty text, end with an empty line that is not
+ * stored. A position past the end of its line or of the text is moved back to
+ * it. The start of the first line of the range and the end of its last line
+ * are joined around the new text and split again at its newlines, so only the
+ * lines of the range are replaced; the other lines keep their strings.
+ *
+ * @param doc A pointer to the document.
+ * @param start_line The 0-based line where the range starts.
+ * @param start_character The 0-based column where the range starts.
+ * @param end_line The 0-based line where the range ends.
+ * @param end_character The 0-based column where the range ends.
+ * @param text The text put in place of the range.
+ * @param edit Receives the lines that changed.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_edit_document(struct lsp_document *doc, int start_line, int start_character, int end_line, int end_character, const char *text, struct lsp_edit *edit)
+{
+	char **lines = NULL, *joined;
+	unsigned long *line_hash = NULL;
+	const char *start_text, *end_text, *piece, *stop;
+	int count = doc->num_lines + (doc->trailing_newline || doc->num_lines == 0);
+	int num_lines = 0, capacity, removed, added, pieces = 1, drop_last, i;
+	size_t start_len, end_len, len;
+
+	if(start_line < 0)
+	{
+		start_line = 0;
+		start_character = 0;
+	}
+	if(start_line >= count)
+	{
+		start_line = count - 1;
+		start_character = (start_line < doc->num_lines) ? (int)strlen(doc->lines[start_line]) : 0;
+	}
+	if(end_line >= count)
+	{
+		end_line = count - 1;
+		end_character = (end_line < doc->num_lines) ? (int)strlen(doc->lines[end_line]) : 0;
+	}
+	start_text = (start_line < doc->num_lines) ? doc->lines[start_line] : "";
+	start_len = strlen(start_text);
+	if(start_character < 0 || (size_t)start_character > start_len)
+	{
+		start_character = (start_character < 0) ? 0 : (int)start_len;
+	}
+	if(end_line < start_line || (end_line == start_line && end_character < start_character))
+	{
+		end_line = start_line;
+		end_character = start_character;
+	}
+	end_text = (end_line < doc->num_lines) ? doc->lines[end_line] : "";
+	end_len = strlen(end_text);
+	if((size_t)end_character > end_len)
+	{
+		end_character = (int)end_len;
+	}
+
+	len = start_character + strlen(text) + (end_len - end_character);
+	joined = (char *)malloc(len + 1);
+	if(joined == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	memcpy(joined, start_text, start_character);
+	strcpy(joined + start_character, text);
+	strcat(joined, end_text + end_character);
+	for(piece = joined; (piece = strchr(piece, '\n')) != NULL; piece++)
+	{
+		pieces++;
+	}
+	/* The empty line after a final newline is not stored. */
+	drop_last = (end_line == count - 1 && (len == 0 || joined[len - 1] == '\n'));
+	removed = (start_line < doc->num_lines) ? ((end_line < doc->num_lines) ? end_line : doc->num_lines - 1) - start_line + 1 : 0;
+	added = pieces - drop_last;
+
+	capacity = doc->num_lines - removed + added + 1;
+	lines = (char **)malloc(capacity * sizeof(char *));
+	line_hash = (unsigned long *)malloc(capacity * sizeof(unsigned long));
+	if(lines == NULL || line_hash == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		goto clean_edit;
+	}
+	for(i = 0; i < start_line && i < doc->num_lines; i++)
+	{
+		lines[num_lines] = doc->lines[i];
+		line_hash[num_lines++] = doc->line_hash[i];
+	}
+	for(piece = joined, i = 0; i < added; i++)
+	{
+		stop = strchr(piece, '\n');
+		if(stop == NULL)
+		{
+			stop = piece + strlen(piece);
+		}
+		if(append_line(&lines, &num_lines, &capacity, piece, stop - piece) == EXIT)
+		{
+			for(i = start_line; i < num_lines; i++)
+			{
+				spill_free(lines[i]);
+			}
+			goto clean_edit;
+		}
+		line_hash[num_lines - 1] = hash_string(lines[num_lines - 1]);
+		piece = (*stop == '\n') ? stop + 1 : stop;
+	}
+	for(i = start_line + removed; i < doc->num_lines; i++)
+	{
+		lines[num_lines] = doc->lines[i];
+		line_hash[num_lines++] = doc->line_hash[i];
+	}
+	for(i = start_line; i < start_line + removed; i++)
+	{
+		spill_free(doc->lines[i]);
+	}
+	spill_free(doc->lines);
+	free(doc->line_hash);
+	free(joined);
+	doc->lines = lines;
+	doc->line_hash = line_hash;
+	doc->num_lines = num_lines;
+	if(end_line == count - 1)
+	{
+		doc->trailing_newline = drop_last;
+	}
+	edit->first = start_line;
+	edit->removed = removed;
+	edit->added = added;
+	return 1;
+
+	clean_edit:
+		free(lines);
+		free(line_hash);
+		free(joined);
+		return EXIT;
+}
+
+/**
+ * @brief Applies the content changes of a `textDocument/didChange` notification.
+ *
+ * The changes are applied in order. A change with a `range` replaces that
+ * range; a change without one replaces the whole text. The line records follow
+ * every change, so the lines a later change refers to are already in place.
+ *
+ * @param doc A pointer to the document.
+ * @param changes A pointer to the `contentChanges` array.
+ * @return 1 if the lines changed, 0 if they are unchanged, or EXIT on a memory error.
+ */
+int lsp_apply_changes(struct lsp_document *doc, const char *changes)
+{
+	const char *p, *end, *value, *range, *start, *stop;
+	char *change, *text;
+	struct lsp_edit edit;
+	int changed = 0, status;
+
+	if(changes == NULL || *changes != '[')
+	{
+		return 0;
+	}
+	p = changes + 1;
+	while(1)
+	{
+		while(isspace((unsigned char)*p) || *p == ',')
+		{
+			p++;
+		}
+		if(*p != '{')
+		{
+			break;
+		}
+		end = json_skip_value(p);
+		change = (char *)malloc((end - p) + 1);
+		if(change == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			return EXIT;
+		}
+		memcpy(change, p, end - p);
+		change[end - p] = '\0';
+		value = json_find_key(change, "text");
+		text = (value != NULL) ? json_string_value(value) : NULL;
+		range = json_find_key(change, "range");
+		start = (range != NULL) ? json_find_key(range, "start") : NULL;
+		stop = (range != NULL) ? json_find_key(range, "end") : NULL;
+		if(text == NULL)
+		{
+			status = 0;
+		}
+		else if(range == NULL)
+		{
+			status = lsp_replace_text(doc, text, &edit);
+		}
+		else if(start == NULL || stop == NULL)
+		{
+			status = 0;
+		}
+		else
+		{
+			status = lsp_edit_document(doc, json_int_value(start, "line"), json_int_value(start, "character"), json_int_value(stop, "line"), json_int_value(stop, "character"), text, &edit);
+		}
+		if(status == 1)
+		{
+			changed = 1;
+			status = lsp_apply_edit(doc, &edit);
+		}
+		free(change);
+		free(text);
+		if(status == EXIT)
+		{
+			return EXIT;
+		}
+		p = end;
+	}
+	return changed;
+}
+
+/**
+ * @brief Brings the line records of a document in line with an edit of its lines.
+ *
+ * The records of the removed lines are freed and their operations leave the
+ * name table; the new lines get fresh records and their symbols. When the
+ * document is analyzed incrementally, the removed lines are all plain, the new
+ * lines are all plain and an insertion does not follow a line that is not
+ * plain (whose block it could join), the new lines are run alone and the names
+ * they touch are queued. Otherwise the next refresh analyzes the whole document.
+ *
+ * @param doc A pointer to the document.
+ * @param edit The lines that changed.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_apply_edit(struct lsp_document *doc, const struct lsp_edit *edit)
+{
+	struct lsp_line **records;
+	struct lsp_line *record;
+	struct lsp_scratch scratch;
+	int old_lines = doc->num_lines - edit->added + edit->removed, incremental = doc->incremental, rows, i, status = 1;
+
+	for(i = edit->first; incremental && i < edit->first + edit->removed; i++)
+	{
+		incremental = doc->records[i]->plain;
+	}
+	if(incremental && edit->removed == 0 && edit->first > 0)
+	{
+		incremental = doc->records[edit->first - 1]->plain;
+	}
+	for(i = edit->first; incremental == 1 && i < edit->first + edit->added; i++)
+	{
+		incremental = lsp_plain_line(doc, doc->lines[i]);
+	}
+	if(incremental == EXIT)
+	{
+		return EXIT;
+	}
+
+	records = (struct lsp_line **)malloc((doc->num_lines + 1) * sizeof(struct lsp_line *));
+	if(records == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	for(i = edit->first; status == 1 && i < edit->first + edit->added; i++)
+	{
+		records[i] = (struct lsp_line *)calloc(1, sizeof(struct lsp_line));
+		if(records[i] == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			status = EXIT;
+		}
+		else
+		{
+			records[i]->plain = incremental;
+			status = lsp_index_line(records[i], doc->lines[i]);
+		}
+	}
+	if(status == EXIT)
+	{
+		while(--i >= edit->first)
+		{
+			free(records[i]);
+		}
+		free(records);
+		return EXIT;
+	}
+	for(i = edit->first; i < edit->first + edit->removed; i++)
+	{
+		lsp_free_rows(doc, doc->records[i]);
+		free(doc->records[i]);
+	}
+	for(i = 0; i < edit->first; i++)
+	{
+		records[i] = doc->records[i];
+	}
+	for(i = edit->first + edit->removed; i < old_lines; i++)
+	{
+		records[i - edit->removed + edit->added] = doc->records[i];
+	}
+	free(doc->records);
+	doc->records = records;
+	for(i = edit->first; i < doc->num_lines; i++)
+	{
+		records[i]->index = i;
+	}
+	if(!incremental)
+	{
+		doc->incremental = 0;
+		return 1;
+	}
+
+	if(lsp_open_scratch(&scratch) == EXIT)
+	{
+		return EXIT;
+	}
+	for(i = edit->first; status == 1 && i < edit->first + edit->added; i++)
+	{
+		record = records[i];
+		rows = lsp_line_rows(doc->lines[i]);
+		if(rows == EXIT)
+		{
+			status = EXIT;
+		}
+		else if(rows > 0)
+		{
+			record->rows = (struct lsp_row *)calloc(rows, sizeof(struct lsp_row));
+			if(record->rows == NULL)
+			{
+				fprintf(stderr, "Memory allocation failed");
+				status = EXIT;
+			}
+			else
+			{
+				record->num_rows = rows;
+				record->rows[0].line = record;
+				status = lsp_run_row(doc, &scratch, doc->lines[i], &record->rows[0]);
+			}
+		}
+	}
+	lsp_close_scratch(&scratch);
+	return status;
+}
+
+/**
+ * @brief Analyzes a document after edits, again as a whole or only where it changed.
+ *
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int lsp_refresh_document(struct lsp_document *doc)
+{
+	if(!doc->incremental)
+	{
+		return lsp_analyze_document(doc);
+	}
+	if(lsp_resolve(doc) == EXIT)
+	{
+		return EXIT;
+	}
+	return lsp_collect_diagnostics(doc);
+}
+
+/**
+ * @brief Runs the assembler checks on a document in memory and stores the results.
+ *
+ * The document lines have their `.include` lines replaced, then go through
+ * `pre_assemble_lines`. Included files are read relative to the document's
+ * path and are not cached across edits, since they may change on disk.
+ *
+ * When the pre-assembler found no error and every expanded line comes from a
+ * line of the document itself, in order, the document keeps its macro table
+ * and the rows of its lines (`lsp_build_rows`), and the diagnostics are built
+ * from them, so later edits of plain lines can be analyzed alone. Otherwise
+ * the expanded lines go through `passes_lines` with fresh tables. Errors of
+ * the pre-assembler carry source line numbers; errors of the passes carry
+ * expanded line numbers and are mapped back through the line origins. Errors
+ * raised inside a macro expansion name the macro.
+ *
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int lsp_analyze_document(struct lsp_document *doc)
+{
+	struct instructionsMemory *instable = allocated_memory_table();
+	struct labelMemory *labeltable = allocated_label_table();
+	struct error *errortable = allocated_error_table();
+	struct dataMemory *datatable = allocated_dataMemory_table();
+	struct external *extable = allocated_extern_table();
+	MacroDefinition *macrostable = NULL;
+	ExpandedSource flat = {NULL, NULL, 0, 0};
+	ExpandedSource expanded = {NULL, NULL, 0, 0};
+	struct included_file *cache = NULL;
+	const char *stack[MAX_INCLUDE_DEPTH];
+	const char *path = doc->uri;
+	struct lsp_diagnostic *diagnostics = NULL;
+	int ic = 0, dc = 0, ec = 0, lac = 0, exc = 0, pre_ec, i, line, status = EXIT;
+	int isize = MAX_SIZE_MEMORY, dsize = MAX_SIZE_MEMORY, esize = MAX_SIZE_MEMORY, lasize = MAX_SIZE_MEMORY, exsize = MAX_SIZE_MEMORY;
+
+	lsp_clear_analysis(doc);
+	if(instable == NULL || labeltable == NULL || errortable == NULL || datatable == NULL || extable == NULL){goto clean_analyze;}
+	if(strncmp(path, LSP_FILE_SCHEME, strlen(LSP_FILE_SCHEME)) == 0)
+	{
+		path += strlen(LSP_FILE_SCHEME);
+	}
+	stack[0] = path;
+	if(flatten_includes(path, doc->lines, doc->num_lines, NULL, stack, 1, &cache, NULL, &flat, &errortable, &ec, &esize) == EXIT){goto clean_analyze;}
+	if(ec == 0)
+	{
+		if(pre_assemble_lines(flat.lines, flat.count, flat.origins, NULL, &expanded, &errortable, &ec, &esize, &macrostable) == EXIT){goto clean_analyze;}
+	}
+	pre_ec = ec;
+	if(ec == 0)
+	{
+		doc->macros = macrostable;
+		macrostable = NULL;
+		status = lsp_mark_plain_lines(doc);
+		if(status == 1)
+		{
+			status = lsp_build_rows(doc, &expanded);
+		}
+		if(status == 1)
+		{
+			status = lsp_collect_diagnostics(doc);
+			doc->incremental = (status == 1);
+			goto clean_analyze;
+		}
+		if(status == EXIT){goto clean_analyze;}
+		/* The expanded lines do not follow the document lines: check them as a whole. */
+		macrostable = doc->macros;
+		doc->macros = NULL;
+		lsp_clear_analysis(doc);
+		status = EXIT;
+		if(passes_lines(expanded.lines, expanded.count, &instable, &labeltable, &errortable, &extable, &datatable, macrostable, &ic, &dc, &ec, &lac, &exc, &isize, &dsize, &esize, &lasize, &exsize, NULL) == EXIT){goto clean_analyze;}
+		annotate_included_errors(errortable, pre_ec, ec, &expanded);
+	}
+
+	diagnostics = (struct lsp_diagnostic *)malloc((ec + 1) * sizeof(struct lsp_diagnostic));
+	if(diagnostics == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		goto clean_analyze;
+	}
+	for(i = 0; i < ec; i++)
+	{
+		line = errortable[i].line;
+		if(i < pre_ec)
+		{
+			strcpy(diagnostics[i].message, errortable[i].error);
+		}
+		else if(line >= 0 && line < expanded.count)
+		{
+			if(expanded.origins[line].macro != NULL && strlen(errortable[i].error) + strlen(expanded.origins[line].macro) + 12 < MAX_SIZE_MASAGE)
+			{
+				strcpy(diagnostics[i].message, errortable[i].error);
+				strcat(diagnostics[i].message, " (in macro ");
+				strcat(diagnostics[i].message, expanded.origins[line].macro);
+				strcat(diagnostics[i].message, ")");
+			}
+			else
+			{
+				strcpy(diagnostics[i].message, errortable[i].error);
+			}
+			line = expanded.origins[line].line - 1;
+		}
+		else
+		{
+			strcpy(diagnostics[i].message, errortable[i].error);
+		}
+		diagnostics[i].line = (line < 0) ? 0 : line;
+	}
+	if((ic + dc) > 156)
+	{
+		diagnostics[ec].line = 0;
+		strcpy(diagnostics[ec].message, ": the memory is over");
+		ec++;
+	}
+
+	free(doc->diagnostics);
+	doc->diagnostics = diagnostics;
+	doc->num_diagnostics = ec;
+	status = 1;
+
+	clean_analyze:
+		if(instable)free(instable);
+		if(labeltable)free(labeltable);
+		if(errortable)free(errortable);
+		if(extable)free(extable);
+		if(datatable)free(datatable);
+		free_macro_definitions(&macrostable);
+		free_expanded_source(&flat);
+		free_expanded_source(&expanded);
+		free_include_cache(&cache);
+		return status;
+}
+
+/**
+ * @brief Tells whether the pre-assembler copies a top-level line unchanged.
+ *
+ * A line is not plain when it is a conditional or `.include` line, or when its
+ * command starts or ends a macro definition or a `.rept` block or calls a
+ * macro of the document.
+ *
+ * @param doc A pointer to the document, for its macro table.
+ * @param line The line.
+ * @return 1 if the line is plain, 0 if not, or EXIT on a memory allocation failure.
+ */
+int lsp_plain_line(struct lsp_document *doc, const char *line)
+{
+	const char *after;
+	char *tokens, *rest, *label_name, *command, *name = NULL;
+	int status, plain;
+
+	if(conditional_keyword(line, &after) != CONDITIONAL_NONE)
+	{
+		return 0;
+	}
+	status = parse_include_line(line, &name);
+	free(name);
+	if(status != 0)
+	{
+		return (status == EXIT) ? EXIT : 0;
+	}
+	tokens = my_strdup(line);
+	if(tokens == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	command = split_label_and_command(line, tokens, &rest, &label_name);
+	plain = (command == NULL || (strcmp(command, MACRO_START_KEYWORD) != 0 && strcmp(command, MACRO_END_KEYWORD) != 0
+		&& strcmp(command, REPT_START_KEYWORD) != 0 && strcmp(command, REPT_END_KEYWORD) != 0
+		&& find_macro_definition(doc->macros, command) == NULL));
+	free(tokens);
+	return plain;
+}
+
+/**
+ * @brief Counts the expanded lines the pre-assembler makes of a plain line.
+ *
+ * As in `pre_assemble_lines`, an empty line, a comment line and a line with
+ * neither a label nor a command are dropped; any other plain line is copied.
+ *
+ * @param line The line.
+ * @return 0 for a dropped line, 1 otherwise, or EXIT on a memory allocation failure.
+ */
+int lsp_line_rows(const char *line)
+{
+	const char *first = line;
+	char *tokens, *rest, *label_name, *command;
+	int rows;
+
+	while(*first != '\0' && isspace((unsigned char)*first))
+	{
+		first++;
+	}
+	if(*first == ';' || *first == '\0')
+	{
+		return 0;
+	}
+	tokens = my_strdup(line);
+	if(tokens == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	command = split_label_and_command(line, tokens, &rest, &label_name);
+	rows = (command != NULL || label_name != NULL);
+	free(tokens);
+	return rows;
+}
+
+/**
+ * @brief Marks the plain lines of a document after an analysis of the whole document.
+ *
+ * The lines are scanned as the pre-assembler does: the lines from `mcro` to
+ * `mcroend`, from `.rept` to `.endr`, and inside a conditional region are not
+ * plain, whatever they hold.
+ *
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_mark_plain_lines(struct lsp_document *doc)
+{
+	const char *after;
+	char *tokens, *rest, *label_name, *command;
+	int i, keyword, plain, in_macro = 0, in_rept = 0, depth = 0;
+
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		keyword = conditional_keyword(doc->lines[i], &after);
+		if(keyword == CONDITIONAL_IFDEF || keyword == CONDITIONAL_IFNDEF)
+		{
+			depth++;
+		}
+		tokens = my_strdup(doc->lines[i]);
+		if(tokens == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			return EXIT;
+		}
+		command = split_label_and_command(doc->lines[i], tokens, &rest, &label_name);
+		if(command != NULL && strcmp(command, MACRO_START_KEYWORD) == 0)
+		{
+			in_macro = 1;
+		}
+		else if(command != NULL && strcmp(command, REPT_START_KEYWORD) == 0)
+		{
+			in_rept = 1;
+		}
+		plain = (keyword == CONDITIONAL_NONE && depth == 0 && !in_macro && !in_rept) ? lsp_plain_line(doc, doc->lines[i]) : 0;
+		if(command != NULL && strcmp(command, MACRO_END_KEYWORD) == 0)
+		{
+			in_macro = 0;
+		}
+		else if(command != NULL && strcmp(command, REPT_END_KEYWORD) == 0)
+		{
+			in_rept = 0;
+		}
+		free(tokens);
+		if(plain == EXIT)
+		{
+			return EXIT;
+		}
+		if(keyword == CONDITIONAL_ENDIF && depth > 0)
+		{
+			depth--;
+		}
+		doc->records[i]->plain = plain;
+	}
+	return 1;
+}
+
+/**
+ * @brief Builds the rows of a document from its expanded source and resolves every name.
+ *
+ * Every expanded line becomes a row of the document line it comes from. The
+ * rows are only kept when the expanded lines follow the document lines in
+ * order and every plain line expands to itself alone (or to nothing, when
+ * `lsp_line_rows` says so), since an edit of a plain line rebuilds its rows
+ * from its text alone.
+ *
+ * @param doc A pointer to the document.
+ * @param expanded A pointer to the expanded source.
+ * @return 1 on success, 0 if the expanded lines do not follow the document lines, or EXIT on a memory error.
+ */
+int lsp_build_rows(struct lsp_document *doc, const ExpandedSource *expanded)
+{
+	struct lsp_scratch scratch;
+	struct lsp_line *record;
+	struct lsp_row *row;
+	int i, line, previous = 0, rows, status = 1;
+
+	for(i = 0; i < expanded->count; i++)
+	{
+		line = expanded->origins[i].line - 1;
+		if(expanded->origins[i].file != NULL || line < previous || line >= doc->num_lines)
+		{
+			return 0;
+		}
+		previous = line;
+		doc->records[line]->num_rows++;
+	}
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		record = doc->records[i];
+		if(record->plain)
+		{
+			rows = lsp_line_rows(doc->lines[i]);
+			if(rows == EXIT)
+			{
+				return EXIT;
+			}
+			if(rows != record->num_rows)
+			{
+				return 0;
+			}
+		}
+		if(record->num_rows > 0)
+		{
+			record->rows = (struct lsp_row *)calloc(record->num_rows, sizeof(struct lsp_row));
+			if(record->rows == NULL)
+			{
+				fprintf(stderr, "Memory allocation failed");
+				return EXIT;
+			}
+			record->num_rows = 0;
+		}
+	}
+	for(i = 0; i < expanded->count; i++)
+	{
+		record = doc->records[expanded->origins[i].line - 1];
+		if(record->plain && strcmp(expanded->lines[i], doc->lines[record->index]) != 0)
+		{
+			return 0;
+		}
+	}
+
+	if(lsp_open_scratch(&scratch) == EXIT)
+	{
+		return EXIT;
+	}
+	for(i = 0; status == 1 && i < expanded->count; i++)
+	{
+		record = doc->records[expanded->origins[i].line - 1];
+		row = &record->rows[record->num_rows];
+		row->line = record;
+		row->slot = record->num_rows++;
+		row->macro = expanded->origins[i].macro;
+		status = lsp_run_row(doc, &scratch, expanded->lines[i], row);
+	}
+	lsp_close_scratch(&scratch);
+	if(status == EXIT)
+	{
+		return EXIT;
+	}
+	return (lsp_resolve(doc) == EXIT) ? EXIT : 1;
+}
+
+/**
+ * @brief Runs one expanded line alone through both passes and stores the results in its row.
+ *
+ * The scratch tables start empty, so the label checks and lookups of the line
+ * see no other label; what the other lines change is worked out from the name
+ * operations the passes record. The undefined-label errors of the lookups
+ * depend on the whole document and are dropped; a lookup keeps the place of
+ * its error among the errors kept.
+ *
+ * @param doc A pointer to the document.
+ * @param scratch A pointer to the tables to run the line through.
+ * @param text The expanded line.
+ * @param row A pointer to the row.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_run_row(struct lsp_document *doc, struct lsp_scratch *scratch, char *text, struct lsp_row *row)
+{
+	struct lsp_name_op *op;
+	struct lsp_name_op **defs;
+	struct lsp_name *name;
+	int ic = 0, dc = 0, ec = 0, lac = 0, exc = 0, first_ec, kept, capacity, e, i, status;
+
+	LSP_TRACE.count = 0;
+	LSP_TRACE.enabled = 1;
+	status = first_pass_lines(&text, 1, &scratch->instable, &scratch->labeltable, &scratch->errortable, &scratch->extable, &scratch->datatable, doc->macros, &ic, &dc, &ec, &lac, &exc, &scratch->isize, &scratch->dsize, &scratch->esize, &scratch->lasize, &scratch->exsize, NULL);
+	first_ec = ec;
+	if(status != EXIT)
+	{
+		status = second_pass_lines(&text, 1, scratch->instable, scratch->labeltable, &scratch->errortable, &scratch->extable, &ec, &lac, &exc, &scratch->esize, &scratch->exsize);
+	}
+	LSP_TRACE.enabled = 0;
+	if(status == EXIT)
+	{
+		return EXIT;
+	}
+
+	row->ic = ic;
+	row->dc = dc;
+	row->live = 1;
+	row->errors = (struct error *)malloc((ec + 1) * sizeof(struct error));
+	row->ops = (struct lsp_name_op *)malloc((LSP_TRACE.count + 1) * sizeof(struct lsp_name_op));
+	if(row->errors == NULL || row->ops == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	for(kept = 0, e = 0, i = 0; i < LSP_TRACE.count; i++)
+	{
+		if(LSP_TRACE.entries[i].kind != LSP_NAME_REFERENCE)
+		{
+			continue;
+		}
+		while(e < LSP_TRACE.entries[i].position)
+		{
+			row->errors[kept++] = scratch->errortable[e++];
+		}
+		LSP_TRACE.entries[i].position = kept;
+		if(find_label(scratch->labeltable, lac, LSP_TRACE.entries[i].name) < 0)
+		{
+			e++;
+		}
+	}
+	while(e < ec)
+	{
+		row->errors[kept++] = scratch->errortable[e++];
+	}
+	row->num_errors = first_ec;
+	row->num_second_errors = kept - first_ec;
+	for(i = 0; i < LSP_TRACE.count; i++)
+	{
+		name = lsp_intern_name(doc, LSP_TRACE.entries[i].name);
+		if(name == NULL)
+		{
+			return EXIT;
+		}
+		op = &row->ops[i];
+		op->kind = LSP_TRACE.entries[i].kind;
+		op->position = LSP_TRACE.entries[i].position;
+		op->result = 0;
+		op->name = name;
+		op->row = row;
+		row->num_ops = i + 1;
+		if(op->kind == LSP_NAME_REFERENCE)
+		{
+			continue;
+		}
+		if(name->num_defs >= name->defs_capacity)
+		{
+			capacity = (name->defs_capacity == 0) ? DOUBLE : name->defs_capacity * DOUBLE;
+			defs = (struct lsp_name_op **)realloc(name->defs, capacity * sizeof(struct lsp_name_op *));
+			if(defs == NULL)
+			{
+				fprintf(stderr, "Memory allocation failed");
+				return EXIT;
+			}
+			name->defs = defs;
+			name->defs_capacity = capacity;
+		}
+		name->defs[name->num_defs++] = op;
+		lsp_queue_name(doc, name);
+	}
+	return 1;
+}
+
+/**
+ * @brief Allocates the tables single lines are run through.
+ *
+ * @param scratch A pointer to the tables.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_open_scratch(struct lsp_scratch *scratch)
+{
+	scratch->instable = allocated_memory_table();
+	scratch->labeltable = allocated_label_table();
+	scratch->errortable = allocated_error_table();
+	scratch->datatable = allocated_dataMemory_table();
+	scratch->extable = allocated_extern_table();
+	scratch->isize = scratch->dsize = scratch->esize = scratch->lasize = scratch->exsize = MAX_SIZE_MEMORY;
+	if(scratch->instable == NULL || scratch->labeltable == NULL || scratch->errortable == NULL || scratch->datatable == NULL || scratch->extable == NULL)
+	{
+		lsp_close_scratch(scratch);
+		return EXIT;
+	}
+	return 1;
+}
+
+/**
+ * @brief Frees the tables single lines are run through.
+ *
+ * @param scratch A pointer to the tables.
+ */
+void lsp_close_scratch(struct lsp_scratch *scratch)
+{
+	if(scratch->instable)free(scratch->instable);
+	if(scratch->labeltable)free(scratch->labeltable);
+	if(scratch->errortable)free(scratch->errortable);
+	if(scratch->datatable)free(scratch->datatable);
+	if(scratch->extable)free(scratch->extable);
+	scratch->instable = NULL;
+	scratch->labeltable = NULL;
+	scratch->errortable = NULL;
+	scratch->datatable = NULL;
+	scratch->extable = NULL;
+}
+
+/**
+ * @brief Records a name operation of the line being analyzed.
+ *
+ * The passes call this wherever a line checks a label definition, defines or
+ * declares a label, or looks one up. Nothing is recorded unless the language
+ * server is running a single line, and a missing name is ignored.
+ *
+ * @param kind The kind of operation.
+ * @param name The name, or NULL.
+ * @param position The number of errors of the line so far.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_note_name(int kind, const char *name, int position)
+{
+	struct lsp_trace_entry *entries;
+	int capacity;
+	if(!LSP_TRACE.enabled || name == NULL)
+	{
+		return 1;
+	}
+	if(LSP_TRACE.count >= LSP_TRACE.capacity)
+	{
+		capacity = (LSP_TRACE.capacity == 0) ? MAX_SIZE_MEMORY : LSP_TRACE.capacity * DOUBLE;
+		entries = (struct lsp_trace_entry *)realloc(LSP_TRACE.entries, capacity * sizeof(struct lsp_trace_entry));
+		if(entries == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			return EXIT;
+		}
+		LSP_TRACE.entries = entries;
+		LSP_TRACE.capacity = capacity;
+	}
+	entries = &LSP_TRACE.entries[LSP_TRACE.count++];
+	entries->kind = kind;
+	entries->position = position;
+	entries->name[0] = '\0';
+	strncat(entries->name, name, MAX_LINE_LENGTH);
+	return 1;
+}
+
+/**
+ * @brief Finds a name in a document's name table, adding it if it is new.
+ *
+ * @param doc A pointer to the document.
+ * @param text The name.
+ * @return A pointer to the entry, or NULL on a memory allocation failure.
+ */
+struct lsp_name *lsp_intern_name(struct lsp_document *doc, const char *text)
+{
+	struct lsp_name *name;
+	unsigned long bucket;
+	if(doc->names == NULL)
+	{
+		doc->names = (struct lsp_name **)calloc(LSP_NAME_BUCKETS, sizeof(struct lsp_name *));
+		if(doc->names == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			return NULL;
+		}
+	}
+	bucket = hash_string(text) & (LSP_NAME_BUCKETS - 1);
+	for(name = doc->names[bucket]; name != NULL; name = name->next)
+	{
+		if(strcmp(name->text, text) == 0)
+		{
+			return name;
+		}
+	}
+	name = (struct lsp_name *)calloc(1, sizeof(struct lsp_name));
+	if(name == NULL || (name->text = my_strdup(text)) == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		free(name);
+		return NULL;
+	}
+	name->next = doc->names[bucket];
+	doc->names[bucket] = name;
+	return name;
+}
+
+/**
+ * @brief Queues a name to be resolved again.
+ *
+ * @param doc A pointer to the document.
+ * @param name A pointer to the name.
+ */
+void lsp_queue_name(struct lsp_document *doc, struct lsp_name *name)
+{
+	if(!name->queued)
+	{
+		name->queued = 1;
+		name->next_queued = doc->queue;
+		doc->queue = name;
+	}
+}
+
+/**
+ * @brief Compares two name operations by their place in the expanded source, for `qsort`.
+ *
+ * @param a A pointer to a pointer to the first operation.
+ * @param b A pointer to a pointer to the second operation.
+ * @return A negative, zero or positive value as the first comes before, with or after the second.
+ */
+int lsp_compare_ops(const void *a, const void *b)
+{
+	const struct lsp_name_op *x = *(const struct lsp_name_op * const *)a;
+	const struct lsp_name_op *y = *(const struct lsp_name_op * const *)b;
+	if(x->row->line->index != y->row->line->index)
+	{
+		return (x->row->line->index < y->row->line->index) ? -1 : 1;
+	}
+	if(x->row->slot != y->row->slot)
+	{
+		return (x->row->slot < y->row->slot) ? -1 : 1;
+	}
+	return (x < y) ? -1 : (x > y);
+}
+
+/**
+ * @brief Replays the first-pass operations on a name in source order.
+ *
+ * The label records of the name are rebuilt as `valid_label`, `add_label` and
+ * `search_entery_and_update` would build them, keeping only whether a record's
+ * index is 0. A label check whose outcome changes turns its row on or off, so
+ * the other names of that row are queued as well. Operations after a failed
+ * check never happened, as in `first_pass`.
+ *
+ * @param doc A pointer to the document.
+ * @param name A pointer to the name.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_resolve_name(struct lsp_document *doc, struct lsp_name *name)
+{
+	struct labelMemory *records;
+	struct lsp_name_op *op;
+	struct lsp_row *row;
+	int count = 0, result, flag, errors, i, j;
+
+	records = (struct labelMemory *)calloc(name->num_defs + 1, sizeof(struct labelMemory));
+	if(records == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	qsort(name->defs, name->num_defs, sizeof(struct lsp_name_op *), lsp_compare_ops);
+	for(i = 0; i < name->num_defs; i++)
+	{
+		op = name->defs[i];
+		row = op->row;
+		if(op->kind == LSP_NAME_CHECK)
+		{
+			/* Only an entry that nothing has defined yet lets the label through. */
+			for(result = 0, j = 0; j < count && result == 0; j++)
+			{
+				if(records[j].en != ENTRY)
+				{
+					result = (records[j].en == EXTERN) ? LSP_CHECK_EXTERNAL : LSP_CHECK_DEFINED;
+				}
+				else if(records[j].type != 0 || records[j].index != 0)
+				{
+					result = LSP_CHECK_DEFINED;
+				}
+			}
+			if((result == 0) != (op->result == 0))
+			{
+				row->live = (result == 0);
+				for(j = 0; j < row->num_ops; j++)
+				{
+					if(row->ops[j].kind != LSP_NAME_REFERENCE && row->ops[j].name != name)
+					{
+						lsp_queue_name(doc, row->ops[j].name);
+					}
+				}
+			}
+			op->result = result;
+		}
+		else if(!row->live)
+		{
+			continue;
+		}
+		else if(op->kind == INSTRUCTION || op->kind == DIRECTIVE)
+		{
+			/* The first entry takes the definition; otherwise a record is added. */
+			for(j = 0; j < count && records[j].en != ENTRY; j++);
+			if(j == count)
+			{
+				count++;
+			}
+			records[j].type = op->kind;
+			records[j].index = (op->kind == INSTRUCTION && row->ic_zero) ? 0 : 1;
+		}
+		else if(op->kind == EXTERN)
+		{
+			records[0].en = EXTERN;
+			count = (count == 0) ? 1 : count;
+		}
+		else if(op->kind == ENTRY)
+		{
+			for(flag = 0, errors = 0, j = 0; j < count; j++)
+			{
+				if(records[j].en != ENTRY && records[j].en != EXTERN)
+				{
+					records[j].en = ENTRY;
+					flag = 1;
+				}
+				else
+				{
+					errors++;
+				}
+			}
+			if(!flag)
+			{
+				records[0].en = ENTRY;
+				count = (count == 0) ? 1 : count;
+			}
+			op->result = errors;
+		}
+	}
+	name->defined = (count > 0);
+	free(records);
+	return 1;
+}
+
+/**
+ * @brief Recomputes the words of a document and which rows have no instruction word before them.
+ *
+ * A row whose answer changes has its instruction labels queued, since a
+ * label at instruction index 0 does not count as a definition for an entry.
+ *
+ * @param doc A pointer to the document.
+ */
+void lsp_layout(struct lsp_document *doc)
+{
+	struct lsp_row *row;
+	int ic = 0, dc = 0, i, j, k;
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		for(j = 0; j < doc->records[i]->num_rows; j++)
+		{
+			row = &doc->records[i]->rows[j];
+			if(row->ic_zero != (ic == 0))
+			{
+				row->ic_zero = (ic == 0);
+				for(k = 0; k < row->num_ops; k++)
+				{
+					if(row->ops[k].kind == INSTRUCTION)
+					{
+						lsp_queue_name(doc, row->ops[k].name);
+					}
+				}
+			}
+			if(row->live)
+			{
+				ic += row->ic;
+				dc += row->dc;
+			}
+		}
+	}
+	doc->ic = ic;
+	doc->dc = dc;
+}
+
+/**
+ * @brief Resolves the queued names until no row changes.
+ *
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_resolve(struct lsp_document *doc)
+{
+	struct lsp_name *name;
+	do
+	{
+		while(doc->queue != NULL)
+		{
+			name = doc->queue;
+			doc->queue = name->next_queued;
+			name->queued = 0;
+			if(lsp_resolve_name(doc, name) == EXIT)
+			{
+				return EXIT;
+			}
+		}
+		lsp_layout(doc);
+	} while(doc->queue != NULL);
+	return 1;
+}
+
+/**
+ * @brief Appends a diagnostic, naming the macro of the line it comes from.
+ *
+ * @param diagnostics The address of the growable array of diagnostics.
+ * @param count A pointer to the number of diagnostics.
+ * @param capacity A pointer to the allocated number of diagnostics.
+ * @param line The 0-based document line.
+ * @param message The error message.
+ * @param macro The macro whose expansion produced the line, or NULL.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_add_diagnostic(struct lsp_diagnostic **diagnostics, int *count, int *capacity, int line, const char *message, const char *macro)
+{
+	struct lsp_diagnostic *grown;
+	if(*count >= *capacity)
+	{
+		grown = (struct lsp_diagnostic *)realloc(*diagnostics, (*capacity) * DOUBLE * sizeof(struct lsp_diagnostic));
+		if(grown == NULL)
+		{
+			fprintf(stderr, "Memory allocation failed");
+			return EXIT;
+		}
+		*diagnostics = grown;
+		*capacity = (*capacity) * DOUBLE;
+	}
+	(*diagnostics)[*count].line = line;
+	strcpy((*diagnostics)[*count].message, message);
+	if(macro != NULL && strlen(message) + strlen(macro) + 12 < MAX_SIZE_MASAGE)
+	{
+		strcat((*diagnostics)[*count].message, " (in macro ");
+		strcat((*diagnostics)[*count].message, macro);
+		strcat((*diagnostics)[*count].message, ")");
+	}
+	(*count)++;
+	return 1;
+}
+
+/**
+ * @brief Builds the diagnostics of a document from its rows.
+ *
+ * The errors come in the order of an analysis of the whole document: the
+ * errors of the first pass line by line, then those of the second pass, then
+ * the memory check. The errors that depend on other lines (a failed label
+ * check, an `.entry` of a name already external or entry, an undefined label)
+ * are put back where the passes raise them.
+ *
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_collect_diagnostics(struct lsp_document *doc)
+{
+	struct lsp_diagnostic *diagnostics;
+	struct lsp_line *record;
+	struct lsp_row *row;
+	const struct lsp_name_op *check;
+	int count = 0, capacity = MAX_SIZE_MEMORY, i, j, e, k, n;
+
+	diagnostics = (struct lsp_diagnostic *)malloc(capacity * sizeof(struct lsp_diagnostic));
+	if(diagnostics == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		record = doc->records[i];
+		for(j = 0; j < record->num_rows; j++)
+		{
+			row = &record->rows[j];
+			check = (row->num_ops > 0 && row->ops[0].kind == LSP_NAME_CHECK) ? &row->ops[0] : NULL;
+			if(check != NULL && check->result != 0)
+			{
+				for(e = 0; e < check->position; e++)
+				{
+					if(lsp_add_diagnostic(&diagnostics, &count, &capacity, i, row->errors[e].error, row->macro) == EXIT){goto clean_collect;}
+				}
+				if(lsp_add_diagnostic(&diagnostics, &count, &capacity, i, (check->result == LSP_CHECK_EXTERNAL) ? ": error! Label name already defined as external" : ": error! Label name already defined", row->macro) == EXIT){goto clean_collect;}
+				continue;
+			}
+			for(e = 0; e <= row->num_errors; e++)
+			{
+				for(k = 0; k < row->num_ops; k++)
+				{
+					for(n = 0; row->ops[k].kind == ENTRY && row->ops[k].position == e && n < row->ops[k].result; n++)
+					{
+						if(lsp_add_diagnostic(&diagnostics, &count, &capacity, i, ": error! invalid enternal label", row->macro) == EXIT){goto clean_collect;}
+					}
+				}
+				if(e < row->num_errors && lsp_add_diagnostic(&diagnostics, &count, &capacity, i, row->errors[e].error, row->macro) == EXIT){goto clean_collect;}
+			}
+		}
+	}
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		record = doc->records[i];
+		for(j = 0; j < record->num_rows; j++)
+		{
+			row = &record->rows[j];
+			for(e = row->num_errors; e <= row->num_errors + row->num_second_errors; e++)
+			{
+				for(k = 0; k < row->num_ops; k++)
+				{
+					if(row->ops[k].kind == LSP_NAME_REFERENCE && row->ops[k].position == e && !row->ops[k].name->defined)
+					{
+						if(lsp_add_diagnostic(&diagnostics, &count, &capacity, i, ": error! Label name is not defined", row->macro) == EXIT){goto clean_collect;}
+					}
+				}
+				if(e < row->num_errors + row->num_second_errors && lsp_add_diagnostic(&diagnostics, &count, &capacity, i, row->errors[e].error, row->macro) == EXIT){goto clean_collect;}
+			}
+		}
+	}
+	if((doc->ic + doc->dc) > 156)
+	{
+		if(lsp_add_diagnostic(&diagnostics, &count, &capacity, 0, ": the memory is over", NULL) == EXIT){goto clean_collect;}
+	}
+	free(doc->diagnostics);
+	doc->diagnostics = diagnostics;
+	doc->num_diagnostics = count;
+	return 1;
+
+	clean_collect:
+		free(diagnostics);
+		return EXIT;
+}
+
+/**
+ * @brief Finds the symbol a line defines.
+ *
+ * A line whose first token ends with a colon defines a label; a line whose
+ * command is `mcro` defines a macro. Positions refer to the document line.
+ *
+ * @param record A pointer to the line record.
+ * @param text The line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_index_line(struct lsp_line *record, const char *text)
+{
+	char *tokens, *rest, *label_name, *command, *name;
+
+	tokens = my_strdup(text);
+	if(tokens == NULL)
+	{
+		fprintf(stderr, "Memory allocation failed");
+		return EXIT;
+	}
+	command = split_label_and_command(text, tokens, &rest, &label_name);
+	name = label_name;
+	if(name == NULL && command != NULL && strcmp(command, MACRO_START_KEYWORD) == 0)
+	{
+		name = get_next_token(&rest);
+	}
+	record->symbol.name[0] = '\0';
+	if(name != NULL && strlen(name) <= MAX_SIZE_LABEL)
+	{
+		strcpy(record->symbol.name, name);
+		record->symbol.character = name - tokens;
+	}
+	free(tokens);
+	return 1;
+}
+
+/**
+ * @brief Sends a `textDocument/publishDiagnostics` notification.
+ *
+ * Each error covers its whole line. The leading ": " of the assembler's error
+ * messages is dropped.
+ *
+ * @param out The output stream.
+ * @param uri The URI of the document.
+ * @param doc The document whose diagnostics are sent, or NULL to clear them.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_publish_diagnostics(FILE *out, const char *uri, struct lsp_document *doc)
+{
+	struct lsp_buffer buf = {NULL, 0, 0};
+	const char *message;
+	int i, n = (doc != NULL) ? doc->num_diagnostics : 0, line;
+
+	if(buffer_append(&buf, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":") == EXIT){goto clean_publish;}
+	if(buffer_append_json_string(&buf, uri) == EXIT){goto clean_publish;}
+	if(buffer_append(&buf, ",\"diagnostics\":[") == EXIT){goto clean_publish;}
+	for(i = 0; i < n; i++)
+	{
+		line = doc->diagnostics[i].line;
+		message = doc->diagnostics[i].message;
+		if(strncmp(message, ": ", 2) == 0)
+		{
+			message += 2;
+		}
+		if(i > 0 && buffer_append(&buf, ",") == EXIT){goto clean_publish;}
+		if(buffer_append(&buf, "{\"range\":{\"start\":{\"line\":") == EXIT){goto clean_publish;}
+		if(buffer_append_int(&buf, line) == EXIT){goto clean_publish;}
+		if(buffer_append(&buf, ",\"character\":0},\"end\":{\"line\":") == EXIT){goto clean_publish;}
+		if(buffer_append_int(&buf, line) == EXIT){goto clean_publish;}
+		if(buffer_append(&buf, ",\"character\":") == EXIT){goto clean_publish;}
+		if(buffer_append_int(&buf, (line < doc->num_lines) ? (int)strlen(doc->lines[line]) : 0) == EXIT){goto clean_publish;}
+		if(buffer_append(&buf, "}},\"severity\":1,\"source\":\"assembler\",\"message\":") == EXIT){goto clean_publish;}
+		if(buffer_append_json_string(&buf, message) == EXIT){goto clean_publish;}
+		if(buffer_append(&buf, "}") == EXIT){goto clean_publish;}
+	}
+	if(buffer_append(&buf, "]}}") == EXIT){goto clean_publish;}
+	lsp_write_message(out, &buf);
+	free(buf.data);
+	return 1;
+
+	clean_publish:
+		free(buf.data);
+		return EXIT;
+}
+
+/**
+ * @brief Answers a `textDocument/definition` request from the symbol index.
+ *
+ * The word under the cursor (letters, digits and underscores) is looked up in
+ * the symbol index. The result is the location of its definition, or null.
+ *
+ * @param out The output stream.
+ * @param id The raw id of the request.
+ * @param doc The document, or NULL if it is not open.
+ * @param line The 0-based line of the cursor.
+ * @param character The 0-based column of the cursor.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_definition(FILE *out, const char *id, struct lsp_document *doc, int line, int character)
+{
+	struct lsp_buffer buf = {NULL, 0, 0};
+	const struct lsp_symbol *symbol;
+	char name[MAX_SIZE_LABEL + 1];
+	const char *text;
+	int begin, end, i, status;
+
+	if(doc == NULL || line < 0 || line >= doc->num_lines || character < 0 || character > (int)strlen(doc->lines[line]))
+	{
+		return lsp_respond(out, id, "null");
+	}
+	text = doc->lines[line];
+	begin = character;
+	end = character;
+	while(begin > 0 && (isalnum((unsigned char)text[begin - 1]) || text[begin - 1] == '_'))
+	{
+		begin--;
+	}
+	while(text[end] != '\0' && (isalnum((unsigned char)text[end]) || text[end] == '_'))
+	{
+		end++;
+	}
+	if(end == begin || end - begin > MAX_SIZE_LABEL)
+	{
+		return lsp_respond(out, id, "null");
+	}
+	memcpy(name, text + begin, end - begin);
+	name[end - begin] = '\0';
+
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		if(strcmp(doc->records[i]->symbol.name, name) == 0)
+		{
+			break;
+		}
+	}
+	if(i == doc->num_lines)
+	{
+		return lsp_respond(out, id, "null");
+	}
+	symbol = &doc->records[i]->symbol;
+	if(buffer_append(&buf, "{\"uri\":") == EXIT){goto clean_definition;}
+	if(buffer_append_json_string(&buf, doc->uri) == EXIT){goto clean_definition;}
+	if(buffer_append(&buf, ",\"range\":{\"start\":{\"line\":") == EXIT){goto clean_definition;}
+	if(buffer_append_int(&buf, i) == EXIT){goto clean_definition;}
+	if(buffer_append(&buf, ",\"character\":") == EXIT){goto clean_definition;}
+	if(buffer_append_int(&buf, symbol->character) == EXIT){goto clean_definition;}
+	if(buffer_append(&buf, "},\"end\":{\"line\":") == EXIT){goto clean_definition;}
+	if(buffer_append_int(&buf, i) == EXIT){goto clean_definition;}
+	if(buffer_append(&buf, ",\"character\":") == EXIT){goto clean_definition;}
+	if(buffer_append_int(&buf, symbol->character + (int)strlen(name)) == EXIT){goto clean_definition;}
+	if(buffer_append(&buf, "}}}") == EXIT){goto clean_definition;}
+	status = lsp_respond(out, id, buf.data);
+	free(buf.data);
+	return status;
+
+	clean_definition:
+		free(buf.data);
+		return EXIT;
+}
+
+/**
+ * @brief Sends a response with a literal JSON result.
+ *
+ * @param out The output stream.
+ * @param id The raw id of the request (a JSON null is sent if it is missing).
+ * @param result The JSON text of the result.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_respond(FILE *out, const char *id, const char *result)
+{
+	struct lsp_buffer buf = {NULL, 0, 0};
+	if(buffer_append(&buf, "{\"jsonrpc\":\"2.0\",\"id\":") == EXIT
+		|| buffer_append(&buf, (id != NULL) ? id : "null") == EXIT
+		|| buffer_append(&buf, ",\"result\":") == EXIT
+		|| buffer_append(&buf, result) == EXIT
+		|| buffer_append(&buf, "}") == EXIT)
+	{
+		free(buf.data);
+		return EXIT;
+	}
+	lsp_write_message(out, &buf);
+	free(buf.data);
+	return 1;
+}
+
+/**
+ * @brief Sends an error response.
+ *
+ * @param out The output stream.
+ * @param id The raw id of the request.
+ * @param code The JSON-RPC error code.
+ * @param message The error message.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_respond_error(FILE *out, const char *id, int code, const char *message)
+{
+	struct lsp_buffer buf = {NULL, 0, 0};
+	if(buffer_append(&buf, "{\"jsonrpc\":\"2.0\",\"id\":") == EXIT
+		|| buffer_append(&buf, id) == EXIT
+		|| buffer_append(&buf, ",\"error\":{\"code\":") == EXIT
+		|| buffer_append_int(&buf, code) == EXIT
+		|| buffer_append(&buf, ",\"message\":") == EXIT
+		|| buffer_append_json_string(&buf, message) == EXIT
+		|| buffer_append(&buf, "}}") == EXIT)
+	{
+		free(buf.data);
+		return EXIT;
+	}
+	lsp_write_message(out, &buf);
+	free(buf.data);
+	return 1;
+}
+
+/**
+ * @brief Closes a document and frees its state.
+ *
+ * @param docs A pointer to the list of open documents.
+ * @param uri The URI of the document.
+ */
+void lsp_close_document(struct lsp_document **docs, const char *uri)
+{
+	struct lsp_document **link = docs, *doc;
+	while(*link != NULL)
+	{
+		if(strcmp((*link)->uri, uri) == 0)
+		{
+			doc = *link;
+			*link = doc->next;
+			lsp_free_document(doc);
+			return;
+		}
+		link = &(*link)->next;
+	}
+}
+
+/**
+ * @brief Frees the state of a single document.
+ *
+ * @param doc A pointer to the document.
+ */
+/**
+ * @brief Frees the rows of a line and takes its operations out of the name table.
+ *
+ * The names the rows defined or declared are queued, since their remaining
+ * operations may now resolve differently.
+ *
+ * @param doc A pointer to the document.
+ * @param record A pointer to the line record.
+ */
+void lsp_free_rows(struct lsp_document *doc, struct lsp_line *record)
+{
+	struct lsp_name_op *op;
+	struct lsp_name *name;
+	int i, j, k;
+	for(i = 0; record->rows != NULL && i < record->num_rows; i++)
+	{
+		for(j = 0; doc->names != NULL && j < record->rows[i].num_ops; j++)
+		{
+			op = &record->rows[i].ops[j];
+			name = op->name;
+			for(k = 0; op->kind != LSP_NAME_REFERENCE && k < name->num_defs; k++)
+			{
+				if(name->defs[k] == op)
+				{
+					name->defs[k] = name->defs[--name->num_defs];
+					lsp_queue_name(doc, name);
+					break;
+				}
+			}
+		}
+		free(record->rows[i].ops);
+		free(record->rows[i].errors);
+	}
+	free(record->rows);
+	record->rows = NULL;
+	record->num_rows = 0;
+}
+
+/**
+ * @brief Drops the rows, names and macro table of a document's last analysis.
+ *
+ * @param doc A pointer to the document.
+ */
+void lsp_clear_analysis(struct lsp_document *doc)
+{
+	struct lsp_name *name, *next;
+	int i;
+	for(i = 0; doc->names != NULL && i < LSP_NAME_BUCKETS; i++)
+	{
+		for(name = doc->names[i]; name != NULL; name = next)
+		{
+			next = name->next;
+			free(name->text);
+			free(name->defs);
+			free(name);
+		}
+	}
+	free(doc->names);
+	doc->names = NULL;
+	doc->queue = NULL;
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		lsp_free_rows(doc, doc->records[i]);
+	}
+	free_macro_definitions(&doc->macros);
+	doc->incremental = 0;
+}
+
+void lsp_free_document(struct lsp_document *doc)
+{
+	int i;
+	lsp_clear_analysis(doc);
+	for(i = 0; i < doc->num_lines; i++)
+	{
+		free(doc->records[i]);
+	}
+	free(doc->records);
+	free(doc->uri);
+	free_lines(doc->lines, doc->num_lines);
+	free(doc->line_hash);
+	free(doc->diagnostics);
+	free(doc);
+}
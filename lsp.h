@@ -0,0 +1,708 @@
+#ifndef LSP_H
+#define LSP_H
+
+/**
+ * @file lsp.h
+ * @brief This header file declares the language-server mode of the assembler.
+ *
+ * In this mode the assembler speaks the Language Server Protocol over stdin and
+ * stdout, so an editor can use it as a linter without spawning a process or
+ * writing `.am`/`.ob` files on every keystroke. Each open document keeps its
+ * lines, diagnostics and symbol index in memory. Diagnostics come from running
+ * the pre-assembler and both passes on the lines in memory, and go-to-definition
+ * is answered from the symbol index.
+ *
+ * Edits are applied line by line. After an analysis of the whole document, a
+ * document keeps its macro table and, for every line, the results of both
+ * passes on the lines it expands to: the words, the errors that depend on the
+ * line alone, and the names the line checks, defines, declares and refers to.
+ * The names point into a per-document name table that holds, for every name,
+ * the lines that define or declare it. An edit that only replaces plain lines
+ * (no macro definition, macro call, `.rept`, conditional or `.include` line)
+ * runs the new lines alone through both passes and then resolves again only
+ * the names those lines, and the lines they enable or disable, define or use:
+ * the order of definitions of such a name decides its errors, and whether it
+ * is defined at all decides the errors of its references. Any other edit, a
+ * document with `.include` lines, and a document with pre-assembler errors
+ * are analyzed as a whole.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "data.h"
+#include "pre_assembler.h"
+#include "include.h"
+#include "assembler.h"
+
+/**
+ * @def LSP_CONTENT_LENGTH
+ * @brief The header that gives the size of a protocol message body.
+ */
+#define LSP_CONTENT_LENGTH "Content-Length:"
+
+/**
+ * @def LSP_FILE_SCHEME
+ * @brief The prefix of a document URI that names a local file.
+ */
+#define LSP_FILE_SCHEME "file://"
+
+/**
+ * @def LSP_MAX_HEADER_LINE
+ * @brief The maximum length of a single protocol header line.
+ */
+#define LSP_MAX_HEADER_LINE 256
+
+/**
+ * @def LSP_MAX_NUMBER
+ * @brief The size of a buffer large enough to hold a printed integer.
+ */
+#define LSP_MAX_NUMBER 32
+
+/**
+ * @def LSP_NAME_CHECK
+ * @brief A name operation: a label definition is checked against the labels before it.
+ *
+ * The other name operations are the label types `INSTRUCTION`, `DIRECTIVE`,
+ * `EXTERN` and `ENTRY` of code.h, and `LSP_NAME_REFERENCE`.
+ */
+#define LSP_NAME_CHECK 10
+
+/**
+ * @def LSP_NAME_REFERENCE
+ * @brief A name operation: an operand of the second pass refers to a label.
+ */
+#define LSP_NAME_REFERENCE 11
+
+/**
+ * @def LSP_CHECK_DEFINED
+ * @brief The result of a failed `LSP_NAME_CHECK`: the label is already defined.
+ */
+#define LSP_CHECK_DEFINED 1
+
+/**
+ * @def LSP_CHECK_EXTERNAL
+ * @brief The result of a failed `LSP_NAME_CHECK`: the label is already declared external.
+ */
+#define LSP_CHECK_EXTERNAL 2
+
+/**
+ * @def LSP_NAME_BUCKETS
+ * @brief The number of hash buckets of a document's name table (a power of two).
+ */
+#define LSP_NAME_BUCKETS 1024
+
+/**
+ * @def LSP_METHOD_NOT_FOUND
+ * @brief The JSON-RPC error code for an unsupported request.
+ */
+#define LSP_METHOD_NOT_FOUND -32601
+
+/**
+ * @struct lsp_buffer
+ * @brief A growable text buffer used to build outgoing messages.
+ *
+ * - `data`: The null-terminated text.
+ * - `len`: The length of the text.
+ * - `cap`: The allocated size of `data`.
+ */
+struct lsp_buffer
+{
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+/**
+ * @struct lsp_diagnostic
+ * @brief A single error to publish, positioned on a line of the document.
+ *
+ * - `line`: The 0-based line number in the document.
+ * - `message`: The error message.
+ */
+struct lsp_diagnostic
+{
+	int line;
+	char message[MAX_SIZE_MASAGE];
+};
+
+/**
+ * @struct lsp_symbol
+ * @brief The symbol a line defines (a label or a macro definition), for the symbol index.
+ *
+ * - `name`: The name of the symbol, or an empty string if the line defines none.
+ * - `character`: The 0-based column where the name starts.
+ */
+struct lsp_symbol
+{
+	char name[MAX_SIZE_LABEL + 1];
+	int character;
+};
+
+/**
+ * @struct lsp_trace_entry
+ * @brief A name operation recorded while a single line goes through the passes.
+ *
+ * - `kind`: `LSP_NAME_CHECK`, `LSP_NAME_REFERENCE`, or the label type of a
+ *   definition or declaration (`INSTRUCTION`, `DIRECTIVE`, `EXTERN`, `ENTRY`).
+ * - `position`: The number of errors the line had before the operation.
+ * - `name`: The name.
+ */
+struct lsp_trace_entry
+{
+	int kind;
+	int position;
+	char name[MAX_LINE_LENGTH + 1];
+};
+
+/**
+ * @struct lsp_trace
+ * @brief The name operations of the line being analyzed, filled by `lsp_note_name`.
+ *
+ * - `enabled`: Whether operations are recorded (only while the server runs a single line).
+ * - `entries`: The operations, in the order the passes performed them.
+ * - `count`: The number of operations.
+ * - `capacity`: The allocated number of entries.
+ */
+struct lsp_trace
+{
+	int enabled;
+	struct lsp_trace_entry *entries;
+	int count;
+	int capacity;
+};
+
+extern struct lsp_trace LSP_TRACE;
+
+struct lsp_row;
+
+/**
+ * @struct lsp_name
+ * @brief An entry of a document's name table.
+ *
+ * - `text`: The name.
+ * - `defs`: The operations of the first pass on the name, in no particular order.
+ * - `num_defs`: The number of operations.
+ * - `defs_capacity`: The allocated size of `defs`.
+ * - `defined`: Whether the label table of a whole analysis would hold the name.
+ * - `queued`: Whether the name waits in the queue of names to resolve.
+ * - `next`: The next name in the same hash bucket.
+ * - `next_queued`: The next name in the queue.
+ */
+struct lsp_name
+{
+	char *text;
+	struct lsp_name_op **defs;
+	int num_defs;
+	int defs_capacity;
+	int defined;
+	int queued;
+	struct lsp_name *next;
+	struct lsp_name *next_queued;
+};
+
+/**
+ * @struct lsp_name_op
+ * @brief A name operation of an expanded line, as kept between edits.
+ *
+ * - `kind`: As in `struct lsp_trace_entry`.
+ * - `position`: The number of errors the line had before the operation.
+ * - `result`: For `LSP_NAME_CHECK`, 0 or the `LSP_CHECK_*` failure; for
+ *   `ENTRY`, the number of errors the declaration raises.
+ * - `name`: The entry of the name in the name table.
+ * - `row`: The expanded line.
+ */
+struct lsp_name_op
+{
+	int kind;
+	int position;
+	int result;
+	struct lsp_name *name;
+	struct lsp_row *row;
+};
+
+struct lsp_line;
+
+/**
+ * @struct lsp_row
+ * @brief The results of both passes on one expanded line, run alone.
+ *
+ * - `line`: The document line the expanded line comes from.
+ * - `slot`: The place of the expanded line among those of its document line.
+ * - `ic`: The instruction words the line allocates.
+ * - `dc`: The data words the line allocates.
+ * - `live`: Whether the label check of the line passes, so its words and
+ *   operations after the check count.
+ * - `ic_zero`: Whether no instruction word comes before the line.
+ * - `macro`: The macro whose expansion produced the line, or NULL.
+ * - `errors`: The errors of both passes that depend on the line alone, those
+ *   of the first pass first.
+ * - `num_errors`: The number of errors of the first pass.
+ * - `num_second_errors`: The number of errors of the second pass.
+ * - `ops`: The name operations of the line, in order.
+ * - `num_ops`: The number of operations.
+ */
+struct lsp_row
+{
+	struct lsp_line *line;
+	int slot;
+	int ic;
+	int dc;
+	int live;
+	int ic_zero;
+	const char *macro;
+	struct error *errors;
+	int num_errors;
+	int num_second_errors;
+	struct lsp_name_op *ops;
+	int num_ops;
+};
+
+/**
+ * @struct lsp_line
+ * @brief The state kept for a document line.
+ *
+ * - `index`: The 0-based line number, updated when lines are inserted or removed above.
+ * - `plain`: Whether the line is outside any macro definition, `.rept` block
+ *   and conditional region and is none of those lines nor a macro call, so
+ *   the pre-assembler copies it unchanged.
+ * - `symbol`: The symbol the line defines.
+ * - `rows`: The expanded lines the line produced.
+ * - `num_rows`: The number of expanded lines.
+ */
+struct lsp_line
+{
+	int index;
+	int plain;
+	struct lsp_symbol symbol;
+	struct lsp_row *rows;
+	int num_rows;
+};
+
+/**
+ * @struct lsp_edit
+ * @brief The lines an edit replaced.
+ *
+ * - `first`: The first replaced line.
+ * - `removed`: The number of lines removed from `first` on.
+ * - `added`: The number of lines put in their place.
+ */
+struct lsp_edit
+{
+	int first;
+	int removed;
+	int added;
+};
+
+/**
+ * @struct lsp_scratch
+ * @brief The tables a single expanded line is run through, reused for every line.
+ */
+struct lsp_scratch
+{
+	struct instructionsMemory *instable;
+	struct labelMemory *labeltable;
+	struct error *errortable;
+	struct dataMemory *datatable;
+	struct external *extable;
+	int isize;
+	int dsize;
+	int esize;
+	int lasize;
+	int exsize;
+};
+
+/**
+ * @struct lsp_document
+ * @brief The in-memory state of an open document.
+ *
+ * - `uri`: The URI the editor uses for the document.
+ * - `lines`: The lines of the document.
+ * - `line_hash`: A hash of every line, used to detect edits that change nothing.
+ * - `num_lines`: The number of lines.
+ * - `trailing_newline`: Whether the text ends with a newline.
+ * - `records`: The state of every line.
+ * - `names`: The name table (`LSP_NAME_BUCKETS` buckets), or NULL.
+ * - `queue`: The names whose operations changed since they were last resolved.
+ * - `macros`: The macro table of the last analysis.
+ * - `incremental`: Whether the rows and names are up to date, so an edit of
+ *   plain lines can be analyzed alone.
+ * - `ic`: The instruction words of the document.
+ * - `dc`: The data words of the document.
+ * - `diagnostics`: The errors found by the last analysis.
+ * - `num_diagnostics`: The number of errors.
+ * - `next`: The next open document.
+ */
+struct lsp_document
+{
+	char *uri;
+	char **lines;
+	unsigned long *line_hash;
+	int num_lines;
+	int trailing_newline;
+	struct lsp_line **records;
+	struct lsp_name **names;
+	struct lsp_name *queue;
+	MacroDefinition *macros;
+	int incremental;
+	int ic;
+	int dc;
+	struct lsp_diagnostic *diagnostics;
+	int num_diagnostics;
+	struct lsp_document *next;
+};
+
+/**
+ * @brief Runs the language server until the client sends `exit` or closes the input.
+ * @param in The stream the client writes requests to.
+ * @param out The stream the server writes responses and notifications to.
+ * @return 1 on a clean exit, or EXIT on a critical memory error.
+ */
+int lsp_run(FILE *in, FILE *out);
+
+/**
+ * @brief Reads one protocol message (headers and body) from a stream.
+ * @param in The input stream.
+ * @return The dynamically allocated body, or NULL at the end of the input.
+ */
+char *lsp_read_message(FILE *in);
+
+/**
+ * @brief Writes one protocol message with its `Content-Length` header.
+ * @param out The output stream.
+ * @param body The message body.
+ */
+void lsp_write_message(FILE *out, struct lsp_buffer *body);
+
+/**
+ * @brief Finds the value of a key anywhere in a JSON text, skipping string contents.
+ * @param json The JSON text.
+ * @param key The key to look for.
+ * @return A pointer to the first character of the value, or NULL if the key is absent.
+ */
+const char *json_find_key(const char *json, const char *key);
+
+/**
+ * @brief Decodes a JSON string value.
+ * @param value A pointer to the opening quote of the string.
+ * @return The dynamically allocated, unescaped string, or NULL if the value is not a string.
+ */
+char *json_string_value(const char *value);
+
+/**
+ * @brief Copies a JSON number or string token as it appears in the text.
+ * @param value A pointer to the first character of the value.
+ * @return The dynamically allocated token, or NULL on a memory allocation failure.
+ */
+char *json_raw_value(const char *value);
+
+/**
+ * @brief Skips a JSON value of any type.
+ * @param value A pointer to the first character of the value.
+ * @return A pointer to the first character after the value.
+ */
+const char *json_skip_value(const char *value);
+
+/**
+ * @brief Reads the integer value of a key.
+ * @param json The JSON text.
+ * @param key The key to look for.
+ * @return The value, or 0 if the key is absent.
+ */
+int json_int_value(const char *json, const char *key);
+
+/**
+ * @brief Appends text to a buffer.
+ * @param buf A pointer to the buffer.
+ * @param text The text to append.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int buffer_append(struct lsp_buffer *buf, const char *text);
+
+/**
+ * @brief Appends an integer to a buffer.
+ * @param buf A pointer to the buffer.
+ * @param num The integer to append.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int buffer_append_int(struct lsp_buffer *buf, int num);
+
+/**
+ * @brief Appends text to a buffer as a quoted JSON string.
+ * @param buf A pointer to the buffer.
+ * @param text The text to quote and escape.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int buffer_append_json_string(struct lsp_buffer *buf, const char *text);
+
+/**
+ * @brief Finds an open document by its URI.
+ * @param docs The list of open documents.
+ * @param uri The URI to look for.
+ * @return A pointer to the document, or NULL if it is not open.
+ */
+struct lsp_document *lsp_find_document(struct lsp_document *docs, const char *uri);
+
+/**
+ * @brief Opens a document or replaces its text.
+ * @param docs A pointer to the list of open documents.
+ * @param uri The URI of the document.
+ * @param text The full text of the document.
+ * @param updated Receives a pointer to the document.
+ * @param edit Receives the lines that changed.
+ * @return 1 if the lines changed, 0 if the text is unchanged, or EXIT on a memory error.
+ */
+int lsp_update_document(struct lsp_document **docs, const char *uri, const char *text, struct lsp_document **updated, struct lsp_edit *edit);
+
+/**
+ * @brief Replaces the whole text of a document.
+ * @param doc A pointer to the document.
+ * @param text The new text.
+ * @param edit Receives the lines that changed.
+ * @return 1 if the lines changed, 0 if they are unchanged, or EXIT on a memory error.
+ */
+int lsp_replace_text(struct lsp_document *doc, const char *text, struct lsp_edit *edit);
+
+/**
+ * @brief Replaces a range of a document's text.
+ * @param doc A pointer to the document.
+ * @param start_line The 0-based line where the range starts.
+ * @param start_character The 0-based column where the range starts.
+ * @param end_line The 0-based line where the range ends.
+ * @param end_character The 0-based column where the range ends.
+ * @param text The text put in place of the range.
+ * @param edit Receives the lines that changed.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_edit_document(struct lsp_document *doc, int start_line, int start_character, int end_line, int end_character, const char *text, struct lsp_edit *edit);
+
+/**
+ * @brief Applies the content changes of a `textDocument/didChange` notification.
+ * @param doc A pointer to the document.
+ * @param changes A pointer to the `contentChanges` array.
+ * @return 1 if the lines changed, 0 if they are unchanged, or EXIT on a memory error.
+ */
+int lsp_apply_changes(struct lsp_document *doc, const char *changes);
+
+/**
+ * @brief Brings the line records of a document in line with an edit of its lines.
+ * @param doc A pointer to the document.
+ * @param edit The lines that changed.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_apply_edit(struct lsp_document *doc, const struct lsp_edit *edit);
+
+/**
+ * @brief Analyzes a document after edits, again as a whole or only where it changed.
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int lsp_refresh_document(struct lsp_document *doc);
+
+/**
+ * @brief Runs the assembler checks on a document in memory and stores the results.
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a critical memory error.
+ */
+int lsp_analyze_document(struct lsp_document *doc);
+
+/**
+ * @brief Tells whether the pre-assembler copies a top-level line unchanged.
+ * @param doc A pointer to the document, for its macro table.
+ * @param line The line.
+ * @return 1 if the line is plain, 0 if not, or EXIT on a memory allocation failure.
+ */
+int lsp_plain_line(struct lsp_document *doc, const char *line);
+
+/**
+ * @brief Counts the expanded lines the pre-assembler makes of a plain line.
+ * @param line The line.
+ * @return 0 for an empty or comment line, 1 otherwise, or EXIT on a memory allocation failure.
+ */
+int lsp_line_rows(const char *line);
+
+/**
+ * @brief Marks the plain lines of a document after an analysis of the whole document.
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_mark_plain_lines(struct lsp_document *doc);
+
+/**
+ * @brief Builds the rows of a document from its expanded source and resolves every name.
+ * @param doc A pointer to the document.
+ * @param expanded A pointer to the expanded source.
+ * @return 1 on success, 0 if the expanded lines do not follow the document lines, or EXIT on a memory error.
+ */
+int lsp_build_rows(struct lsp_document *doc, const ExpandedSource *expanded);
+
+/**
+ * @brief Runs one expanded line alone through both passes and stores the results in its row.
+ * @param doc A pointer to the document.
+ * @param scratch A pointer to the tables to run the line through.
+ * @param text The expanded line.
+ * @param row A pointer to the row.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_run_row(struct lsp_document *doc, struct lsp_scratch *scratch, char *text, struct lsp_row *row);
+
+/**
+ * @brief Allocates the tables single lines are run through.
+ * @param scratch A pointer to the tables.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_open_scratch(struct lsp_scratch *scratch);
+
+/**
+ * @brief Frees the tables single lines are run through.
+ * @param scratch A pointer to the tables.
+ */
+void lsp_close_scratch(struct lsp_scratch *scratch);
+
+/**
+ * @brief Records a name operation of the line being analyzed.
+ * @param kind The kind of operation.
+ * @param name The name, or NULL.
+ * @param position The number of errors of the line so far.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_note_name(int kind, const char *name, int position);
+
+/**
+ * @brief Finds a name in a document's name table, adding it if it is new.
+ * @param doc A pointer to the document.
+ * @param text The name.
+ * @return A pointer to the entry, or NULL on a memory allocation failure.
+ */
+struct lsp_name *lsp_intern_name(struct lsp_document *doc, const char *text);
+
+/**
+ * @brief Queues a name to be resolved again.
+ * @param doc A pointer to the document.
+ * @param name A pointer to the name.
+ */
+void lsp_queue_name(struct lsp_document *doc, struct lsp_name *name);
+
+/**
+ * @brief Compares two name operations by their place in the expanded source, for `qsort`.
+ * @param a A pointer to a pointer to the first operation.
+ * @param b A pointer to a pointer to the second operation.
+ * @return A negative, zero or positive value as the first comes before, with or after the second.
+ */
+int lsp_compare_ops(const void *a, const void *b);
+
+/**
+ * @brief Replays the first-pass operations on a name in source order.
+ * @param doc A pointer to the document.
+ * @param name A pointer to the name.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_resolve_name(struct lsp_document *doc, struct lsp_name *name);
+
+/**
+ * @brief Recomputes the words of a document and which rows have no instruction word before them.
+ * @param doc A pointer to the document.
+ */
+void lsp_layout(struct lsp_document *doc);
+
+/**
+ * @brief Resolves the queued names until no row changes.
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_resolve(struct lsp_document *doc);
+
+/**
+ * @brief Appends a diagnostic, naming the macro of the line it comes from.
+ * @param diagnostics The address of the growable array of diagnostics.
+ * @param count A pointer to the number of diagnostics.
+ * @param capacity A pointer to the allocated number of diagnostics.
+ * @param line The 0-based document line.
+ * @param message The error message.
+ * @param macro The macro whose expansion produced the line, or NULL.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_add_diagnostic(struct lsp_diagnostic **diagnostics, int *count, int *capacity, int line, const char *message, const char *macro);
+
+/**
+ * @brief Builds the diagnostics of a document from its rows.
+ * @param doc A pointer to the document.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_collect_diagnostics(struct lsp_document *doc);
+
+/**
+ * @brief Finds the symbol a line defines.
+ * @param record A pointer to the line record.
+ * @param text The line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_index_line(struct lsp_line *record, const char *text);
+
+/**
+ * @brief Sends a `textDocument/publishDiagnostics` notification.
+ * @param out The output stream.
+ * @param uri The URI of the document.
+ * @param doc The document whose diagnostics are sent, or NULL to clear them.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_publish_diagnostics(FILE *out, const char *uri, struct lsp_document *doc);
+
+/**
+ * @brief Answers a `textDocument/definition` request from the symbol index.
+ * @param out The output stream.
+ * @param id The raw id of the request.
+ * @param doc The document, or NULL if it is not open.
+ * @param line The 0-based line of the cursor.
+ * @param character The 0-based column of the cursor.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_definition(FILE *out, const char *id, struct lsp_document *doc, int line, int character);
+
+/**
+ * @brief Sends a response with a literal JSON result.
+ * @param out The output stream.
+ * @param id The raw id of the request.
+ * @param result The JSON text of the result.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_respond(FILE *out, const char *id, const char *result);
+
+/**
+ * @brief Sends an error response.
+ * @param out The output stream.
+ * @param id The raw id of the request.
+ * @param code The JSON-RPC error code.
+ * @param message The error message.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int lsp_respond_error(FILE *out, const char *id, int code, const char *message);
+
+/**
+ * @brief Closes a document and frees its state.
+ * @param docs A pointer to the list of open documents.
+ * @param uri The URI of the document.
+ */
+void lsp_close_document(struct lsp_document **docs, const char *uri);
+
+/**
+ * @brief Frees the rows of a line and takes its operations out of the name table.
+ * @param doc A pointer to the document.
+ * @param record A pointer to the line record.
+ */
+void lsp_free_rows(struct lsp_document *doc, struct lsp_line *record);
+
+/**
+ * @brief Drops the rows, names and macro table of a document's last analysis.
+ * @param doc A pointer to the document.
+ */
+void lsp_clear_analysis(struct lsp_document *doc);
+
+/**
+ * @brief Frees the state of a single document.
+ * @param doc A pointer to the document.
+ */
+void lsp_free_document(struct lsp_document *doc);
+
+#endif /* LSP_H */
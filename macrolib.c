@@ -0,0 +1,458 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "macrolib.h"
+
+/**
+ * @brief Reads a little-endian 32-bit number.
+ *
+ * The bytes are combined one by one, so the number may sit at any address and
+ * the file reads the same on every host.
+ *
+ * @param bytes The four bytes of the number.
+ * @return The number.
+ */
+unsigned long read_word(const unsigned char *bytes)
+{
+	return (unsigned long)bytes[0] | ((unsigned long)bytes[1] << 8) | ((unsigned long)bytes[2] << 16) | ((unsigned long)bytes[3] << 24);
+}
+
+/**
+ * @brief Writes a little-endian 32-bit number.
+ *
+ * @param bytes The four bytes that receive the number.
+ * @param value The number.
+ */
+void write_word(unsigned char *bytes, unsigned long value)
+{
+	bytes[0] = (unsigned char)(value & 0xFF);
+	bytes[1] = (unsigned char)((value >> 8) & 0xFF);
+	bytes[2] = (unsigned char)((value >> 16) & 0xFF);
+	bytes[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+/**
+ * @brief Collects the macros of a library source and writes them as a precompiled library.
+ *
+ * The source goes through the same include and macro handling as an assembled
+ * file, so the library gets the same checks. Lines outside macro definitions
+ * are ignored. Every macro is stored with the macros it invokes already
+ * expanded, so a library macro is emitted as is wherever it is used. If the
+ * source has errors they are printed and no file is written.
+ *
+ * @param source The name of the library source file.
+ * @param output The name of the `.amh` file to write, or NULL to replace the source's suffix with `.amh`.
+ * @return 1 on success, 0 if the source has errors, or EXIT on a critical failure.
+ */
+int precompile_macros(const char *source, const char *output)
+{
+	struct error *errortable = allocated_error_table();
+	struct included_file *cache = NULL;
+	MacroDefinition *macros = NULL, *macro;
+	LineOrigin origin = {1, NULL, 0, NULL};
+	ExpandedSource flat = {NULL, NULL, 0, 0};
+	ExpandedSource expanded = {NULL, NULL, 0, 0};
+	const char *stack[MAX_INCLUDE_DEPTH];
+	unsigned char *image = NULL;
+	char **lines = NULL;
+	char *output_name = NULL, *dot;
+	size_t size;
+	FILE *fileptr;
+	int num_lines = 0, ec = 0, esize = MAX_SIZE_MEMORY, status = EXIT;
+
+	if(errortable == NULL){goto clean_precompile;}
+	lines = read_raw_lines(source, &num_lines);
+	if(lines == NULL)
+	{
+		fprintf(stdout, "error opening file!\n");
+		goto clean_precompile;
+	}
+	stack[0] = source;
+	if(flatten_includes(source, lines, num_lines, NULL, stack, 1, &cache, NULL, &flat, &errortable, &ec, &esize) == EXIT){goto clean_precompile;}
+	if(ec == 0)
+	{
+		if(pre_assemble_lines(flat.lines, flat.count, flat.origins, NULL, &expanded, &errortable, &ec, &esize, &macros) == EXIT){goto clean_precompile;}
+	}
+	for(macro = macros; ec == 0 && macro != NULL; macro = macro->next)
+	{
+		if(flatten_macro(macro, macros, NULL, 0, &origin, &errortable, &ec, &esize) == EXIT){goto clean_precompile;}
+	}
+	if(ec > 0)
+	{
+		print_error(errortable, ec);
+		status = 0;
+		goto clean_precompile;
+	}
+
+	if(output == NULL)
+	{
+		output_name = (char *)malloc(strlen(source) + strlen(END_MACRO_LIBRARY_FILE_NAME) + 1);
+		if(output_name == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			goto clean_precompile;
+		}
+		strcpy(output_name, source);
+		dot = strrchr(output_name, '.');
+		if(dot != NULL && strcmp(dot, END_SOURCE_FILE_NAME) == 0)
+		{
+			*dot = '\0';
+		}
+		strcat(output_name, END_MACRO_LIBRARY_FILE_NAME);
+		output = output_name;
+	}
+
+	image = build_macro_library(macros, &size);
+	if(image == NULL){goto clean_precompile;}
+	fileptr = fopen(output, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean_precompile;
+	}
+	if(fwrite(image, 1, size, fileptr) != size)
+	{
+		fprintf(stdout,"error writing file!\n");
+		fclose(fileptr);
+		goto clean_precompile;
+	}
+	fclose(fileptr);
+	status = 1;
+
+	clean_precompile:
+		free(image);
+		free(output_name);
+		if(lines)free_lines(lines, num_lines);
+		free_expanded_source(&flat);
+		free_expanded_source(&expanded);
+		free_macro_definitions(&macros);
+		free_include_cache(&cache);
+		if(errortable)free(errortable);
+		return status;
+}
+
+/**
+ * @brief Serializes a macro list into the precompiled library format.
+ *
+ * The number of buckets is the smallest power of two that is at least twice
+ * the number of macros. Macros are stored grouped by bucket, so a lookup only
+ * compares the names of one bucket. Every macro must have been flattened; its
+ * flattened body is what is stored.
+ *
+ * @param macros The head of the macro list.
+ * @param size Receives the size of the image.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned char *build_macro_library(MacroDefinition *macros, size_t *size)
+{
+	MacroDefinition *macro;
+	MacroDefinition **order = NULL;
+	int j;
+	unsigned long *starts = NULL;
+	unsigned long num_macros = 0, num_lines = 0, pool_size = 0, num_buckets = 1;
+	unsigned long buckets_off, entries_off, lines_off, pool_off, hash, b, i, line_index = 0, pool_pos = 0;
+	unsigned char *image = NULL, *entry;
+
+	for(macro = macros; macro != NULL; macro = macro->next)
+	{
+		num_macros++;
+		pool_size += strlen(macro->name) + 1;
+		for(j = 0; j < macro->flat_count; j++)
+		{
+			num_lines++;
+			pool_size += strlen(macro->flat[j]) + 1;
+		}
+	}
+	while(num_buckets < num_macros * DOUBLE)
+	{
+		num_buckets *= DOUBLE;
+	}
+
+	buckets_off = MACRO_LIBRARY_WORD * (1 + MACRO_LIBRARY_HEADER_WORDS);
+	entries_off = buckets_off + (num_buckets + 1) * MACRO_LIBRARY_WORD;
+	lines_off = entries_off + num_macros * MACRO_LIBRARY_ENTRY_WORDS * MACRO_LIBRARY_WORD;
+	pool_off = lines_off + num_lines * MACRO_LIBRARY_WORD;
+	*size = pool_off + pool_size;
+
+	image = (unsigned char *)calloc(*size, 1);
+	starts = (unsigned long *)calloc(num_buckets + 1, sizeof(unsigned long));
+	order = (MacroDefinition **)malloc((num_macros + 1) * sizeof(MacroDefinition *));
+	if(image == NULL || starts == NULL || order == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		free(image);
+		image = NULL;
+		goto clean_build;
+	}
+
+	/* Count the macros of every bucket, then turn the counts into start indexes. */
+	for(macro = macros; macro != NULL; macro = macro->next)
+	{
+		starts[(hash_string(macro->name) & (num_buckets - 1)) + 1]++;
+	}
+	for(b = 0; b < num_buckets; b++)
+	{
+		starts[b + 1] += starts[b];
+		write_word(image + buckets_off + b * MACRO_LIBRARY_WORD, starts[b]);
+	}
+	write_word(image + buckets_off + num_buckets * MACRO_LIBRARY_WORD, num_macros);
+	for(macro = macros; macro != NULL; macro = macro->next)
+	{
+		b = hash_string(macro->name) & (num_buckets - 1);
+		order[starts[b]] = macro;
+		starts[b]++;
+	}
+
+	for(i = 0; i < num_macros; i++)
+	{
+		macro = order[i];
+		hash = hash_string(macro->name);
+		entry = image + entries_off + i * MACRO_LIBRARY_ENTRY_WORDS * MACRO_LIBRARY_WORD;
+		write_word(entry, hash);
+		write_word(entry + MACRO_LIBRARY_WORD, pool_pos);
+		write_word(entry + 2 * MACRO_LIBRARY_WORD, line_index);
+		strcpy((char *)image + pool_off + pool_pos, macro->name);
+		pool_pos += strlen(macro->name) + 1;
+		for(j = 0; j < macro->flat_count; j++)
+		{
+			write_word(image + lines_off + line_index * MACRO_LIBRARY_WORD, pool_pos);
+			strcpy((char *)image + pool_off + pool_pos, macro->flat[j]);
+			pool_pos += strlen(macro->flat[j]) + 1;
+			line_index++;
+		}
+		write_word(entry + 3 * MACRO_LIBRARY_WORD, line_index - read_word(entry + 2 * MACRO_LIBRARY_WORD));
+		write_word(entry + 4 * MACRO_LIBRARY_WORD, (unsigned long)macro->num_params);
+	}
+
+	memcpy(image, MACRO_LIBRARY_MAGIC, MACRO_LIBRARY_WORD);
+	write_word(image + MACRO_LIBRARY_WORD, num_buckets);
+	write_word(image + 2 * MACRO_LIBRARY_WORD, num_macros);
+	write_word(image + 3 * MACRO_LIBRARY_WORD, num_lines);
+	write_word(image + 4 * MACRO_LIBRARY_WORD, buckets_off);
+	write_word(image + 5 * MACRO_LIBRARY_WORD, entries_off);
+	write_word(image + 6 * MACRO_LIBRARY_WORD, lines_off);
+	write_word(image + 7 * MACRO_LIBRARY_WORD, pool_off);
+	write_word(image + 8 * MACRO_LIBRARY_WORD, pool_size);
+
+	clean_build:
+		free(starts);
+		free(order);
+		return image;
+}
+
+/**
+ * @brief Maps a whole file into memory, read-only.
+ *
+ * The precompiled macro libraries and the line and cross-reference tables
+ * are all read this way, with a single `mmap` and no copy.
+ *
+ * @param name The name of the file.
+ * @param size Receives the size of the file.
+ * @return The mapped file, or NULL if it cannot be opened or mapped, or is empty.
+ */
+const unsigned char *map_file(const char *name, size_t *size)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if(fd < 0)
+	{
+		fprintf(stdout, "error opening file!\n");
+		return NULL;
+	}
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		fprintf(stdout, "error opening file!\n");
+		return NULL;
+	}
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		fprintf(stdout, "error opening file!\n");
+		return NULL;
+	}
+	*size = (size_t)st.st_size;
+	return (const unsigned char *)map;
+}
+
+/**
+ * @brief Unmaps a file mapped by `map_file`.
+ *
+ * @param data The mapped file, or NULL.
+ * @param size The size of the file.
+ */
+void unmap_file(const unsigned char *data, size_t size)
+{
+	if(data != NULL)
+	{
+		munmap((void *)data, size);
+	}
+}
+
+/**
+ * @brief Maps a precompiled macro library into memory and checks its structure.
+ *
+ * The whole file is mapped read-only with one `mmap`. Every table and every
+ * offset is checked against the file size once, here, so lookups can trust
+ * the data without further checks.
+ *
+ * @param name The name of the `.amh` file.
+ * @param library A pointer to the library to fill.
+ * @return 1 on success, or EXIT if the file cannot be mapped or is not a valid library.
+ */
+int load_macro_library(const char *name, struct macro_library *library)
+{
+	const unsigned char *data, *entry;
+	unsigned long num_lines, buckets_off, entries_off, lines_off, pool_off, pool_size, i;
+
+	memset(library, 0, sizeof(struct macro_library));
+	data = map_file(name, &library->size);
+	if(data == NULL)
+	{
+		return EXIT;
+	}
+	library->data = data;
+
+	if(library->size < MACRO_LIBRARY_WORD * (1 + MACRO_LIBRARY_HEADER_WORDS) || memcmp(data, MACRO_LIBRARY_MAGIC, MACRO_LIBRARY_WORD) != 0){goto invalid_library;}
+	library->num_buckets = read_word(data + MACRO_LIBRARY_WORD);
+	library->num_macros = read_word(data + 2 * MACRO_LIBRARY_WORD);
+	num_lines = read_word(data + 3 * MACRO_LIBRARY_WORD);
+	buckets_off = read_word(data + 4 * MACRO_LIBRARY_WORD);
+	entries_off = read_word(data + 5 * MACRO_LIBRARY_WORD);
+	lines_off = read_word(data + 6 * MACRO_LIBRARY_WORD);
+	pool_off = read_word(data + 7 * MACRO_LIBRARY_WORD);
+	pool_size = read_word(data + 8 * MACRO_LIBRARY_WORD);
+
+	if(library->num_buckets == 0 || (library->num_buckets & (library->num_buckets - 1)) != 0){goto invalid_library;}
+	if(library->num_buckets >= library->size || library->num_macros >= library->size || num_lines >= library->size){goto invalid_library;}
+	if(buckets_off + (library->num_buckets + 1) * MACRO_LIBRARY_WORD > entries_off){goto invalid_library;}
+	if(entries_off + library->num_macros * MACRO_LIBRARY_ENTRY_WORDS * MACRO_LIBRARY_WORD > lines_off){goto invalid_library;}
+	if(lines_off + num_lines * MACRO_LIBRARY_WORD > pool_off){goto invalid_library;}
+	if(pool_size == 0 || pool_off + pool_size != library->size || data[library->size - 1] != '\0'){goto invalid_library;}
+
+	library->buckets = data + buckets_off;
+	library->entries = data + entries_off;
+	library->lines = data + lines_off;
+	library->pool = (const char *)data + pool_off;
+
+	for(i = 0; i < library->num_buckets; i++)
+	{
+		if(read_word(library->buckets + i * MACRO_LIBRARY_WORD) > read_word(library->buckets + (i + 1) * MACRO_LIBRARY_WORD)){goto invalid_library;}
+	}
+	if(read_word(library->buckets + library->num_buckets * MACRO_LIBRARY_WORD) != library->num_macros){goto invalid_library;}
+	for(i = 0; i < library->num_macros; i++)
+	{
+		entry = library->entries + i * MACRO_LIBRARY_ENTRY_WORDS * MACRO_LIBRARY_WORD;
+		if(read_word(entry + MACRO_LIBRARY_WORD) >= pool_size){goto invalid_library;}
+		if(read_word(entry + 2 * MACRO_LIBRARY_WORD) + read_word(entry + 3 * MACRO_LIBRARY_WORD) > num_lines){goto invalid_library;}
+		if(read_word(entry + 4 * MACRO_LIBRARY_WORD) > MAX_MACRO_PARAMS){goto invalid_library;}
+	}
+	for(i = 0; i < num_lines; i++)
+	{
+		if(read_word(library->lines + i * MACRO_LIBRARY_WORD) >= pool_size){goto invalid_library;}
+	}
+	return 1;
+
+	invalid_library:
+		fprintf(stdout, "invalid macro library: %s\n", name);
+		unload_macro_library(library);
+		return EXIT;
+}
+
+/**
+ * @brief Unmaps a macro library.
+ *
+ * @param library A pointer to the library.
+ */
+void unload_macro_library(struct macro_library *library)
+{
+	unmap_file(library->data, library->size);
+	memset(library, 0, sizeof(struct macro_library));
+}
+
+/**
+ * @brief Finds a macro in a library.
+ *
+ * The name is hashed to a bucket, and only the macros of that bucket whose
+ * stored hash matches are compared by name.
+ *
+ * @param library A pointer to the library, or NULL.
+ * @param name The name of the macro.
+ * @return The macro's entry in the macro table, or NULL if the library has no such macro.
+ */
+const unsigned char *find_library_macro(const struct macro_library *library, const char *name)
+{
+	const unsigned char *entry;
+	unsigned long hash, b, i, end;
+	if(library == NULL || library->data == NULL)
+	{
+		return NULL;
+	}
+	hash = hash_string(name);
+	b = hash & (library->num_buckets - 1);
+	end = read_word(library->buckets + (b + 1) * MACRO_LIBRARY_WORD);
+	for(i = read_word(library->buckets + b * MACRO_LIBRARY_WORD); i < end; i++)
+	{
+		entry = library->entries + i * MACRO_LIBRARY_ENTRY_WORDS * MACRO_LIBRARY_WORD;
+		if(read_word(entry) == hash && strcmp(library_macro_name(library, entry), name) == 0)
+		{
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Returns the name of a library macro.
+ *
+ * @param library A pointer to the library.
+ * @param entry The macro's entry in the macro table.
+ * @return The name, inside the mapped file.
+ */
+const char *library_macro_name(const struct macro_library *library, const unsigned char *entry)
+{
+	return library->pool + read_word(entry + MACRO_LIBRARY_WORD);
+}
+
+/**
+ * @brief Returns the number of body lines of a library macro.
+ *
+ * @param entry The macro's entry in the macro table.
+ * @return The number of lines.
+ */
+int library_macro_lines(const unsigned char *entry)
+{
+	return (int)read_word(entry + 3 * MACRO_LIBRARY_WORD);
+}
+
+/**
+ * @brief Returns the number of parameters of a library macro.
+ *
+ * @param entry The macro's entry in the macro table.
+ * @return The number of parameters.
+ */
+int library_macro_params(const unsigned char *entry)
+{
+	return (int)read_word(entry + 4 * MACRO_LIBRARY_WORD);
+}
+
+/**
+ * @brief Returns a body line of a library macro.
+ *
+ * @param library A pointer to the library.
+ * @param entry The macro's entry in the macro table.
+ * @param index The index of the line in the macro body.
+ * @return The trimmed line, inside the mapped file.
+ */
+const char *library_macro_line(const struct macro_library *library, const unsigned char *entry, int index)
+{
+	unsigned long line = read_word(entry + 2 * MACRO_LIBRARY_WORD) + (unsigned long)index;
+	return library->pool + read_word(library->lines + line * MACRO_LIBRARY_WORD);
+}
@@ -0,0 +1,190 @@
+#ifndef MACROLIB_H
+#define MACROLIB_H
+
+/**
+ * @file macrolib.h
+ * @brief This header file declares precompiled macro libraries.
+ *
+ * A macro library is a source file that only defines macros. It can be
+ * precompiled once into a `.amh` file that holds a hash table of the macros and
+ * their already trimmed body lines. Assembly runs map the file into memory with
+ * a single `mmap` and look macros up in it directly, read-only, next to the
+ * macros the source file defines itself.
+ *
+ * All numbers in the file are 32-bit little-endian, and all references are
+ * offsets from the start of the file, so the file is position independent:
+ *
+ * - Header: the magic "AMH2", then the number of buckets, macros and body lines,
+ *   the offsets of the bucket table, the macro table, the line table and the
+ *   string pool, and the size of the string pool.
+ * - Buckets: `num_buckets + 1` macro indexes. The macros of bucket `b` are the
+ *   entries from `buckets[b]` up to `buckets[b + 1]`.
+ * - Macros: for every macro, the hash of its name, the pool offset of its name,
+ *   the index of its first line in the line table, its number of lines and its
+ *   number of parameters.
+ * - Lines: the pool offset of every body line. Parameter references are stored
+ *   as slot bytes, as in the body of a `MacroDefinition`.
+ * - Pool: null-terminated strings.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "pre_assembler.h"
+#include "assembler.h"
+
+/**
+ * @def MACRO_LIBRARY_MAGIC
+ * @brief The four bytes every precompiled macro library starts with.
+ */
+#define MACRO_LIBRARY_MAGIC "AMH2"
+
+/**
+ * @def END_MACRO_LIBRARY_FILE_NAME
+ * @brief Suffix for a precompiled macro library.
+ */
+#define END_MACRO_LIBRARY_FILE_NAME ".amh"
+
+/**
+ * @def MACRO_LIBRARY_WORD
+ * @brief The size in bytes of every number stored in a macro library.
+ */
+#define MACRO_LIBRARY_WORD 4
+
+/**
+ * @def MACRO_LIBRARY_HEADER_WORDS
+ * @brief The number of words in the header, after the magic.
+ */
+#define MACRO_LIBRARY_HEADER_WORDS 8
+
+/**
+ * @def MACRO_LIBRARY_ENTRY_WORDS
+ * @brief The number of words in every entry of the macro table.
+ */
+#define MACRO_LIBRARY_ENTRY_WORDS 5
+
+/**
+ * @struct macro_library
+ * @brief A precompiled macro library mapped into memory.
+ *
+ * - `data`: The mapped file.
+ * - `size`: The size of the file.
+ * - `num_buckets`: The number of hash buckets (a power of two).
+ * - `num_macros`: The number of macros.
+ * - `buckets`: The bucket table.
+ * - `entries`: The macro table.
+ * - `lines`: The line table.
+ * - `pool`: The string pool.
+ */
+struct macro_library
+{
+	const unsigned char *data;
+	size_t size;
+	unsigned long num_buckets;
+	unsigned long num_macros;
+	const unsigned char *buckets;
+	const unsigned char *entries;
+	const unsigned char *lines;
+	const char *pool;
+};
+
+/**
+ * @brief Reads a little-endian 32-bit number.
+ * @param bytes The four bytes of the number.
+ * @return The number.
+ */
+unsigned long read_word(const unsigned char *bytes);
+
+/**
+ * @brief Writes a little-endian 32-bit number.
+ * @param bytes The four bytes that receive the number.
+ * @param value The number.
+ */
+void write_word(unsigned char *bytes, unsigned long value);
+
+/**
+ * @brief Collects the macros of a library source and writes them as a precompiled library.
+ * @param source The name of the library source file.
+ * @param output The name of the `.amh` file to write, or NULL to replace the source's suffix with `.amh`.
+ * @return 1 on success, 0 if the source has errors, or EXIT on a critical failure.
+ */
+int precompile_macros(const char *source, const char *output);
+
+/**
+ * @brief Serializes a macro list into the precompiled library format.
+ * @param macros The head of the macro list.
+ * @param size Receives the size of the image.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned char *build_macro_library(MacroDefinition *macros, size_t *size);
+
+/**
+ * @brief Maps a whole file into memory, read-only.
+ * @param name The name of the file.
+ * @param size Receives the size of the file.
+ * @return The mapped file, or NULL if it cannot be opened or mapped, or is empty.
+ */
+const unsigned char *map_file(const char *name, size_t *size);
+
+/**
+ * @brief Unmaps a file mapped by `map_file`.
+ * @param data The mapped file, or NULL.
+ * @param size The size of the file.
+ */
+void unmap_file(const unsigned char *data, size_t size);
+
+/**
+ * @brief Maps a precompiled macro library into memory and checks its structure.
+ * @param name The name of the `.amh` file.
+ * @param library A pointer to the library to fill.
+ * @return 1 on success, or EXIT if the file cannot be mapped or is not a valid library.
+ */
+int load_macro_library(const char *name, struct macro_library *library);
+
+/**
+ * @brief Unmaps a macro library.
+ * @param library A pointer to the library.
+ */
+void unload_macro_library(struct macro_library *library);
+
+/**
+ * @brief Finds a macro in a library.
+ * @param library A pointer to the library, or NULL.
+ * @param name The name of the macro.
+ * @return The macro's entry in the macro table, or NULL if the library has no such macro.
+ */
+const unsigned char *find_library_macro(const struct macro_library *library, const char *name);
+
+/**
+ * @brief Returns the name of a library macro.
+ * @param library A pointer to the library.
+ * @param entry The macro's entry in the macro table.
+ * @return The name, inside the mapped file.
+ */
+const char *library_macro_name(const struct macro_library *library, const unsigned char *entry);
+
+/**
+ * @brief Returns the number of body lines of a library macro.
+ * @param entry The macro's entry in the macro table.
+ * @return The number of lines.
+ */
+int library_macro_lines(const unsigned char *entry);
+
+/**
+ * @brief Returns the number of parameters of a library macro.
+ * @param entry The macro's entry in the macro table.
+ * @return The number of parameters.
+ */
+int library_macro_params(const unsigned char *entry);
+
+/**
+ * @brief Returns a body line of a library macro.
+ * @param library A pointer to the library.
+ * @param entry The macro's entry in the macro table.
+ * @param index The index of the line in the macro body.
+ * @return The trimmed line, inside the mapped file.
+ */
+const char *library_macro_line(const struct macro_library *library, const unsigned char *entry, int index);
+
+#endif /* MACROLIB_H */
@@ -0,0 +1,280 @@
+#define _DEFAULT_SOURCE
+#include "metrics.h"
+
+struct metrics_recorder METRICS;
+
+volatile sig_atomic_t METRICS_DUMP_REQUESTED = 0;
+
+/**
+ * @brief Starts recording the progress of a run and writes the first status file.
+ *
+ * The first status file lists every file as queued, so a path that cannot be
+ * written is reported before any file is assembled. `SIGUSR1` is caught from
+ * here on.
+ *
+ * @param name The name of the status file.
+ * @param num_files The number of files of the run.
+ * @return 1 on success, or EXIT if the status file cannot be written.
+ */
+int metrics_open(const char *name, int num_files)
+{
+	memset(&METRICS, 0, sizeof(METRICS));
+	METRICS.name = name;
+	METRICS.origin = perf_wall_clock();
+	METRICS.mark = METRICS.origin;
+	METRICS.files_total = num_files;
+	METRICS.enabled = 1;
+	METRICS_DUMP_REQUESTED = 0;
+	if(write_metrics() == EXIT)
+	{
+		METRICS.enabled = 0;
+		return EXIT;
+	}
+#ifdef SIGUSR1
+	signal(SIGUSR1, metrics_signal);
+#endif
+	return 1;
+}
+
+/**
+ * @brief Requests a dump of the metrics (the `SIGUSR1` handler).
+ *
+ * Only the flag is set here; printing is not safe in a signal handler. The
+ * handler is installed again for systems that reset it on delivery.
+ *
+ * @param sig The signal number.
+ */
+void metrics_signal(int sig)
+{
+	METRICS_DUMP_REQUESTED = 1;
+	signal(sig, metrics_signal);
+}
+
+/**
+ * @brief Records the start of a source file.
+ *
+ * The size of the source file is added to the bytes read; a file that cannot
+ * be opened adds nothing, and its error is reported by the pre-assembler.
+ *
+ * @param name The name of the source file.
+ */
+void metrics_begin_file(const char *name)
+{
+	FILE *fileptr;
+	long size;
+	if(!METRICS.enabled)
+	{
+		return;
+	}
+	METRICS.current[0] = '\0';
+	strncat(METRICS.current, name, METRICS_FILE_LENGTH - 1);
+	fileptr = fopen(name, "rb");
+	if(fileptr != NULL)
+	{
+		if(fseek(fileptr, 0, SEEK_END) == 0 && (size = ftell(fileptr)) > 0)
+		{
+			METRICS.bytes_in += size;
+		}
+		fclose(fileptr);
+	}
+	METRICS.file_start = perf_wall_clock();
+	METRICS.mark = METRICS.file_start;
+	metrics_poll();
+}
+
+/**
+ * @brief Adds the time since the last phase boundary to a phase.
+ *
+ * @param phase The phase that ended.
+ */
+void metrics_phase(int phase)
+{
+	double now;
+	if(!METRICS.enabled)
+	{
+		return;
+	}
+	now = perf_wall_clock();
+	METRICS.phase_seconds[phase] += now - METRICS.mark;
+	METRICS.mark = now;
+	metrics_poll();
+}
+
+/**
+ * @brief Records the end of the current source file.
+ *
+ * @param lines The number of expanded lines of the file.
+ * @param errors The number of errors of the file.
+ * @param bytes_out The size of the output files written for the file.
+ */
+void metrics_end_file(long lines, int errors, double bytes_out)
+{
+	if(!METRICS.enabled)
+	{
+		return;
+	}
+	METRICS.files_done++;
+	if(errors > 0)
+	{
+		METRICS.files_failed++;
+	}
+	METRICS.lines += lines;
+	METRICS.errors += errors;
+	METRICS.bytes_out += bytes_out;
+	METRICS.current[0] = '\0';
+	metrics_poll();
+}
+
+/**
+ * @brief Prints the metrics if a dump was requested and rewrites the status file if it is due.
+ *
+ * It is called at every phase boundary and every `METRICS_POLL_LINES` lines
+ * of the line loops. A status file that cannot be written is reported and
+ * tried again at the next poll; the run itself goes on.
+ */
+void metrics_poll(void)
+{
+	if(!METRICS.enabled)
+	{
+		return;
+	}
+	if(METRICS_DUMP_REQUESTED)
+	{
+		METRICS_DUMP_REQUESTED = 0;
+		print_metrics(stdout);
+		fflush(stdout);
+	}
+	if(perf_wall_clock() - METRICS.last_write >= METRICS_INTERVAL && write_metrics() == EXIT)
+	{
+		fprintf(stdout, "cannot write metrics file: %s\n", METRICS.name);
+	}
+}
+
+/**
+ * @brief Writes a label value with the Prometheus escapes.
+ *
+ * Backslashes, double quotes and newlines are the only characters escaped.
+ *
+ * @param fileptr The file to write to.
+ * @param value The label value.
+ */
+void print_metrics_label(FILE *fileptr, const char *value)
+{
+	for(; *value != '\0'; value++)
+	{
+		if(*value == '\\' || *value == '"')
+		{
+			fprintf(fileptr, "\\%c", *value);
+		}
+		else if(*value == '\n')
+		{
+			fprintf(fileptr, "\\n");
+		}
+		else
+		{
+			fputc(*value, fileptr);
+		}
+	}
+}
+
+/**
+ * @brief Writes the metrics in the Prometheus text format.
+ *
+ * Counters end in `_total`; the queued files, the throughput and the time on
+ * the current file are gauges. The lines per second are the expanded lines of
+ * the finished files over the time since the run began. The current file is
+ * only listed while a file is being assembled, so a slow file shows as a
+ * growing `assembler_worker_file_seconds`; a file stuck on a single line stops
+ * the rewrites instead.
+ *
+ * @param fileptr The file to write to.
+ */
+void print_metrics(FILE *fileptr)
+{
+	double now = perf_wall_clock(), elapsed = now - METRICS.origin;
+	long queued = METRICS.files_total - METRICS.files_done - (METRICS.current[0] != '\0');
+	int i;
+
+	fprintf(fileptr, "# HELP assembler_files_done_total Source files finished.\n");
+	fprintf(fileptr, "# TYPE assembler_files_done_total counter\n");
+	fprintf(fileptr, "assembler_files_done_total %ld\n", METRICS.files_done);
+	fprintf(fileptr, "# HELP assembler_files_failed_total Finished source files with errors.\n");
+	fprintf(fileptr, "# TYPE assembler_files_failed_total counter\n");
+	fprintf(fileptr, "assembler_files_failed_total %ld\n", METRICS.files_failed);
+	fprintf(fileptr, "# HELP assembler_files_queued Source files not begun yet.\n");
+	fprintf(fileptr, "# TYPE assembler_files_queued gauge\n");
+	fprintf(fileptr, "assembler_files_queued %ld\n", queued);
+	fprintf(fileptr, "# HELP assembler_lines_total Expanded lines of the finished files.\n");
+	fprintf(fileptr, "# TYPE assembler_lines_total counter\n");
+	fprintf(fileptr, "assembler_lines_total %ld\n", METRICS.lines);
+	fprintf(fileptr, "# HELP assembler_lines_per_second Expanded lines per second since the run began.\n");
+	fprintf(fileptr, "# TYPE assembler_lines_per_second gauge\n");
+	fprintf(fileptr, "assembler_lines_per_second %.3f\n", (elapsed > 0) ? METRICS.lines / elapsed : 0.0);
+	fprintf(fileptr, "# HELP assembler_input_bytes_total Bytes of the source files begun.\n");
+	fprintf(fileptr, "# TYPE assembler_input_bytes_total counter\n");
+	fprintf(fileptr, "assembler_input_bytes_total %.0f\n", METRICS.bytes_in);
+	fprintf(fileptr, "# HELP assembler_output_bytes_total Bytes of the output files written.\n");
+	fprintf(fileptr, "# TYPE assembler_output_bytes_total counter\n");
+	fprintf(fileptr, "assembler_output_bytes_total %.0f\n", METRICS.bytes_out);
+	fprintf(fileptr, "# HELP assembler_errors_total Errors reported in the finished files.\n");
+	fprintf(fileptr, "# TYPE assembler_errors_total counter\n");
+	fprintf(fileptr, "assembler_errors_total %ld\n", METRICS.errors);
+	fprintf(fileptr, "# HELP assembler_phase_seconds_total Time spent in every phase, summed over the files.\n");
+	fprintf(fileptr, "# TYPE assembler_phase_seconds_total counter\n");
+	for(i = 0; i < METRICS_PHASES; i++)
+	{
+		fprintf(fileptr, "assembler_phase_seconds_total{phase=\"%s\"} %.6f\n", PERF_PHASE_NAMES[i], METRICS.phase_seconds[i]);
+	}
+	fprintf(fileptr, "# HELP assembler_elapsed_seconds Time since the run began.\n");
+	fprintf(fileptr, "# TYPE assembler_elapsed_seconds gauge\n");
+	fprintf(fileptr, "assembler_elapsed_seconds %.6f\n", elapsed);
+	fprintf(fileptr, "# HELP assembler_worker_file_seconds Time the worker has spent on its current file.\n");
+	fprintf(fileptr, "# TYPE assembler_worker_file_seconds gauge\n");
+	if(METRICS.current[0] != '\0')
+	{
+		fprintf(fileptr, "assembler_worker_file_seconds{worker=\"%s\",file=\"", METRICS_WORKER);
+		print_metrics_label(fileptr, METRICS.current);
+		fprintf(fileptr, "\"} %.6f\n", now - METRICS.file_start);
+	}
+}
+
+/**
+ * @brief Rewrites the status file.
+ *
+ * The metrics go to a `.new` copy that `commit_output` renames over the
+ * status file.
+ *
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_metrics(void)
+{
+	FILE *fileptr;
+	METRICS.last_write = perf_wall_clock();
+	fileptr = open_output(METRICS.name, "w");
+	if(fileptr == NULL)
+	{
+		return EXIT;
+	}
+	print_metrics(fileptr);
+	if(fclose(fileptr) != 0)
+	{
+		discard_output(METRICS.name);
+		return EXIT;
+	}
+	return (commit_output(METRICS.name) == EXIT) ? EXIT : 1;
+}
+
+/**
+ * @brief Stops recording and restores the default action of `SIGUSR1`.
+ */
+void metrics_close(void)
+{
+	if(!METRICS.enabled)
+	{
+		return;
+	}
+#ifdef SIGUSR1
+	signal(SIGUSR1, SIG_DFL);
+#endif
+	METRICS.enabled = 0;
+}
@@ -0,0 +1,178 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/**
+ * @file metrics.h
+ * @brief This header file declares the live progress metrics of a run.
+ *
+ * With `--metrics FILE` the assembler keeps a status file in the Prometheus
+ * text exposition format while it runs: the files done, queued and failed,
+ * the expanded lines and lines per second, the bytes read and written, the
+ * errors, the time spent in every phase summed over the files, and the file
+ * the assembler is working on with the time it has spent on it. The file is
+ * rewritten at most every `METRICS_INTERVAL` seconds, through a `.new` copy
+ * that is renamed over it, so a scraper (such as the node exporter's textfile
+ * collector) never reads half a file; it is written once more when the run
+ * ends.
+ *
+ * While `--metrics` is on, `SIGUSR1` prints the same metrics on the standard
+ * output. The handler only sets a flag; the metrics are printed at the next
+ * poll, like the periodic rewrite. The pre-assembler and both passes poll
+ * every `METRICS_POLL_LINES` lines besides the phase boundaries, so a long
+ * file is reported while it is assembled.
+ *
+ * The assembler works on one file at a time, so there is a single worker,
+ * `worker="0"`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "perf.h"
+#include "output.h"
+#include "assembler.h"
+
+/**
+ * @def METRICS_INTERVAL
+ * @brief The least time between two rewrites of the status file, in seconds.
+ */
+#define METRICS_INTERVAL 1.0
+
+/**
+ * @def METRICS_POLL_LINES
+ * @brief The number of lines the line loops go through between two polls.
+ */
+#define METRICS_POLL_LINES 1024
+
+/**
+ * @def METRICS_FILE_LENGTH
+ * @brief The size of the name of the current file stored in the recorder.
+ */
+#define METRICS_FILE_LENGTH 256
+
+/**
+ * @def METRICS_PHASES
+ * @brief The number of timed phases, as `PERF_PHASES` (perf.h includes this header through assembler.h).
+ */
+#define METRICS_PHASES 4
+
+/**
+ * @def METRICS_WORKER
+ * @brief The label of the only worker.
+ */
+#define METRICS_WORKER "0"
+
+/**
+ * @struct metrics_recorder
+ * @brief The progress of the run.
+ *
+ * - `enabled`: Non-zero while the progress is recorded.
+ * - `name`: The name of the status file.
+ * - `origin`: The time the run began, in seconds.
+ * - `last_write`: The time the status file was last written.
+ * - `mark`: The time the current phase began.
+ * - `file_start`: The time the current file began.
+ * - `files_total`: The number of files of the run.
+ * - `files_done`: The number of files finished.
+ * - `files_failed`: The number of finished files with errors.
+ * - `lines`: The number of expanded lines of the finished files.
+ * - `errors`: The number of errors of the finished files.
+ * - `bytes_in`: The size of the source files begun so far.
+ * - `bytes_out`: The size of the output files written so far.
+ * - `phase_seconds`: The time spent in every phase, indexed by `perf_phase_id`.
+ * - `current`: The file being assembled, or an empty string between files.
+ */
+struct metrics_recorder
+{
+	int enabled;
+	const char *name;
+	double origin;
+	double last_write;
+	double mark;
+	double file_start;
+	long files_total;
+	long files_done;
+	long files_failed;
+	long lines;
+	long errors;
+	double bytes_in;
+	double bytes_out;
+	double phase_seconds[METRICS_PHASES];
+	char current[METRICS_FILE_LENGTH];
+};
+
+/**
+ * @brief The progress of the run.
+ */
+extern struct metrics_recorder METRICS;
+
+/**
+ * @brief Set by `SIGUSR1`; the metrics are printed at the next poll.
+ */
+extern volatile sig_atomic_t METRICS_DUMP_REQUESTED;
+
+/**
+ * @brief Starts recording the progress of a run and writes the first status file.
+ * @param name The name of the status file.
+ * @param num_files The number of files of the run.
+ * @return 1 on success, or EXIT if the status file cannot be written.
+ */
+int metrics_open(const char *name, int num_files);
+
+/**
+ * @brief Requests a dump of the metrics (the `SIGUSR1` handler).
+ * @param sig The signal number.
+ */
+void metrics_signal(int sig);
+
+/**
+ * @brief Records the start of a source file.
+ * @param name The name of the source file.
+ */
+void metrics_begin_file(const char *name);
+
+/**
+ * @brief Adds the time since the last phase boundary to a phase.
+ * @param phase The phase that ended.
+ */
+void metrics_phase(int phase);
+
+/**
+ * @brief Records the end of the current source file.
+ * @param lines The number of expanded lines of the file.
+ * @param errors The number of errors of the file.
+ * @param bytes_out The size of the output files written for the file.
+ */
+void metrics_end_file(long lines, int errors, double bytes_out);
+
+/**
+ * @brief Prints the metrics if a dump was requested and rewrites the status file if it is due.
+ */
+void metrics_poll(void);
+
+/**
+ * @brief Writes a label value with the Prometheus escapes.
+ * @param fileptr The file to write to.
+ * @param value The label value.
+ */
+void print_metrics_label(FILE *fileptr, const char *value);
+
+/**
+ * @brief Writes the metrics in the Prometheus text format.
+ * @param fileptr The file to write to.
+ */
+void print_metrics(FILE *fileptr);
+
+/**
+ * @brief Rewrites the status file.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_metrics(void);
+
+/**
+ * @brief Stops recording and restores the default action of `SIGUSR1`.
+ */
+void metrics_close(void);
+
+#endif /* METRICS_H */
@@ -0,0 +1,776 @@
+#define _DEFAULT_SOURCE
+#include <unistd.h>
+#include "microbench.h"
+
+const struct bench_case BENCH_CASES[] =
+{
+	{"which_type", bench_which_type},
+	{"which_type_operand", bench_which_type_operand},
+	{"valid_label", bench_valid_label},
+	{"search_label", bench_search_label},
+	{"find_macro_definition", bench_find_macro_definition},
+	{"int_to_special_base4", bench_int_to_special_base4},
+	{"data_update", bench_data_update},
+	{"instruction", bench_instruction},
+	{NULL, NULL}
+};
+
+const struct scaling_case SCALING_CASES[] =
+{
+	{"labels", scaling_labels},
+	{"references", scaling_references},
+	{"macros", scaling_macros},
+	{"invocations", scaling_invocations},
+	{"data", scaling_data},
+	{"errors", scaling_errors},
+	{NULL, NULL}
+};
+
+/**
+ * @brief Times `which_type` on mnemonics, directives and an unknown word.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_which_type(struct bench_state *state, long iterations)
+{
+	char inputs[][8] = {"mov", "stop", ".data", ".extern", "prn", "jsr", ".string", "foo"};
+	long i;
+	for(i = 0; i < iterations; i++)
+	{
+		state->sink += which_type(inputs[i % (sizeof(inputs) / sizeof(inputs[0]))], &state->errortable, &state->ec, &state->cl, NOT_UPDATE, &state->esize);
+	}
+	return 1;
+}
+
+/**
+ * @brief Times `which_type_operand` on every addressing mode.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_which_type_operand(struct bench_state *state, long iterations)
+{
+	char inputs[][16] = {"#5", " r3", "LOOP", "M1[r2][r7]", "#-12", "STR"};
+	long i;
+	for(i = 0; i < iterations; i++)
+	{
+		state->sink += which_type_operand(inputs[i % (sizeof(inputs) / sizeof(inputs[0]))]);
+	}
+	return 1;
+}
+
+/**
+ * @brief Times `valid_label` on new labels checked against the full label table.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_valid_label(struct bench_state *state, long iterations)
+{
+	char inputs[][32] = {"LOOP", "MAIN", "END", "ALONGERLABELNAME"};
+	char word2[] = "mov";
+	long i;
+	int status;
+	for(i = 0; i < iterations; i++)
+	{
+		status = valid_label(inputs[i % (sizeof(inputs) / sizeof(inputs[0]))], word2, &state->errortable, state->labeltable, state->macros, &state->ec, &state->cl, &state->esize, &state->lac);
+		if(status == EXIT){return EXIT;}
+		state->sink += status;
+	}
+	return 1;
+}
+
+/**
+ * @brief Times `search_label` on labels at the start, middle and end of the table and a missing one.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_search_label(struct bench_state *state, long iterations)
+{
+	char inputs[][8] = {"L0", "L31", "L63", "MISSING"};
+	long i;
+	for(i = 0; i < iterations; i++)
+	{
+		state->sink += search_label(state->labeltable, &state->lac, inputs[i % (sizeof(inputs) / sizeof(inputs[0]))], &state->lasize, -1, 0, 0);
+	}
+	return 1;
+}
+
+/**
+ * @brief Times `find_macro_definition` on macros along the list and a missing one.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_find_macro_definition(struct bench_state *state, long iterations)
+{
+	const char *inputs[] = {"m_mc0", "m_mc15", "m_mc31", "missing"};
+	long i;
+	for(i = 0; i < iterations; i++)
+	{
+		state->sink += (find_macro_definition(state->macros, inputs[i % (sizeof(inputs) / sizeof(inputs[0]))]) != NULL);
+	}
+	return 1;
+}
+
+/**
+ * @brief Times `int_to_special_base4` on positive and negative words.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_int_to_special_base4(struct bench_state *state, long iterations)
+{
+	const int inputs[] = {0, 7, 511, -1, -300, 1023};
+	char *digits;
+	long i;
+	for(i = 0; i < iterations; i++)
+	{
+		digits = int_to_special_base4(inputs[i % (sizeof(inputs) / sizeof(inputs[0]))], 5);
+		if(digits == NULL){return EXIT;}
+		state->sink += digits[4];
+		free(digits);
+	}
+	return 1;
+}
+
+/**
+ * @brief Times `data_update` on `.data` operand lists.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_data_update(struct bench_state *state, long iterations)
+{
+	char inputs[][40] = {"7", "6, -9, 15", "1,2,3,4,5,6,7,8", " -100 , +200 , 300 "};
+	long i;
+	for(i = 0; i < iterations; i++)
+	{
+		state->dc = 0;
+		if(data_update(inputs[i % (sizeof(inputs) / sizeof(inputs[0]))], &state->datatable, &state->errortable, &state->ec, &state->dc, &state->cl, &state->esize, &state->dsize) == EXIT){return EXIT;}
+		state->sink += state->dc;
+	}
+	return 1;
+}
+
+/**
+ * @brief Times `instruction` on lines with every operand count and addressing mode.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_instruction(struct bench_state *state, long iterations)
+{
+	char inputs[][32] = {"mov M1[r2][r7], LENGTH", "cmp #5, r3", "add r2, STR", "prn #-5", "jmp LOOP", "inc r1", "lea STR, r6", "stop"};
+	long i;
+	for(i = 0; i < iterations; i++)
+	{
+		state->ic = 0;
+		if(instruction(inputs[i % (sizeof(inputs) / sizeof(inputs[0]))], &state->instable, &state->errortable, &state->ic, &state->ec, &state->cl, &state->isize, &state->esize) == EXIT){return EXIT;}
+		state->sink += state->ic;
+	}
+	return 1;
+}
+
+/**
+ * @brief Allocates the tables and fills the label table and macro list.
+ *
+ * The label table holds `BENCH_LABELS` labels named `L0`, `L1`, ... and the
+ * macro list `BENCH_MACROS` macros named `m_mc0`, `m_mc1`, ..., the sizes of
+ * a large program, so the lookups scan realistic tables.
+ *
+ * @param state A pointer to the benchmark state.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int bench_setup(struct bench_state *state)
+{
+	MacroDefinition *macro;
+	int i;
+	memset(state, 0, sizeof(*state));
+	state->instable = allocated_memory_table();
+	state->datatable = allocated_dataMemory_table();
+	state->errortable = allocated_error_table();
+	state->labeltable = allocated_label_table();
+	state->isize = MAX_SIZE_MEMORY;
+	state->dsize = MAX_SIZE_MEMORY;
+	state->esize = MAX_SIZE_MEMORY;
+	state->lasize = MAX_SIZE_MEMORY;
+	if(state->instable == NULL || state->datatable == NULL || state->errortable == NULL || state->labeltable == NULL){return EXIT;}
+	for(i = 0; i < BENCH_LABELS; i++)
+	{
+		sprintf(state->labeltable[i].name, "L%d", i);
+		state->labeltable[i].type = INSTRUCTION;
+		state->labeltable[i].index = i;
+	}
+	state->lac = BENCH_LABELS;
+	for(i = BENCH_MACROS - 1; i >= 0; i--)
+	{
+		macro = (MacroDefinition *)calloc(1, sizeof(MacroDefinition));
+		if(macro == NULL)
+		{
+			fprintf(stdout, "Memory allocation failed");
+			return EXIT;
+		}
+		sprintf(macro->name, "m_mc%d", i);
+		add_macro_definition(&state->macros, macro);
+	}
+	return 1;
+}
+
+/**
+ * @brief Frees the tables and the macro list.
+ * @param state A pointer to the benchmark state.
+ */
+void bench_teardown(struct bench_state *state)
+{
+	free(state->instable);
+	free(state->datatable);
+	free(state->errortable);
+	free(state->labeltable);
+	free_macro_definitions(&state->macros);
+}
+
+/**
+ * @brief Orders numbers (a `qsort` comparator).
+ * @param a A pointer to the first number.
+ * @param b A pointer to the second number.
+ * @return A negative, zero or positive value.
+ */
+int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Calibrates, warms up and times a benchmark.
+ *
+ * The batch size doubles until a batch takes `BENCH_MIN_SECONDS`, so the
+ * clock resolution is negligible. After `BENCH_WARMUP_BATCHES` untimed
+ * batches, `BENCH_REPETITIONS` batches are timed and summarized by their
+ * median and median absolute deviation.
+ *
+ * @param bench The benchmark.
+ * @param state A pointer to the benchmark state.
+ * @param result Receives the timing.
+ * @return 1 on success, or EXIT on a memory error.
+ */
+int run_benchmark(const struct bench_case *bench, struct bench_state *state, struct bench_result *result)
+{
+	double samples[BENCH_REPETITIONS], deviations[BENCH_REPETITIONS];
+	double start, elapsed = 0;
+	long iterations = 1;
+	int i;
+	for(;;)
+	{
+		start = perf_wall_clock();
+		if(bench->run(state, iterations) == EXIT){return EXIT;}
+		elapsed = perf_wall_clock() - start;
+		if(elapsed >= BENCH_MIN_SECONDS){break;}
+		iterations *= 2;
+	}
+	for(i = 0; i < BENCH_WARMUP_BATCHES; i++)
+	{
+		if(bench->run(state, iterations) == EXIT){return EXIT;}
+	}
+	for(i = 0; i < BENCH_REPETITIONS; i++)
+	{
+		start = perf_wall_clock();
+		if(bench->run(state, iterations) == EXIT){return EXIT;}
+		samples[i] = (perf_wall_clock() - start) * 1e9 / iterations;
+	}
+	qsort(samples, BENCH_REPETITIONS, sizeof(double), compare_doubles);
+	result->median = samples[BENCH_REPETITIONS / 2];
+	result->best = samples[0];
+	result->iterations = iterations;
+	for(i = 0; i < BENCH_REPETITIONS; i++)
+	{
+		deviations[i] = (samples[i] > result->median) ? samples[i] - result->median : result->median - samples[i];
+	}
+	qsort(deviations, BENCH_REPETITIONS, sizeof(double), compare_doubles);
+	result->mad = deviations[BENCH_REPETITIONS / 2];
+	return 1;
+}
+
+/**
+ * @brief Looks a benchmark up in a baseline JSON file.
+ *
+ * The file is read the way `--save` writes it: one `"name": value` pair per
+ * line.
+ *
+ * @param lines The lines of the baseline file, one benchmark per line as `--save` writes them.
+ * @param count The number of lines.
+ * @param name The name of the benchmark.
+ * @param value Receives the baseline time per call, in nanoseconds.
+ * @return 1 if the benchmark is in the baseline, 0 otherwise.
+ */
+int find_baseline(char **lines, int count, const char *name, double *value)
+{
+	const char *key;
+	size_t len = strlen(name);
+	int i;
+	for(i = 0; i < count; i++)
+	{
+		key = strchr(lines[i], '"');
+		if(key != NULL && strncmp(key + 1, name, len) == 0 && key[len + 1] == '"' && key[len + 2] == ':')
+		{
+			*value = strtod(key + len + 3, NULL);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Appends a generated source line.
+ * @param lines The lines.
+ * @param count A pointer to the number of lines, incremented.
+ * @param text The line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_scaling_line(char **lines, int *count, const char *text)
+{
+	lines[*count] = my_strdup(text);
+	if(lines[*count] == NULL){return EXIT;}
+	(*count)++;
+	return 1;
+}
+
+/**
+ * @brief Generates `n` labeled instructions, each defining a new label.
+ *
+ * Stresses the duplicate check of `add_label` and the label table growth.
+ *
+ * @param n The number of labels.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_labels(int n, char **lines, int *count)
+{
+	char text[MAX_SIZE_CHAR];
+	int i;
+	for(i = 0; i < n; i++)
+	{
+		sprintf(text, "L%d: inc r1", i);
+		if(add_scaling_line(lines, count, text) == EXIT){return EXIT;}
+	}
+	return 1;
+}
+
+/**
+ * @brief Generates `n` instructions that refer to a fixed set of labels.
+ *
+ * Stresses `search_and_update` with a label table of constant size.
+ *
+ * @param n The number of references.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_references(int n, char **lines, int *count)
+{
+	char text[MAX_SIZE_CHAR];
+	int i;
+	for(i = 0; i < n; i++)
+	{
+		sprintf(text, "inc L%d", i % BENCH_LABELS);
+		if(add_scaling_line(lines, count, text) == EXIT){return EXIT;}
+	}
+	for(i = 0; i < BENCH_LABELS; i++)
+	{
+		sprintf(text, "L%d: stop", i);
+		if(add_scaling_line(lines, count, text) == EXIT){return EXIT;}
+	}
+	return 1;
+}
+
+/**
+ * @brief Generates `n` macro definitions, each invoked once.
+ *
+ * Stresses the macro list: every definition is checked against the earlier
+ * ones, and every invocation is looked up.
+ *
+ * @param n The number of macros.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_macros(int n, char **lines, int *count)
+{
+	char text[MAX_SIZE_CHAR];
+	int i;
+	for(i = 0; i < n; i++)
+	{
+		sprintf(text, "mcro m_mc%d", i);
+		if(add_scaling_line(lines, count, text) == EXIT || add_scaling_line(lines, count, "inc r1") == EXIT || add_scaling_line(lines, count, "mcroend") == EXIT){return EXIT;}
+	}
+	for(i = 0; i < n; i++)
+	{
+		sprintf(text, "m_mc%d", i);
+		if(add_scaling_line(lines, count, text) == EXIT){return EXIT;}
+	}
+	return 1;
+}
+
+/**
+ * @brief Generates `n` invocations of one macro.
+ *
+ * Stresses the expansion itself and the growth of the expanded source.
+ *
+ * @param n The number of invocations.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_invocations(int n, char **lines, int *count)
+{
+	int i;
+	if(add_scaling_line(lines, count, "mcro m_mc") == EXIT || add_scaling_line(lines, count, "inc r1") == EXIT || add_scaling_line(lines, count, "mcroend") == EXIT){return EXIT;}
+	for(i = 0; i < n; i++)
+	{
+		if(add_scaling_line(lines, count, "m_mc") == EXIT){return EXIT;}
+	}
+	return 1;
+}
+
+/**
+ * @brief Generates `.data` lines holding `n` values in total.
+ *
+ * Stresses the data table growth and the data counter.
+ *
+ * @param n The number of values.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_data(int n, char **lines, int *count)
+{
+	int i;
+	for(i = 0; i < n; i += 10)
+	{
+		if(add_scaling_line(lines, count, ".data 1,-2,3,-4,5,-6,7,-8,9,-10") == EXIT){return EXIT;}
+	}
+	return 1;
+}
+
+/**
+ * @brief Generates `n` lines that are each reported as an error.
+ *
+ * Stresses the error table growth.
+ *
+ * @param n The number of errors.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_errors(int n, char **lines, int *count)
+{
+	int i;
+	for(i = 0; i < n; i++)
+	{
+		if(add_scaling_line(lines, count, "foo r1") == EXIT){return EXIT;}
+	}
+	return 1;
+}
+
+/**
+ * @brief Writes generated source lines to the `.as` file of a base name.
+ * @param base The base name of the source.
+ * @param lines The source lines.
+ * @param count The number of lines.
+ * @return 1 on success, or EXIT if the file cannot be written.
+ */
+int write_scaling_source(const char *base, char **lines, int count)
+{
+	char name[MAX_SIZE_CHAR];
+	FILE *fileptr;
+	int i, status = 1;
+	sprintf(name, "%s.as", base);
+	fileptr = fopen(name, "w");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout, "error opening file: %s\n", name);
+		return EXIT;
+	}
+	for(i = 0; i < count; i++)
+	{
+		if(fprintf(fileptr, "%s\n", lines[i]) < 0){status = EXIT;}
+	}
+	if(fclose(fileptr) != 0){status = EXIT;}
+	if(status == EXIT){fprintf(stdout, "error writing file: %s\n", name);}
+	return status;
+}
+
+/**
+ * @brief Assembles a source with the real assembler binary, in a process of its own.
+ *
+ * The run is what a user runs: process start, reading the file, the
+ * pre-assembler, both passes and the output files. Its messages are discarded.
+ *
+ * @param base The base name of the source.
+ * @return 1 on success, or EXIT if the assembler cannot be run.
+ */
+int run_scaling_input(const char *base)
+{
+	char command[MAX_SIZE_CHAR];
+	sprintf(command, "%s %s > /dev/null", SCALING_ASSEMBLER, base);
+	if(system(command) == -1)
+	{
+		fprintf(stdout, "cannot run %s\n", SCALING_ASSEMBLER);
+		return EXIT;
+	}
+	return 1;
+}
+
+/**
+ * @brief Times a source, repeating it until `SCALING_MIN_SECONDS` have passed.
+ * @param base The base name of the source.
+ * @param seconds Receives the time of one run.
+ * @return 1 on success, or EXIT if the assembler cannot be run.
+ */
+int time_scaling_input(const char *base, double *seconds)
+{
+	double start, elapsed;
+	long runs = 0;
+	if(run_scaling_input(base) == EXIT){return EXIT;}
+	start = perf_wall_clock();
+	do
+	{
+		if(run_scaling_input(base) == EXIT){return EXIT;}
+		runs++;
+		elapsed = perf_wall_clock() - start;
+	}while(elapsed < SCALING_MIN_SECONDS);
+	*seconds = elapsed / runs;
+	return 1;
+}
+
+/**
+ * @brief Removes the source and output files of a base name, and their directory.
+ * @param directory The temporary directory.
+ * @param base The base name of the source, in the directory.
+ */
+void remove_scaling_files(const char *directory, const char *base)
+{
+	const char *extensions[] = {".as", ".am", ".ob", ".ent", ".ext"};
+	char name[MAX_SIZE_CHAR];
+	int i;
+	for(i = 0; i < (int)(sizeof(extensions) / sizeof(extensions[0])); i++)
+	{
+		sprintf(name, "%s%s", base, extensions[i]);
+		remove(name);
+	}
+	rmdir(directory);
+}
+
+/**
+ * @brief Fits the exponent `k` of `time = c * size^k` by least squares on a log-log scale.
+ * @param sizes The sizes.
+ * @param times The times.
+ * @param count The number of points.
+ * @return The exponent.
+ */
+double fit_growth_exponent(const double *sizes, const double *times, int count)
+{
+	double mean_x = 0, mean_y = 0, sxy = 0, sxx = 0, x, y;
+	int i;
+	for(i = 0; i < count; i++)
+	{
+		mean_x += log(sizes[i]) / count;
+		mean_y += log(times[i]) / count;
+	}
+	for(i = 0; i < count; i++)
+	{
+		x = log(sizes[i]) - mean_x;
+		y = log(times[i]) - mean_y;
+		sxy += x * y;
+		sxx += x * x;
+	}
+	return (sxx > 0) ? sxy / sxx : 0;
+}
+
+/**
+ * @brief Runs every stress dimension and reports its growth exponent.
+ *
+ * The sources are written to a temporary directory in `TMPDIR`, or in
+ * `/tmp`, and assembled by `./assembler`. The time of an empty source, the
+ * process start, is taken off every time so that it does not flatten the
+ * growth. The reference exponent is that of N log N fitted over the same
+ * sizes, which is slightly above 1; a dimension passes when its exponent is
+ * at most the reference plus `SCALING_TOLERANCE`.
+ *
+ * @return 1 if every dimension scales as N log N or better, 0 if one does not, or EXIT on an error.
+ */
+int run_scaling_checks(void)
+{
+	double sizes[SCALING_STEPS], times[SCALING_STEPS], reference[SCALING_STEPS], limit, exponent, startup;
+	const char *parent = getenv("TMPDIR");
+	char directory[MAX_SIZE_CHAR], base[MAX_SIZE_CHAR];
+	char **lines = NULL;
+	int i, j, n, count = 0, status = 1;
+	FILE *binary = fopen(SCALING_ASSEMBLER, "rb");
+
+	if(binary == NULL)
+	{
+		fprintf(stdout, "cannot find %s; run make first\n", SCALING_ASSEMBLER);
+		return EXIT;
+	}
+	fclose(binary);
+	if(parent == NULL || *parent == '\0')
+	{
+		parent = SCALING_DEFAULT_DIRECTORY;
+	}
+	if(strlen(parent) + sizeof(SCALING_DIRECTORY_TEMPLATE) + sizeof("/scaling.ent") > MAX_SIZE_CHAR)
+	{
+		fprintf(stdout, "temporary directory name too long: %s\n", parent);
+		return EXIT;
+	}
+	sprintf(directory, "%s%s", parent, SCALING_DIRECTORY_TEMPLATE);
+	if(mkdtemp(directory) == NULL)
+	{
+		fprintf(stdout, "cannot create a directory in %s\n", parent);
+		return EXIT;
+	}
+	strcpy(base, directory);
+	strcat(base, "/scaling");
+	if(write_scaling_source(base, NULL, 0) == EXIT || time_scaling_input(base, &startup) == EXIT)
+	{
+		status = EXIT;
+		goto clean_checks;
+	}
+
+	for(j = 0; j < SCALING_STEPS; j++)
+	{
+		sizes[j] = (double)(SCALING_BASE_SIZE << j);
+		reference[j] = sizes[j] * log(sizes[j]);
+	}
+	limit = fit_growth_exponent(sizes, reference, SCALING_STEPS) + SCALING_TOLERANCE;
+	fprintf(stdout, "%s, %.0f us per run taken off\n", SCALING_ASSEMBLER, startup * 1e6);
+	fprintf(stdout, "%-12s", "us/run  N =");
+	for(j = 0; j < SCALING_STEPS; j++){fprintf(stdout, " %11d", SCALING_BASE_SIZE << j);}
+	fprintf(stdout, " %8s %8s\n", "exponent", "limit");
+	for(i = 0; SCALING_CASES[i].name != NULL; i++)
+	{
+		for(j = 0; j < SCALING_STEPS; j++)
+		{
+			n = SCALING_BASE_SIZE << j;
+			lines = (char **)malloc(SCALING_LINES_PER_ELEMENT * n * sizeof(char *));
+			count = 0;
+			if(lines == NULL)
+			{
+				fprintf(stdout, "Memory allocation failed");
+				status = EXIT;
+				goto clean_checks;
+			}
+			if(SCALING_CASES[i].generate(n, lines, &count) == EXIT || write_scaling_source(base, lines, count) == EXIT || time_scaling_input(base, &times[j]) == EXIT)
+			{
+				status = EXIT;
+				goto clean_checks;
+			}
+			free_lines(lines, count);
+			lines = NULL;
+			/* A run faster than the empty source is noise; keep the point on the scale. */
+			times[j] = (times[j] > startup * (1 + SCALING_TOLERANCE)) ? times[j] - startup : startup * SCALING_TOLERANCE;
+		}
+		exponent = fit_growth_exponent(sizes, times, SCALING_STEPS);
+		fprintf(stdout, "%-12s", SCALING_CASES[i].name);
+		for(j = 0; j < SCALING_STEPS; j++){fprintf(stdout, " %11.0f", times[j] * 1e6);}
+		fprintf(stdout, " %8.2f %8.2f%s\n", exponent, limit, (exponent > limit) ? "  superlinear" : "");
+		if(exponent > limit){status = 0;}
+	}
+
+	clean_checks:
+		free_lines(lines, count);
+		remove_scaling_files(directory, base);
+		return status;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_state state;
+	struct bench_result result;
+	const char *save = NULL, *baseline_name = NULL;
+	char **baseline = NULL;
+	FILE *savefile = NULL;
+	double base, change;
+	int i, count = 0, status = 1;
+
+	if(argc == 2 && strcmp(argv[1], OPTION_BENCH_SCALING) == 0)
+	{
+		status = run_scaling_checks();
+		return (status == 1) ? 0 : 1;
+	}
+	for(i = 1; i < argc; i++)
+	{
+		if((strcmp(argv[i], OPTION_BENCH_SAVE) == 0 || strcmp(argv[i], OPTION_BENCH_BASELINE) == 0) && i + 1 < argc)
+		{
+			if(strcmp(argv[i], OPTION_BENCH_SAVE) == 0){save = argv[i + 1];}
+			else{baseline_name = argv[i + 1];}
+			i++;
+		}
+		else
+		{
+			fprintf(stdout, "usage: %s [%s FILE] [%s FILE] | %s\n", argv[0], OPTION_BENCH_SAVE, OPTION_BENCH_BASELINE, OPTION_BENCH_SCALING);
+			return 1;
+		}
+	}
+	if(baseline_name != NULL && (baseline = read_raw_lines(baseline_name, &count)) == NULL)
+	{
+		fprintf(stdout, "error opening file: %s\n", baseline_name);
+		return 1;
+	}
+	if(bench_setup(&state) == EXIT)
+	{
+		status = EXIT;
+		goto clean;
+	}
+	if(save != NULL && (savefile = fopen(save, "w")) == NULL)
+	{
+		fprintf(stdout, "error opening file: %s\n", save);
+		status = EXIT;
+		goto clean;
+	}
+	if(savefile != NULL){fprintf(savefile, "{\n");}
+	fprintf(stdout, "%-22s %10s %8s %10s %10s", "function", "ns/op", "MAD", "best", "calls");
+	if(baseline != NULL){fprintf(stdout, " %10s %8s", "baseline", "change");}
+	fprintf(stdout, "\n");
+	for(i = 0; BENCH_CASES[i].name != NULL; i++)
+	{
+		if(run_benchmark(&BENCH_CASES[i], &state, &result) == EXIT)
+		{
+			status = EXIT;
+			goto clean;
+		}
+		fprintf(stdout, "%-22s %10.2f %8.2f %10.2f %10ld", BENCH_CASES[i].name, result.median, result.mad, result.best, result.iterations);
+		if(baseline != NULL && find_baseline(baseline, count, BENCH_CASES[i].name, &base) && base > 0)
+		{
+			change = (result.median - base) / base;
+			fprintf(stdout, " %10.2f %+7.1f%%", base, change * 100);
+			if(change > BENCH_THRESHOLD && result.median - base > 3 * result.mad){fprintf(stdout, "  slower");}
+			else if(change < -BENCH_THRESHOLD && base - result.median > 3 * result.mad){fprintf(stdout, "  faster");}
+		}
+		fprintf(stdout, "\n");
+		if(savefile != NULL)
+		{
+			fprintf(savefile, "  \"%s\": %.3f%s\n", BENCH_CASES[i].name, result.median, (BENCH_CASES[i + 1].name != NULL) ? "," : "");
+		}
+	}
+	if(savefile != NULL)
+	{
+		fprintf(savefile, "}\n");
+		if(fclose(savefile) != 0)
+		{
+			fprintf(stdout, "error writing file: %s\n", save);
+			status = EXIT;
+		}
+		savefile = NULL;
+	}
+
+	clean:
+		if(savefile != NULL)fclose(savefile);
+		bench_teardown(&state);
+		free_lines(baseline, count);
+		return (status == EXIT) ? 1 : 0;
+}
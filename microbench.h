@@ -0,0 +1,433 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+/**
+ * @file microbench.h
+ * @brief This header file declares the micro-benchmarks of the hot functions.
+ *
+ * `make microbench` links a separate program against the assembler objects.
+ * It times the functions that run once or more per source line, on a small
+ * set of representative inputs that it cycles through:
+ * `which_type`, `which_type_operand`, `valid_label`, `search_label`,
+ * `find_macro_definition`, `int_to_special_base4`, `data_update` and
+ * `instruction`.
+ *
+ * Every benchmark is first calibrated: its batch size doubles until a batch
+ * takes at least `BENCH_MIN_SECONDS`, and a few more batches warm the caches
+ * up. Then `BENCH_REPETITIONS` batches are timed. The median time per call is
+ * reported with the median absolute deviation (MAD) as its spread, which
+ * outliers such as a preemption barely move.
+ *
+ * `--save FILE` writes the medians as JSON. `--baseline FILE` compares with
+ * such a file and marks a benchmark slower or faster when it changed by more
+ * than `BENCH_THRESHOLD` and by more than three MADs.
+ *
+ * `--scaling` checks the asymptotic growth of the whole assembler instead. For
+ * every stress dimension (labels, references, macros, invocations, data
+ * values and errors) it writes a source of N, 2N, 4N and 8N elements to a
+ * temporary directory, times the `./assembler` binary on it, less the time it
+ * takes on an empty source (the process start), and fits the growth
+ * exponent of the time by least squares on a log-log scale. A dimension
+ * fails when its exponent exceeds that of N log N over the same range by
+ * more than `SCALING_TOLERANCE`, and the program then exits with status 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assembler.h"
+
+/**
+ * @def BENCH_REPETITIONS
+ * @brief The number of timed batches of every benchmark.
+ */
+#define BENCH_REPETITIONS 15
+
+/**
+ * @def BENCH_WARMUP_BATCHES
+ * @brief The number of untimed batches after the calibration.
+ */
+#define BENCH_WARMUP_BATCHES 3
+
+/**
+ * @def BENCH_MIN_SECONDS
+ * @brief The shortest batch that is timed.
+ */
+#define BENCH_MIN_SECONDS 0.01
+
+/**
+ * @def BENCH_THRESHOLD
+ * @brief The relative change against the baseline that counts as a regression.
+ */
+#define BENCH_THRESHOLD 0.05
+
+/**
+ * @def BENCH_LABELS
+ * @brief The number of labels in the label table the lookups search.
+ */
+#define BENCH_LABELS 64
+
+/**
+ * @def BENCH_MACROS
+ * @brief The number of macros in the macro list the lookups search.
+ */
+#define BENCH_MACROS 32
+
+/**
+ * @def OPTION_BENCH_SAVE
+ * @brief The option that saves the results as a baseline JSON file.
+ */
+#define OPTION_BENCH_SAVE "--save"
+
+/**
+ * @def OPTION_BENCH_BASELINE
+ * @brief The option that compares the results with a baseline JSON file.
+ */
+#define OPTION_BENCH_BASELINE "--baseline"
+
+/**
+ * @def OPTION_BENCH_SCALING
+ * @brief The option that runs the asymptotic scaling checks instead of the micro-benchmarks.
+ */
+#define OPTION_BENCH_SCALING "--scaling"
+
+/**
+ * @def SCALING_BASE_SIZE
+ * @brief The smallest size N of every stress dimension.
+ */
+#define SCALING_BASE_SIZE 1000
+
+/**
+ * @def SCALING_STEPS
+ * @brief The number of sizes of every stress dimension: N, 2N, 4N, ...
+ */
+#define SCALING_STEPS 4
+
+/**
+ * @def SCALING_MIN_SECONDS
+ * @brief The shortest time a size is run for; small sizes are repeated and averaged.
+ */
+#define SCALING_MIN_SECONDS 0.1
+
+/**
+ * @def SCALING_TOLERANCE
+ * @brief How far the fitted exponent may exceed that of N log N, for timing noise.
+ */
+#define SCALING_TOLERANCE 0.15
+
+/**
+ * @def SCALING_LINES_PER_ELEMENT
+ * @brief The most source lines a generator writes per element, plus one.
+ */
+#define SCALING_LINES_PER_ELEMENT 4
+
+/**
+ * @def SCALING_ASSEMBLER
+ * @brief The assembler binary the scaling checks run, built by `make`.
+ */
+#define SCALING_ASSEMBLER "./assembler"
+
+/**
+ * @def SCALING_DEFAULT_DIRECTORY
+ * @brief The directory of the temporary sources when `TMPDIR` is not set.
+ */
+#define SCALING_DEFAULT_DIRECTORY "/tmp"
+
+/**
+ * @def SCALING_DIRECTORY_TEMPLATE
+ * @brief The `mkdtemp` template of the temporary directory, appended to its parent.
+ */
+#define SCALING_DIRECTORY_TEMPLATE "/microbench-XXXXXX"
+
+/**
+ * @struct bench_state
+ * @brief The tables and counters the benchmarked functions work on.
+ *
+ * - `instable`, `datatable`, `errortable`, `labeltable`: The assembler tables.
+ * - `macros`: A list of `BENCH_MACROS` macros.
+ * - `ic`, `dc`, `ec`, `lac`, `cl`: The counters; `ic` and `dc` restart at zero on every call.
+ * - `isize`, `dsize`, `esize`, `lasize`: The sizes of the tables.
+ * - `sink`: Receives every result, so no call can be optimized away.
+ */
+struct bench_state
+{
+	struct instructionsMemory *instable;
+	struct dataMemory *datatable;
+	struct error *errortable;
+	struct labelMemory *labeltable;
+	MacroDefinition *macros;
+	int ic, dc, ec, lac, cl;
+	int isize, dsize, esize, lasize;
+	volatile long sink;
+};
+
+/**
+ * @struct bench_case
+ * @brief A benchmark.
+ *
+ * - `name`: The name of the benchmarked function.
+ * - `run`: Calls the function `iterations` times; returns 1, or EXIT on a memory error.
+ */
+struct bench_case
+{
+	const char *name;
+	int (*run)(struct bench_state *state, long iterations);
+};
+
+/**
+ * @struct bench_result
+ * @brief The timing of a benchmark.
+ *
+ * - `median`: The median time per call, in nanoseconds.
+ * - `mad`: The median absolute deviation of the time per call, in nanoseconds.
+ * - `best`: The fastest batch, per call, in nanoseconds.
+ * - `iterations`: The number of calls in a batch.
+ */
+struct bench_result
+{
+	double median;
+	double mad;
+	double best;
+	long iterations;
+};
+
+/**
+ * @struct scaling_case
+ * @brief A stress dimension of the scaling checks.
+ *
+ * - `name`: The name of the dimension.
+ * - `generate`: Writes a source of `n` elements into `lines`, which has room
+ *   for `SCALING_LINES_PER_ELEMENT * n` lines, and sets `count`; returns 1, or
+ *   EXIT on a memory error.
+ */
+struct scaling_case
+{
+	const char *name;
+	int (*generate)(int n, char **lines, int *count);
+};
+
+/**
+ * @brief The benchmarks, ending with an entry whose name is NULL.
+ */
+extern const struct bench_case BENCH_CASES[];
+
+/**
+ * @brief The stress dimensions, ending with an entry whose name is NULL.
+ */
+extern const struct scaling_case SCALING_CASES[];
+
+/**
+ * @brief Times `which_type` on mnemonics, directives and an unknown word.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_which_type(struct bench_state *state, long iterations);
+
+/**
+ * @brief Times `which_type_operand` on every addressing mode.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_which_type_operand(struct bench_state *state, long iterations);
+
+/**
+ * @brief Times `valid_label` on new labels checked against the full label table.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_valid_label(struct bench_state *state, long iterations);
+
+/**
+ * @brief Times `search_label` on labels at the start, middle and end of the table and a missing one.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_search_label(struct bench_state *state, long iterations);
+
+/**
+ * @brief Times `find_macro_definition` on macros along the list and a missing one.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1.
+ */
+int bench_find_macro_definition(struct bench_state *state, long iterations);
+
+/**
+ * @brief Times `int_to_special_base4` on positive and negative words.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_int_to_special_base4(struct bench_state *state, long iterations);
+
+/**
+ * @brief Times `data_update` on `.data` operand lists.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_data_update(struct bench_state *state, long iterations);
+
+/**
+ * @brief Times `instruction` on lines with every operand count and addressing mode.
+ * @param state A pointer to the benchmark state.
+ * @param iterations The number of calls.
+ * @return 1, or EXIT on a memory error.
+ */
+int bench_instruction(struct bench_state *state, long iterations);
+
+/**
+ * @brief Allocates the tables and fills the label table and macro list.
+ * @param state A pointer to the benchmark state.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int bench_setup(struct bench_state *state);
+
+/**
+ * @brief Frees the tables and the macro list.
+ * @param state A pointer to the benchmark state.
+ */
+void bench_teardown(struct bench_state *state);
+
+/**
+ * @brief Orders numbers (a `qsort` comparator).
+ * @param a A pointer to the first number.
+ * @param b A pointer to the second number.
+ * @return A negative, zero or positive value.
+ */
+int compare_doubles(const void *a, const void *b);
+
+/**
+ * @brief Calibrates, warms up and times a benchmark.
+ * @param bench The benchmark.
+ * @param state A pointer to the benchmark state.
+ * @param result Receives the timing.
+ * @return 1 on success, or EXIT on a memory error.
+ */
+int run_benchmark(const struct bench_case *bench, struct bench_state *state, struct bench_result *result);
+
+/**
+ * @brief Looks a benchmark up in a baseline JSON file.
+ * @param lines The lines of the baseline file, one benchmark per line as `--save` writes them.
+ * @param count The number of lines.
+ * @param name The name of the benchmark.
+ * @param value Receives the baseline time per call, in nanoseconds.
+ * @return 1 if the benchmark is in the baseline, 0 otherwise.
+ */
+int find_baseline(char **lines, int count, const char *name, double *value);
+
+/**
+ * @brief Appends a generated source line.
+ * @param lines The lines.
+ * @param count A pointer to the number of lines, incremented.
+ * @param text The line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_scaling_line(char **lines, int *count, const char *text);
+
+/**
+ * @brief Generates `n` labeled instructions, each defining a new label.
+ * @param n The number of labels.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_labels(int n, char **lines, int *count);
+
+/**
+ * @brief Generates `n` instructions that refer to a fixed set of labels.
+ * @param n The number of references.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_references(int n, char **lines, int *count);
+
+/**
+ * @brief Generates `n` macro definitions, each invoked once.
+ * @param n The number of macros.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_macros(int n, char **lines, int *count);
+
+/**
+ * @brief Generates `n` invocations of one macro.
+ * @param n The number of invocations.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_invocations(int n, char **lines, int *count);
+
+/**
+ * @brief Generates `.data` lines holding `n` values in total.
+ * @param n The number of values.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_data(int n, char **lines, int *count);
+
+/**
+ * @brief Generates `n` lines that are each reported as an error.
+ * @param n The number of errors.
+ * @param lines Receives the lines.
+ * @param count Receives the number of lines.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int scaling_errors(int n, char **lines, int *count);
+
+/**
+ * @brief Writes generated source lines to the `.as` file of a base name.
+ * @param base The base name of the source.
+ * @param lines The source lines.
+ * @param count The number of lines.
+ * @return 1 on success, or EXIT if the file cannot be written.
+ */
+int write_scaling_source(const char *base, char **lines, int count);
+
+/**
+ * @brief Assembles a source with the real assembler binary, in a process of its own.
+ * @param base The base name of the source.
+ * @return 1 on success, or EXIT if the assembler cannot be run.
+ */
+int run_scaling_input(const char *base);
+
+/**
+ * @brief Times a source, repeating it until `SCALING_MIN_SECONDS` have passed.
+ * @param base The base name of the source.
+ * @param seconds Receives the time of one run.
+ * @return 1 on success, or EXIT if the assembler cannot be run.
+ */
+int time_scaling_input(const char *base, double *seconds);
+
+/**
+ * @brief Removes the source and output files of a base name, and their directory.
+ * @param directory The temporary directory.
+ * @param base The base name of the source, in the directory.
+ */
+void remove_scaling_files(const char *directory, const char *base);
+
+/**
+ * @brief Fits the exponent `k` of `time = c * size^k` by least squares on a log-log scale.
+ * @param sizes The sizes.
+ * @param times The times.
+ * @param count The number of points.
+ * @return The exponent.
+ */
+double fit_growth_exponent(const double *sizes, const double *times, int count);
+
+/**
+ * @brief Runs every stress dimension and reports its growth exponent.
+ * @return 1 if every dimension scales as N log N or better, 0 if one does not, or EXIT on an error.
+ */
+int run_scaling_checks(void);
+
+#endif /* MICROBENCH_H */
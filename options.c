@@ -0,0 +1,179 @@
+#include "options.h"
+
+/**
+ * @brief Parses the command-line arguments into an options structure.
+ *
+ * Every argument that starts with a dash is matched against the known options;
+ * options that take a value consume the argument after them. All other arguments are collected, in order, as source file base names. The
+ * file name and define arrays point into `argv` and do not copy the strings.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv The command-line arguments.
+ * @param opts A pointer to the options structure to fill.
+ * @return 1 on success, or EXIT on an unknown option, a missing option value or a memory allocation failure.
+ */
+int parse_options(int argc, char *argv[], struct options *opts)
+{
+	int i;
+	memset(opts, 0, sizeof(struct options));
+	opts->files = (char **)malloc((argc > 1 ? argc : 1) * sizeof(char *));
+	opts->defines = (char **)malloc((argc > 1 ? argc : 1) * sizeof(char *));
+	if(opts->files == NULL || opts->defines == NULL)
+	{
+		free_options(opts);
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	for(i = 1; i < argc; i++)
+	{
+		if(argv[i][0] != '-')
+		{
+			opts->files[opts->num_files] = argv[i];
+			opts->num_files++;
+		}
+		else if(strcmp(argv[i], OPTION_LSP) == 0)
+		{
+			opts->lsp = 1;
+		}
+		else if(strcmp(argv[i], OPTION_DEPS) == 0)
+		{
+			opts->deps = 1;
+		}
+		else if(strcmp(argv[i], OPTION_SIZE_REPORT) == 0)
+		{
+			opts->size_report = 1;
+		}
+		else if(strcmp(argv[i], OPTION_PERF_COUNTERS) == 0)
+		{
+			opts->perf_counters = 1;
+		}
+		else if(strcmp(argv[i], OPTION_DEBUG_INFO) == 0)
+		{
+			opts->debug_info = 1;
+		}
+		else if(strcmp(argv[i], OPTION_XREF) == 0)
+		{
+			opts->xref = 1;
+		}
+		else if(strcmp(argv[i], OPTION_RELOCS) == 0)
+		{
+			opts->relocs = 1;
+		}
+		else if(strcmp(argv[i], OPTION_CHECK) == 0)
+		{
+			opts->check = 1;
+		}
+		else if(strcmp(argv[i], OPTION_DEDUPE) == 0)
+		{
+			opts->dedupe = 1;
+		}
+		else if(strncmp(argv[i], OPTION_DEFINE, strlen(OPTION_DEFINE)) == 0)
+		{
+			/* The name may be attached, `-DNAME`, or the next argument, `-D NAME`. */
+			if(argv[i][strlen(OPTION_DEFINE)] != '\0')
+			{
+				opts->defines[opts->num_defines] = argv[i] + strlen(OPTION_DEFINE);
+			}
+			else if(i + 1 < argc)
+			{
+				opts->defines[opts->num_defines] = argv[++i];
+			}
+			else
+			{
+				fprintf(stdout, "missing value for option: %s\n", argv[i]);
+				free_options(opts);
+				return EXIT;
+			}
+			opts->num_defines++;
+		}
+		else if(strcmp(argv[i], OPTION_PRECOMPILE_MACROS) == 0 || strcmp(argv[i], OPTION_OUTPUT) == 0 || strcmp(argv[i], OPTION_MACROS) == 0 || strcmp(argv[i], OPTION_FORMAT) == 0 || strcmp(argv[i], OPTION_DELTA_FROM) == 0 || strcmp(argv[i], OPTION_STABLE_LAYOUT) == 0 || strcmp(argv[i], OPTION_TRACE) == 0 || strcmp(argv[i], OPTION_MANIFEST) == 0 || strcmp(argv[i], OPTION_ADDR2LINE) == 0 || strcmp(argv[i], OPTION_XREF_QUERY) == 0 || strcmp(argv[i], OPTION_REBASE) == 0 || strcmp(argv[i], OPTION_METRICS) == 0 || strcmp(argv[i], OPTION_MEMORY_BUDGET) == 0 || strcmp(argv[i], OPTION_DEDUPE_STORE) == 0)
+		{
+			if(i + 1 >= argc)
+			{
+				fprintf(stdout, "missing value for option: %s\n", argv[i]);
+				free_options(opts);
+				return EXIT;
+			}
+			if(strcmp(argv[i], OPTION_PRECOMPILE_MACROS) == 0)
+			{
+				opts->precompile = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_OUTPUT) == 0)
+			{
+				opts->output = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_MACROS) == 0)
+			{
+				opts->macros = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_FORMAT) == 0)
+			{
+				opts->format = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_DELTA_FROM) == 0)
+			{
+				opts->delta_from = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_STABLE_LAYOUT) == 0)
+			{
+				opts->stable_layout = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_TRACE) == 0)
+			{
+				opts->trace = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_MANIFEST) == 0)
+			{
+				opts->manifest = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_ADDR2LINE) == 0)
+			{
+				opts->addr2line = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_XREF_QUERY) == 0)
+			{
+				opts->xref_query = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_METRICS) == 0)
+			{
+				opts->metrics = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_MEMORY_BUDGET) == 0)
+			{
+				opts->memory_budget = argv[i + 1];
+			}
+			else if(strcmp(argv[i], OPTION_DEDUPE_STORE) == 0)
+			{
+				opts->dedupe_store = argv[i + 1];
+				opts->dedupe = 1;
+			}
+			else
+			{
+				opts->rebase = argv[i + 1];
+			}
+			i++;
+		}
+		else
+		{
+			fprintf(stdout, "unknown option: %s\n", argv[i]);
+			free_options(opts);
+			return EXIT;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Frees the memory held by an options structure.
+ *
+ * @param opts A pointer to the options structure.
+ */
+void free_options(struct options *opts)
+{
+	free(opts->files);
+	opts->files = NULL;
+	opts->num_files = 0;
+	free(opts->defines);
+	opts->defines = NULL;
+	opts->num_defines = 0;
+}
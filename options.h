@@ -0,0 +1,241 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+/**
+ * @file options.h
+ * @brief This header file declares the command-line options of the assembler.
+ *
+ * Arguments that start with a dash are options; every other argument is the
+ * base name of a source file (without the `.as` suffix). The parsed options
+ * are collected in a single structure that `main` consults while it drives
+ * the assembly of each file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assembler.h"
+
+/**
+ * @def OPTION_LSP
+ * @brief The option that runs the assembler as a language server on stdin/stdout.
+ */
+#define OPTION_LSP "--lsp"
+
+/**
+ * @def OPTION_DEPS
+ * @brief The option that writes a make dependency (`.d`) file for every assembled source.
+ */
+#define OPTION_DEPS "--deps"
+
+/**
+ * @def OPTION_PRECOMPILE_MACROS
+ * @brief The option that precompiles the macros of a library source instead of assembling files.
+ */
+#define OPTION_PRECOMPILE_MACROS "--precompile-macros"
+
+/**
+ * @def OPTION_OUTPUT
+ * @brief The option that names the file written by `--precompile-macros`.
+ */
+#define OPTION_OUTPUT "-o"
+
+/**
+ * @def OPTION_MACROS
+ * @brief The option that makes the macros of a precompiled library available to every file.
+ */
+#define OPTION_MACROS "--macros"
+
+/**
+ * @def OPTION_FORMAT
+ * @brief The option that chooses the object file format (see `EMITTERS`).
+ */
+#define OPTION_FORMAT "--format"
+
+/**
+ * @def OPTION_DELTA_FROM
+ * @brief The option that writes a `.delta` file against the build in a directory.
+ */
+#define OPTION_DELTA_FROM "--delta-from"
+
+/**
+ * @def OPTION_STABLE_LAYOUT
+ * @brief The option that keeps blocks at the addresses of the build in a directory and writes `.map` files.
+ */
+#define OPTION_STABLE_LAYOUT "--stable-layout"
+
+/**
+ * @def OPTION_SIZE_REPORT
+ * @brief The option that writes a `.size` report attributing every word to its source line, label and macro.
+ */
+#define OPTION_SIZE_REPORT "--size-report"
+
+/**
+ * @def OPTION_PERF_COUNTERS
+ * @brief The option that reports the time and hardware counters of every assembly phase.
+ */
+#define OPTION_PERF_COUNTERS "--perf-counters"
+
+/**
+ * @def OPTION_TRACE
+ * @brief The option that writes a Chrome trace-event timeline of the run to a file.
+ */
+#define OPTION_TRACE "--trace"
+
+/**
+ * @def OPTION_MANIFEST
+ * @brief The option that writes the hash, size and name of every output file of the run.
+ */
+#define OPTION_MANIFEST "--manifest"
+
+/**
+ * @def OPTION_DEBUG_INFO
+ * @brief The option that writes a `.dbg` address-to-source line table next to every object file.
+ */
+#define OPTION_DEBUG_INFO "--debug-info"
+
+/**
+ * @def OPTION_ADDR2LINE
+ * @brief The option that looks the addresses given on the command line up in a `.dbg` file.
+ */
+#define OPTION_ADDR2LINE "--addr2line"
+
+/**
+ * @def OPTION_XREF
+ * @brief The option that writes a `.xref` symbol cross-reference table next to every object file.
+ */
+#define OPTION_XREF "--xref"
+
+/**
+ * @def OPTION_XREF_QUERY
+ * @brief The option that looks the symbols given on the command line up in a `.xref` file.
+ */
+#define OPTION_XREF_QUERY "--xref-query"
+
+/**
+ * @def OPTION_RELOCS
+ * @brief The option that writes a `.rel` list of relocatable words next to every object file.
+ */
+#define OPTION_RELOCS "--relocs"
+
+/**
+ * @def OPTION_REBASE
+ * @brief The option that moves finished object files to another load address using their `.rel` files.
+ */
+#define OPTION_REBASE "--rebase"
+
+/**
+ * @def OPTION_CHECK
+ * @brief The option that only reports the errors of every file, without encoding or writing anything.
+ */
+#define OPTION_CHECK "--check"
+
+/**
+ * @def OPTION_DEFINE
+ * @brief The option that defines a symbol for `.ifdef`, as `-D NAME` or `-DNAME`.
+ */
+#define OPTION_DEFINE "-D"
+
+/**
+ * @def OPTION_METRICS
+ * @brief Option that keeps a Prometheus status file of the run's progress.
+ */
+#define OPTION_METRICS "--metrics"
+
+/**
+ * @def OPTION_MEMORY_BUDGET
+ * @brief Option that spills line storage and tables beyond a size to temporary files.
+ */
+#define OPTION_MEMORY_BUDGET "--memory-budget"
+
+/**
+ * @def OPTION_DEDUPE
+ * @brief Option that hard-links identical object, entry and external images instead of writing them again.
+ */
+#define OPTION_DEDUPE "--dedupe"
+
+/**
+ * @def OPTION_DEDUPE_STORE
+ * @brief Option that also shares identical images with other runs through a store directory.
+ */
+#define OPTION_DEDUPE_STORE "--dedupe-store"
+
+/**
+ * @struct options
+ * @brief A structure holding the parsed command-line options.
+ *
+ * - `lsp`: Non-zero when the assembler should run as a language server.
+ * - `deps`: Non-zero when a `.d` file listing the included files should be written.
+ * - `size_report`: Non-zero when a `.size` report and its treemap JSON should be written.
+ * - `perf_counters`: Non-zero when the time and hardware counters of every phase should be reported.
+ * - `debug_info`: Non-zero when a `.dbg` line table should be written next to every object file.
+ * - `xref`: Non-zero when a `.xref` cross-reference table should be written next to every object file.
+ * - `relocs`: Non-zero when a `.rel` list of relocatable words should be written next to every object file.
+ * - `check`: Non-zero when the files should only be checked for errors, with no output files.
+ * - `dedupe`: Non-zero when identical images should be hard-linked instead of written again.
+ * - `precompile`: The macro library source to precompile, or NULL.
+ * - `output`: The name of the precompiled library to write, or NULL for the default.
+ * - `macros`: The precompiled macro library to load, or NULL.
+ * - `format`: The name of the object file format, or NULL for the default.
+ * - `delta_from`: The directory of the previous build to write `.delta` files against, or NULL.
+ * - `stable_layout`: The directory of the previous build whose block addresses are kept, or NULL.
+ * - `trace`: The name of the trace-event file to write, or NULL.
+ * - `manifest`: The name of the output manifest to write, or NULL.
+ * - `addr2line`: The `.dbg` file to look addresses up in, or NULL.
+ * - `xref_query`: The `.xref` file to look symbols up in, or NULL.
+ * - `rebase`: The load address to move the object files of the given base names to, or NULL.
+ * - `metrics`: The name of the Prometheus status file to keep up to date, or NULL.
+ * - `memory_budget`: The memory budget of line storage and tables, with an optional K, M or G suffix, or NULL.
+ * - `dedupe_store`: The store directory of deduplicated images shared between runs, or NULL.
+ * - `files`: The source file base names, in command-line order (the addresses with `addr2line`, the symbols with `xref_query`).
+ * - `num_files`: The number of source file base names.
+ * - `defines`: The symbols defined with `-D`, for conditional assembly.
+ * - `num_defines`: The number of defined symbols.
+ */
+struct options
+{
+	int lsp;
+	int deps;
+	int size_report;
+	int perf_counters;
+	int debug_info;
+	int xref;
+	int relocs;
+	int check;
+	int dedupe;
+	char *precompile;
+	char *output;
+	char *macros;
+	char *format;
+	char *delta_from;
+	char *stable_layout;
+	char *trace;
+	char *manifest;
+	char *addr2line;
+	char *xref_query;
+	char *rebase;
+	char *metrics;
+	char *memory_budget;
+	char *dedupe_store;
+	char **files;
+	int num_files;
+	char **defines;
+	int num_defines;
+};
+
+/**
+ * @brief Parses the command-line arguments into an options structure.
+ * @param argc The number of command-line arguments.
+ * @param argv The command-line arguments.
+ * @param opts A pointer to the options structure to fill.
+ * @return 1 on success, or EXIT on an unknown option, a missing option value or a memory allocation failure.
+ */
+int parse_options(int argc, char *argv[], struct options *opts);
+
+/**
+ * @brief Frees the memory held by an options structure.
+ * @param opts A pointer to the options structure.
+ */
+void free_options(struct options *opts);
+
+#endif /* OPTIONS_H */
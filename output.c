@@ -0,0 +1,239 @@
+#include "output.h"
+
+/**
+ * @brief Builds the name an output file is written under before it is committed.
+ * @param name The name of the output file.
+ * @return A dynamically allocated name, or NULL on a memory allocation failure.
+ */
+char *output_temp_name(const char *name)
+{
+	char *temp = (char *)malloc(strlen(name) + sizeof(OUTPUT_TEMP_SUFFIX));
+	if(temp == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return NULL;
+	}
+	strcpy(temp, name);
+	strcat(temp, OUTPUT_TEMP_SUFFIX);
+	return temp;
+}
+
+/**
+ * @brief Opens an output file for writing under its temporary name.
+ *
+ * The writer fills the file as usual, closes it, and then calls
+ * `commit_output`, or `discard_output` if it failed.
+ *
+ * @param name The name of the output file.
+ * @param mode The `fopen` mode.
+ * @return The open file, or NULL on an error.
+ */
+FILE *open_output(const char *name, const char *mode)
+{
+	FILE *fileptr;
+	char *temp = output_temp_name(name);
+	if(temp == NULL)
+	{
+		return NULL;
+	}
+	fileptr = fopen(temp, mode);
+	free(temp);
+	return fileptr;
+}
+
+/**
+ * @brief Compares the contents of two files.
+ *
+ * The files are read in blocks and compared block by block, so the comparison
+ * stops at the first difference.
+ *
+ * @param first The name of the first file.
+ * @param second The name of the second file.
+ * @return 1 if both exist and hold the same bytes, 0 otherwise.
+ */
+int same_file_contents(const char *first, const char *second)
+{
+	FILE *a = NULL, *b = NULL;
+	char block_a[BUFSIZ], block_b[BUFSIZ];
+	size_t len_a, len_b;
+	int same = 0;
+	a = fopen(first, "rb");
+	b = fopen(second, "rb");
+	if(a == NULL || b == NULL){goto clean;}
+	for(;;)
+	{
+		len_a = fread(block_a, 1, sizeof(block_a), a);
+		len_b = fread(block_b, 1, sizeof(block_b), b);
+		if(len_a != len_b || memcmp(block_a, block_b, len_a) != 0){goto clean;}
+		if(len_a == 0){break;}
+	}
+	same = 1;
+
+	clean:
+		if(a != NULL)fclose(a);
+		if(b != NULL)fclose(b);
+		return same;
+}
+
+/**
+ * @brief Replaces an output file with its new copy, unless the bytes are the same.
+ *
+ * An unchanged file is left alone, with its modification time; its new copy
+ * is removed. A changed file is replaced by renaming the new copy over it.
+ *
+ * @param name The name of the output file, closed after `open_output`.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or EXIT on a file or memory error.
+ */
+int commit_output(const char *name)
+{
+	int status = OUTPUT_CHANGED;
+	char *temp = output_temp_name(name);
+	if(temp == NULL)
+	{
+		return EXIT;
+	}
+	if(same_file_contents(temp, name))
+	{
+		remove(temp);
+		status = OUTPUT_UNCHANGED;
+	}
+	else if(rename(temp, name) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		remove(temp);
+		status = EXIT;
+	}
+	free(temp);
+	return status;
+}
+
+/**
+ * @brief Removes the new copy of an output file that could not be written.
+ * @param name The name of the output file.
+ */
+void discard_output(const char *name)
+{
+	char *temp = output_temp_name(name);
+	if(temp != NULL)
+	{
+		remove(temp);
+		free(temp);
+	}
+}
+
+/**
+ * @brief Computes the FNV-1a hash and the size of a file.
+ * @param name The name of the file.
+ * @param hash Receives the hash.
+ * @param size Receives the size in bytes.
+ * @return 1 on success, or EXIT if the file cannot be read.
+ */
+int hash_file(const char *name, unsigned long *hash, long *size)
+{
+	unsigned char block[BUFSIZ];
+	size_t len, i;
+	FILE *fileptr = fopen(name, "rb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		return EXIT;
+	}
+	*hash = FNV_OFFSET_BASIS;
+	*size = 0;
+	while((len = fread(block, 1, sizeof(block), fileptr)) > 0)
+	{
+		for(i = 0; i < len; i++)
+		{
+			*hash ^= block[i];
+			*hash = (*hash * FNV_PRIME) & HASH_MASK;
+		}
+		*size += (long)len;
+	}
+	fclose(fileptr);
+	return 1;
+}
+
+/**
+ * @brief Adds an output file to the manifest.
+ *
+ * The file is hashed as it is on disk, whether it was just replaced or kept.
+ *
+ * @param manifest A pointer to the manifest.
+ * @param name The name of the file, which has been written.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int add_output_record(struct output_manifest *manifest, const char *name)
+{
+	struct output_record *record, *temp;
+	if(manifest->count == manifest->capacity)
+	{
+		temp = (struct output_record *)realloc(manifest->records, (manifest->capacity + MAX_SIZE_MEMORY) * sizeof(struct output_record));
+		if(temp == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		manifest->records = temp;
+		manifest->capacity += MAX_SIZE_MEMORY;
+	}
+	record = &manifest->records[manifest->count];
+	if(hash_file(name, &record->hash, &record->size) == EXIT)
+	{
+		return EXIT;
+	}
+	record->name = (char *)malloc(strlen(name) + 1);
+	if(record->name == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	strcpy(record->name, name);
+	manifest->count++;
+	return 1;
+}
+
+/**
+ * @brief Writes the manifest, if it changed.
+ * @param name The name of the manifest file.
+ * @param manifest A pointer to the manifest.
+ * @return 1 on success, or EXIT on a file error.
+ */
+int print_manifest(const char *name, const struct output_manifest *manifest)
+{
+	FILE *fileptr;
+	int i;
+	fileptr = open_output(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		return EXIT;
+	}
+	for(i = 0; i < manifest->count; i++)
+	{
+		fprintf(fileptr, "%08lx\t%ld\t%s\n", manifest->records[i].hash, manifest->records[i].size, manifest->records[i].name);
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(name);
+		return EXIT;
+	}
+	return (commit_output(name) == EXIT) ? EXIT : 1;
+}
+
+/**
+ * @brief Frees the records of a manifest.
+ * @param manifest A pointer to the manifest.
+ */
+void free_manifest(struct output_manifest *manifest)
+{
+	int i;
+	for(i = 0; i < manifest->count; i++)
+	{
+		free(manifest->records[i].name);
+	}
+	free(manifest->records);
+	manifest->records = NULL;
+	manifest->count = 0;
+	manifest->capacity = 0;
+}
@@ -0,0 +1,142 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/**
+ * @file output.h
+ * @brief This header file declares write-if-changed output files and the output manifest.
+ *
+ * Every output file is first written next to its final name, with the
+ * `OUTPUT_TEMP_SUFFIX` suffix added, and then compared with the file it
+ * replaces. If the bytes are the same, the new copy is removed and the old
+ * file keeps its modification time, so build tools that watch it do not
+ * rebuild anything. Otherwise the new copy is renamed over the old file.
+ *
+ * With `--manifest FILE`, the run also writes one line per output file it
+ * produced: the 32-bit FNV-1a hash of its bytes in hexadecimal, its size and
+ * its name, separated by tabs. The manifest is itself written only if it
+ * changed, so a build system can compare it, or its time stamp, to skip the
+ * steps that depend on the outputs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "assembler.h"
+
+/**
+ * @def OUTPUT_TEMP_SUFFIX
+ * @brief Suffix of an output file while it is being written.
+ */
+#define OUTPUT_TEMP_SUFFIX ".new"
+
+/**
+ * @def OUTPUT_CHANGED
+ * @brief `commit_output` replaced the file.
+ */
+#define OUTPUT_CHANGED 1
+
+/**
+ * @def OUTPUT_UNCHANGED
+ * @brief `commit_output` kept the file, whose bytes were the same.
+ */
+#define OUTPUT_UNCHANGED 2
+
+/**
+ * @struct output_record
+ * @brief An output file listed in the manifest.
+ *
+ * - `name`: The name of the file.
+ * - `hash`: The FNV-1a hash of its bytes.
+ * - `size`: Its size in bytes.
+ */
+struct output_record
+{
+	char *name;
+	unsigned long hash;
+	long size;
+};
+
+/**
+ * @struct output_manifest
+ * @brief The output files of a run.
+ *
+ * - `records`: The files, in the order they were written.
+ * - `count`: The number of files.
+ * - `capacity`: The allocated number of records.
+ */
+struct output_manifest
+{
+	struct output_record *records;
+	int count;
+	int capacity;
+};
+
+/**
+ * @brief Builds the name an output file is written under before it is committed.
+ * @param name The name of the output file.
+ * @return A dynamically allocated name, or NULL on a memory allocation failure.
+ */
+char *output_temp_name(const char *name);
+
+/**
+ * @brief Opens an output file for writing under its temporary name.
+ * @param name The name of the output file.
+ * @param mode The `fopen` mode.
+ * @return The open file, or NULL on an error.
+ */
+FILE *open_output(const char *name, const char *mode);
+
+/**
+ * @brief Compares the contents of two files.
+ * @param first The name of the first file.
+ * @param second The name of the second file.
+ * @return 1 if both exist and hold the same bytes, 0 otherwise.
+ */
+int same_file_contents(const char *first, const char *second);
+
+/**
+ * @brief Replaces an output file with its new copy, unless the bytes are the same.
+ * @param name The name of the output file, closed after `open_output`.
+ * @return `OUTPUT_CHANGED`, `OUTPUT_UNCHANGED`, or EXIT on a file or memory error.
+ */
+int commit_output(const char *name);
+
+/**
+ * @brief Removes the new copy of an output file that could not be written.
+ * @param name The name of the output file.
+ */
+void discard_output(const char *name);
+
+/**
+ * @brief Computes the FNV-1a hash and the size of a file.
+ * @param name The name of the file.
+ * @param hash Receives the hash.
+ * @param size Receives the size in bytes.
+ * @return 1 on success, or EXIT if the file cannot be read.
+ */
+int hash_file(const char *name, unsigned long *hash, long *size);
+
+/**
+ * @brief Adds an output file to the manifest.
+ * @param manifest A pointer to the manifest.
+ * @param name The name of the file, which has been written.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int add_output_record(struct output_manifest *manifest, const char *name);
+
+/**
+ * @brief Writes the manifest, if it changed.
+ * @param name The name of the manifest file.
+ * @param manifest A pointer to the manifest.
+ * @return 1 on success, or EXIT on a file error.
+ */
+int print_manifest(const char *name, const struct output_manifest *manifest);
+
+/**
+ * @brief Frees the records of a manifest.
+ * @param manifest A pointer to the manifest.
+ */
+void free_manifest(struct output_manifest *manifest);
+
+#endif /* OUTPUT_H */
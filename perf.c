@@ -0,0 +1,205 @@
+#define _DEFAULT_SOURCE
+
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "perf.h"
+
+const char *PERF_PHASE_NAMES[] = {"pre-assemble", "first pass", "second pass", "output"};
+
+/**
+ * @brief Opens every hardware counter that is available.
+ *
+ * The counters are opened one by one rather than as a group, so a machine
+ * that lacks one of them still reports the others. They count the user-space
+ * work of this process only, which is also what an unprivileged process is
+ * allowed to count.
+ *
+ * @param perf A pointer to the counters to initialize.
+ * @return The number of counters that were opened.
+ */
+int perf_open(struct perf_counters *perf)
+{
+	int i, opened = 0;
+#ifdef __linux__
+	const unsigned long configs[PERF_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+	struct perf_event_attr attr;
+#endif
+	memset(perf, 0, sizeof(*perf));
+	for(i = 0; i < PERF_EVENTS; i++)
+	{
+		perf->fds[i] = PERF_NO_COUNTER;
+#ifdef __linux__
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = configs[i];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		perf->fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		if(perf->fds[i] < 0)
+		{
+			perf->fds[i] = PERF_NO_COUNTER;
+		}
+		else
+		{
+			opened++;
+		}
+#endif
+	}
+	return opened;
+}
+
+/**
+ * @brief Reads a monotonic wall clock.
+ * @return The time in seconds.
+ */
+double perf_wall_clock(void)
+{
+	struct timespec now;
+	if(clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+	{
+		return 0;
+	}
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Reads a counter, scaled for the time it was multiplexed out.
+ *
+ * When more counters are open than the PMU has registers, the kernel rotates
+ * them, and each one only counts part of the time. The value is scaled up by
+ * the time the counter was enabled over the time it actually ran.
+ *
+ * @param fd The descriptor of the counter.
+ * @return The value, or a negative value if the counter cannot be read.
+ */
+double perf_read_counter(int fd)
+{
+#ifdef __linux__
+	__u64 values[3];
+	if(fd == PERF_NO_COUNTER || read(fd, values, sizeof(values)) != (ssize_t)sizeof(values))
+	{
+		return -1;
+	}
+	if(values[2] == 0)
+	{
+		return 0;
+	}
+	return (double)values[0] * ((double)values[1] / (double)values[2]);
+#else
+	return -1;
+#endif
+}
+
+/**
+ * @brief Starts measuring a phase.
+ * @param perf A pointer to the counters.
+ */
+void perf_begin(struct perf_counters *perf)
+{
+	int i;
+	for(i = 0; i < PERF_EVENTS; i++)
+	{
+		perf->start[i] = perf_read_counter(perf->fds[i]);
+	}
+	perf->start_time = perf_wall_clock();
+}
+
+/**
+ * @brief Stops measuring a phase and adds it to the phase totals.
+ *
+ * The clock is read before the counters, the reverse of `perf_begin`, so the
+ * reads themselves stay out of the measured time.
+ *
+ * @param perf A pointer to the counters.
+ * @param phase The phase that was measured.
+ */
+void perf_end(struct perf_counters *perf, int phase)
+{
+	int i;
+	double value;
+	perf->seconds[phase] += perf_wall_clock() - perf->start_time;
+	for(i = 0; i < PERF_EVENTS; i++)
+	{
+		value = perf_read_counter(perf->fds[i]);
+		if(value >= 0 && perf->start[i] >= 0 && value > perf->start[i])
+		{
+			perf->counts[phase][i] += value - perf->start[i];
+		}
+	}
+}
+
+/**
+ * @brief Writes the totals, IPC and miss rates of every phase.
+ *
+ * Misses are given per thousand instructions (MPKI). A column whose counter
+ * could not be opened shows `-`; without any counter only the times are
+ * written.
+ *
+ * @param fileptr The file to write to.
+ * @param perf A pointer to the counters.
+ */
+void print_perf_report(FILE *fileptr, const struct perf_counters *perf)
+{
+	int i, phase, counted = 0;
+	const double *counts;
+	for(i = 0; i < PERF_EVENTS; i++)
+	{
+		if(perf->fds[i] != PERF_NO_COUNTER){counted = 1;}
+	}
+	fprintf(fileptr, "%-13s %12s", "phase", "seconds");
+	if(counted)
+	{
+		fprintf(fileptr, " %14s %14s %6s %12s %11s", "cycles", "instructions", "IPC", "branch-MPKI", "cache-MPKI");
+	}
+	fprintf(fileptr, "\n");
+	for(phase = 0; phase < PERF_PHASES; phase++)
+	{
+		counts = perf->counts[phase];
+		fprintf(fileptr, "%-13s %12.6f", PERF_PHASE_NAMES[phase], perf->seconds[phase]);
+		if(counted)
+		{
+			for(i = PERF_CYCLES; i <= PERF_INSTRUCTIONS; i++)
+			{
+				if(perf->fds[i] != PERF_NO_COUNTER){fprintf(fileptr, " %14.0f", counts[i]);}
+				else{fprintf(fileptr, " %14s", "-");}
+			}
+			if(perf->fds[PERF_CYCLES] != PERF_NO_COUNTER && perf->fds[PERF_INSTRUCTIONS] != PERF_NO_COUNTER && counts[PERF_CYCLES] > 0)
+			{
+				fprintf(fileptr, " %6.2f", counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES]);
+			}
+			else{fprintf(fileptr, " %6s", "-");}
+			for(i = PERF_BRANCH_MISSES; i <= PERF_CACHE_MISSES; i++)
+			{
+				if(perf->fds[i] != PERF_NO_COUNTER && perf->fds[PERF_INSTRUCTIONS] != PERF_NO_COUNTER && counts[PERF_INSTRUCTIONS] > 0)
+				{
+					fprintf(fileptr, (i == PERF_BRANCH_MISSES) ? " %12.3f" : " %11.3f", counts[i] * 1000 / counts[PERF_INSTRUCTIONS]);
+				}
+				else{fprintf(fileptr, (i == PERF_BRANCH_MISSES) ? " %12s" : " %11s", "-");}
+			}
+		}
+		fprintf(fileptr, "\n");
+	}
+}
+
+/**
+ * @brief Closes every open counter.
+ * @param perf A pointer to the counters.
+ */
+void perf_close(struct perf_counters *perf)
+{
+	int i;
+	for(i = 0; i < PERF_EVENTS; i++)
+	{
+		if(perf->fds[i] != PERF_NO_COUNTER)
+		{
+			close(perf->fds[i]);
+			perf->fds[i] = PERF_NO_COUNTER;
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#ifndef PERF_H
+#define PERF_H
+
+/**
+ * @file perf.h
+ * @brief This header file declares the per-phase hardware performance counters.
+ *
+ * With `--perf-counters` the assembler measures every phase of every file:
+ * the pre-assembly, the first pass, the second pass and the output. Each
+ * phase adds up its wall-clock time and, on Linux, the cycles, instructions,
+ * branch misses and cache misses of the process from `perf_event_open`.
+ * When the run ends, one line per phase reports the totals, the instructions
+ * per cycle and the misses per thousand instructions.
+ *
+ * Counters that cannot be opened (no PMU, a container, a restrictive
+ * `perf_event_paranoid`) are left out quietly, so at worst the report holds
+ * the wall-clock times only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assembler.h"
+
+/**
+ * @def PERF_EVENTS
+ * @brief The number of hardware counters.
+ */
+#define PERF_EVENTS 4
+
+/**
+ * @def PERF_NO_COUNTER
+ * @brief The descriptor of a counter that could not be opened.
+ */
+#define PERF_NO_COUNTER -1
+
+/**
+ * @enum perf_event_id
+ * @brief The hardware counters, in report order.
+ */
+enum perf_event_id {PERF_CYCLES, PERF_INSTRUCTIONS, PERF_BRANCH_MISSES, PERF_CACHE_MISSES};
+
+/**
+ * @enum perf_phase_id
+ * @brief The measured phases of the assembly of a file.
+ */
+enum perf_phase_id {PERF_PRE_ASSEMBLE, PERF_FIRST_PASS, PERF_SECOND_PASS, PERF_OUTPUT, PERF_PHASES};
+
+/**
+ * @brief The names of the phases, indexed by `perf_phase_id`.
+ */
+extern const char *PERF_PHASE_NAMES[];
+
+/**
+ * @struct perf_counters
+ * @brief The open counters and the totals of every phase.
+ *
+ * - `fds`: The descriptor of every counter, or `PERF_NO_COUNTER`.
+ * - `start`: The counter values when the current phase began.
+ * - `start_time`: The wall-clock time when the current phase began, in seconds.
+ * - `counts`: The counter totals of every phase.
+ * - `seconds`: The wall-clock totals of every phase.
+ */
+struct perf_counters
+{
+	int fds[PERF_EVENTS];
+	double start[PERF_EVENTS];
+	double start_time;
+	double counts[PERF_PHASES][PERF_EVENTS];
+	double seconds[PERF_PHASES];
+};
+
+/**
+ * @brief Opens every hardware counter that is available.
+ * @param perf A pointer to the counters to initialize.
+ * @return The number of counters that were opened.
+ */
+int perf_open(struct perf_counters *perf);
+
+/**
+ * @brief Reads a monotonic wall clock.
+ * @return The time in seconds.
+ */
+double perf_wall_clock(void);
+
+/**
+ * @brief Reads a counter, scaled for the time it was multiplexed out.
+ * @param fd The descriptor of the counter.
+ * @return The value, or a negative value if the counter cannot be read.
+ */
+double perf_read_counter(int fd);
+
+/**
+ * @brief Starts measuring a phase.
+ * @param perf A pointer to the counters.
+ */
+void perf_begin(struct perf_counters *perf);
+
+/**
+ * @brief Stops measuring a phase and adds it to the phase totals.
+ * @param perf A pointer to the counters.
+ * @param phase The phase that was measured.
+ */
+void perf_end(struct perf_counters *perf, int phase);
+
+/**
+ * @brief Writes the totals, IPC and miss rates of every phase.
+ * @param fileptr The file to write to.
+ * @param perf A pointer to the counters.
+ */
+void print_perf_report(FILE *fileptr, const struct perf_counters *perf);
+
+/**
+ * @brief Closes every open counter.
+ * @param perf A pointer to the counters.
+ */
+void perf_close(struct perf_counters *perf);
+
+#endif /* PERF_H */
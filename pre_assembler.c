@@ -11,11 +11,17 @@
 const char *RESERVED_WORDS[] =
 {
 	"mov", "cmp", "add", "sub", "not", "clr", "lea", "inc", "dec", "jmp",
-	"bne", "red", "prn", "jsr", "rts", "stop", "data", "string", "mat", "entry", "extern",
-	".data", ".string", ".mat", ".entry", ".extern", "mcro", "mcroend",
+	"bne", "red", "prn", "jsr", "rts", "stop", "data", "string", "mat", "entry", "extern", "incbin",
+	".data", ".string", ".mat", ".entry", ".extern", ".incbin", ".rept", ".endr",
+	".define", ".ifdef", ".ifndef", ".else", ".endif", "mcro", "mcroend",
 	"r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", NULL
 };
 
+MacroIndex MACRO_INDEX;
+
+char **COMMAND_LINE_DEFINES = NULL;
+int NUM_COMMAND_LINE_DEFINES = 0;
+
 /**
  * @brief Duplicates a string on the heap.
  *
@@ -100,7 +106,8 @@ int is_valid_macro_name(const char *name)
  * @brief Adds a new macro definition to the macro list.
  *
  * This function prepends a new `MacroDefinition` node to the head of the
- * linked list of macros.
+ * linked list of macros, and to its bucket of the macro index. A list that is
+ * not the indexed one is indexed first.
  *
  * @param macros_list_head A pointer to the head of the macro list.
  * @param macro_def A pointer to the macro definition to add.
@@ -108,15 +115,49 @@ int is_valid_macro_name(const char *name)
  */
 int add_macro_definition(MacroDefinition **macros_list_head, MacroDefinition *macro_def)
 {
+	MacroDefinition **bucket;
+	if(*macros_list_head != MACRO_INDEX.head)
+	{
+		index_macro_list(*macros_list_head);
+	}
 	macro_def->next = *macros_list_head;
 	*macros_list_head = macro_def;
+	bucket = &MACRO_INDEX.buckets[hash_string(macro_def->name) & (MACRO_INDEX_BUCKETS - 1)];
+	macro_def->bucket_next = *bucket;
+	*bucket = macro_def;
+	MACRO_INDEX.head = macro_def;
 	return 0;
 }
 
+/**
+ * @brief Indexes every macro of a list by name, replacing the previous index.
+ *
+ * Each macro is appended to its bucket, so a bucket keeps the order of the list.
+ *
+ * @param macros_list_head The head of the macros linked list.
+ */
+void index_macro_list(MacroDefinition *macros_list_head)
+{
+	MacroDefinition *current, **link;
+	int i;
+	for(i = 0; i < MACRO_INDEX_BUCKETS; i++)
+	{
+		MACRO_INDEX.buckets[i] = NULL;
+	}
+	for(current = macros_list_head; current != NULL; current = current->next)
+	{
+		for(link = &MACRO_INDEX.buckets[hash_string(current->name) & (MACRO_INDEX_BUCKETS - 1)]; *link != NULL; link = &(*link)->bucket_next);
+		current->bucket_next = NULL;
+		*link = current;
+	}
+	MACRO_INDEX.head = macros_list_head;
+}
+
 /**
  * @brief Finds a macro definition by its name.
  *
- * This function searches the linked list of macros for a macro with a matching name.
+ * This function searches the linked list of macros for a macro with a matching
+ * name, through the macro index when the list is the indexed one.
  *
  * @param macros_list_head The head of the macro list.
  * @param name The name of the macro to find.
@@ -125,6 +166,11 @@ int add_macro_definition(MacroDefinition **macros_list_head, MacroDefinition *ma
 MacroDefinition *find_macro_definition(MacroDefinition *macros_list_head, const char *name)
 {
 	MacroDefinition *current = macros_list_head;
+	if(current != NULL && current == MACRO_INDEX.head)
+	{
+		for(current = MACRO_INDEX.buckets[hash_string(name) & (MACRO_INDEX_BUCKETS - 1)]; current != NULL && strcmp(current->name, name) != 0; current = current->bucket_next);
+		return current;
+	}
 	while (current != NULL)
 	{
 		if (strcmp(current->name, name) == 0)
@@ -158,7 +204,8 @@ int same_name_as_macro(MacroDefinition *macros_list_head, const char *word)
  * @brief Frees all memory allocated for the macro definitions.
  *
  * This function iterates through the macro list and frees all macro
- * definitions and their associated lines, preventing memory leaks.
+ * definitions and their associated lines, preventing memory leaks. The
+ * macro index is emptied if it was built for the list.
  *
  * @param macros_list_head A pointer to the head of the macro list.
  */
@@ -168,6 +215,11 @@ void free_macro_definitions(MacroDefinition **macros_list_head)
 	MacroLine *current_line;
 	MacroLine *temp_line;
 	MacroDefinition *temp_macro;
+	int i;
+	if(current_macro != NULL && current_macro == MACRO_INDEX.head)
+	{
+		index_macro_list(NULL);
+	}
 	while (current_macro != NULL)
 	{
 		current_line = current_macro->head;
@@ -178,6 +230,12 @@ void free_macro_definitions(MacroDefinition **macros_list_head)
 			free(temp_line->content);
 			free(temp_line);
 		}
+		for(i = 0; i < current_macro->flat_count; i++)
+		{
+			free(current_macro->flat[i]);
+		}
+		free(current_macro->flat);
+		free((void *)current_macro->flat_macros);
 		temp_macro = current_macro;
 		current_macro = current_macro->next;
 		free(temp_macro);
@@ -355,365 +413,1374 @@ void print_formatted_line(FILE *fp, const char *label, const char *text)
 	}
 }
 
-
 /**
- * @brief The main function for the pre-assembler pass.
- *
- * This function performs two passes over the input assembly file.
- *
- * **First Pass:**
- * - It reads the input file line by line to identify and store all macro definitions.
- * - It validates macro names and checks for re-definitions or invalid syntax.
- * - Errors are collected in the error table.
+ * @brief Appends a line to the expanded source.
  *
- * **Second Pass:**
- * - If no errors were found in the first pass, it reads the input file again.
- * - It expands any macro calls by replacing the macro name with its stored content.
- * - All other lines are written to the new `.am` output file without changes.
+ * The text is duplicated on the heap and stored together with the source line
+ * number and the name of the macro that produced it. The arrays grow by
+ * doubling when they are full.
  *
- * @param input_filename The name of the input `.as` file.
- * @param errortable_ptr A pointer to the error table.
- * @param ec_ptr A pointer to the error counter.
- * @param esize_ptr A pointer to the size of the error table.
- * @param macros_list_head A pointer to the head of the macro list.
- * @return 0 on successful completion, or EXIT on a critical memory or file error.
+ * @param out A pointer to the expanded source.
+ * @param text The content of the line (without a trailing newline).
+ * @param origin The origin of the line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
  */
-int pre_assemble(const char *input_filename, struct error *errortable_ptr, int *ec_ptr, int *esize_ptr, MacroDefinition **macros_list_head)
+int add_expanded_line(ExpandedSource *out, const char *text, const LineOrigin *origin)
 {
-	FILE *input_fp = NULL;
-	FILE *output_fp = NULL;
-	char output_filename[FILENAME_MAX];
-	char line[MAX_LINE_LENGTH + 2];
-	int line_num = 0;
-	int in_macro_definition = 0;
-	MacroDefinition *current_macro = NULL;
-	char *dot;
-	char *original_line_copy_for_content = NULL;
-	char *processed_line_for_tokens = NULL;
-	char *current_line_ptr;
-	char *first_token_candidate;
-	char *label_name;
-	char *trimmed_line_no_comments;
-	char *actual_first_token;
-	char *trimmed_content = NULL;
-	char *first_char = line;
-	int c;
-
-	strncpy(output_filename, input_filename, FILENAME_MAX - 4);
-	output_filename[FILENAME_MAX - 4] = '\0';
-	dot = strrchr(output_filename, '.');
-
-	if(dot != NULL && strcmp(dot, ".as") == 0)
+	char **new_lines;
+	LineOrigin *new_origins;
+	size_t length = strlen(text) + 1;
+	int capacity;
+	if(out->count >= out->capacity)
 	{
-		strcpy(dot, ".am");
+		capacity = (out->capacity == 0) ? MAX_SIZE_MEMORY : out->capacity * DOUBLE;
+		new_lines = (char **)spill_resize(out->lines, out->capacity * sizeof(char *), capacity * sizeof(char *));
+		if(new_lines == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		out->lines = new_lines;
+		new_origins = (LineOrigin *)spill_resize(out->origins, out->capacity * sizeof(LineOrigin), capacity * sizeof(LineOrigin));
+		if(new_origins == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		out->origins = new_origins;
+		out->capacity = capacity;
 	}
-	else
+	out->lines[out->count] = (char *)spill_alloc(length);
+	if(out->lines[out->count] == NULL)
 	{
-		strcat(output_filename, ".am");
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
 	}
+	memcpy(out->lines[out->count], text, length);
+	out->origins[out->count] = *origin;
+	out->count++;
+	return 1;
+}
 
-	input_fp = fopen(input_filename, "r");
-	if(!input_fp)
+/**
+ * @brief Appends an indented line ("label:<tab>text" or "<tab>text") to the expanded source.
+ *
+ * @param out A pointer to the expanded source.
+ * @param label The label to put in front of the text, or NULL for none.
+ * @param text The content of the line.
+ * @param origin The origin of the line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_labeled_line(ExpandedSource *out, const char *label, const char *text, const LineOrigin *origin)
+{
+	int status;
+	char *labeled = (char *)malloc((label != NULL ? strlen(label) : 0) + strlen(text) + 3);
+	if(labeled == NULL)
 	{
-		fprintf(stdout, "allocation failed");
+		fprintf(stdout,"Memory allocation failed");
 		return EXIT;
 	}
-
-	/* --- First Pass: Collect Macro Definitions and Check for Errors --- */
-	while(fgets(line, sizeof(line), input_fp) != NULL)
+	labeled[0] = '\0';
+	if(label != NULL)
 	{
-		line_num++;
-		if(strlen(line) > MAX_LINE_LENGTH + 1)
-		{
-			if(add_error(&errortable_ptr, ec_ptr, line_num, ": Line exceeds the maximum length of 80 characters.", esize_ptr) == EXIT){goto cleanup_pass1;}
-			if (strchr(line, '\n') == NULL && !feof(input_fp))
-			{
-				while ((c = fgetc(input_fp)) != '\n' && c != EOF);
-			}
+		strcpy(labeled, label);
+		strcat(labeled, ":");
+	}
+	strcat(labeled, "\t");
+	strcat(labeled, text);
+	status = add_expanded_line(out, labeled, origin);
+	free(labeled);
+	return status;
+}
 
-			continue;
-		}
-		first_char = line;
+/**
+ * @brief Frees all memory held by an expanded source and resets it to empty.
+ *
+ * @param out A pointer to the expanded source.
+ */
+void free_expanded_source(ExpandedSource *out)
+{
+	int i;
+	for(i = 0; i < out->count; i++)
+	{
+		spill_free(out->lines[i]);
+	}
+	spill_free(out->lines);
+	spill_free(out->origins);
+	out->lines = NULL;
+	out->origins = NULL;
+	out->count = 0;
+	out->capacity = 0;
+}
 
-		while (*first_char != '\0' && isspace((unsigned char)*first_char))
-		{
-			first_char++;
-		}
+/**
+ * @brief Splits a source line into its optional label and its first real token.
+ *
+ * The line is tokenized with `get_next_token`, which stops a token at a colon.
+ * A first token that was terminated by a colon in the original line is a label,
+ * and the token after it becomes the command.
+ *
+ * @param line The original line.
+ * @param tokens A writable copy of the line, tokenized in place.
+ * @param rest Receives the position in `tokens` after the command token.
+ * @param label_name Receives the label, or NULL if the line has none.
+ * @return The command token, or NULL if there is none.
+ */
+char *split_label_and_command(const char *line, char *tokens, char **rest, char **label_name)
+{
+	char *first_token_candidate;
+	char *actual_first_token;
+	*rest = tokens;
+	*label_name = NULL;
+	first_token_candidate = get_next_token(rest);
+	actual_first_token = first_token_candidate;
+	if(first_token_candidate != NULL && line[(first_token_candidate - tokens) + strlen(first_token_candidate)] == ':')
+	{
+		*label_name = first_token_candidate;
+		actual_first_token = get_next_token(rest);
+	}
+	return actual_first_token;
+}
 
-		if (*first_char == ';' || *first_char == '\0')
+/**
+ * @brief Splits the argument list of a macro invocation, or the parameter list of a definition.
+ *
+ * A comment ends the list. The items are separated by `MACRO_PARAM_SEPARATOR`
+ * and trimmed; an empty text has no items.
+ *
+ * @param text The text after the macro name, split in place.
+ * @param args Receives up to `MAX_MACRO_PARAMS` trimmed items.
+ * @return The number of items, or -1 if there are too many or one is empty.
+ */
+int split_macro_arguments(char *text, char **args)
+{
+	char *item, *separator;
+	int count = 0;
+	text = trim_whitespace_and_comments(text);
+	if(text == NULL)
+	{
+		return 0;
+	}
+	for(item = text; item != NULL; item = (separator != NULL) ? separator + 1 : NULL)
+	{
+		separator = strchr(item, MACRO_PARAM_SEPARATOR);
+		if(separator != NULL)
 		{
-			if (strchr(line, '\n') == NULL && !feof(input_fp))
-			{
-				while ((c = fgetc(input_fp)) != '\n' && c != EOF);
-			}
-			continue;
+			*separator = '\0';
 		}
-
-		original_line_copy_for_content = my_strdup(line);
-		if(!original_line_copy_for_content)
+		if(count == MAX_MACRO_PARAMS || (args[count] = trim_whitespace_and_comments(item)) == NULL)
 		{
-			fprintf(stdout, "allocation failed");
-			goto cleanup_pass1;
+			return -1;
 		}
+		count++;
+	}
+	return count;
+}
 
-		processed_line_for_tokens = my_strdup(line);
-		if(!processed_line_for_tokens)
+/**
+ * @brief Reads the parameter list of a macro definition.
+ *
+ * Every parameter must be a valid macro name that is not a reserved word, and
+ * no name may appear twice.
+ *
+ * @param macro The macro, whose `params` and `num_params` are set.
+ * @param text The text after the macro name, split in place.
+ * @return 1 if the list is valid, 0 otherwise.
+ */
+int parse_macro_parameters(MacroDefinition *macro, char *text)
+{
+	char *names[MAX_MACRO_PARAMS];
+	int i, j;
+	macro->num_params = split_macro_arguments(text, names);
+	if(macro->num_params < 0)
+	{
+		macro->num_params = 0;
+		return 0;
+	}
+	for(i = 0; i < macro->num_params; i++)
+	{
+		if(strlen(names[i]) > MAX_LABEL_LENGTH || !is_valid_macro_name(names[i]) || is_reserved_word(names[i]))
 		{
-			fprintf(stdout, "allocation failed");
-			free(original_line_copy_for_content);
-			goto cleanup_pass1;
+			macro->num_params = 0;
+			return 0;
 		}
-
-		current_line_ptr = processed_line_for_tokens;
-		first_token_candidate = get_next_token(&current_line_ptr);
-		label_name = NULL;
-		actual_first_token = first_token_candidate;
-
-		if(first_token_candidate != NULL && strchr(first_token_candidate, ':') != NULL)
+		for(j = 0; j < i; j++)
 		{
-			label_name = first_token_candidate;
-			actual_first_token = get_next_token(&current_line_ptr);
+			if(strcmp(macro->params[j], names[i]) == 0)
+			{
+				macro->num_params = 0;
+				return 0;
+			}
 		}
+		strcpy(macro->params[i], names[i]);
+	}
+	return 1;
+}
 
-		trimmed_line_no_comments = trim_whitespace_and_comments(original_line_copy_for_content);
-
-		if(actual_first_token != NULL)
+/**
+ * @brief Replaces the parameter references of a body line with slot bytes, in place.
+ *
+ * A reference is `MACRO_PARAM_PREFIX` followed by the longest run of letters,
+ * digits and underscores; it becomes the byte `MACRO_SLOT_BASE` plus the index
+ * of the parameter. A prefix that does not name a parameter is kept as it is.
+ * The line can only get shorter.
+ *
+ * @param macro The macro the line belongs to.
+ * @param line The trimmed body line.
+ */
+void encode_macro_parameters(const MacroDefinition *macro, char *line)
+{
+	char *read = line, *write = line, *end;
+	int i, found;
+	while(*read != '\0')
+	{
+		found = -1;
+		if(*read == MACRO_PARAM_PREFIX)
 		{
-			if(strcmp(actual_first_token, MACRO_START_KEYWORD) == 0)
-			{
-				char *macro_name_candidate = get_next_token(&current_line_ptr);
-
-				if(macro_name_candidate == NULL || strlen(macro_name_candidate) == 0 || strlen(macro_name_candidate) > MAX_LABEL_LENGTH)
-				{
-					if(add_error(&errortable_ptr, ec_ptr, line_num, ": Invalid or missing macro name for 'mcro' directive.", esize_ptr) == EXIT){goto cleanup_pass1;}
-				}
-				else if(!is_valid_macro_name(macro_name_candidate))
-				{
-					if(add_error(&errortable_ptr, ec_ptr, line_num, ": Macro name contains invalid characters. Must start with a letter and be alphanumeric.", esize_ptr) == EXIT){goto cleanup_pass1;}
-				}
-				else
-				{
-					if(is_reserved_word(macro_name_candidate))
-					{
-						if(add_error(&errortable_ptr, ec_ptr, line_num, ": Macro name cannot be a reserved word (instruction, directive, or register).", esize_ptr) == EXIT){goto cleanup_pass1;}
-					}
-					else if(find_macro_definition(*macros_list_head, macro_name_candidate) != NULL)
-					{
-						if(add_error(&errortable_ptr, ec_ptr, line_num, ": Macro with this name already defined (redefinition).", esize_ptr) == EXIT){goto cleanup_pass1;}
-					}
-					else
-					{
-						current_macro = (MacroDefinition *)malloc(sizeof(MacroDefinition));
-						if(!current_macro)
-						{
-							fprintf(stdout, "allocation failed");
-							goto cleanup_pass1;
-						}
-						strcpy(current_macro->name, macro_name_candidate);
-						current_macro->head = NULL;
-						current_macro->tail = NULL;
-						current_macro->next = NULL;
-						in_macro_definition = 1;
-					}
-				}
-			}
-			else if(strcmp(actual_first_token, MACRO_END_KEYWORD) == 0)
-			{
-				while(isspace((unsigned char)*current_line_ptr))
-				{
-					current_line_ptr++;
-				}
-				if(*current_line_ptr != '\0')
-				{
-					if(add_error(&errortable_ptr, ec_ptr, line_num, ": Unexpected text after 'endmcro'.", esize_ptr) == EXIT){goto cleanup_pass1;}
-				}
-				if(in_macro_definition == 0)
-				{
-					if(add_error(&errortable_ptr, ec_ptr, line_num, ": endmcro directive without a preceding mcro definition.", esize_ptr) == EXIT){goto cleanup_pass1;}
-				}
-				else
-				{
-					add_macro_definition(macros_list_head, current_macro);
-					in_macro_definition = 0;
-					current_macro = NULL;
-				}
-			}
-			else if(in_macro_definition == 1)
+			for(end = read + 1; isalnum((unsigned char)*end) || *end == '_'; end++);
+			for(i = 0; i < macro->num_params && found < 0; i++)
 			{
-				if(trimmed_line_no_comments != NULL)
+				if(strlen(macro->params[i]) == (size_t)(end - read - 1) && strncmp(macro->params[i], read + 1, end - read - 1) == 0)
 				{
-					if(add_macro_line(current_macro, trimmed_line_no_comments) == EXIT){goto cleanup_pass1;}
+					found = i;
 				}
 			}
 		}
-
-		free(processed_line_for_tokens);
-		processed_line_for_tokens = NULL;
-		free(original_line_copy_for_content);
-		original_line_copy_for_content = NULL;
+		if(found >= 0)
+		{
+			*write++ = (char)(MACRO_SLOT_BASE + found);
+			read = end;
+		}
+		else
+		{
+			*write++ = *read++;
+		}
 	}
+	*write = '\0';
+}
 
-	if(in_macro_definition == 1)
+/**
+ * @brief Splits the arguments of a macro invocation and checks their number.
+ *
+ * @param text The text after the macro name, split in place.
+ * @param num_params The number of parameters of the macro.
+ * @param args Receives the arguments.
+ * @param origin The origin of the invocation, for errors.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 if the arguments match, 0 if an error was reported, or EXIT on a memory allocation failure.
+ */
+int check_macro_arguments(char *text, int num_params, char **args, const LineOrigin *origin, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr)
+{
+	if(split_macro_arguments(text, args) != num_params)
 	{
-		if(add_error(&errortable_ptr, ec_ptr, line_num, ": Unclosed macro definition (missing endmcro).", esize_ptr) == EXIT){goto cleanup_pass1;}
+		if(add_source_error(errortable_ptr, ec_ptr, origin, ": Wrong number of macro arguments.", esize_ptr) == EXIT){return EXIT;}
+		return 0;
 	}
-	fclose(input_fp);
-	input_fp = NULL;
+	return 1;
+}
 
-	if(*ec_ptr > 0)
+/**
+ * @brief Fills the parameter slots of a body line with arguments.
+ *
+ * The length of the result is computed first, so the line is gathered into
+ * one allocation in a single pass over its bytes. An argument may itself hold
+ * slot bytes, of the macro whose body invokes this one. Only the slots of
+ * the macro's own parameters are filled; any other byte of the slot range
+ * (one that was in the source text itself) is copied as it is.
+ *
+ * @param line The body line, with slot bytes.
+ * @param args The arguments.
+ * @param num_args The number of arguments, which is the number of parameters of the macro.
+ * @return A dynamically allocated line, or NULL on a memory allocation failure.
+ */
+char *substitute_macro_arguments(const char *line, char **args, int num_args)
+{
+	const char *p;
+	char *result, *write;
+	size_t length = 0;
+	int slot;
+	for(p = line; *p != '\0'; p++)
 	{
-		return 0;
+		slot = (unsigned char)*p - MACRO_SLOT_BASE;
+		length += (slot >= 0 && slot < num_args) ? strlen(args[slot]) : 1;
 	}
-	else
+	result = (char *)malloc(length + 1);
+	if(result == NULL)
 	{
-		/* --- Second Pass: Expand Macros and Write Output --- */
-		output_fp = fopen(output_filename, "w");
-		if(!output_fp)
+		fprintf(stdout,"Memory allocation failed");
+		return NULL;
+	}
+	write = result;
+	for(p = line; *p != '\0'; p++)
+	{
+		slot = (unsigned char)*p - MACRO_SLOT_BASE;
+		if(slot >= 0 && slot < num_args)
 		{
-			fprintf(stdout, "allocation failed");
-			return EXIT;
+			strcpy(write, args[slot]);
+			write += strlen(args[slot]);
 		}
-
-		input_fp = fopen(input_filename, "r");
-		if(!input_fp)
+		else
 		{
-			fprintf(stdout, "allocation failed");
-			fclose(output_fp);
-			return EXIT;
+			*write++ = *p;
 		}
+	}
+	*write = '\0';
+	return result;
+}
 
-		line_num = 0;
-		in_macro_definition = 0;
-
-		while(fgets(line, sizeof(line), input_fp) != NULL)
-		{
-			line_num++;
-			first_char = line;
-
-			while (*first_char != '\0' && isspace((unsigned char)*first_char))
-			{
-				first_char++;
-			}
+/**
+ * @brief Appends a line to the flattened body of a macro.
+ *
+ * The line is stored as the body of a macro stores it: trimmed, with its
+ * label, if any, in front. The arrays grow like those of an expanded source.
+ *
+ * @param macro The macro.
+ * @param label The label to put in front of the text, or NULL for none.
+ * @param text The content of the line.
+ * @param producer The name of the macro whose body holds the line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_flat_line(MacroDefinition *macro, const char *label, const char *text, const char *producer)
+{
+	char **new_flat;
+	const char **new_macros;
+	char *line;
+	if(macro->flat_count >= macro->flat_capacity)
+	{
+		macro->flat_capacity = (macro->flat_capacity == 0) ? MAX_SIZE_MEMORY : macro->flat_capacity * DOUBLE;
+		new_flat = (char **)realloc(macro->flat, macro->flat_capacity * sizeof(char *));
+		if(new_flat == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		macro->flat = new_flat;
+		new_macros = (const char **)realloc((void *)macro->flat_macros, macro->flat_capacity * sizeof(const char *));
+		if(new_macros == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		macro->flat_macros = new_macros;
+	}
+	line = (char *)malloc((label != NULL ? strlen(label) + 2 : 0) + strlen(text) + 1);
+	if(line == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	line[0] = '\0';
+	if(label != NULL)
+	{
+		strcpy(line, label);
+		strcat(line, ": ");
+	}
+	strcat(line, text);
+	macro->flat[macro->flat_count] = line;
+	macro->flat_macros[macro->flat_count] = producer;
+	macro->flat_count++;
+	return 1;
+}
+
+/**
+ * @brief Computes the fully expanded body of a macro, once.
+ *
+ * Every body line that invokes another macro of the list, or of the
+ * precompiled library, is replaced by that macro's expanded body; a label in
+ * front of the invocation moves to its first line, and its arguments fill the
+ * callee's parameter slots. Arguments that refer to this macro's own
+ * parameters leave slots in the result, which its invocations fill in turn.
+ * The callee is expanded first, recursively, and its result is cached too, so
+ * each macro is expanded only once per file however often it is invoked.
+ *
+ * A macro met again while it is being expanded is a cycle, a chain longer
+ * than `MAX_MACRO_NESTING` is refused, and a label in front of an invocation
+ * that expands to no lines has nowhere to go. Each is reported once, at the
+ * line that started the expansion; every macro on the failed chain is then
+ * marked broken and expands to nothing, without further errors.
+ *
+ * @param macro The macro to expand.
+ * @param macros_list_head The head of the macro list.
+ * @param library A precompiled macro library whose macros may also be invoked, or NULL.
+ * @param depth The number of macros whose expansion invoked this one.
+ * @param origin The line whose macro call started the expansion, for errors.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success, 0 if the expansion has errors, or EXIT on a memory allocation failure.
+ */
+int flatten_macro(MacroDefinition *macro, MacroDefinition *macros_list_head, const struct macro_library *library, int depth, const LineOrigin *origin, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr)
+{
+	MacroLine *ml;
+	MacroDefinition *callee;
+	const unsigned char *library_macro;
+	char *tokens, *rest, *label_name, *command, *text;
+	char *args[MAX_MACRO_PARAMS];
+	int j, count, status = 1;
+
+	if(macro->flat_state == MACRO_FLATTENED)
+	{
+		return 1;
+	}
+	if(macro->flat_state == MACRO_BROKEN)
+	{
+		return 0;
+	}
+	if(macro->flat_state == MACRO_FLATTENING)
+	{
+		if(add_source_error(errortable_ptr, ec_ptr, origin, ": Recursive macro invocation.", esize_ptr) == EXIT){return EXIT;}
+		return 0;
+	}
+	if(depth >= MAX_MACRO_NESTING)
+	{
+		if(add_source_error(errortable_ptr, ec_ptr, origin, ": Macro invocations nested too deeply.", esize_ptr) == EXIT){return EXIT;}
+		return 0;
+	}
+
+	macro->flat_state = MACRO_FLATTENING;
+	for(ml = macro->head; ml != NULL && status == 1; ml = ml->next)
+	{
+		tokens = my_strdup(ml->content);
+		if(tokens == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		command = split_label_and_command(ml->content, tokens, &rest, &label_name);
+		callee = (command != NULL) ? find_macro_definition(macros_list_head, command) : NULL;
+		library_macro = (command != NULL && callee == NULL) ? find_library_macro(library, command) : NULL;
+		if(callee != NULL)
+		{
+			status = check_macro_arguments(rest, callee->num_params, args, origin, errortable_ptr, ec_ptr, esize_ptr);
+			if(status == 1)
+			{
+				status = flatten_macro(callee, macros_list_head, library, depth + 1, origin, errortable_ptr, ec_ptr, esize_ptr);
+			}
+		}
+		else if(library_macro != NULL)
+		{
+			status = check_macro_arguments(rest, library_macro_params(library_macro), args, origin, errortable_ptr, ec_ptr, esize_ptr);
+		}
+		else
+		{
+			status = add_flat_line(macro, NULL, ml->content, macro->name);
+		}
+		count = (callee != NULL) ? callee->flat_count : (library_macro != NULL) ? library_macro_lines(library_macro) : 0;
+		for(j = 0; status == 1 && j < count; j++)
+		{
+			text = substitute_macro_arguments((callee != NULL) ? callee->flat[j] : library_macro_line(library, library_macro, j), args, (callee != NULL) ? callee->num_params : library_macro_params(library_macro));
+			if(text == NULL)
+			{
+				status = EXIT;
+				break;
+			}
+			status = add_flat_line(macro, (j == 0) ? label_name : NULL, text, (callee != NULL) ? callee->flat_macros[j] : library_macro_name(library, library_macro));
+			free(text);
+		}
+		if(status == 1 && count == 0 && label_name != NULL)
+		{
+			status = (add_source_error(errortable_ptr, ec_ptr, origin, ": The label is on a macro that expands to no lines.", esize_ptr) == EXIT) ? EXIT : 0;
+		}
+		free(tokens);
+	}
+	macro->flat_state = (status == 1) ? MACRO_FLATTENED : MACRO_BROKEN;
+	return status;
+}
+
+/**
+ * @brief Reads the operands of a `.rept` line: the count and the optional counter name.
+ *
+ * The count is a decimal number from 1 to `MAX_REPT_COUNT`. The counter name
+ * follows the rules of a macro parameter.
+ *
+ * @param text The text after `.rept`, split in place.
+ * @param count Receives the repeat count.
+ * @param counter Receives the counter name, or an empty string if there is none.
+ * @return 1 if the operands are valid, 0 otherwise.
+ */
+int parse_rept_header(char *text, int *count, char *counter)
+{
+	char *items[MAX_MACRO_PARAMS];
+	char *p;
+	int num = split_macro_arguments(text, items);
+	counter[0] = '\0';
+	if(num != 1 && num != 2)
+	{
+		return 0;
+	}
+	*count = 0;
+	for(p = items[0]; isdigit((unsigned char)*p) && *count <= MAX_REPT_COUNT; p++)
+	{
+		*count = *count * 10 + (*p - '0');
+	}
+	if(*p != '\0' || *count < 1 || *count > MAX_REPT_COUNT)
+	{
+		return 0;
+	}
+	if(num == 2)
+	{
+		if(strlen(items[1]) > MAX_LABEL_LENGTH || !is_valid_macro_name(items[1]) || is_reserved_word(items[1]))
+		{
+			return 0;
+		}
+		strcpy(counter, items[1]);
+	}
+	return 1;
+}
+
+/**
+ * @brief Appends a body line to a `.rept` block, with its counter references as slots.
+ *
+ * The line is trimmed and stored as a macro body line is, so the counter is
+ * found once here and never searched for again.
+ *
+ * @param block The block.
+ * @param line The source line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_rept_line(MacroDefinition *block, const char *line)
+{
+	char *copy = my_strdup(line), *trimmed;
+	int status = 1;
+	if(copy == NULL)
+	{
+		fprintf(stdout, "allocation failed");
+		return EXIT;
+	}
+	trimmed = trim_whitespace_and_comments(copy);
+	if(trimmed != NULL)
+	{
+		encode_macro_parameters(block, trimmed);
+		status = add_macro_line(block, trimmed);
+	}
+	free(copy);
+	return status;
+}
+
+/**
+ * @brief Expands the body of a `.rept` block once and replays it into the expanded source.
+ *
+ * The body is expanded by `flatten_macro` like the body of a macro, so its
+ * lines are tokenized and its macro invocations resolved once, whatever the
+ * count. Every repetition then only fills the counter slot of each line with
+ * the repetition number, from 0, and appends it; the cost is proportional to
+ * the lines produced. The label of the `.rept` line goes on the first line,
+ * and is an error if the block expands to no lines; every line reports the
+ * `.rept` line as its origin.
+ *
+ * @param block The block.
+ * @param count The repeat count.
+ * @param label The label of the `.rept` line, or NULL.
+ * @param origin The origin of the `.rept` line.
+ * @param macros_list_head The head of the macro list.
+ * @param library A precompiled macro library whose macros may also be invoked, or NULL.
+ * @param out A pointer to the expanded source.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success, 0 if the expansion has errors, or EXIT on a memory allocation failure.
+ */
+int expand_rept_block(MacroDefinition *block, int count, const char *label, const LineOrigin *origin, MacroDefinition *macros_list_head, const struct macro_library *library, ExpandedSource *out, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr)
+{
+	char number[REPT_COUNTER_DIGITS];
+	char *args[MAX_MACRO_PARAMS];
+	char *text;
+	LineOrigin line_origin = *origin;
+	int i, j, status;
+
+	status = flatten_macro(block, macros_list_head, library, 0, origin, errortable_ptr, ec_ptr, esize_ptr);
+	if(status != 1)
+	{
+		return status;
+	}
+	if(block->flat_count == 0 && label != NULL)
+	{
+		return (add_source_error(errortable_ptr, ec_ptr, origin, ": The label is on a .rept block that expands to no lines.", esize_ptr) == EXIT) ? EXIT : 0;
+	}
+	args[0] = number;
+	for(i = 0; i < count; i++)
+	{
+		sprintf(number, "%d", i);
+		for(j = 0; j < block->flat_count; j++)
+		{
+			text = substitute_macro_arguments(block->flat[j], args, block->num_params);
+			if(text == NULL){return EXIT;}
+			line_origin.macro = (block->flat_macros[j] == block->name) ? NULL : block->flat_macros[j];
+			status = add_labeled_line(out, (i == 0 && j == 0) ? label : NULL, text, &line_origin);
+			free(text);
+			if(status == EXIT){return EXIT;}
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Recognizes a conditional assembly line by its first word, without tokenizing it.
+ *
+ * Only leading whitespace is skipped, and a line whose first word does not
+ * start with a dot is rejected on its first character, so the lines of a
+ * disabled region cost one short scan each.
+ *
+ * @param line The source line.
+ * @param rest Receives the text after the keyword.
+ * @return The keyword, `CONDITIONAL_DEFINE` to `CONDITIONAL_ENDIF`, or `CONDITIONAL_NONE`.
+ */
+int conditional_keyword(const char *line, const char **rest)
+{
+	static const char *keywords[] = {DEFINE_KEYWORD, IFDEF_KEYWORD, IFNDEF_KEYWORD, ELSE_KEYWORD, ENDIF_KEYWORD};
+	size_t len;
+	int i;
+	while(*line == ' ' || *line == '\t')
+	{
+		line++;
+	}
+	if(*line != '.')
+	{
+		return CONDITIONAL_NONE;
+	}
+	for(i = 0; i < (int)(sizeof(keywords) / sizeof(keywords[0])); i++)
+	{
+		len = strlen(keywords[i]);
+		if(strncmp(line, keywords[i], len) == 0 && (line[len] == '\0' || isspace((unsigned char)line[len]) || line[len] == COMMENT_START_CHAR))
+		{
+			*rest = line + len;
+			return CONDITIONAL_DEFINE + i;
+		}
+	}
+	return CONDITIONAL_NONE;
+}
+
+/**
+ * @brief Checks whether a symbol was defined with `.define` or `-D`.
+ *
+ * @param symbols The symbols the file defined so far.
+ * @param name The name of the symbol.
+ * @return 1 if the symbol is defined, 0 otherwise.
+ */
+int is_symbol_defined(const DefinedSymbols *symbols, const char *name)
+{
+	int i;
+	for(i = 0; i < NUM_COMMAND_LINE_DEFINES; i++)
+	{
+		if(strcmp(COMMAND_LINE_DEFINES[i], name) == 0)
+		{
+			return 1;
+		}
+	}
+	for(i = 0; i < symbols->count; i++)
+	{
+		if(strcmp(symbols->names[i], name) == 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Adds a symbol defined with `.define`.
+ *
+ * A symbol that is already defined is not added again.
+ *
+ * @param symbols The symbols of the file.
+ * @param name The name of the symbol.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_defined_symbol(DefinedSymbols *symbols, const char *name)
+{
+	char **new_names;
+	if(is_symbol_defined(symbols, name))
+	{
+		return 1;
+	}
+	if(symbols->count >= symbols->capacity)
+	{
+		symbols->capacity = (symbols->capacity == 0) ? MAX_MACRO_NESTING : symbols->capacity * DOUBLE;
+		new_names = (char **)realloc(symbols->names, symbols->capacity * sizeof(char *));
+		if(new_names == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		symbols->names = new_names;
+	}
+	symbols->names[symbols->count] = my_strdup(name);
+	if(symbols->names[symbols->count] == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	symbols->count++;
+	return 1;
+}
+
+/**
+ * @brief Frees the symbols of a file.
+ *
+ * @param symbols The symbols.
+ */
+void free_defined_symbols(DefinedSymbols *symbols)
+{
+	int i;
+	for(i = 0; i < symbols->count; i++)
+	{
+		free(symbols->names[i]);
+	}
+	free(symbols->names);
+	symbols->names = NULL;
+	symbols->count = 0;
+	symbols->capacity = 0;
+}
+
+/**
+ * @brief Reads the symbol name after a conditional keyword.
+ *
+ * The name follows the rules of a macro name; only whitespace or a comment
+ * may follow it.
+ *
+ * @param rest The text after the keyword.
+ * @param name Receives the name; it must hold `MAX_LABEL_LENGTH + 1` characters.
+ * @return 1 if the text is a single valid name, 0 otherwise, or EXIT on a memory allocation failure.
+ */
+int read_conditional_name(const char *rest, char *name)
+{
+	char *copy = my_strdup(rest), *trimmed;
+	int valid = 0;
+	if(copy == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	trimmed = trim_whitespace_and_comments(copy);
+	if(trimmed != NULL && strlen(trimmed) <= MAX_LABEL_LENGTH && is_valid_macro_name(trimmed))
+	{
+		strcpy(name, trimmed);
+		valid = 1;
+	}
+	free(copy);
+	return valid;
+}
+
+/**
+ * @brief Evaluates the conditional assembly lines and marks every line the passes must skip.
+ *
+ * The lines are scanned once, in order, so `.ifdef` sees the `.define` lines
+ * above it and the `-D` symbols. Inside a disabled region only the
+ * conditional keywords are recognized, to keep track of nesting; the other
+ * lines are neither tokenized nor checked, and `.define` and the names of
+ * nested conditions are ignored there. Every conditional line is marked too,
+ * so none reaches the `.am` file. Misplaced `.else` and `.endif` lines,
+ * invalid names, nesting deeper than `MAX_CONDITIONAL_DEPTH` and an
+ * unclosed region are errors.
+ *
+ * @param lines The source lines.
+ * @param num_lines The number of source lines.
+ * @param origins The origin of every source line, or NULL if the lines are a whole source file.
+ * @param skip Receives 1 for every conditional line and every line of a disabled region, 0 otherwise.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success (errors are reported through the error table), or EXIT on a critical failure.
+ */
+int mark_disabled_lines(char **lines, int num_lines, const LineOrigin *origins, char *skip, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr)
+{
+	DefinedSymbols symbols = {NULL, 0, 0};
+	LineOrigin origin = {0, NULL, 0, NULL};
+	LineOrigin opened[MAX_CONDITIONAL_DEPTH];
+	int parent_active[MAX_CONDITIONAL_DEPTH], taken[MAX_CONDITIONAL_DEPTH], seen_else[MAX_CONDITIONAL_DEPTH];
+	char name[MAX_LABEL_LENGTH + 1];
+	const char *rest, *message;
+	int k, keyword, depth = 0, active = 1, valid = 1, status = 1;
+
+	for(k = 0; k < num_lines && status != EXIT; k++)
+	{
+		keyword = conditional_keyword(lines[k], &rest);
+		skip[k] = (keyword != CONDITIONAL_NONE || !active);
+		if(keyword == CONDITIONAL_NONE)
+		{
+			continue;
+		}
+		if(origins != NULL)
+		{
+			origin = origins[k];
+		}
+		else
+		{
+			origin.line = k + 1;
+			origin.macro = NULL;
+		}
+		message = NULL;
+		valid = 1;
+		if(keyword == CONDITIONAL_ELSE || keyword == CONDITIONAL_ENDIF)
+		{
+			for(; *rest != '\0' && *rest != COMMENT_START_CHAR; rest++)
+			{
+				if(!isspace((unsigned char)*rest))
+				{
+					message = (keyword == CONDITIONAL_ELSE) ? ": Unexpected text after '.else'." : ": Unexpected text after '.endif'.";
+				}
+			}
+		}
+		else if(active)
+		{
+			valid = read_conditional_name(rest, name);
+			if(valid == EXIT)
+			{
+				status = EXIT;
+				break;
+			}
+			if(!valid)
+			{
+				message = ": Invalid or missing symbol name for a conditional directive.";
+			}
+		}
+		if(keyword == CONDITIONAL_DEFINE)
+		{
+			if(active && valid)
+			{
+				status = add_defined_symbol(&symbols, name);
+			}
+		}
+		else if(keyword == CONDITIONAL_IFDEF || keyword == CONDITIONAL_IFNDEF)
+		{
+			if(depth >= MAX_CONDITIONAL_DEPTH)
+			{
+				message = ": Conditional directives nested too deeply.";
+			}
+			else
+			{
+				opened[depth] = origin;
+				parent_active[depth] = active;
+				taken[depth] = active && valid && (is_symbol_defined(&symbols, name) == (keyword == CONDITIONAL_IFDEF));
+				seen_else[depth] = 0;
+				active = taken[depth];
+				depth++;
+			}
+		}
+		else if(depth == 0)
+		{
+			message = (keyword == CONDITIONAL_ELSE) ? ": '.else' without a preceding '.ifdef' or '.ifndef'." : ": '.endif' without a preceding '.ifdef' or '.ifndef'.";
+		}
+		else if(keyword == CONDITIONAL_ELSE)
+		{
+			if(seen_else[depth - 1])
+			{
+				message = ": More than one '.else' for the same condition.";
+			}
+			seen_else[depth - 1] = 1;
+			active = parent_active[depth - 1] && !taken[depth - 1];
+		}
+		else
+		{
+			depth--;
+			active = parent_active[depth];
+		}
+		if(message != NULL && status != EXIT)
+		{
+			status = add_source_error(errortable_ptr, ec_ptr, &origin, message, esize_ptr);
+		}
+	}
+	if(status != EXIT && depth > 0)
+	{
+		status = add_source_error(errortable_ptr, ec_ptr, &opened[depth - 1], ": Unclosed conditional region (missing '.endif').", esize_ptr);
+	}
+	free_defined_symbols(&symbols);
+	return status;
+}
+
+/**
+ * @brief The main function for the pre-assembler pass, working on lines in memory.
+ *
+ * This function performs two passes over the source lines, after
+ * `mark_disabled_lines` has evaluated the conditional assembly lines; both
+ * passes skip the lines it marks.
+ *
+ * **First Pass:**
+ * - It scans the lines to identify and store all macro definitions.
+ * - It validates macro names and checks for re-definitions or invalid syntax.
+ * - It checks that every `.rept` block is closed by `.endr`, has a valid count,
+ *   and holds no macro definition or nested block.
+ * - Errors are collected in the error table.
+ *
+ * **Second Pass:**
+ * - If no errors were found in the first pass, it scans the lines again.
+ * - It expands any macro calls by replacing the macro name with its stored content.
+ *   A macro the file does not define itself is looked up in the precompiled library.
+ * - It collects the body of every `.rept` block and replays it with `expand_rept_block`.
+ * - All other lines are copied to the expanded source without changes.
+ *
+ * Every expanded line records the source line it came from, so later stages
+ * can report positions in the original file.
+ *
+ * @param lines The source lines (without trailing newlines).
+ * @param num_lines The number of source lines.
+ * @param origins The origin of every source line, or NULL if the lines are a whole source file.
+ * @param library A precompiled macro library whose macros may also be called, or NULL.
+ * @param out A pointer to an empty expanded source that receives the result.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @param macros_list_head A pointer to the head of the macro list.
+ * @return 0 on successful completion, or EXIT on a critical memory error.
+ */
+int pre_assemble_lines(char **lines, int num_lines, const LineOrigin *origins, const struct macro_library *library, ExpandedSource *out, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr, MacroDefinition **macros_list_head)
+{
+	int k, j, count, status;
+	LineOrigin origin = {0, NULL, 0, NULL};
+	int in_macro_definition = 0, in_rept = 0, rept_count = 0;
+	char *skip = NULL;
+	LineOrigin rept_origin = {0, NULL, 0, NULL};
+	MacroDefinition *current_macro = NULL;
+	MacroDefinition *rept = NULL;
+	char *rept_label = NULL;
+	char rept_counter[MAX_LABEL_LENGTH + 1];
+	MacroDefinition *called_macro;
+	const unsigned char *library_macro;
+	char *line;
+	char *original_line_copy_for_content = NULL;
+	char *processed_line_for_tokens = NULL;
+	char *current_line_ptr;
+	char *label_name;
+	char *trimmed_line_no_comments;
+	char *actual_first_token;
+	char *first_char;
+	char *text;
+	char *args[MAX_MACRO_PARAMS];
+
+	/* --- Conditional Assembly: Mark the Lines of Disabled Regions --- */
+	skip = (char *)malloc(num_lines > 0 ? num_lines : 1);
+	if(skip == NULL)
+	{
+		fprintf(stdout, "allocation failed");
+		return EXIT;
+	}
+	if(mark_disabled_lines(lines, num_lines, origins, skip, errortable_ptr, ec_ptr, esize_ptr) == EXIT){goto cleanup_pass1;}
 
-			if (*first_char == ';' || *first_char == '\0')
-			{
-				if (strchr(line, '\n') == NULL && !feof(input_fp))
-				{
-					while ((c = fgetc(input_fp)) != '\n' && c != EOF);
-				}
-				continue;
-			}
+	/* --- First Pass: Collect Macro Definitions and Check for Errors --- */
+	for(k = 0; k < num_lines; k++)
+	{
+		if(k % METRICS_POLL_LINES == 0)
+		{
+			metrics_poll();
+		}
+		if(skip[k])
+		{
+			continue;
+		}
+		line = lines[k];
+		if(origins != NULL)
+		{
+			origin = origins[k];
+		}
+		else
+		{
+			origin.line = k + 1;
+			origin.macro = NULL;
+		}
+		first_char = line;
 
-			original_line_copy_for_content = my_strdup(line);
-			if(!original_line_copy_for_content)
-			{
-				fprintf(stdout, "allocation failed");
-				goto cleanup_pass2;
-			}
+		while (*first_char != '\0' && isspace((unsigned char)*first_char))
+		{
+			first_char++;
+		}
 
-			processed_line_for_tokens = my_strdup(line);
-			if(!processed_line_for_tokens)
-			{
-				fprintf(stdout, "allocation failed");
-				free(original_line_copy_for_content);
-				goto cleanup_pass2;
-			}
+		if (*first_char == ';' || *first_char == '\0')
+		{
+			continue;
+		}
+
+		original_line_copy_for_content = my_strdup(line);
+		if(!original_line_copy_for_content)
+		{
+			fprintf(stdout, "allocation failed");
+			goto cleanup_pass1;
+		}
+
+		processed_line_for_tokens = my_strdup(line);
+		if(!processed_line_for_tokens)
+		{
+			fprintf(stdout, "allocation failed");
+			goto cleanup_pass1;
+		}
 
-			current_line_ptr = processed_line_for_tokens;
-			first_token_candidate = get_next_token(&current_line_ptr);
-			label_name = NULL;
-			actual_first_token = first_token_candidate;
+		actual_first_token = split_label_and_command(line, processed_line_for_tokens, &current_line_ptr, &label_name);
+		trimmed_line_no_comments = trim_whitespace_and_comments(original_line_copy_for_content);
 
-			if(first_token_candidate != NULL && strchr(first_token_candidate, ':') != NULL)
+		if(actual_first_token != NULL)
+		{
+			if(strcmp(actual_first_token, MACRO_START_KEYWORD) == 0 && in_rept == 1)
 			{
-				label_name = first_token_candidate;
-				actual_first_token = get_next_token(&current_line_ptr);
+				if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Macro definitions cannot appear inside a '.rept' block.", esize_ptr) == EXIT){goto cleanup_pass1;}
 			}
-
-			if(actual_first_token != NULL)
+			else if(strcmp(actual_first_token, MACRO_START_KEYWORD) == 0)
 			{
-				if(strcmp(actual_first_token, MACRO_START_KEYWORD) == 0)
-				{
-					in_macro_definition = 1;
-				}
-				else if(strcmp(actual_first_token, MACRO_END_KEYWORD) == 0)
+				char *macro_name_candidate = get_next_token(&current_line_ptr);
+
+				if(macro_name_candidate == NULL || strlen(macro_name_candidate) == 0 || strlen(macro_name_candidate) > MAX_LABEL_LENGTH)
 				{
-					in_macro_definition = 0;
+					if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Invalid or missing macro name for 'mcro' directive.", esize_ptr) == EXIT){goto cleanup_pass1;}
 				}
-				else if(in_macro_definition == 1)
+				else if(!is_valid_macro_name(macro_name_candidate))
 				{
-					/* Do nothing, we are inside a macro definition. */
+					if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Macro name contains invalid characters. Must start with a letter and be alphanumeric.", esize_ptr) == EXIT){goto cleanup_pass1;}
 				}
 				else
 				{
-					MacroDefinition *called_macro = find_macro_definition(*macros_list_head, actual_first_token);
-
-					if(called_macro != NULL)
+					if(is_reserved_word(macro_name_candidate))
 					{
-						MacroLine *ml = called_macro->head;
-
-						if(label_name != NULL)
+						if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Macro name cannot be a reserved word (instruction, directive, or register).", esize_ptr) == EXIT){goto cleanup_pass1;}
+					}
+					else if(find_macro_definition(*macros_list_head, macro_name_candidate) != NULL)
+					{
+						if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Macro with this name already defined (redefinition).", esize_ptr) == EXIT){goto cleanup_pass1;}
+					}
+					else
+					{
+						current_macro = (MacroDefinition *)malloc(sizeof(MacroDefinition));
+						if(!current_macro)
 						{
-							trimmed_content = trim_whitespace_and_comments(my_strdup(ml->content));
-							fprintf(output_fp, "%s:\t%s\n", label_name, trimmed_content);
-							free(trimmed_content);
-							trimmed_content = NULL;
-							ml = ml->next;
+							fprintf(stdout, "allocation failed");
+							goto cleanup_pass1;
 						}
-
-						while(ml != NULL)
+						strcpy(current_macro->name, macro_name_candidate);
+						current_macro->head = NULL;
+						current_macro->tail = NULL;
+						current_macro->next = NULL;
+						current_macro->flat = NULL;
+						current_macro->flat_macros = NULL;
+						current_macro->flat_count = 0;
+						current_macro->flat_capacity = 0;
+						current_macro->flat_state = MACRO_UNFLATTENED;
+						in_macro_definition = 1;
+						if(!parse_macro_parameters(current_macro, current_line_ptr))
 						{
-							trimmed_content = trim_whitespace_and_comments(my_strdup(ml->content));
-							if(!trimmed_content)
-							{
-								goto cleanup_pass2;
-							}
-							fprintf(output_fp, "\t%s\n", trimmed_content);
-							free(trimmed_content);
-							trimmed_content = NULL;
-							ml = ml->next;
+							if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Invalid macro parameter list.", esize_ptr) == EXIT){goto cleanup_pass1;}
 						}
 					}
+				}
+			}
+			else if(strcmp(actual_first_token, MACRO_END_KEYWORD) == 0)
+			{
+				while(isspace((unsigned char)*current_line_ptr))
+				{
+					current_line_ptr++;
+				}
+				if(*current_line_ptr != '\0')
+				{
+					if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Unexpected text after 'endmcro'.", esize_ptr) == EXIT){goto cleanup_pass1;}
+				}
+				if(in_macro_definition == 0)
+				{
+					if(add_source_error(errortable_ptr, ec_ptr, &origin, ": endmcro directive without a preceding mcro definition.", esize_ptr) == EXIT){goto cleanup_pass1;}
+				}
+				else
+				{
+					add_macro_definition(macros_list_head, current_macro);
+					in_macro_definition = 0;
+					current_macro = NULL;
+				}
+			}
+			else if(strcmp(actual_first_token, REPT_START_KEYWORD) == 0 || strcmp(actual_first_token, REPT_END_KEYWORD) == 0)
+			{
+				if(in_macro_definition == 1)
+				{
+					if(add_source_error(errortable_ptr, ec_ptr, &origin, ": '.rept' blocks cannot appear inside a macro definition.", esize_ptr) == EXIT){goto cleanup_pass1;}
+				}
+				else if(strcmp(actual_first_token, REPT_START_KEYWORD) == 0)
+				{
+					if(in_rept == 1)
+					{
+						if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Nested '.rept' blocks are not supported.", esize_ptr) == EXIT){goto cleanup_pass1;}
+					}
 					else
 					{
-						if(label_name != NULL)
-						{
-							print_formatted_line(output_fp, label_name, current_line_ptr);
-						}
-						else if(original_line_copy_for_content != NULL)
+						if(!parse_rept_header(current_line_ptr, &rept_count, rept_counter))
 						{
-							fputs(original_line_copy_for_content, output_fp);
+							if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Invalid '.rept' count or counter name.", esize_ptr) == EXIT){goto cleanup_pass1;}
 						}
+						in_rept = 1;
+						rept_origin = origin;
+					}
+				}
+				else if(in_rept == 0)
+				{
+					if(add_source_error(errortable_ptr, ec_ptr, &origin, ": '.endr' without a preceding '.rept'.", esize_ptr) == EXIT){goto cleanup_pass1;}
+				}
+				else
+				{
+					if(trim_whitespace_and_comments(current_line_ptr) != NULL)
+					{
+						if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Unexpected text after '.endr'.", esize_ptr) == EXIT){goto cleanup_pass1;}
 					}
+					in_rept = 0;
 				}
 			}
-			else
+			else if(in_macro_definition == 1)
 			{
-				if(label_name != NULL)
+				if(trimmed_line_no_comments != NULL)
 				{
-					fputs(original_line_copy_for_content, output_fp);
+					encode_macro_parameters(current_macro, trimmed_line_no_comments);
+					if(add_macro_line(current_macro, trimmed_line_no_comments) == EXIT){goto cleanup_pass1;}
 				}
 			}
-
-			free(processed_line_for_tokens);
-			processed_line_for_tokens = NULL;
-			free(original_line_copy_for_content);
-			original_line_copy_for_content = NULL;
 		}
 
-		cleanup_pass2:
-			if (input_fp) fclose(input_fp);
-			if (output_fp) fclose(output_fp);
-			if (processed_line_for_tokens) free(processed_line_for_tokens);
-			if (original_line_copy_for_content) free(original_line_copy_for_content);
+		free(processed_line_for_tokens);
+		processed_line_for_tokens = NULL;
+		free(original_line_copy_for_content);
+		original_line_copy_for_content = NULL;
+	}
+
+	if(in_macro_definition == 1)
+	{
+		if(add_source_error(errortable_ptr, ec_ptr, &origin, ": Unclosed macro definition (missing endmcro).", esize_ptr) == EXIT){goto cleanup_pass1;}
+	}
+	if(in_rept == 1)
+	{
+		if(add_source_error(errortable_ptr, ec_ptr, &rept_origin, ": Unclosed '.rept' block (missing '.endr').", esize_ptr) == EXIT){goto cleanup_pass1;}
+	}
+
+	if(*ec_ptr > 0)
+	{
+		free(skip);
 		return 0;
 	}
 
+	/* --- Second Pass: Expand Macros into the Expanded Source --- */
+	in_macro_definition = 0;
+	for(k = 0; k < num_lines; k++)
+	{
+		if(k % METRICS_POLL_LINES == 0)
+		{
+			metrics_poll();
+		}
+		if(skip[k])
+		{
+			continue;
+		}
+		line = lines[k];
+		if(origins != NULL)
+		{
+			origin = origins[k];
+		}
+		else
+		{
+			origin.line = k + 1;
+			origin.macro = NULL;
+		}
+		first_char = line;
+
+		while (*first_char != '\0' && isspace((unsigned char)*first_char))
+		{
+			first_char++;
+		}
+
+		if (*first_char == ';' || *first_char == '\0')
+		{
+			continue;
+		}
+
+		processed_line_for_tokens = my_strdup(line);
+		if(!processed_line_for_tokens)
+		{
+			fprintf(stdout, "allocation failed");
+			goto cleanup_pass2;
+		}
+
+		actual_first_token = split_label_and_command(line, processed_line_for_tokens, &current_line_ptr, &label_name);
+
+		if(rept != NULL && (actual_first_token == NULL || strcmp(actual_first_token, REPT_END_KEYWORD) != 0))
+		{
+			if(add_rept_line(rept, line) == EXIT){goto cleanup_pass2;}
+		}
+		else if(rept != NULL)
+		{
+			status = expand_rept_block(rept, rept_count, rept_label, &rept_origin, *macros_list_head, library, out, errortable_ptr, ec_ptr, esize_ptr);
+			free_macro_definitions(&rept);
+			free(rept_label);
+			rept_label = NULL;
+			if(status == EXIT){goto cleanup_pass2;}
+		}
+		else if(actual_first_token != NULL)
+		{
+			if(strcmp(actual_first_token, MACRO_START_KEYWORD) == 0)
+			{
+				in_macro_definition = 1;
+			}
+			else if(strcmp(actual_first_token, MACRO_END_KEYWORD) == 0)
+			{
+				in_macro_definition = 0;
+			}
+			else if(in_macro_definition == 1)
+			{
+				/* Do nothing, we are inside a macro definition. */
+			}
+			else if(strcmp(actual_first_token, REPT_START_KEYWORD) == 0)
+			{
+				/* The body is collected up to `.endr` and replayed there; the header was checked in the first pass. */
+				rept = (MacroDefinition *)calloc(1, sizeof(MacroDefinition));
+				if(rept == NULL || (label_name != NULL && (rept_label = my_strdup(label_name)) == NULL))
+				{
+					fprintf(stdout, "allocation failed");
+					goto cleanup_pass2;
+				}
+				strcpy(rept->name, REPT_START_KEYWORD);
+				parse_rept_header(current_line_ptr, &rept_count, rept->params[0]);
+				rept->num_params = (rept->params[0][0] != '\0') ? 1 : 0;
+				rept_origin = origin;
+			}
+			else
+			{
+				called_macro = find_macro_definition(*macros_list_head, actual_first_token);
+
+				library_macro = (called_macro == NULL) ? find_library_macro(library, actual_first_token) : NULL;
+
+				if(called_macro != NULL)
+				{
+					/* The body, with its own macro invocations expanded, is computed on the first call only. */
+					status = check_macro_arguments(current_line_ptr, called_macro->num_params, args, &origin, errortable_ptr, ec_ptr, esize_ptr);
+					if(status == 1)
+					{
+						status = flatten_macro(called_macro, *macros_list_head, library, 0, &origin, errortable_ptr, ec_ptr, esize_ptr);
+					}
+				}
+				else if(library_macro != NULL)
+				{
+					status = check_macro_arguments(current_line_ptr, library_macro_params(library_macro), args, &origin, errortable_ptr, ec_ptr, esize_ptr);
+				}
+				else
+				{
+					status = add_expanded_line(out, line, &origin);
+				}
+				if(status == EXIT){goto cleanup_pass2;}
+				count = (called_macro != NULL) ? called_macro->flat_count : (library_macro != NULL) ? library_macro_lines(library_macro) : 0;
+				for(j = 0; status == 1 && j < count; j++)
+				{
+					/* Filling the slots gathers the line and its arguments in one pass. */
+					text = substitute_macro_arguments((called_macro != NULL) ? called_macro->flat[j] : library_macro_line(library, library_macro, j), args, (called_macro != NULL) ? called_macro->num_params : library_macro_params(library_macro));
+					if(text == NULL){goto cleanup_pass2;}
+					origin.macro = (called_macro != NULL) ? called_macro->flat_macros[j] : library_macro_name(library, library_macro);
+					status = add_labeled_line(out, (j == 0) ? label_name : NULL, text, &origin);
+					free(text);
+					if(status == EXIT){goto cleanup_pass2;}
+				}
+				if(status == 1 && count == 0 && label_name != NULL && (called_macro != NULL || library_macro != NULL))
+				{
+					if(add_source_error(errortable_ptr, ec_ptr, &origin, ": The label is on a macro that expands to no lines.", esize_ptr) == EXIT){goto cleanup_pass2;}
+				}
+			}
+		}
+		else if(label_name != NULL)
+		{
+			if(add_expanded_line(out, line, &origin) == EXIT){goto cleanup_pass2;}
+		}
+
+		free(processed_line_for_tokens);
+		processed_line_for_tokens = NULL;
+	}
+	free(skip);
+	return 0;
+
+	cleanup_pass2:
+		if (processed_line_for_tokens) free(processed_line_for_tokens);
+		free_macro_definitions(&rept);
+		free(rept_label);
+		free(skip);
+		return EXIT;
+
 	cleanup_pass1:
-		if (input_fp) fclose(input_fp);
+		free(skip);
 		if (original_line_copy_for_content) free(original_line_copy_for_content);
 		if (processed_line_for_tokens) free(processed_line_for_tokens);
 		if (current_macro) free_macro_definitions(&current_macro);
 		if(macros_list_head) free_macro_definitions(macros_list_head);
 	return EXIT;
 }
+
+/**
+ * @brief The main function for the pre-assembler pass.
+ *
+ * This function reads the input file, replaces its `.include` lines with the
+ * lines of the included files, expands it with `pre_assemble_lines` and, if no
+ * errors were found, writes the expanded lines to the `.am` file. The expanded
+ * lines are also handed back, so the assembly passes do not need to read the
+ * `.am` file again. An `.am` file whose contents did not change is left
+ * untouched. In `--check` mode no `.am` file is written.
+ *
+ * @param input_filename The name of the input `.as` file.
+ * @param cache A pointer to the head of the include cache shared by the run.
+ * @param library A precompiled macro library whose macros may also be called, or NULL.
+ * @param deps A pointer to the list that receives the included files, or NULL.
+ * @param expanded A pointer to an empty expanded source that receives the result.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @param macros_list_head A pointer to the head of the macro list.
+ * @return 0 on successful completion, or EXIT on a critical memory or file error.
+ */
+int pre_assemble(const char *input_filename, struct included_file **cache, const struct macro_library *library, struct include_deps *deps, ExpandedSource *expanded, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr, MacroDefinition **macros_list_head)
+{
+	FILE *output_fp = NULL;
+	char output_filename[FILENAME_MAX];
+	char **lines;
+	char *dot;
+	const char *stack[MAX_INCLUDE_DEPTH];
+	int num_lines, i, status;
+	ExpandedSource flat = {NULL, NULL, 0, 0};
+
+	strncpy(output_filename, input_filename, FILENAME_MAX - 4);
+	output_filename[FILENAME_MAX - 4] = '\0';
+	dot = strrchr(output_filename, '.');
+
+	if(dot != NULL && strcmp(dot, ".as") == 0)
+	{
+		strcpy(dot, ".am");
+	}
+	else
+	{
+		strcat(output_filename, ".am");
+	}
+
+	lines = read_raw_lines(input_filename, &num_lines);
+	if(lines == NULL)
+	{
+		fprintf(stdout, "error opening file!\n");
+		return EXIT;
+	}
+
+	stack[0] = input_filename;
+	status = flatten_includes(input_filename, lines, num_lines, NULL, stack, 1, cache, deps, &flat, errortable_ptr, ec_ptr, esize_ptr);
+	free_lines(lines, num_lines);
+	if(status != EXIT && *ec_ptr == 0)
+	{
+		status = pre_assemble_lines(flat.lines, flat.count, flat.origins, library, expanded, errortable_ptr, ec_ptr, esize_ptr, macros_list_head);
+	}
+	free_expanded_source(&flat);
+	if(status == EXIT)
+	{
+		return EXIT;
+	}
+
+	if(*ec_ptr == 0 && !CHECK_ONLY)
+	{
+		output_fp = open_output(output_filename, "w");
+		if(!output_fp)
+		{
+			fprintf(stdout, "error opening file!\n");
+			return EXIT;
+		}
+		for(i = 0; i < expanded->count; i++)
+		{
+			fprintf(output_fp, "%s\n", expanded->lines[i]);
+		}
+		if(fclose(output_fp) != 0)
+		{
+			discard_output(output_filename);
+			return EXIT;
+		}
+		if(commit_output(output_filename) == EXIT){return EXIT;}
+	}
+	return 0;
+}
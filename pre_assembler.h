@@ -15,6 +15,36 @@
 #define COMMENT_START_CHAR ';'          /* The character used to indicate a comment line */
 #define CODE_COLUMN 12                  /* A specific column for code formatting */
 #define MAX_LINE_FOR_COLUMN_CHECK 1000  /* The maximum number of lines to check for column formatting */
+#define MAX_MACRO_NESTING 16            /* The longest chain of macros invoking macros */
+#define MAX_MACRO_PARAMS 9              /* The most parameters a macro may take */
+#define MACRO_PARAM_PREFIX '\\'         /* The character that starts a parameter reference in a macro body */
+#define MACRO_PARAM_SEPARATOR ','       /* The character between macro parameters and arguments */
+#define MACRO_SLOT_BASE 16              /* Parameter i is stored in a body line as the byte MACRO_SLOT_BASE + i */
+#define REPT_START_KEYWORD ".rept"      /* The keyword that starts a repeated block */
+#define REPT_END_KEYWORD ".endr"        /* The keyword that ends a repeated block */
+#define MAX_REPT_COUNT 65536            /* The most times a block may be repeated */
+#define REPT_COUNTER_DIGITS 12          /* Room for the decimal counter of a repeated block */
+#define DEFINE_KEYWORD ".define"        /* Defines a symbol for conditional assembly */
+#define IFDEF_KEYWORD ".ifdef"          /* Starts a region kept only if a symbol is defined */
+#define IFNDEF_KEYWORD ".ifndef"        /* Starts a region kept only if a symbol is not defined */
+#define ELSE_KEYWORD ".else"            /* Starts the opposite region of an `.ifdef` or `.ifndef` */
+#define MACRO_INDEX_BUCKETS 4096        /* The number of buckets of the macro index (a power of two) */
+#define ENDIF_KEYWORD ".endif"          /* Ends a conditional region */
+#define MAX_CONDITIONAL_DEPTH 16        /* The deepest nesting of conditional regions */
+
+/* The conditional keywords, as returned by `conditional_keyword` */
+#define CONDITIONAL_NONE 0              /* Not a conditional line */
+#define CONDITIONAL_DEFINE 1
+#define CONDITIONAL_IFDEF 2
+#define CONDITIONAL_IFNDEF 3
+#define CONDITIONAL_ELSE 4
+#define CONDITIONAL_ENDIF 5
+
+/* The states of the flattened body of a macro */
+#define MACRO_UNFLATTENED 0             /* Not expanded yet */
+#define MACRO_FLATTENING 1              /* Being expanded; meeting it again means a cycle */
+#define MACRO_FLATTENED 2               /* Expanded; `flat` holds the body */
+#define MACRO_BROKEN 3                  /* Its expansion failed and was reported */
 
 /*
  * Structure to represent a single line within a macro.
@@ -28,21 +58,109 @@ typedef struct MacroLine
 
 /*
  * Structure to manage a macro definition.
- * This structure holds the macro's name and a linked list of its lines.
+ * This structure holds the macro's name, its parameters and a linked list of its lines.
+ * A macro defined as `mcro NAME a, b` refers to its parameters as `\a` and `\b`;
+ * when a body line is stored, each reference is replaced by a single slot byte,
+ * so an invocation copies the line and its arguments without searching for names.
+ * A `.rept N, i` block is kept as an unnamed macro outside the list, whose only
+ * parameter is the counter `i`.
+ * The first time the macro is invoked, the invocations of other macros in
+ * its body are replaced by their own bodies, recursively, and the result is
+ * kept in `flat`, so every later invocation copies it in one go.
  */
 typedef struct MacroDefinition
 {
 	char name[MAX_LABEL_LENGTH + 1];
+	char params[MAX_MACRO_PARAMS][MAX_LABEL_LENGTH + 1];   /* The parameter names */
+	int num_params;         /* The number of parameters */
 	MacroLine *head;        /* Pointer to the first line of the macro */
 	MacroLine *tail;        /* Pointer to the last line of the macro for efficient appending */
 	struct MacroDefinition *next;   /* Pointer to the next macro in the linked list */
+	char **flat;            /* The fully expanded body lines */
+	const char **flat_macros;       /* The name of the macro that produced each line of `flat` */
+	int flat_count;         /* The number of lines in `flat` */
+	int flat_capacity;      /* The allocated size of `flat` and `flat_macros` */
+	int flat_state;         /* MACRO_UNFLATTENED, MACRO_FLATTENING, MACRO_FLATTENED or MACRO_BROKEN */
+	struct MacroDefinition *bucket_next;    /* The next macro of the same bucket of the macro index */
 } MacroDefinition;
 
+/*
+ * Structure of the hash index over the names of a macro list.
+ * The first word of every line is looked up among the macros, so the list that
+ * `add_macro_definition` builds is also indexed by name. A bucket chains its
+ * macros in list order, newest first, so a lookup finds the macro a walk of the
+ * list would. Only the list whose head is `head` is indexed; others are walked.
+ */
+typedef struct MacroIndex
+{
+	MacroDefinition *head;  /* The head of the indexed list, or NULL */
+	MacroDefinition *buckets[MACRO_INDEX_BUCKETS];  /* The first macro of every bucket */
+} MacroIndex;
+
+/*
+ * Structure that records where a line of the expanded source came from.
+ * `line` is the 1-based line number in the source file; for a line that came from
+ * an included file it is the line of the outermost `.include` directive, and
+ * `file`/`file_line` name the included file and the line in it (`file` is NULL
+ * for a line of the source file itself). `macro` is the name of the macro whose
+ * body produced the line, or NULL for a line copied as is.
+ */
+typedef struct LineOrigin
+{
+	int line;
+	const char *file;
+	int file_line;
+	const char *macro;
+} LineOrigin;
+
+/*
+ * Structure holding the output of the pre-assembler in memory.
+ * `lines[i]` is the i-th line of the `.am` file and `origins[i]` tells where it came from.
+ */
+typedef struct ExpandedSource
+{
+	char **lines;           /* The expanded lines, without trailing newlines */
+	LineOrigin *origins;    /* The origin of every expanded line */
+	int count;              /* The number of expanded lines */
+	int capacity;           /* The allocated size of both arrays */
+} ExpandedSource;
+
+/*
+ * Structure holding the symbols a source file defines with `.define`.
+ * The symbols given with `-D` are kept apart, in `COMMAND_LINE_DEFINES`.
+ */
+typedef struct DefinedSymbols
+{
+	char **names;           /* The defined names */
+	int count;              /* The number of names */
+	int capacity;           /* The allocated size of `names` */
+} DefinedSymbols;
+
+/*
+ * The symbols defined on the command line with `-D`, for every source file of the run.
+ */
+extern char **COMMAND_LINE_DEFINES;
+extern int NUM_COMMAND_LINE_DEFINES;
+
+/*
+ * The index of the macro list being built.
+ */
+extern MacroIndex MACRO_INDEX;
+
 /*
  * Additional includes for data structures and assembler functions.
  */
 #include "data.h"
 #include "assembler.h"
+#include "include.h"
+#include "macrolib.h"
+
+/* The include cache and dependency list are declared in include.h. */
+struct included_file;
+struct include_deps;
+
+/* Precompiled macro libraries are declared in macrolib.h. */
+struct macro_library;
 
 /*
  * Function Prototypes for the Pre-Assembler
@@ -97,6 +215,13 @@ int add_macro_definition(MacroDefinition **macros_list_head, MacroDefinition *ma
  */
 MacroDefinition *find_macro_definition(MacroDefinition *macros_list_head, const char *name);
 
+/**
+ * @brief Indexes every macro of a list by name, replacing the previous index.
+ *
+ * @param macros_list_head The head of the macros linked list.
+ */
+void index_macro_list(MacroDefinition *macros_list_head);
+
 /**
  * @brief Checks if a given word is already the name of an existing macro.
  *
@@ -147,19 +272,247 @@ int add_macro_line(MacroDefinition *macro_def, const char *line_content);
  */
 void print_formatted_line(FILE *fp, const char *label, const char *text);
 
+/**
+ * @brief Appends a line to the expanded source.
+ *
+ * @param out A pointer to the expanded source.
+ * @param text The content of the line (without a trailing newline).
+ * @param origin The origin of the line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_expanded_line(ExpandedSource *out, const char *text, const LineOrigin *origin);
+
+/**
+ * @brief Appends an indented line, optionally preceded by a label, to the expanded source.
+ *
+ * @param out A pointer to the expanded source.
+ * @param label The label to put in front of the text, or NULL for none.
+ * @param text The content of the line.
+ * @param origin The origin of the line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_labeled_line(ExpandedSource *out, const char *label, const char *text, const LineOrigin *origin);
+
+/**
+ * @brief Frees all memory held by an expanded source.
+ *
+ * @param out A pointer to the expanded source.
+ */
+void free_expanded_source(ExpandedSource *out);
+
+/**
+ * @brief Splits a source line into its optional label and its first real token.
+ *
+ * @param line The original line.
+ * @param tokens A writable copy of the line, tokenized in place.
+ * @param rest Receives the position in `tokens` after the command token.
+ * @param label_name Receives the label, or NULL if the line has none.
+ * @return The command token, or NULL if there is none.
+ */
+char *split_label_and_command(const char *line, char *tokens, char **rest, char **label_name);
+
+/**
+ * @brief Splits the argument list of a macro invocation, or the parameter list of a definition.
+ *
+ * @param text The text after the macro name, split in place.
+ * @param args Receives up to `MAX_MACRO_PARAMS` trimmed items.
+ * @return The number of items, or -1 if there are too many or one is empty.
+ */
+int split_macro_arguments(char *text, char **args);
+
+/**
+ * @brief Reads the parameter list of a macro definition.
+ *
+ * @param macro The macro, whose `params` and `num_params` are set.
+ * @param text The text after the macro name, split in place.
+ * @return 1 if the list is valid, 0 otherwise.
+ */
+int parse_macro_parameters(MacroDefinition *macro, char *text);
+
+/**
+ * @brief Replaces the parameter references of a body line with slot bytes, in place.
+ *
+ * @param macro The macro the line belongs to.
+ * @param line The trimmed body line.
+ */
+void encode_macro_parameters(const MacroDefinition *macro, char *line);
+
+/**
+ * @brief Splits the arguments of a macro invocation and checks their number.
+ *
+ * @param text The text after the macro name, split in place.
+ * @param num_params The number of parameters of the macro.
+ * @param args Receives the arguments.
+ * @param origin The origin of the invocation, for errors.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 if the arguments match, 0 if an error was reported, or EXIT on a memory allocation failure.
+ */
+int check_macro_arguments(char *text, int num_params, char **args, const LineOrigin *origin, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr);
+
+/**
+ * @brief Fills the parameter slots of a body line with arguments.
+ *
+ * @param line The body line, with slot bytes.
+ * @param args The arguments.
+ * @param num_args The number of arguments, which is the number of parameters of the macro.
+ * @return A dynamically allocated line, or NULL on a memory allocation failure.
+ */
+char *substitute_macro_arguments(const char *line, char **args, int num_args);
+
+/**
+ * @brief Appends a line to the flattened body of a macro.
+ *
+ * @param macro The macro.
+ * @param label The label to put in front of the text, or NULL for none.
+ * @param text The content of the line.
+ * @param producer The name of the macro whose body holds the line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_flat_line(MacroDefinition *macro, const char *label, const char *text, const char *producer);
+
+/**
+ * @brief Computes the fully expanded body of a macro, once.
+ *
+ * @param macro The macro to expand.
+ * @param macros_list_head The head of the macro list.
+ * @param library A precompiled macro library whose macros may also be invoked, or NULL.
+ * @param depth The number of macros whose expansion invoked this one.
+ * @param origin The line whose macro call started the expansion, for errors.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success, 0 if the expansion has errors, or EXIT on a memory allocation failure.
+ */
+int flatten_macro(MacroDefinition *macro, MacroDefinition *macros_list_head, const struct macro_library *library, int depth, const LineOrigin *origin, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr);
+
+/**
+ * @brief Reads the operands of a `.rept` line: the count and the optional counter name.
+ *
+ * @param text The text after `.rept`, split in place.
+ * @param count Receives the repeat count.
+ * @param counter Receives the counter name, or an empty string if there is none.
+ * @return 1 if the operands are valid, 0 otherwise.
+ */
+int parse_rept_header(char *text, int *count, char *counter);
+
+/**
+ * @brief Appends a body line to a `.rept` block, with its counter references as slots.
+ *
+ * @param block The block.
+ * @param line The source line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_rept_line(MacroDefinition *block, const char *line);
+
+/**
+ * @brief Expands the body of a `.rept` block once and replays it into the expanded source.
+ *
+ * @param block The block.
+ * @param count The repeat count.
+ * @param label The label of the `.rept` line, or NULL.
+ * @param origin The origin of the `.rept` line.
+ * @param macros_list_head The head of the macro list.
+ * @param library A precompiled macro library whose macros may also be invoked, or NULL.
+ * @param out A pointer to the expanded source.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success, 0 if the expansion has errors, or EXIT on a memory allocation failure.
+ */
+int expand_rept_block(MacroDefinition *block, int count, const char *label, const LineOrigin *origin, MacroDefinition *macros_list_head, const struct macro_library *library, ExpandedSource *out, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr);
+
+/**
+ * @brief Recognizes a conditional assembly line by its first word, without tokenizing it.
+ *
+ * @param line The source line.
+ * @param rest Receives the text after the keyword.
+ * @return The keyword, `CONDITIONAL_DEFINE` to `CONDITIONAL_ENDIF`, or `CONDITIONAL_NONE`.
+ */
+int conditional_keyword(const char *line, const char **rest);
+
+/**
+ * @brief Checks whether a symbol was defined with `.define` or `-D`.
+ *
+ * @param symbols The symbols the file defined so far.
+ * @param name The name of the symbol.
+ * @return 1 if the symbol is defined, 0 otherwise.
+ */
+int is_symbol_defined(const DefinedSymbols *symbols, const char *name);
+
+/**
+ * @brief Adds a symbol defined with `.define`.
+ *
+ * @param symbols The symbols of the file.
+ * @param name The name of the symbol.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_defined_symbol(DefinedSymbols *symbols, const char *name);
+
+/**
+ * @brief Frees the symbols of a file.
+ *
+ * @param symbols The symbols.
+ */
+void free_defined_symbols(DefinedSymbols *symbols);
+
+/**
+ * @brief Reads the symbol name after a conditional keyword.
+ *
+ * @param rest The text after the keyword.
+ * @param name Receives the name; it must hold `MAX_LABEL_LENGTH + 1` characters.
+ * @return 1 if the text is a single valid name, 0 otherwise, or EXIT on a memory allocation failure.
+ */
+int read_conditional_name(const char *rest, char *name);
+
+/**
+ * @brief Evaluates the conditional assembly lines and marks every line the passes must skip.
+ *
+ * @param lines The source lines.
+ * @param num_lines The number of source lines.
+ * @param origins The origin of every source line, or NULL if the lines are a whole source file.
+ * @param skip Receives 1 for every conditional line and every line of a disabled region, 0 otherwise.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @return 1 on success (errors are reported through the error table), or EXIT on a critical failure.
+ */
+int mark_disabled_lines(char **lines, int num_lines, const LineOrigin *origins, char *skip, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr);
+
+/**
+ * @brief Expands the macros of source lines held in memory.
+ *
+ * @param lines The source lines (without trailing newlines).
+ * @param num_lines The number of source lines.
+ * @param origins The origin of every source line, or NULL if the lines are a whole source file.
+ * @param library A precompiled macro library whose macros may also be called, or NULL.
+ * @param out A pointer to an empty expanded source that receives the result.
+ * @param errortable_ptr The address of the pointer to the error table.
+ * @param ec_ptr A pointer to the error counter.
+ * @param esize_ptr A pointer to the size of the error table.
+ * @param macros_list_head A pointer to the head of the macros linked list.
+ * @return 0 on success (errors are reported through the error table), or EXIT on a critical failure.
+ */
+int pre_assemble_lines(char **lines, int num_lines, const LineOrigin *origins, const struct macro_library *library, ExpandedSource *out, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr, MacroDefinition **macros_list_head);
+
 /**
  * @brief The main function of the pre-assembler.
  *
- * This function scans the input file, finds and stores macro definitions,
- * and expands them into an output file.
+ * This function reads the input file, inserts its included files, finds and
+ * stores macro definitions, and expands them into an output file.
  *
  * @param input_filename The name of the input file.
- * @param errortable_ptr A pointer to the error table.
+ * @param cache A pointer to the head of the include cache shared by the run.
+ * @param library A precompiled macro library whose macros may also be called, or NULL.
+ * @param deps A pointer to the list that receives the included files, or NULL.
+ * @param expanded A pointer to an empty expanded source that receives the result.
+ * @param errortable_ptr The address of the pointer to the error table.
  * @param ec_ptr A pointer to the error counter.
  * @param esize_ptr A pointer to the size of the error table.
  * @param macros_list_head A pointer to the head of the macros linked list.
- * @return 1 on success, 0 if errors were found, or EXIT on a critical failure.
+ * @return 0 on success (errors are reported through the error table), or EXIT on a critical failure.
  */
-int pre_assemble(const char *input_filename, struct error *errortable_ptr, int *ec_ptr, int *esize_ptr, MacroDefinition **macros_list_head);
+int pre_assemble(const char *input_filename, struct included_file **cache, const struct macro_library *library, struct include_deps *deps, ExpandedSource *expanded, struct error **errortable_ptr, int *ec_ptr, int *esize_ptr, MacroDefinition **macros_list_head);
 
 #endif
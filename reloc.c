@@ -0,0 +1,442 @@
+#include "reloc.h"
+
+/**
+ * @brief Lists the relocatable words of the instruction table.
+ *
+ * Only address words carry ARE RELOCATABLE; data words never hold addresses.
+ *
+ * @param instable A pointer to the instruction table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @param rel A pointer to the relocations to fill.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int collect_relocations(const struct instructionsMemory *instable, int ic, int dc, struct relocations *rel)
+{
+	int i;
+	rel->base = MEMORY_START;
+	rel->num_words = ic + dc;
+	rel->ic = ic;
+	rel->count = 0;
+	rel->offsets = (int *)malloc(((size_t)ic + 1) * sizeof(int));
+	if(rel->offsets == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	for(i = 0; i < ic; i++)
+	{
+		if(instable[i].type == RECORD_TYPE_ADDRESS && instable[i].data.addr.ARE == RELOCATABLE)
+		{
+			rel->offsets[rel->count++] = i;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Writes relocations into a `.rel` file, if it changed.
+ *
+ * @param name The name of the `.rel` file.
+ * @param rel A pointer to the relocations.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_relocations(const char *name, const struct relocations *rel)
+{
+	unsigned char header[MACRO_LIBRARY_WORD * (1 + RELOC_HEADER_WORDS)], *stream;
+	size_t size = 0;
+	FILE *fileptr;
+	int i, previous = 0, status = EXIT;
+
+	stream = (unsigned char *)malloc((size_t)rel->count * DEBUG_MAX_VARINT + 1);
+	if(stream == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	memcpy(header, RELOC_MAGIC, MACRO_LIBRARY_WORD);
+	write_word(header + MACRO_LIBRARY_WORD, (unsigned long)rel->base);
+	write_word(header + 2 * MACRO_LIBRARY_WORD, (unsigned long)rel->num_words);
+	write_word(header + 3 * MACRO_LIBRARY_WORD, (unsigned long)rel->ic);
+	write_word(header + 4 * MACRO_LIBRARY_WORD, (unsigned long)rel->count);
+	for(i = 0; i < rel->count; i++)
+	{
+		size += put_varint(stream + size, (unsigned long)(rel->offsets[i] - previous));
+		previous = rel->offsets[i];
+	}
+
+	fileptr = open_output(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	if(fwrite(header, 1, sizeof(header), fileptr) != sizeof(header) || fwrite(stream, 1, size, fileptr) != size)
+	{
+		fprintf(stdout,"error writing file!\n");
+		fclose(fileptr);
+		discard_output(name);
+		goto clean;
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(name);
+		goto clean;
+	}
+	if(commit_output(name) == EXIT){goto clean;}
+	status = 1;
+
+	clean:
+		free(stream);
+		return status;
+}
+
+/**
+ * @brief Writes the `.rel` file of an assembled file.
+ *
+ * @param name The name of the `.rel` file.
+ * @param instable A pointer to the instruction table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_relocations(const char *name, const struct instructionsMemory *instable, int ic, int dc)
+{
+	struct relocations rel;
+	int status;
+	if(collect_relocations(instable, ic, dc, &rel) == EXIT)
+	{
+		return EXIT;
+	}
+	status = write_relocations(name, &rel);
+	free_relocations(&rel);
+	return status;
+}
+
+/**
+ * @brief Reads a `.rel` file.
+ *
+ * The file is mapped with `map_file` and its relocations are decoded in one
+ * pass; every index must lie in the instruction words and follow the
+ * previous one.
+ *
+ * @param name The name of the `.rel` file.
+ * @param rel A pointer to the relocations to fill.
+ * @return 1 on success, or EXIT if the file cannot be read or is not a valid relocation file.
+ */
+int load_relocations(const char *name, struct relocations *rel)
+{
+	const unsigned char *data, *p, *end;
+	unsigned long count, delta, offset = 0;
+	size_t size;
+	int i;
+
+	memset(rel, 0, sizeof(struct relocations));
+	data = map_file(name, &size);
+	if(data == NULL)
+	{
+		return EXIT;
+	}
+	if(size < MACRO_LIBRARY_WORD * (1 + RELOC_HEADER_WORDS) || memcmp(data, RELOC_MAGIC, MACRO_LIBRARY_WORD) != 0){goto invalid_relocations;}
+	rel->base = (int)read_word(data + MACRO_LIBRARY_WORD);
+	rel->num_words = (int)read_word(data + 2 * MACRO_LIBRARY_WORD);
+	rel->ic = (int)read_word(data + 3 * MACRO_LIBRARY_WORD);
+	count = read_word(data + 4 * MACRO_LIBRARY_WORD);
+	if(rel->base < 0 || rel->num_words < 0 || (unsigned long)rel->num_words > MAX_SIZE_IMAGE || rel->ic < 0 || rel->ic > rel->num_words || count > (unsigned long)rel->ic){goto invalid_relocations;}
+
+	rel->offsets = (int *)malloc((count + 1) * sizeof(int));
+	if(rel->offsets == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		unmap_file(data, size);
+		return EXIT;
+	}
+	p = data + MACRO_LIBRARY_WORD * (1 + RELOC_HEADER_WORDS);
+	end = data + size;
+	for(i = 0; (unsigned long)i < count; i++)
+	{
+		if(!get_varint(&p, end, &delta) || (i > 0 && delta == 0)){goto invalid_relocations;}
+		offset += delta;
+		if(offset >= (unsigned long)rel->ic){goto invalid_relocations;}
+		rel->offsets[i] = (int)offset;
+	}
+	if(p != end){goto invalid_relocations;}
+	rel->count = (int)count;
+	unmap_file(data, size);
+	return 1;
+
+	invalid_relocations:
+		fprintf(stdout, "invalid relocation file: %s\n", name);
+		unmap_file(data, size);
+		free_relocations(rel);
+		return EXIT;
+}
+
+/**
+ * @brief Frees the list of relocations.
+ *
+ * @param rel A pointer to the relocations.
+ */
+void free_relocations(struct relocations *rel)
+{
+	free(rel->offsets);
+	rel->offsets = NULL;
+	rel->count = 0;
+}
+
+/**
+ * @brief Moves the address of a relocatable word to another load address.
+ *
+ * The address field keeps its position above ARE, which is not changed.
+ *
+ * @param word The machine word.
+ * @param old_base The load address the word was written for.
+ * @param new_base The new load address.
+ * @param rebased Receives the patched word.
+ * @return 1 on success, or 0 if the new address does not fit in the word.
+ */
+int rebase_word(unsigned int word, int old_base, int new_base, unsigned int *rebased)
+{
+	int address = (int)(word >> ADDRESS_FIELD_SHIFT) - old_base + new_base;
+	if(address < 0 || address >= REBASE_ADDRESS_LIMIT)
+	{
+		return 0;
+	}
+	*rebased = ((unsigned int)address << ADDRESS_FIELD_SHIFT) | (word & 0x3U);
+	return 1;
+}
+
+/**
+ * @brief Moves the `.ob` text of an image to another load address, in memory.
+ *
+ * Every line after the counters has a fixed width, so line `i` is found by
+ * its offset: its address column is rewritten, and the word is patched only
+ * if it is on the relocation list.
+ *
+ * @param text The contents of the `.ob` file.
+ * @param size The size of the contents.
+ * @param rel A pointer to the relocations of the image.
+ * @param new_base The new load address.
+ * @return 1 on success, or 0 if the text does not match the relocations or a word does not fit.
+ */
+int rebase_base4_text(char *text, size_t size, const struct relocations *rel, int new_base)
+{
+	char *lines, *line;
+	unsigned long address, value;
+	unsigned int rebased;
+	int i;
+
+	lines = (char *)memchr(text, '\n', size);
+	if(lines == NULL)
+	{
+		return 0;
+	}
+	lines++;
+	if((size_t)(text + size - lines) != (size_t)rel->num_words * (NUM_4 + WORD_DIGITS + 2))
+	{
+		return 0;
+	}
+	for(i = 0; i < rel->num_words; i++)
+	{
+		line = lines + (size_t)i * (NUM_4 + WORD_DIGITS + 2);
+		if(!base4_to_value(line, NUM_4, &address) || address != (unsigned long)(rel->base + i))
+		{
+			return 0;
+		}
+		word_to_base4((unsigned long)(new_base + i), NUM_4, line);
+	}
+	for(i = 0; i < rel->count; i++)
+	{
+		line = lines + (size_t)rel->offsets[i] * (NUM_4 + WORD_DIGITS + 2) + NUM_4 + 1;
+		if(!base4_to_value(line, WORD_DIGITS, &value) || !rebase_word((unsigned int)value, rel->base, new_base, &rebased))
+		{
+			return 0;
+		}
+		word_to_base4(rebased, WORD_DIGITS, line);
+	}
+	return 1;
+}
+
+/**
+ * @brief Moves a packed image to another load address, in memory.
+ *
+ * The load address in the header is rewritten, and every word on the
+ * relocation list is patched in place in the bit stream; a 10-bit word at an
+ * even bit offset always lies within two bytes.
+ *
+ * @param image The contents of the packed image.
+ * @param size The size of the contents.
+ * @param rel A pointer to the relocations of the image.
+ * @param new_base The new load address.
+ * @return 1 on success, or 0 if the image does not match the relocations or a word does not fit.
+ */
+int rebase_packed_image(unsigned char *image, size_t size, const struct relocations *rel, int new_base)
+{
+	unsigned char *p;
+	unsigned long bit, pair;
+	unsigned int rebased;
+	int i, shift;
+
+	if(size != PACKED_HEADER_SIZE + ((size_t)rel->num_words * WORD_BITS + 7) / 8)
+	{
+		return 0;
+	}
+	if(read_word(image + MACRO_LIBRARY_WORD) != (unsigned long)rel->base || read_word(image + 2 * MACRO_LIBRARY_WORD) != (unsigned long)rel->ic || read_word(image + 3 * MACRO_LIBRARY_WORD) != (unsigned long)(rel->num_words - rel->ic))
+	{
+		return 0;
+	}
+	write_word(image + MACRO_LIBRARY_WORD, (unsigned long)new_base);
+	for(i = 0; i < rel->count; i++)
+	{
+		bit = (unsigned long)rel->offsets[i] * WORD_BITS;
+		p = image + PACKED_HEADER_SIZE + bit / 8;
+		shift = (int)(bit % 8);
+		pair = (unsigned long)p[0] | ((unsigned long)p[1] << 8);
+		if(!rebase_word((unsigned int)((pair >> shift) & WORD_MASK), rel->base, new_base, &rebased))
+		{
+			return 0;
+		}
+		pair = (pair & ~((unsigned long)WORD_MASK << shift)) | ((unsigned long)rebased << shift);
+		p[0] = (unsigned char)(pair & 0xFF);
+		p[1] = (unsigned char)((pair >> 8) & 0xFF);
+	}
+	return 1;
+}
+
+/**
+ * @brief Moves an object file and its `.rel` file to another load address.
+ *
+ * The object file is read into memory whole, patched in one pass over its
+ * relocation list and written back only if it changed. A file that starts
+ * with `PACKED_MAGIC` is a packed image; any other file is `.ob` text.
+ *
+ * @param object The name of the object file.
+ * @param rel_name The name of the `.rel` file.
+ * @param new_base The new load address.
+ * @return 1 on success, or EXIT on a file or memory error or if the image cannot be moved.
+ */
+int rebase_object(const char *object, const char *rel_name, int new_base)
+{
+	struct relocations rel;
+	const unsigned char *data;
+	unsigned char *image = NULL;
+	size_t size;
+	FILE *fileptr;
+	int moved, status = EXIT;
+
+	if(load_relocations(rel_name, &rel) == EXIT)
+	{
+		return EXIT;
+	}
+	if(new_base < 0 || new_base + rel.num_words > REBASE_ADDRESS_LIMIT)
+	{
+		fprintf(stdout, "cannot load %s at address %d\n", object, new_base);
+		goto clean;
+	}
+	data = map_file(object, &size);
+	if(data == NULL){goto clean;}
+	image = (unsigned char *)malloc(size);
+	if(image == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		unmap_file(data, size);
+		goto clean;
+	}
+	memcpy(image, data, size);
+	unmap_file(data, size);
+
+	if(size >= MACRO_LIBRARY_WORD && memcmp(image, PACKED_MAGIC, MACRO_LIBRARY_WORD) == 0)
+	{
+		moved = rebase_packed_image(image, size, &rel, new_base);
+	}
+	else
+	{
+		moved = rebase_base4_text((char *)image, size, &rel, new_base);
+	}
+	if(!moved)
+	{
+		fprintf(stdout, "object file does not match its relocations: %s\n", object);
+		goto clean;
+	}
+
+	fileptr = open_output(object, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	if(fwrite(image, 1, size, fileptr) != size)
+	{
+		fprintf(stdout,"error writing file!\n");
+		fclose(fileptr);
+		discard_output(object);
+		goto clean;
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(object);
+		goto clean;
+	}
+	if(commit_output(object) == EXIT){goto clean;}
+	rel.base = new_base;
+	status = write_relocations(rel_name, &rel);
+
+	clean:
+		free(image);
+		free_relocations(&rel);
+		return status;
+}
+
+/**
+ * @brief Moves the object files of the given base names to another load address.
+ *
+ * Every base name names an object file in the chosen format and its `.rel`
+ * file. Intel-HEX records carry a checksum per record and are not patched.
+ *
+ * @param address The new load address, in decimal.
+ * @param bases The base names.
+ * @param count The number of base names.
+ * @param emitter A pointer to the format of the object files.
+ * @return 1 on success, or EXIT if the address is invalid or a file cannot be moved.
+ */
+int rebase_files(const char *address, char **bases, int count, const struct emitter *emitter)
+{
+	char *object, *rel_name, *end;
+	long new_base;
+	int i, status = 1;
+
+	new_base = strtol(address, &end, 10);
+	if(*address == '\0' || *end != '\0' || new_base < 0 || new_base >= REBASE_ADDRESS_LIMIT)
+	{
+		fprintf(stdout, "invalid load address: %s\n", address);
+		return EXIT;
+	}
+	if(emitter->emit == emit_ihex)
+	{
+		fprintf(stdout, "cannot rebase object format: %s\n", emitter->name);
+		return EXIT;
+	}
+	for(i = 0; i < count && status == 1; i++)
+	{
+		object = (char *)malloc(strlen(bases[i]) + strlen(emitter->suffix) + 1);
+		rel_name = (char *)malloc(strlen(bases[i]) + sizeof(END_RELOC_FILE_NAME));
+		if(object == NULL || rel_name == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			status = EXIT;
+		}
+		else
+		{
+			strcpy(object, bases[i]);
+			strcat(object, emitter->suffix);
+			strcpy(rel_name, bases[i]);
+			strcat(rel_name, END_RELOC_FILE_NAME);
+			status = rebase_object(object, rel_name, (int)new_base);
+		}
+		free(object);
+		free(rel_name);
+	}
+	return status;
+}
@@ -0,0 +1,182 @@
+#ifndef RELOC_H
+#define RELOC_H
+
+/**
+ * @file reloc.h
+ * @brief This header file declares relocation records and the rebase of object files.
+ *
+ * Every address word whose ARE is RELOCATABLE holds an address relative to
+ * the load address `MEMORY_START`. With `--relocs`, every object file gets a
+ * `.rel` sidecar that lists those words, so `--rebase ADDRESS` can move a
+ * finished object file to another load address without assembling it again:
+ * the address column of the `.ob` text (or the load address of a packed
+ * image) is rewritten, and only the words on the relocation list are patched.
+ *
+ * All numbers in the header are 32-bit little-endian, as in a macro library:
+ *
+ * - Header: the magic "REL1", then the load address, the number of words of
+ *   the image, the number of instruction words and the number of relocations.
+ * - Relocations: the index of every relocatable word in the image, in
+ *   increasing order, as the unsigned LEB128 distance from the previous one
+ *   (the first from index 0).
+ *
+ * A rebase rewrites the load address of the `.rel` file too, so an image can
+ * be moved again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "instruction.h"
+#include "second_pass.h"
+#include "macrolib.h"
+#include "emitter.h"
+#include "delta.h"
+#include "debug_info.h"
+#include "assembler.h"
+
+/* The object file formats are declared in emitter.h. */
+struct emitter;
+
+/**
+ * @def END_RELOC_FILE_NAME
+ * @brief Suffix for the relocation records.
+ */
+#define END_RELOC_FILE_NAME ".rel"
+
+/**
+ * @def RELOC_MAGIC
+ * @brief The four bytes every relocation file starts with.
+ */
+#define RELOC_MAGIC "REL1"
+
+/**
+ * @def RELOC_HEADER_WORDS
+ * @brief The number of words in the header, after the magic.
+ */
+#define RELOC_HEADER_WORDS 4
+
+/**
+ * @def REBASE_ADDRESS_LIMIT
+ * @brief One past the highest address an address word and the `.ob` address column can hold.
+ */
+#define REBASE_ADDRESS_LIMIT 256
+
+/**
+ * @def ADDRESS_FIELD_SHIFT
+ * @brief The position of the address field in an address word, above ARE.
+ */
+#define ADDRESS_FIELD_SHIFT 2
+
+/**
+ * @struct relocations
+ * @brief The relocatable words of an image.
+ *
+ * - `base`: The load address the image was written for.
+ * - `num_words`: The number of words of the image.
+ * - `ic`: The number of instruction words of the image.
+ * - `offsets`: The index of every relocatable word, in increasing order.
+ * - `count`: The number of relocatable words.
+ */
+struct relocations
+{
+	int base;
+	int num_words;
+	int ic;
+	int *offsets;
+	int count;
+};
+
+/**
+ * @brief Lists the relocatable words of the instruction table.
+ * @param instable A pointer to the instruction table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @param rel A pointer to the relocations to fill.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int collect_relocations(const struct instructionsMemory *instable, int ic, int dc, struct relocations *rel);
+
+/**
+ * @brief Writes relocations into a `.rel` file, if it changed.
+ * @param name The name of the `.rel` file.
+ * @param rel A pointer to the relocations.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_relocations(const char *name, const struct relocations *rel);
+
+/**
+ * @brief Writes the `.rel` file of an assembled file.
+ * @param name The name of the `.rel` file.
+ * @param instable A pointer to the instruction table.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_relocations(const char *name, const struct instructionsMemory *instable, int ic, int dc);
+
+/**
+ * @brief Reads a `.rel` file.
+ * @param name The name of the `.rel` file.
+ * @param rel A pointer to the relocations to fill.
+ * @return 1 on success, or EXIT if the file cannot be read or is not a valid relocation file.
+ */
+int load_relocations(const char *name, struct relocations *rel);
+
+/**
+ * @brief Frees the list of relocations.
+ * @param rel A pointer to the relocations.
+ */
+void free_relocations(struct relocations *rel);
+
+/**
+ * @brief Moves the address of a relocatable word to another load address.
+ * @param word The machine word.
+ * @param old_base The load address the word was written for.
+ * @param new_base The new load address.
+ * @param rebased Receives the patched word.
+ * @return 1 on success, or 0 if the new address does not fit in the word.
+ */
+int rebase_word(unsigned int word, int old_base, int new_base, unsigned int *rebased);
+
+/**
+ * @brief Moves the `.ob` text of an image to another load address, in memory.
+ * @param text The contents of the `.ob` file.
+ * @param size The size of the contents.
+ * @param rel A pointer to the relocations of the image.
+ * @param new_base The new load address.
+ * @return 1 on success, or 0 if the text does not match the relocations or a word does not fit.
+ */
+int rebase_base4_text(char *text, size_t size, const struct relocations *rel, int new_base);
+
+/**
+ * @brief Moves a packed image to another load address, in memory.
+ * @param image The contents of the packed image.
+ * @param size The size of the contents.
+ * @param rel A pointer to the relocations of the image.
+ * @param new_base The new load address.
+ * @return 1 on success, or 0 if the image does not match the relocations or a word does not fit.
+ */
+int rebase_packed_image(unsigned char *image, size_t size, const struct relocations *rel, int new_base);
+
+/**
+ * @brief Moves an object file and its `.rel` file to another load address.
+ * @param object The name of the object file.
+ * @param rel_name The name of the `.rel` file.
+ * @param new_base The new load address.
+ * @return 1 on success, or EXIT on a file or memory error or if the image cannot be moved.
+ */
+int rebase_object(const char *object, const char *rel_name, int new_base);
+
+/**
+ * @brief Moves the object files of the given base names to another load address.
+ * @param address The new load address, in decimal.
+ * @param bases The base names.
+ * @param count The number of base names.
+ * @param emitter A pointer to the format of the object files.
+ * @return 1 on success, or EXIT if the address is invalid or a file cannot be moved.
+ */
+int rebase_files(const char *address, char **bases, int count, const struct emitter *emitter);
+
+#endif /* RELOC_H */
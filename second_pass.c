@@ -42,8 +42,8 @@ void index_update(struct labelMemory *labeltable, int *lac, int *ic)
  * @param str The line of assembly code to process.
  * @param instable A pointer to the instruction memory table.
  * @param labeltable A pointer to the label memory table.
- * @param errortable A pointer to the error table.
- * @param extable A pointer to the external labels table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
  * @param ec A pointer to the error counter.
  * @param lac A pointer to the label counter.
  * @param exsize A pointer to the size of the external table.
@@ -53,7 +53,7 @@ void index_update(struct labelMemory *labeltable, int *lac, int *ic)
  * @param ic2 A pointer to the instruction counter for the second pass.
  * @return 1 on success, 0 on an error, or EXIT on a critical memory error.
  */
-int second_pass(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct error *errortable, struct external *extable, int *ec, int *lac, int *exsize, int *esize, int *exc, int *cl_pass2, int *ic2)
+int second_pass(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct error **errortable, struct external **extable, int *ec, int *lac, int *exsize, int *esize, int *exc, int *cl_pass2, int *ic2)
 {
 	char *word1 = NULL;
 	char *word2 = NULL;
@@ -139,8 +139,8 @@ int second_pass(char str[], struct instructionsMemory *instable, struct labelMem
  * @param str The operand string.
  * @param labeltable A pointer to the label memory table.
  * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
- * @param extable A pointer to the external labels table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
  * @param ec A pointer to the error counter.
  * @param ic2 A pointer to the instruction counter for the second pass.
  * @param lac A pointer to the label counter.
@@ -150,7 +150,7 @@ int second_pass(char str[], struct instructionsMemory *instable, struct labelMem
  * @param cl_pass2 A pointer to the current line number for the second pass.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int instruction_uptade_address(char str[], struct labelMemory *labeltable, struct instructionsMemory *instable, struct error *errortable, struct external *extable, int *ec, int *ic2, int *lac, int *exsize, int *esize, int *exc, int *cl_pass2)
+int instruction_uptade_address(char str[], struct labelMemory *labeltable, struct instructionsMemory *instable, struct error **errortable, struct external **extable, int *ec, int *ic2, int *lac, int *exsize, int *esize, int *exc, int *cl_pass2)
 {
 	char *word1 = NULL;
 	char *word2 = NULL;
@@ -253,13 +253,15 @@ int instruction_uptade_address(char str[], struct labelMemory *labeltable, struc
  * instruction memory word at the current instruction counter (`ic2`) with the label's
  * final address and its relocation type (relocatable, external, or absolute). If the label
  * is external, it also adds it to the external table. If the label is not found,
- * it reports an error.
+ * it reports an error. With `--xref`, every resolved operand is recorded as a
+ * reference to its label. In `--check` mode only the existence of the label
+ * is checked.
  *
  * @param str The label name to search for.
  * @param instable A pointer to the instruction memory table.
  * @param labeltable A pointer to the label memory table.
- * @param extable A pointer to the external labels table.
- * @param errortable A pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param errortable The address of the pointer to the error table.
  * @param esize A pointer to the size of the error table.
  * @param exsize A pointer to the size of the external table.
  * @param exc A pointer to the external label counter.
@@ -269,36 +271,39 @@ int instruction_uptade_address(char str[], struct labelMemory *labeltable, struc
  * @param ec A pointer to the error counter.
  * @return 1 on success, 0 if the label is not found, or EXIT on a critical memory error.
  */
-int search_and_update(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct external *extable, struct error *errortable, int *esize, int *exsize, int *exc, int *lac, int *ic2, int *cl_pass2, int *ec)
+int search_and_update(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct external **extable, struct error **errortable, int *esize, int *exsize, int *exc, int *lac, int *ic2, int *cl_pass2, int *ec)
 {
-	int i = 0;
-	for(; i < *lac; i++)
+	int i;
+	if(lsp_note_name(LSP_NAME_REFERENCE, str, *ec) == EXIT){return EXIT;}
+	for(i = find_label(labeltable, *lac, str); i >= 0; i = next_label(labeltable, *lac, i))
 	{
-		if(strcmp(labeltable[i].name, str) == 0)
+		if(xref_reference(str, *cl_pass2, *ic2 + MEMORY_START) == EXIT){return EXIT;}
+		if(CHECK_ONLY)
 		{
-			instable[*ic2].type = RECORD_TYPE_ADDRESS;
-			if(labeltable[i].en == EXTERN)
-			{
-				add_extern(str, &extable, exsize, exc, *ic2 + MEMORY_START);
-				instable[*ic2].data.addr.address = 0;
-				instable[*ic2].data.addr.ARE = EXTERNAL;
-				return 1;
-			}
-			else if(labeltable[i].en == ENTRY)
-			{
-				instable[*ic2].data.addr.address = labeltable[i].index;
-				instable[*ic2].data.addr.ARE = RELOCATABLE;
-				return 1;
-			}
-			else
-			{
-				instable[*ic2].data.addr.address = labeltable[i].index;
-				instable[*ic2].data.addr.ARE = RELOCATABLE;
-				return 1;
-			}
+			return 1;
+		}
+		instable[*ic2].type = RECORD_TYPE_ADDRESS;
+		if(labeltable[i].en == EXTERN)
+		{
+			add_extern(str, extable, exsize, exc, *ic2 + MEMORY_START);
+			instable[*ic2].data.addr.address = 0;
+			instable[*ic2].data.addr.ARE = EXTERNAL;
+			return 1;
+		}
+		else if(labeltable[i].en == ENTRY)
+		{
+			instable[*ic2].data.addr.address = labeltable[i].index;
+			instable[*ic2].data.addr.ARE = RELOCATABLE;
+			return 1;
+		}
+		else
+		{
+			instable[*ic2].data.addr.address = labeltable[i].index;
+			instable[*ic2].data.addr.ARE = RELOCATABLE;
+			return 1;
 		}
 	}
-	if(add_error(&errortable, ec, *cl_pass2, ": error! Label name is not defined", esize) == EXIT){return EXIT;}
+	if(add_error(errortable, ec, *cl_pass2, ": error! Label name is not defined", esize) == EXIT){return EXIT;}
 	return 0;
 }
 
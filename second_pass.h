@@ -51,8 +51,8 @@ void index_update(struct labelMemory *labeltable, int *lac, int *ic);
  * @param str The line of assembly code to process.
  * @param instable A pointer to the instruction memory table.
  * @param labeltable A pointer to the label memory table.
- * @param errortable A pointer to the error table.
- * @param extable A pointer to the external labels table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
  * @param ec A pointer to the error counter.
  * @param lac A pointer to the label counter.
  * @param exsize A pointer to the size of the external table.
@@ -62,7 +62,7 @@ void index_update(struct labelMemory *labeltable, int *lac, int *ic);
  * @param ic2 A pointer to the instruction counter for the second pass.
  * @return 1 on success, 0 on an error, or EXIT on a critical memory error.
  */
-int second_pass(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct error *errortable, struct external *extable, int *ec, int *lac, int *exsize, int *esize, int *exc, int *cl_pass2, int *ic2);
+int second_pass(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct error **errortable, struct external **extable, int *ec, int *lac, int *exsize, int *esize, int *exc, int *cl_pass2, int *ic2);
 
 /**
  * @brief Updates instruction memory with resolved addresses for operands.
@@ -74,8 +74,8 @@ int second_pass(char str[], struct instructionsMemory *instable, struct labelMem
  * @param str The string containing the operands.
  * @param labeltable A pointer to the label memory table.
  * @param instable A pointer to the instruction memory table.
- * @param errortable A pointer to the error table.
- * @param extable A pointer to the external labels table.
+ * @param errortable The address of the pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
  * @param ec A pointer to the error counter.
  * @param ic2 A pointer to the instruction counter for the second pass.
  * @param lac A pointer to the label counter.
@@ -85,7 +85,7 @@ int second_pass(char str[], struct instructionsMemory *instable, struct labelMem
  * @param lc_pass2 A pointer to the current line number for the second pass.
  * @return 1 on success, or EXIT on a critical memory error.
  */
-int instruction_uptade_address(char str[], struct labelMemory *labeltable, struct instructionsMemory *instable, struct error *errortable, struct external *extable, int *ec, int *ic2, int *lac, int *exsize, int *esize, int *exc, int *lc_pass2);
+int instruction_uptade_address(char str[], struct labelMemory *labeltable, struct instructionsMemory *instable, struct error **errortable, struct external **extable, int *ec, int *ic2, int *lac, int *exsize, int *esize, int *exc, int *lc_pass2);
 
 /**
  * @brief Finds a label's address and updates the instruction memory.
@@ -97,8 +97,8 @@ int instruction_uptade_address(char str[], struct labelMemory *labeltable, struc
  * @param str The label name to search for.
  * @param instable A pointer to the instruction memory table.
  * @param labeltable A pointer to the label memory table.
- * @param extable A pointer to the external labels table.
- * @param errortable A pointer to the error table.
+ * @param extable The address of the pointer to the external labels table.
+ * @param errortable The address of the pointer to the error table.
  * @param esize A pointer to the size of the error table.
  * @param exsize A pointer to the size of the external table.
  * @param exc A pointer to the external label counter.
@@ -108,7 +108,7 @@ int instruction_uptade_address(char str[], struct labelMemory *labeltable, struc
  * @param ec A pointer to the error counter.
  * @return 1 on success, 0 if the label is not found, or EXIT on a critical memory error.
  */
-int search_and_update(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct external *extable, struct error *errortable, int *esize, int *exsize, int *exc, int *lac, int *ic2, int *cl, int *ec);
+int search_and_update(char str[], struct instructionsMemory *instable, struct labelMemory *labeltable, struct external **extable, struct error **errortable, int *esize, int *exsize, int *exc, int *lac, int *ic2, int *cl, int *ec);
 
 /**
  * @brief Converts a digit (0-3) to its special base-4 character representation ('a'-'d').
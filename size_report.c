@@ -0,0 +1,383 @@
+#include "size_report.h"
+
+/**
+ * @brief Orders labels by address (a `qsort` comparator).
+ *
+ * @param a A pointer to the first label.
+ * @param b A pointer to the second label.
+ * @return A negative, zero or positive value.
+ */
+int compare_symbol_addresses(const void *a, const void *b)
+{
+	return ((const struct external *)a)->index - ((const struct external *)b)->index;
+}
+
+/**
+ * @brief Compares two names that may be NULL; NULL comes first.
+ *
+ * @param a The first name, or NULL.
+ * @param b The second name, or NULL.
+ * @return A negative, zero or positive value.
+ */
+int compare_optional_names(const char *a, const char *b)
+{
+	if(a == NULL || b == NULL)
+	{
+		return (a != NULL) - (b != NULL);
+	}
+	return strcmp(a, b);
+}
+
+/**
+ * @brief Orders size rows by label (a `qsort` comparator).
+ *
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_rows_by_label(const void *a, const void *b)
+{
+	return compare_optional_names(((const struct size_row *)a)->label, ((const struct size_row *)b)->label);
+}
+
+/**
+ * @brief Orders size rows by macro (a `qsort` comparator).
+ *
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_rows_by_macro(const void *a, const void *b)
+{
+	return compare_optional_names(((const struct size_row *)a)->macro, ((const struct size_row *)b)->macro);
+}
+
+/**
+ * @brief Orders size rows by words, largest first, then by line (a `qsort` comparator).
+ *
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_rows_by_words(const void *a, const void *b)
+{
+	const struct size_row *first = (const struct size_row *)a;
+	const struct size_row *second = (const struct size_row *)b;
+	if(first->words != second->words)
+	{
+		return second->words - first->words;
+	}
+	if(first->line != second->line)
+	{
+		return first->line - second->line;
+	}
+	return second->code - first->code;
+}
+
+/**
+ * @brief Orders totals by words, largest first, then by name (a `qsort` comparator).
+ *
+ * @param a A pointer to the first total.
+ * @param b A pointer to the second total.
+ * @return A negative, zero or positive value.
+ */
+int compare_size_totals(const void *a, const void *b)
+{
+	const struct size_total *first = (const struct size_total *)a;
+	const struct size_total *second = (const struct size_total *)b;
+	if(first->words != second->words)
+	{
+		return second->words - first->words;
+	}
+	return compare_optional_names(first->name, second->name);
+}
+
+/**
+ * @brief Finds the label a word belongs to.
+ *
+ * The words of a segment belong to the last label before them, so the label
+ * is found by binary search over the labels sorted by address.
+ *
+ * @param labels The labels of the word's segment, sorted by address.
+ * @param count The number of labels.
+ * @param address The address of the word.
+ * @return The name of the last label at or before the address, or NULL if there is none.
+ */
+const char *enclosing_label(const struct external *labels, int count, int address)
+{
+	int low = 0, high = count - 1, mid, found = -1;
+	while(low <= high)
+	{
+		mid = (low + high) / 2;
+		if(labels[mid].index <= address)
+		{
+			found = mid;
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+	return (found < 0) ? NULL : labels[found].name;
+}
+
+/**
+ * @brief Describes where an expanded line came from as `file:line`.
+ *
+ * @param source The base name of the source file, without its suffix.
+ * @param origin The origin of the line.
+ * @return A dynamically allocated string, or NULL on a memory allocation failure.
+ */
+char *size_line_location(const char *source, const LineOrigin *origin)
+{
+	char *location;
+	if(origin->file != NULL)
+	{
+		location = (char *)malloc(strlen(origin->file) + LSP_MAX_NUMBER + 2);
+		if(location != NULL){sprintf(location, "%s:%d", origin->file, origin->file_line);}
+	}
+	else
+	{
+		location = (char *)malloc(strlen(source) + strlen(END_SOURCE_FILE_NAME) + LSP_MAX_NUMBER + 2);
+		if(location != NULL){sprintf(location, "%s%s:%d", source, END_SOURCE_FILE_NAME, origin->line);}
+	}
+	if(location == NULL){fprintf(stdout,"Memory allocation failed");}
+	return location;
+}
+
+/**
+ * @brief Writes the words per label or per macro, largest first.
+ *
+ * The rows are already sorted by the grouping name, so every group is a run
+ * of rows; the group totals are then sorted by size.
+ *
+ * @param fileptr The report file.
+ * @param title The title of the first column.
+ * @param rows The rows, sorted by the label or macro.
+ * @param count The number of rows.
+ * @param by_macro Non-zero to group by macro, zero to group by label.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int print_size_totals(FILE *fileptr, const char *title, const struct size_row *rows, int count, int by_macro)
+{
+	struct size_total *totals = (struct size_total *)malloc((count + 1) * sizeof(struct size_total));
+	const char *group;
+	int i, num_totals = 0;
+	if(totals == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return EXIT;
+	}
+	for(i = 0; i < count; i++)
+	{
+		group = by_macro ? rows[i].macro : rows[i].label;
+		if(num_totals == 0 || compare_optional_names(totals[num_totals - 1].name, group) != 0)
+		{
+			totals[num_totals].name = group;
+			totals[num_totals].words = 0;
+			num_totals++;
+		}
+		totals[num_totals - 1].words += rows[i].words;
+	}
+	qsort(totals, (size_t)num_totals, sizeof(struct size_total), compare_size_totals);
+	fprintf(fileptr, "\n%s\twords\n", title);
+	for(i = 0; i < num_totals; i++)
+	{
+		fprintf(fileptr, "%s\t%d\n", (totals[i].name != NULL) ? totals[i].name : SIZE_NO_NAME, totals[i].words);
+	}
+	free(totals);
+	return 1;
+}
+
+/**
+ * @brief Writes the `.size` report and its treemap JSON.
+ *
+ * Every line's instruction words start where the previous line's ended, and
+ * so do its data words, which follow all instruction words as in
+ * `index_update`. That gives the address of every word and, through the
+ * labels sorted by address, the label it belongs to.
+ *
+ * The JSON tree is built in address order: the segments `code` and `data`,
+ * the labels of each segment, and the lines of each label as leaves with
+ * their number of words and macro.
+ *
+ * @param name The name of the `.size` file.
+ * @param json_name The name of the `.size.json` file.
+ * @param source The base name of the source file, without its suffix.
+ * @param expanded A pointer to the expanded source.
+ * @param sizes The words the first pass allocated for every expanded line.
+ * @param labeltable A pointer to the label table.
+ * @param lac The number of labels.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_size_report(const char *name, const char *json_name, const char *source, const ExpandedSource *expanded, const struct line_size *sizes, struct labelMemory *labeltable, int lac, int ic, int dc)
+{
+	FILE *fileptr = NULL;
+	struct external *code_labels = NULL, *data_labels = NULL;
+	struct size_row *rows = NULL;
+	struct lsp_buffer json = {NULL, 0, 0};
+	char *location = NULL;
+	const char *group = NULL;
+	int i, code, num_code = 0, num_data = 0, num_rows = 0, code_address = MEMORY_START, data_address = MEMORY_START + ic, open_group, written, status = EXIT;
+
+	code_labels = (struct external *)malloc((lac + 1) * sizeof(struct external));
+	data_labels = (struct external *)malloc((lac + 1) * sizeof(struct external));
+	rows = (struct size_row *)malloc((2 * expanded->count + 1) * sizeof(struct size_row));
+	if(code_labels == NULL || data_labels == NULL || rows == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		goto clean;
+	}
+
+	/* Sort the labels of each segment by address. */
+	for(i = 0; i < lac; i++)
+	{
+		if(labeltable[i].en == EXTERN)
+		{
+			continue;
+		}
+		if(labeltable[i].type == INSTRUCTION)
+		{
+			strcpy(code_labels[num_code].name, labeltable[i].name);
+			code_labels[num_code++].index = labeltable[i].index;
+		}
+		else if(labeltable[i].type == DIRECTIVE)
+		{
+			strcpy(data_labels[num_data].name, labeltable[i].name);
+			data_labels[num_data++].index = labeltable[i].index;
+		}
+	}
+	qsort(code_labels, (size_t)num_code, sizeof(struct external), compare_symbol_addresses);
+	qsort(data_labels, (size_t)num_data, sizeof(struct external), compare_symbol_addresses);
+
+	/* One row for every line and segment that allocated words. */
+	for(i = 0; i < expanded->count; i++)
+	{
+		if(sizes[i].ic > 0)
+		{
+			rows[num_rows].line = i;
+			rows[num_rows].address = code_address;
+			rows[num_rows].words = sizes[i].ic;
+			rows[num_rows].code = 1;
+			rows[num_rows].label = enclosing_label(code_labels, num_code, code_address);
+			rows[num_rows].macro = expanded->origins[i].macro;
+			code_address += sizes[i].ic;
+			num_rows++;
+		}
+		if(sizes[i].dc > 0)
+		{
+			rows[num_rows].line = i;
+			rows[num_rows].address = data_address;
+			rows[num_rows].words = sizes[i].dc;
+			rows[num_rows].code = 0;
+			rows[num_rows].label = enclosing_label(data_labels, num_data, data_address);
+			rows[num_rows].macro = expanded->origins[i].macro;
+			data_address += sizes[i].dc;
+			num_rows++;
+		}
+	}
+
+	/* The treemap JSON, built while the rows are in address order per segment. */
+	if(buffer_append(&json, "{\"name\":") == EXIT || buffer_append_json_string(&json, source) == EXIT || buffer_append(&json, ",\"children\":[") == EXIT){goto clean;}
+	for(code = 1; code >= 0; code--)
+	{
+		if(buffer_append(&json, code ? "{\"name\":\"code\",\"children\":[" : ",{\"name\":\"data\",\"children\":[") == EXIT){goto clean;}
+		open_group = 0;
+		for(i = 0; i < num_rows; i++)
+		{
+			if(rows[i].code != code)
+			{
+				continue;
+			}
+			if(!open_group || compare_optional_names(group, rows[i].label) != 0)
+			{
+				if(open_group && buffer_append(&json, "]},") == EXIT){goto clean;}
+				group = rows[i].label;
+				if(buffer_append(&json, "{\"name\":") == EXIT || buffer_append_json_string(&json, (group != NULL) ? group : SIZE_NO_NAME) == EXIT || buffer_append(&json, ",\"children\":[") == EXIT){goto clean;}
+				open_group = 1;
+			}
+			else if(buffer_append(&json, ",") == EXIT){goto clean;}
+			location = size_line_location(source, &expanded->origins[rows[i].line]);
+			if(location == NULL){goto clean;}
+			if(buffer_append(&json, "{\"name\":") == EXIT || buffer_append_json_string(&json, location) == EXIT || buffer_append(&json, ",\"value\":") == EXIT || buffer_append_int(&json, rows[i].words) == EXIT || buffer_append(&json, ",\"macro\":") == EXIT){goto clean;}
+			if(rows[i].macro != NULL)
+			{
+				if(buffer_append_json_string(&json, rows[i].macro) == EXIT){goto clean;}
+			}
+			else if(buffer_append(&json, "null") == EXIT){goto clean;}
+			if(buffer_append(&json, "}") == EXIT){goto clean;}
+			free(location);
+			location = NULL;
+		}
+		if(open_group && buffer_append(&json, "]}") == EXIT){goto clean;}
+		if(buffer_append(&json, "]}") == EXIT){goto clean;}
+	}
+	if(buffer_append(&json, "]}\n") == EXIT){goto clean;}
+	fileptr = open_output(json_name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	written = (fwrite(json.data, 1, json.len, fileptr) == json.len);
+	if(fclose(fileptr) != 0 || !written)
+	{
+		fprintf(stdout,"error writing file!\n");
+		fileptr = NULL;
+		discard_output(json_name);
+		goto clean;
+	}
+	fileptr = NULL;
+	if(commit_output(json_name) == EXIT){goto clean;}
+
+	/* The text report. */
+	fileptr = open_output(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	fprintf(fileptr, "total\t%d of %d words (code %d, data %d)\n", ic + dc, MAX_SIZE_MEMORY, ic, dc);
+	qsort(rows, (size_t)num_rows, sizeof(struct size_row), compare_rows_by_label);
+	if(print_size_totals(fileptr, "label", rows, num_rows, 0) == EXIT){goto clean;}
+	qsort(rows, (size_t)num_rows, sizeof(struct size_row), compare_rows_by_macro);
+	if(print_size_totals(fileptr, "macro", rows, num_rows, 1) == EXIT){goto clean;}
+	qsort(rows, (size_t)num_rows, sizeof(struct size_row), compare_rows_by_words);
+	fprintf(fileptr, "\nline\twords\tsegment\tlabel\tmacro\n");
+	for(i = 0; i < num_rows; i++)
+	{
+		location = size_line_location(source, &expanded->origins[rows[i].line]);
+		if(location == NULL){goto clean;}
+		fprintf(fileptr, "%s\t%d\t%s\t%s\t%s\n", location, rows[i].words, rows[i].code ? "code" : "data", (rows[i].label != NULL) ? rows[i].label : SIZE_NO_NAME, (rows[i].macro != NULL) ? rows[i].macro : SIZE_NO_NAME);
+		free(location);
+		location = NULL;
+	}
+	status = 1;
+
+	clean:
+		if(fileptr != NULL)
+		{
+			if(fclose(fileptr) != 0)
+			{
+				fprintf(stdout,"error writing file!\n");
+				status = EXIT;
+			}
+			if(status == EXIT)
+			{
+				discard_output(name);
+			}
+			else if(commit_output(name) == EXIT)
+			{
+				status = EXIT;
+			}
+		}
+		free(location);
+		free(json.data);
+		free(code_labels);
+		free(data_labels);
+		free(rows);
+		return status;
+}
@@ -0,0 +1,174 @@
+#ifndef SIZE_REPORT_H
+#define SIZE_REPORT_H
+
+/**
+ * @file size_report.h
+ * @brief This header file declares the code-size attribution report.
+ *
+ * The first pass records how many instruction and data words every expanded
+ * line allocated. The report attributes those words to the source line they
+ * came from (through included files), to the label they belong to and to the
+ * macro whose expansion produced them, and writes:
+ *
+ * - A `.size` text file with the total, the words per label and per macro
+ *   (largest first) and every line that allocated words.
+ * - A `.size.json` file with the same words as a tree (segment, label, line)
+ *   in the `name`/`children`/`value` shape that treemap tools read.
+ *
+ * The report is written even when the program does not fit in memory, which
+ * is when it is needed most.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "code.h"
+#include "pre_assembler.h"
+#include "lsp.h"
+#include "assembler.h"
+
+/**
+ * @def END_SIZE_FILE_NAME
+ * @brief Suffix for the size report.
+ */
+#define END_SIZE_FILE_NAME ".size"
+
+/**
+ * @def END_SIZE_JSON_FILE_NAME
+ * @brief Suffix for the treemap JSON of the size report.
+ */
+#define END_SIZE_JSON_FILE_NAME ".size.json"
+
+/**
+ * @def SIZE_NO_NAME
+ * @brief How words outside any label or macro are listed.
+ */
+#define SIZE_NO_NAME "(none)"
+
+/**
+ * @struct size_row
+ * @brief The words one line allocated in one segment.
+ *
+ * - `line`: The index of the expanded line.
+ * - `address`: The address of the first word.
+ * - `words`: The number of words.
+ * - `code`: Non-zero for instruction words, zero for data words.
+ * - `label`: The label the words belong to, or NULL.
+ * - `macro`: The macro whose expansion produced the line, or NULL.
+ */
+struct size_row
+{
+	int line;
+	int address;
+	int words;
+	int code;
+	const char *label;
+	const char *macro;
+};
+
+/**
+ * @struct size_total
+ * @brief The words attributed to one label or macro.
+ *
+ * - `name`: The label or macro, or NULL for words outside any.
+ * - `words`: The number of words.
+ */
+struct size_total
+{
+	const char *name;
+	int words;
+};
+
+/**
+ * @brief Orders labels by address (a `qsort` comparator).
+ * @param a A pointer to the first label.
+ * @param b A pointer to the second label.
+ * @return A negative, zero or positive value.
+ */
+int compare_symbol_addresses(const void *a, const void *b);
+
+/**
+ * @brief Compares two names that may be NULL; NULL comes first.
+ * @param a The first name, or NULL.
+ * @param b The second name, or NULL.
+ * @return A negative, zero or positive value.
+ */
+int compare_optional_names(const char *a, const char *b);
+
+/**
+ * @brief Orders size rows by label (a `qsort` comparator).
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_rows_by_label(const void *a, const void *b);
+
+/**
+ * @brief Orders size rows by macro (a `qsort` comparator).
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_rows_by_macro(const void *a, const void *b);
+
+/**
+ * @brief Orders size rows by words, largest first, then by line (a `qsort` comparator).
+ * @param a A pointer to the first row.
+ * @param b A pointer to the second row.
+ * @return A negative, zero or positive value.
+ */
+int compare_rows_by_words(const void *a, const void *b);
+
+/**
+ * @brief Orders totals by words, largest first, then by name (a `qsort` comparator).
+ * @param a A pointer to the first total.
+ * @param b A pointer to the second total.
+ * @return A negative, zero or positive value.
+ */
+int compare_size_totals(const void *a, const void *b);
+
+/**
+ * @brief Finds the label a word belongs to.
+ * @param labels The labels of the word's segment, sorted by address.
+ * @param count The number of labels.
+ * @param address The address of the word.
+ * @return The name of the last label at or before the address, or NULL if there is none.
+ */
+const char *enclosing_label(const struct external *labels, int count, int address);
+
+/**
+ * @brief Describes where an expanded line came from as `file:line`.
+ * @param source The base name of the source file, without its suffix.
+ * @param origin The origin of the line.
+ * @return A dynamically allocated string, or NULL on a memory allocation failure.
+ */
+char *size_line_location(const char *source, const LineOrigin *origin);
+
+/**
+ * @brief Writes the words per label or per macro, largest first.
+ * @param fileptr The report file.
+ * @param title The title of the first column.
+ * @param rows The rows, sorted by the label or macro.
+ * @param count The number of rows.
+ * @param by_macro Non-zero to group by macro, zero to group by label.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int print_size_totals(FILE *fileptr, const char *title, const struct size_row *rows, int count, int by_macro);
+
+/**
+ * @brief Writes the `.size` report and its treemap JSON.
+ * @param name The name of the `.size` file.
+ * @param json_name The name of the `.size.json` file.
+ * @param source The base name of the source file, without its suffix.
+ * @param expanded A pointer to the expanded source.
+ * @param sizes The words the first pass allocated for every expanded line.
+ * @param labeltable A pointer to the label table.
+ * @param lac The number of labels.
+ * @param ic The number of instruction words.
+ * @param dc The number of data words.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_size_report(const char *name, const char *json_name, const char *source, const ExpandedSource *expanded, const struct line_size *sizes, struct labelMemory *labeltable, int lac, int ic, int dc);
+
+#endif /* SIZE_REPORT_H */
@@ -0,0 +1,436 @@
+#define _DEFAULT_SOURCE
+#include <unistd.h>
+#include <sys/mman.h>
+#include "spill.h"
+
+struct spill_store SPILL = {0, 0, 0, 0, NULL, 0, 0, -1, 0};
+
+/**
+ * @brief Parses a size in bytes, with an optional K, M or G suffix.
+ *
+ * The suffixes are binary (K is 1024 bytes) and may be lower case. A size of
+ * zero, or one that does not fit in a `size_t`, is not valid.
+ *
+ * @param text The size.
+ * @param bytes Receives the size in bytes.
+ * @return 1 on success, or 0 if the size is not valid.
+ */
+int parse_memory_budget(const char *text, size_t *bytes)
+{
+	size_t value = 0, unit = 1, digit;
+	const char *p = text;
+	if(*p < '0' || *p > '9')
+	{
+		return 0;
+	}
+	for(; *p >= '0' && *p <= '9'; p++)
+	{
+		digit = (size_t)(*p - '0');
+		if(value > ((size_t)-1 - digit) / 10)
+		{
+			return 0;
+		}
+		value = value * 10 + digit;
+	}
+	if(*p == 'K' || *p == 'k')
+	{
+		unit = 1024;
+	}
+	else if(*p == 'M' || *p == 'm')
+	{
+		unit = 1024L * 1024;
+	}
+	else if(*p == 'G' || *p == 'g')
+	{
+		unit = 1024L * 1024 * 1024;
+	}
+	else if(*p != '\0')
+	{
+		return 0;
+	}
+	if(*p != '\0' && p[1] != '\0')
+	{
+		return 0;
+	}
+	if(value == 0 || value > (size_t)-1 / unit)
+	{
+		return 0;
+	}
+	*bytes = value * unit;
+	return 1;
+}
+
+/**
+ * @brief Sets the memory budget of the run.
+ *
+ * @param budget The budget in bytes.
+ */
+void spill_open(size_t budget)
+{
+	SPILL.enabled = 1;
+	SPILL.budget = budget;
+	SPILL.resident = 0;
+	SPILL.spilled = 0;
+	SPILL.current = -1;
+	SPILL.hint = 0;
+}
+
+/**
+ * @brief Maps a new temporary file into memory.
+ *
+ * The file is unlinked right after it is created, so it goes away with the
+ * mapping, even if the assembler is killed. The mapping is shared, which
+ * makes the file, not the swap, the backing store of its pages.
+ *
+ * @param size The size of the mapping.
+ * @return The mapping, or NULL on an error.
+ */
+char *spill_map(size_t size)
+{
+	const char *directory = getenv("TMPDIR");
+	char *name;
+	void *base;
+	int fd;
+	if(directory == NULL || *directory == '\0')
+	{
+		directory = SPILL_DEFAULT_DIRECTORY;
+	}
+	name = (char *)malloc(strlen(directory) + sizeof(SPILL_FILE_TEMPLATE));
+	if(name == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		return NULL;
+	}
+	strcpy(name, directory);
+	strcat(name, SPILL_FILE_TEMPLATE);
+	fd = mkstemp(name);
+	if(fd < 0)
+	{
+		fprintf(stdout, "cannot create spill file in %s\n", directory);
+		free(name);
+		return NULL;
+	}
+	unlink(name);
+	free(name);
+	if(ftruncate(fd, (off_t)size) != 0)
+	{
+		fprintf(stdout, "cannot grow spill file\n");
+		close(fd);
+		return NULL;
+	}
+	base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED)
+	{
+		fprintf(stdout, "cannot map spill file\n");
+		return NULL;
+	}
+	return (char *)base;
+}
+
+/**
+ * @brief Appends an empty region to the store.
+ *
+ * @return The index of the region, or -1 on a memory allocation failure.
+ */
+int reserve_spill_region(void)
+{
+	struct spill_region *temp;
+	if(SPILL.count == SPILL.capacity)
+	{
+		temp = (struct spill_region *)realloc(SPILL.regions, (SPILL.capacity + SPILL_REGION_STEP) * sizeof(struct spill_region));
+		if(temp == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return -1;
+		}
+		SPILL.regions = temp;
+		SPILL.capacity += SPILL_REGION_STEP;
+	}
+	memset(&SPILL.regions[SPILL.count], 0, sizeof(struct spill_region));
+	return SPILL.count++;
+}
+
+/**
+ * @brief Allocates a region on the heap if the budget allows, or as a mapping.
+ *
+ * @param size The size of the region.
+ * @param used The bytes already handed out.
+ * @param live The number of allocations already in the region.
+ * @return The index of the region, or -1 on an allocation failure.
+ */
+int add_spill_region(size_t size, size_t used, long live)
+{
+	struct spill_region *region;
+	int index = reserve_spill_region();
+	if(index < 0)
+	{
+		return -1;
+	}
+	region = &SPILL.regions[index];
+	region->mapped = (SPILL.resident + size > SPILL.budget);
+	region->base = region->mapped ? spill_map(size) : (char *)malloc(size);
+	if(region->base == NULL)
+	{
+		if(!region->mapped)
+		{
+			fprintf(stdout,"Memory allocation failed");
+		}
+		SPILL.count--;
+		return -1;
+	}
+	region->size = size;
+	region->used = used;
+	region->live = live;
+	if(region->mapped)
+	{
+		SPILL.spilled += size;
+	}
+	else
+	{
+		SPILL.resident += size;
+	}
+	return index;
+}
+
+/**
+ * @brief Finds the region a pointer lies in.
+ *
+ * Lines are mostly freed in the order they were carved, so the region found
+ * last is tried before the others are searched.
+ *
+ * @param ptr The pointer.
+ * @return The index of the region, or -1 if the pointer lies in none.
+ */
+int find_spill_region(const void *ptr)
+{
+	const char *p = (const char *)ptr;
+	struct spill_region *region;
+	int i;
+	if(SPILL.hint < SPILL.count)
+	{
+		region = &SPILL.regions[SPILL.hint];
+		if(p >= region->base && p < region->base + region->size)
+		{
+			return SPILL.hint;
+		}
+	}
+	for(i = 0; i < SPILL.count; i++)
+	{
+		region = &SPILL.regions[i];
+		if(p >= region->base && p < region->base + region->size)
+		{
+			SPILL.hint = i;
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Frees a region and removes it from the store.
+ *
+ * The last region takes its place in the array.
+ *
+ * @param index The index of the region.
+ */
+void release_spill_region(int index)
+{
+	struct spill_region *region = &SPILL.regions[index];
+	if(region->mapped)
+	{
+		munmap(region->base, region->size);
+		SPILL.spilled -= region->size;
+	}
+	else
+	{
+		free(region->base);
+		SPILL.resident -= region->size;
+	}
+	SPILL.count--;
+	SPILL.regions[index] = SPILL.regions[SPILL.count];
+	if(SPILL.current == index)
+	{
+		SPILL.current = -1;
+	}
+	else if(SPILL.current == SPILL.count)
+	{
+		SPILL.current = index;
+	}
+	SPILL.hint = 0;
+}
+
+/**
+ * @brief Allocates storage for the text of a line.
+ *
+ * The text is carved from the current chunk. When it does not fit, a new
+ * chunk is started, on the heap while the budget allows and as a mapping
+ * after that; a line longer than a chunk gets a chunk of its own size. The
+ * chunk that is given up is freed at once if all its lines already were.
+ *
+ * @param size The size in bytes.
+ * @return The storage, or NULL on an allocation failure.
+ */
+void *spill_alloc(size_t size)
+{
+	struct spill_region *region;
+	int index;
+	if(!SPILL.enabled)
+	{
+		return malloc(size);
+	}
+	if(SPILL.current < 0 || SPILL.regions[SPILL.current].size - SPILL.regions[SPILL.current].used < size)
+	{
+		index = add_spill_region((size > (size_t)SPILL_CHUNK_SIZE) ? size : (size_t)SPILL_CHUNK_SIZE, 0, 0);
+		if(index < 0)
+		{
+			return NULL;
+		}
+		if(SPILL.current >= 0 && SPILL.regions[SPILL.current].live == 0)
+		{
+			/* The new chunk may move into the freed slot. */
+			if(index == SPILL.count - 1)
+			{
+				index = SPILL.current;
+			}
+			release_spill_region(SPILL.current);
+		}
+		SPILL.current = index;
+	}
+	region = &SPILL.regions[SPILL.current];
+	region->used += size;
+	region->live++;
+	return region->base + region->used - size;
+}
+
+/**
+ * @brief Resizes an array or table, moving it to a mapping when the budget is used up.
+ *
+ * While the heap regions fit in the budget the array stays on the heap and is
+ * resized with `realloc`. Past the budget it moves to a new mapping, and once
+ * mapped it stays mapped: every later growth maps a larger file and copies
+ * the array over. Arrays are grown by doubling, so the copies add up to no
+ * more than the final size. An array that was allocated outside the store
+ * (the first table of a file) joins it here.
+ *
+ * @param ptr The array, or NULL.
+ * @param old_size The size of the array in bytes.
+ * @param new_size The new size in bytes.
+ * @return The resized array, or NULL on an allocation failure (the array is left as it was).
+ */
+void *spill_resize(void *ptr, size_t old_size, size_t new_size)
+{
+	struct spill_region *region;
+	char *base;
+	int index, spilled;
+	if(!SPILL.enabled)
+	{
+		return realloc(ptr, new_size);
+	}
+	index = (ptr != NULL) ? find_spill_region(ptr) : -1;
+	spilled = (index >= 0 && SPILL.regions[index].mapped);
+	if(!spilled && SPILL.resident - ((index >= 0) ? SPILL.regions[index].size : 0) + new_size <= SPILL.budget)
+	{
+		if(index < 0)
+		{
+			/* Join the store as an empty heap region that the resize fills in. */
+			index = reserve_spill_region();
+			if(index < 0)
+			{
+				return NULL;
+			}
+			SPILL.regions[index].live = 1;
+		}
+		base = (char *)realloc(ptr, new_size);
+		if(base == NULL)
+		{
+			if(SPILL.regions[index].base == NULL)
+			{
+				SPILL.count--;
+			}
+			return NULL;
+		}
+		region = &SPILL.regions[index];
+		SPILL.resident += new_size - region->size;
+		region->base = base;
+		region->size = new_size;
+		region->used = new_size;
+		return base;
+	}
+	if(reserve_spill_region() < 0)
+	{
+		return NULL;
+	}
+	base = spill_map(new_size);
+	if(base == NULL)
+	{
+		SPILL.count--;
+		return NULL;
+	}
+	region = &SPILL.regions[SPILL.count - 1];
+	region->base = base;
+	region->size = new_size;
+	region->used = new_size;
+	region->live = 1;
+	region->mapped = 1;
+	SPILL.spilled += new_size;
+	if(ptr != NULL)
+	{
+		memcpy(base, ptr, (old_size < new_size) ? old_size : new_size);
+	}
+	if(index >= 0)
+	{
+		release_spill_region(index);
+	}
+	else
+	{
+		free(ptr);
+	}
+	return base;
+}
+
+/**
+ * @brief Frees a line, an array or a table.
+ *
+ * A line only lowers the count of its chunk; the chunk is freed with its last
+ * line, unless lines are still being carved from it. Storage from outside the
+ * store is passed to `free`.
+ *
+ * @param ptr The storage, or NULL.
+ */
+void spill_free(void *ptr)
+{
+	int index;
+	if(!SPILL.enabled || ptr == NULL)
+	{
+		free(ptr);
+		return;
+	}
+	index = find_spill_region(ptr);
+	if(index < 0)
+	{
+		free(ptr);
+		return;
+	}
+	SPILL.regions[index].live--;
+	if(SPILL.regions[index].live == 0 && index != SPILL.current)
+	{
+		release_spill_region(index);
+	}
+}
+
+/**
+ * @brief Frees every region and turns the budget off.
+ */
+void spill_close(void)
+{
+	while(SPILL.count > 0)
+	{
+		release_spill_region(SPILL.count - 1);
+	}
+	free(SPILL.regions);
+	SPILL.regions = NULL;
+	SPILL.capacity = 0;
+	SPILL.current = -1;
+	SPILL.enabled = 0;
+}
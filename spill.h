@@ -0,0 +1,181 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+/**
+ * @file spill.h
+ * @brief This header file declares the memory budget and the spill-to-disk store.
+ *
+ * With `--memory-budget SIZE` the storage that grows with the size of the
+ * input is kept under a budget: the text of every line that is read or
+ * expanded, the arrays of lines and origins, and the instruction, data and
+ * label tables. Line text is carved, in order, out of chunks of
+ * `SPILL_CHUNK_SIZE` bytes; the arrays and tables are regions of their own
+ * that move when they grow. While the budget allows, a chunk or region is
+ * ordinary heap memory. Beyond it, it is a shared mapping of a temporary file
+ * that is unlinked as soon as it is created, so its pages are backed by the
+ * file and the kernel writes them out and drops them under memory pressure
+ * instead of the process being killed. The passes keep working on plain
+ * pointers and do not know which storage they use.
+ *
+ * The temporary files are created in `TMPDIR`, or in `/tmp`; on a `tmpfs`
+ * they are memory again, so `TMPDIR` should name a disk.
+ *
+ * Without a budget, `spill_alloc`, `spill_resize` and `spill_free` are
+ * `malloc`, `realloc` and `free`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @def SPILL_CHUNK_SIZE
+ * @brief The size of a chunk of line text, in bytes.
+ */
+#define SPILL_CHUNK_SIZE (1L << 20)
+
+/**
+ * @def SPILL_REGION_STEP
+ * @brief The number of regions the store grows by.
+ */
+#define SPILL_REGION_STEP 64
+
+/**
+ * @def SPILL_FILE_TEMPLATE
+ * @brief The name of a temporary file, after the directory.
+ */
+#define SPILL_FILE_TEMPLATE "/asm-spill-XXXXXX"
+
+/**
+ * @def SPILL_DEFAULT_DIRECTORY
+ * @brief The directory of the temporary files when `TMPDIR` is not set.
+ */
+#define SPILL_DEFAULT_DIRECTORY "/tmp"
+
+/**
+ * @struct spill_region
+ * @brief A chunk of line text, or an array or table that can move.
+ *
+ * - `base`: The first byte.
+ * - `size`: The size in bytes.
+ * - `used`: The bytes of a chunk handed out so far; `size` for a table.
+ * - `live`: The lines of a chunk not freed yet; 1 for a table.
+ * - `mapped`: Non-zero when the region is a mapping of a temporary file.
+ */
+struct spill_region
+{
+	char *base;
+	size_t size;
+	size_t used;
+	long live;
+	int mapped;
+};
+
+/**
+ * @struct spill_store
+ * @brief The memory budget of the run and the regions allocated under it.
+ *
+ * - `enabled`: Non-zero when a budget is set.
+ * - `budget`: The budget in bytes.
+ * - `resident`: The bytes of the heap regions.
+ * - `spilled`: The bytes of the mapped regions.
+ * - `regions`: The regions, in no particular order.
+ * - `count`, `capacity`: The used and allocated number of regions.
+ * - `current`: The index of the chunk lines are carved from, or -1.
+ * - `hint`: The index of the region last found, which is tried first.
+ */
+struct spill_store
+{
+	int enabled;
+	size_t budget;
+	size_t resident;
+	size_t spilled;
+	struct spill_region *regions;
+	int count;
+	int capacity;
+	int current;
+	int hint;
+};
+
+/**
+ * @brief The memory budget of the run.
+ */
+extern struct spill_store SPILL;
+
+/**
+ * @brief Parses a size in bytes, with an optional K, M or G suffix.
+ * @param text The size.
+ * @param bytes Receives the size in bytes.
+ * @return 1 on success, or 0 if the size is not valid.
+ */
+int parse_memory_budget(const char *text, size_t *bytes);
+
+/**
+ * @brief Sets the memory budget of the run.
+ * @param budget The budget in bytes.
+ */
+void spill_open(size_t budget);
+
+/**
+ * @brief Maps a new temporary file into memory.
+ * @param size The size of the mapping.
+ * @return The mapping, or NULL on an error.
+ */
+char *spill_map(size_t size);
+
+/**
+ * @brief Appends an empty region to the store.
+ * @return The index of the region, or -1 on a memory allocation failure.
+ */
+int reserve_spill_region(void);
+
+/**
+ * @brief Allocates a region on the heap if the budget allows, or as a mapping.
+ * @param size The size of the region.
+ * @param used The bytes already handed out.
+ * @param live The number of allocations already in the region.
+ * @return The index of the region, or -1 on an allocation failure.
+ */
+int add_spill_region(size_t size, size_t used, long live);
+
+/**
+ * @brief Finds the region a pointer lies in.
+ * @param ptr The pointer.
+ * @return The index of the region, or -1 if the pointer lies in none.
+ */
+int find_spill_region(const void *ptr);
+
+/**
+ * @brief Frees a region and removes it from the store.
+ * @param index The index of the region.
+ */
+void release_spill_region(int index);
+
+/**
+ * @brief Allocates storage for the text of a line.
+ * @param size The size in bytes.
+ * @return The storage, or NULL on an allocation failure.
+ */
+void *spill_alloc(size_t size);
+
+/**
+ * @brief Resizes an array or table, moving it to a mapping when the budget is used up.
+ * @param ptr The array, or NULL.
+ * @param old_size The size of the array in bytes.
+ * @param new_size The new size in bytes.
+ * @return The resized array, or NULL on an allocation failure (the array is left as it was).
+ */
+void *spill_resize(void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Frees a line, an array or a table.
+ * @param ptr The storage, or NULL.
+ */
+void spill_free(void *ptr);
+
+/**
+ * @brief Frees every region and turns the budget off.
+ */
+void spill_close(void);
+
+#endif /* SPILL_H */
@@ -0,0 +1,142 @@
+#include "trace.h"
+
+struct trace_recorder TRACE = {0, NULL, 0, 0};
+
+/**
+ * @brief Starts recording spans.
+ *
+ * The ring buffer is allocated once, up front, so recording a span never
+ * allocates.
+ *
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int trace_open(void)
+{
+	TRACE.events = (struct trace_event *)malloc(TRACE_CAPACITY * sizeof(struct trace_event));
+	if(TRACE.events == NULL)
+	{
+		fprintf(stdout, "Memory allocation failed");
+		return EXIT;
+	}
+	TRACE.count = 0;
+	TRACE.origin = perf_wall_clock();
+	TRACE.enabled = 1;
+	return 1;
+}
+
+/**
+ * @brief Starts a span.
+ * @return The start time of the span, or 0 when tracing is off.
+ */
+double trace_begin(void)
+{
+	if(!TRACE.enabled)
+	{
+		return 0;
+	}
+	return perf_wall_clock();
+}
+
+/**
+ * @brief Ends a span and records it.
+ *
+ * When the ring buffer is full, the span overwrites the oldest one. Details
+ * longer than the buffer are cut short.
+ *
+ * @param name The name of the span; it must be a string literal.
+ * @param detail The file the span worked on, or NULL.
+ * @param start The value `trace_begin` returned.
+ */
+void trace_end(const char *name, const char *detail, double start)
+{
+	struct trace_event *event;
+	if(!TRACE.enabled)
+	{
+		return;
+	}
+	event = &TRACE.events[TRACE.count % TRACE_CAPACITY];
+	event->end = perf_wall_clock();
+	event->start = start;
+	event->name = name;
+	event->detail[0] = '\0';
+	if(detail != NULL)
+	{
+		strncat(event->detail, detail, TRACE_DETAIL_LENGTH - 1);
+	}
+	TRACE.count++;
+}
+
+/**
+ * @brief Writes the recorded spans as Chrome trace-event JSON.
+ *
+ * Every span is a complete (`"ph":"X"`) event with its start and duration in
+ * microseconds from the start of the trace, and its detail as the `file`
+ * argument. If the ring buffer wrapped, only the newest spans are written.
+ *
+ * @param name The name of the trace file.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_trace(const char *name)
+{
+	struct lsp_buffer json = {NULL, 0, 0};
+	char number[LSP_MAX_NUMBER * 2];
+	const struct trace_event *event;
+	FILE *fileptr = NULL;
+	long i, first;
+	int status = EXIT;
+
+	first = (TRACE.count > TRACE_CAPACITY) ? TRACE.count - TRACE_CAPACITY : 0;
+	if(buffer_append(&json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == EXIT){goto clean;}
+	sprintf(number, "\"pid\":%d,\"tid\":%d", TRACE_PROCESS, TRACE_THREAD);
+	if(buffer_append(&json, "{\"name\":\"thread_name\",\"ph\":\"M\",") == EXIT || buffer_append(&json, number) == EXIT || buffer_append(&json, ",\"args\":{\"name\":\"assembler\"}}") == EXIT){goto clean;}
+	for(i = first; i < TRACE.count; i++)
+	{
+		event = &TRACE.events[i % TRACE_CAPACITY];
+		if(buffer_append(&json, ",\n{\"name\":") == EXIT || buffer_append_json_string(&json, event->name) == EXIT){goto clean;}
+		sprintf(number, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,", (event->start - TRACE.origin) * 1e6, (event->end - event->start) * 1e6);
+		if(buffer_append(&json, number) == EXIT){goto clean;}
+		sprintf(number, "\"pid\":%d,\"tid\":%d", TRACE_PROCESS, TRACE_THREAD);
+		if(buffer_append(&json, number) == EXIT){goto clean;}
+		if(event->detail[0] != '\0')
+		{
+			if(buffer_append(&json, ",\"args\":{\"file\":") == EXIT || buffer_append_json_string(&json, event->detail) == EXIT || buffer_append(&json, "}") == EXIT){goto clean;}
+		}
+		if(buffer_append(&json, "}") == EXIT){goto clean;}
+	}
+	if(buffer_append(&json, "]}\n") == EXIT){goto clean;}
+	fileptr = fopen(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	if(fwrite(json.data, 1, json.len, fileptr) != json.len)
+	{
+		fprintf(stdout,"error writing file!\n");
+		goto clean;
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		fileptr = NULL;
+		goto clean;
+	}
+	fileptr = NULL;
+	status = 1;
+
+	clean:
+		if(fileptr != NULL)fclose(fileptr);
+		free(json.data);
+		return status;
+}
+
+/**
+ * @brief Stops recording and frees the spans.
+ */
+void trace_close(void)
+{
+	free(TRACE.events);
+	TRACE.events = NULL;
+	TRACE.count = 0;
+	TRACE.enabled = 0;
+}
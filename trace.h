@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * @file trace.h
+ * @brief This header file declares the Chrome trace-event timeline.
+ *
+ * With `--trace FILE` the assembler records a span for every phase it goes
+ * through: each source file, the pre-assembly, every file read and every block
+ * read from it, the first-pass line loop, `index_update`, the second pass and
+ * every output writer. The spans are kept in memory, in a ring buffer of
+ * `TRACE_CAPACITY` events that overwrites the oldest spans when it is full,
+ * and are written once when the run ends, as Chrome trace-event JSON that
+ * Perfetto and `chrome://tracing` open directly.
+ *
+ * Recording a span costs two clock reads and a copy into the buffer. When
+ * tracing is off, `trace_begin` and `trace_end` return at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "perf.h"
+#include "lsp.h"
+#include "assembler.h"
+
+/**
+ * @def TRACE_CAPACITY
+ * @brief The number of spans the ring buffer holds.
+ */
+#define TRACE_CAPACITY 65536
+
+/**
+ * @def TRACE_DETAIL_LENGTH
+ * @brief The size of the detail (usually a file name) stored with a span.
+ */
+#define TRACE_DETAIL_LENGTH 64
+
+/**
+ * @def TRACE_PROCESS
+ * @brief The process id written in the trace.
+ */
+#define TRACE_PROCESS 1
+
+/**
+ * @def TRACE_THREAD
+ * @brief The thread id written in the trace; the assembler runs on one thread.
+ */
+#define TRACE_THREAD 1
+
+/**
+ * @struct trace_event
+ * @brief A complete span.
+ *
+ * - `name`: The name of the span; a string literal.
+ * - `detail`: The file the span worked on, or an empty string.
+ * - `start`: The time the span began, in seconds.
+ * - `end`: The time the span ended, in seconds.
+ */
+struct trace_event
+{
+	const char *name;
+	char detail[TRACE_DETAIL_LENGTH];
+	double start;
+	double end;
+};
+
+/**
+ * @struct trace_recorder
+ * @brief The ring buffer of spans.
+ *
+ * - `enabled`: Non-zero while spans are recorded.
+ * - `events`: The ring buffer.
+ * - `count`: The number of spans recorded so far, including overwritten ones.
+ * - `origin`: The time the trace began, in seconds.
+ */
+struct trace_recorder
+{
+	int enabled;
+	struct trace_event *events;
+	long count;
+	double origin;
+};
+
+/**
+ * @brief The spans of the run.
+ */
+extern struct trace_recorder TRACE;
+
+/**
+ * @brief Starts recording spans.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int trace_open(void);
+
+/**
+ * @brief Starts a span.
+ * @return The start time of the span, or 0 when tracing is off.
+ */
+double trace_begin(void);
+
+/**
+ * @brief Ends a span and records it.
+ * @param name The name of the span; it must be a string literal.
+ * @param detail The file the span worked on, or NULL.
+ * @param start The value `trace_begin` returned.
+ */
+void trace_end(const char *name, const char *detail, double start);
+
+/**
+ * @brief Writes the recorded spans as Chrome trace-event JSON.
+ * @param name The name of the trace file.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int write_trace(const char *name);
+
+/**
+ * @brief Stops recording and frees the spans.
+ */
+void trace_close(void);
+
+#endif /* TRACE_H */
@@ -0,0 +1,553 @@
+#include "xref.h"
+
+struct xref_recorder XREF = {0, NULL, 0, 0, NULL, 0, 0};
+
+/**
+ * @brief Starts recording definitions and references.
+ *
+ * The sites are allocated as they are recorded and kept across files, so
+ * their memory is reused by every file of the run.
+ */
+void xref_open(void)
+{
+	XREF.enabled = 1;
+	xref_reset();
+}
+
+/**
+ * @brief Forgets the sites of the previous file.
+ */
+void xref_reset(void)
+{
+	XREF.num_definitions = 0;
+	XREF.num_references = 0;
+}
+
+/**
+ * @brief Stops recording and frees the sites.
+ */
+void xref_close(void)
+{
+	free(XREF.definitions);
+	free(XREF.references);
+	memset(&XREF, 0, sizeof(struct xref_recorder));
+}
+
+/**
+ * @brief Appends a site to one of the recorder's arrays.
+ *
+ * @param sites A pointer to the array.
+ * @param count A pointer to the number of sites.
+ * @param capacity A pointer to the allocated number of sites.
+ * @param name The name of the symbol.
+ * @param line The index of the expanded line.
+ * @param address The address of the word, or 0.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_xref_site(struct xref_site **sites, int *count, int *capacity, const char *name, int line, int address)
+{
+	struct xref_site *temp;
+	if(*count == *capacity)
+	{
+		temp = (struct xref_site *)realloc(*sites, (*capacity + MAX_SIZE_MEMORY) * sizeof(struct xref_site));
+		if(temp == NULL)
+		{
+			fprintf(stdout,"Memory allocation failed");
+			return EXIT;
+		}
+		*sites = temp;
+		*capacity += MAX_SIZE_MEMORY;
+	}
+	strncpy((*sites)[*count].name, name, MAX_SIZE_LABEL);
+	(*sites)[*count].name[MAX_SIZE_LABEL] = '\0';
+	(*sites)[*count].line = line;
+	(*sites)[*count].address = address;
+	(*count)++;
+	return 1;
+}
+
+/**
+ * @brief Records the line that defines a label or declares it `.extern`.
+ *
+ * @param name The name of the label.
+ * @param line The index of the expanded line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int xref_define(const char *name, int line)
+{
+	if(!XREF.enabled)
+	{
+		return 1;
+	}
+	return add_xref_site(&XREF.definitions, &XREF.num_definitions, &XREF.definitions_capacity, name, line, 0);
+}
+
+/**
+ * @brief Records a symbolic operand resolved by the second pass.
+ *
+ * @param name The name of the symbol.
+ * @param line The index of the expanded line.
+ * @param address The address of the word that refers to the symbol, in the dense layout.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int xref_reference(const char *name, int line, int address)
+{
+	if(!XREF.enabled)
+	{
+		return 1;
+	}
+	return add_xref_site(&XREF.references, &XREF.num_references, &XREF.references_capacity, name, line, address);
+}
+
+/**
+ * @brief Orders sites by name, line and address (a `qsort` comparator).
+ *
+ * @param a A pointer to the first site.
+ * @param b A pointer to the second site.
+ * @return A negative, zero or positive value.
+ */
+int compare_xref_sites(const void *a, const void *b)
+{
+	const struct xref_site *first = (const struct xref_site *)a, *second = (const struct xref_site *)b;
+	int order = strcmp(first->name, second->name);
+	if(order != 0)
+	{
+		return order;
+	}
+	if(first->line != second->line)
+	{
+		return first->line - second->line;
+	}
+	return first->address - second->address;
+}
+
+/**
+ * @brief Finds the first site of a name in sorted sites.
+ *
+ * @param sites The sites, sorted by `compare_xref_sites`.
+ * @param count The number of sites.
+ * @param name The name.
+ * @return The index of the first site of the name, or `count` if there is none.
+ */
+int first_xref_site(const struct xref_site *sites, int count, const char *name)
+{
+	int low = 0, high = count, mid;
+	while(low < high)
+	{
+		mid = (low + high) / 2;
+		if(strcmp(sites[mid].name, name) < 0)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return (low < count && strcmp(sites[low].name, name) == 0) ? low : count;
+}
+
+/**
+ * @brief Finds the file and line an expanded line came from.
+ *
+ * A line from an included file is attributed to that file and line; any other
+ * line to the source file and its line there, as in the line table.
+ *
+ * @param files The file names seen so far; only their string table is used.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param line The index of the expanded line.
+ * @param file Receives the string index of the file.
+ * @param file_line Receives the line in the file.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int xref_site_origin(struct debug_table *files, const char *source, const ExpandedSource *expanded, int line, unsigned long *file, unsigned long *file_line)
+{
+	const LineOrigin *origin;
+	int index;
+	if(line < 0 || line >= expanded->count)
+	{
+		*file = 0;
+		*file_line = 0;
+		return 1;
+	}
+	origin = &expanded->origins[line];
+	if(intern_debug_string(files, (origin->file != NULL) ? origin->file : source, &index) == EXIT)
+	{
+		return EXIT;
+	}
+	*file = (unsigned long)index;
+	*file_line = (unsigned long)((origin->file != NULL) ? origin->file_line : origin->line);
+	return 1;
+}
+
+/**
+ * @brief Serializes the symbols of a file and the recorded sites into the `.xref` format.
+ *
+ * The recorded sites are sorted by name first, so the definition and the
+ * references of every label are found by binary search. The number of
+ * buckets is the smallest power of two that is at least twice the number of
+ * labels, and the labels are stored grouped by bucket, as in a macro library.
+ * Every file name is interned before the image is laid out, since the size of
+ * the string pool depends on them.
+ *
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param labeltable A pointer to the label table, with final addresses.
+ * @param lac The number of labels.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @param size Receives the size of the image.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned char *build_xref_image(const char *source, const ExpandedSource *expanded, const struct labelMemory *labeltable, int lac, const struct layout_block *placed, int num_placed, size_t *size)
+{
+	struct debug_table files = {NULL, 0, NULL, 0, 0};
+	const struct labelMemory *label;
+	const struct xref_site *site;
+	unsigned char *image = NULL, *entry;
+	unsigned long *starts = NULL, *order = NULL;
+	unsigned long num_buckets = 1, num_refs = 0, pool_size = 0, names_pos, pool_pos = 0;
+	unsigned long buckets_off, symbols_off, refs_off, strings_off, pool_off, b, s, r = 0, file, file_line;
+	int i, j, index;
+
+	qsort(XREF.definitions, (size_t)XREF.num_definitions, sizeof(struct xref_site), compare_xref_sites);
+	qsort(XREF.references, (size_t)XREF.num_references, sizeof(struct xref_site), compare_xref_sites);
+
+	/* Intern every file name first; the source file is string 0. */
+	if(intern_debug_string(&files, source, &index) == EXIT){goto clean_image;}
+	for(i = 0; i < XREF.num_definitions; i++)
+	{
+		if(xref_site_origin(&files, source, expanded, XREF.definitions[i].line, &file, &file_line) == EXIT){goto clean_image;}
+	}
+	for(i = 0; i < lac; i++)
+	{
+		j = first_xref_site(XREF.references, XREF.num_references, labeltable[i].name);
+		for(; j < XREF.num_references && strcmp(XREF.references[j].name, labeltable[i].name) == 0; j++)
+		{
+			if(xref_site_origin(&files, source, expanded, XREF.references[j].line, &file, &file_line) == EXIT){goto clean_image;}
+			num_refs++;
+		}
+		pool_size += strlen(labeltable[i].name) + 1;
+	}
+	for(i = 0; i < files.num_strings; i++)
+	{
+		pool_size += strlen(files.strings[i]) + 1;
+	}
+	while(num_buckets < (unsigned long)lac * DOUBLE)
+	{
+		num_buckets *= DOUBLE;
+	}
+
+	buckets_off = MACRO_LIBRARY_WORD * (1 + XREF_HEADER_WORDS);
+	symbols_off = buckets_off + (num_buckets + 1) * MACRO_LIBRARY_WORD;
+	refs_off = symbols_off + (unsigned long)lac * XREF_SYMBOL_WORDS * MACRO_LIBRARY_WORD;
+	strings_off = refs_off + num_refs * XREF_REF_WORDS * MACRO_LIBRARY_WORD;
+	pool_off = strings_off + (unsigned long)files.num_strings * MACRO_LIBRARY_WORD;
+	*size = pool_off + pool_size;
+	image = (unsigned char *)calloc(*size, 1);
+	starts = (unsigned long *)calloc(num_buckets + 1, sizeof(unsigned long));
+	order = (unsigned long *)malloc(((size_t)lac + 1) * sizeof(unsigned long));
+	if(image == NULL || starts == NULL || order == NULL)
+	{
+		fprintf(stdout,"Memory allocation failed");
+		free(image);
+		image = NULL;
+		goto clean_image;
+	}
+
+	memcpy(image, XREF_MAGIC, MACRO_LIBRARY_WORD);
+	write_word(image + MACRO_LIBRARY_WORD, num_buckets);
+	write_word(image + 2 * MACRO_LIBRARY_WORD, (unsigned long)lac);
+	write_word(image + 3 * MACRO_LIBRARY_WORD, num_refs);
+	write_word(image + 4 * MACRO_LIBRARY_WORD, (unsigned long)files.num_strings);
+	write_word(image + 5 * MACRO_LIBRARY_WORD, buckets_off);
+	write_word(image + 6 * MACRO_LIBRARY_WORD, symbols_off);
+	write_word(image + 7 * MACRO_LIBRARY_WORD, refs_off);
+	write_word(image + 8 * MACRO_LIBRARY_WORD, strings_off);
+	write_word(image + 9 * MACRO_LIBRARY_WORD, pool_off);
+	write_word(image + 10 * MACRO_LIBRARY_WORD, pool_size);
+
+	for(i = 0; i < files.num_strings; i++)
+	{
+		write_word(image + strings_off + (unsigned long)i * MACRO_LIBRARY_WORD, pool_pos);
+		strcpy((char *)image + pool_off + pool_pos, files.strings[i]);
+		pool_pos += strlen(files.strings[i]) + 1;
+	}
+	names_pos = pool_pos;
+
+	/* Count the labels of every bucket, then turn the counts into start indexes. */
+	for(i = 0; i < lac; i++)
+	{
+		starts[(hash_string(labeltable[i].name) & (num_buckets - 1)) + 1]++;
+	}
+	for(b = 0; b < num_buckets; b++)
+	{
+		starts[b + 1] += starts[b];
+		write_word(image + buckets_off + b * MACRO_LIBRARY_WORD, starts[b]);
+	}
+	write_word(image + buckets_off + num_buckets * MACRO_LIBRARY_WORD, (unsigned long)lac);
+	for(i = 0; i < lac; i++)
+	{
+		order[starts[hash_string(labeltable[i].name) & (num_buckets - 1)]++] = (unsigned long)i;
+	}
+
+	for(s = 0; s < (unsigned long)lac; s++)
+	{
+		label = &labeltable[order[s]];
+		entry = image + symbols_off + s * XREF_SYMBOL_WORDS * MACRO_LIBRARY_WORD;
+		write_word(entry, hash_string(label->name));
+		write_word(entry + MACRO_LIBRARY_WORD, names_pos);
+		strcpy((char *)image + pool_off + names_pos, label->name);
+		names_pos += strlen(label->name) + 1;
+
+		j = first_xref_site(XREF.definitions, XREF.num_definitions, label->name);
+		file = 0;
+		file_line = 0;
+		if(j < XREF.num_definitions && xref_site_origin(&files, source, expanded, XREF.definitions[j].line, &file, &file_line) == EXIT)
+		{
+			free(image);
+			image = NULL;
+			goto clean_image;
+		}
+		write_word(entry + 2 * MACRO_LIBRARY_WORD, file);
+		write_word(entry + 3 * MACRO_LIBRARY_WORD, file_line);
+		write_word(entry + 4 * MACRO_LIBRARY_WORD, (label->en == EXTERN) ? 0 : (unsigned long)label->index);
+		write_word(entry + 5 * MACRO_LIBRARY_WORD, (label->en == EXTERN) ? XREF_KIND_EXTERN : (label->type == DIRECTIVE) ? XREF_KIND_DATA : XREF_KIND_CODE);
+		write_word(entry + 6 * MACRO_LIBRARY_WORD, (label->en == ENTRY) ? 1 : 0);
+		write_word(entry + 7 * MACRO_LIBRARY_WORD, r);
+
+		j = first_xref_site(XREF.references, XREF.num_references, label->name);
+		for(; j < XREF.num_references && strcmp(XREF.references[j].name, label->name) == 0; j++, r++)
+		{
+			site = &XREF.references[j];
+			if(xref_site_origin(&files, source, expanded, site->line, &file, &file_line) == EXIT)
+			{
+				free(image);
+				image = NULL;
+				goto clean_image;
+			}
+			write_word(image + refs_off + r * XREF_REF_WORDS * MACRO_LIBRARY_WORD, file);
+			write_word(image + refs_off + (r * XREF_REF_WORDS + 1) * MACRO_LIBRARY_WORD, file_line);
+			write_word(image + refs_off + (r * XREF_REF_WORDS + 2) * MACRO_LIBRARY_WORD, (unsigned long)((placed != NULL) ? map_layout_address(placed, num_placed, site->address) : site->address));
+		}
+		write_word(entry + 8 * MACRO_LIBRARY_WORD, r - read_word(entry + 7 * MACRO_LIBRARY_WORD));
+	}
+
+	clean_image:
+		free(starts);
+		free(order);
+		free((void *)files.strings);
+		return image;
+}
+
+/**
+ * @brief Writes the `.xref` table of a file, if it changed.
+ *
+ * @param name The name of the `.xref` file.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param labeltable A pointer to the label table, with final addresses.
+ * @param lac The number of labels.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_xref(const char *name, const char *source, const ExpandedSource *expanded, const struct labelMemory *labeltable, int lac, const struct layout_block *placed, int num_placed)
+{
+	unsigned char *image;
+	size_t size;
+	FILE *fileptr;
+	int status = EXIT;
+
+	image = build_xref_image(source, expanded, labeltable, lac, placed, num_placed, &size);
+	if(image == NULL)
+	{
+		return EXIT;
+	}
+	fileptr = open_output(name, "wb");
+	if(fileptr == NULL)
+	{
+		fprintf(stdout,"error opening file!\n");
+		goto clean;
+	}
+	if(fwrite(image, 1, size, fileptr) != size)
+	{
+		fprintf(stdout,"error writing file!\n");
+		fclose(fileptr);
+		discard_output(name);
+		goto clean;
+	}
+	if(fclose(fileptr) != 0)
+	{
+		fprintf(stdout,"error writing file!\n");
+		discard_output(name);
+		goto clean;
+	}
+	if(commit_output(name) == EXIT){goto clean;}
+	status = 1;
+
+	clean:
+		free(image);
+		return status;
+}
+
+/**
+ * @brief Maps a `.xref` table into memory and checks its structure.
+ *
+ * Like a macro library, the file is mapped with `map_file` and its tables,
+ * buckets and symbols are checked against the file size once. A reference is
+ * checked when it is printed.
+ *
+ * @param name The name of the `.xref` file.
+ * @param info A pointer to the table to fill.
+ * @return 1 on success, or EXIT if the file cannot be mapped or is not a valid table.
+ */
+int load_xref(const char *name, struct xref_info *info)
+{
+	const unsigned char *data, *entry;
+	unsigned long buckets_off, symbols_off, refs_off, strings_off, pool_off, i;
+
+	memset(info, 0, sizeof(struct xref_info));
+	data = map_file(name, &info->size);
+	if(data == NULL)
+	{
+		return EXIT;
+	}
+	info->data = data;
+
+	if(info->size < MACRO_LIBRARY_WORD * (1 + XREF_HEADER_WORDS) || memcmp(data, XREF_MAGIC, MACRO_LIBRARY_WORD) != 0){goto invalid_xref;}
+	info->num_buckets = read_word(data + MACRO_LIBRARY_WORD);
+	info->num_symbols = read_word(data + 2 * MACRO_LIBRARY_WORD);
+	info->num_refs = read_word(data + 3 * MACRO_LIBRARY_WORD);
+	info->num_strings = read_word(data + 4 * MACRO_LIBRARY_WORD);
+	buckets_off = read_word(data + 5 * MACRO_LIBRARY_WORD);
+	symbols_off = read_word(data + 6 * MACRO_LIBRARY_WORD);
+	refs_off = read_word(data + 7 * MACRO_LIBRARY_WORD);
+	strings_off = read_word(data + 8 * MACRO_LIBRARY_WORD);
+	pool_off = read_word(data + 9 * MACRO_LIBRARY_WORD);
+	info->pool_size = read_word(data + 10 * MACRO_LIBRARY_WORD);
+
+	if(info->num_buckets == 0 || (info->num_buckets & (info->num_buckets - 1)) != 0){goto invalid_xref;}
+	if(info->num_buckets >= info->size || info->num_symbols >= info->size || info->num_refs >= info->size || info->num_strings >= info->size){goto invalid_xref;}
+	if(buckets_off + (info->num_buckets + 1) * MACRO_LIBRARY_WORD > symbols_off){goto invalid_xref;}
+	if(symbols_off + info->num_symbols * XREF_SYMBOL_WORDS * MACRO_LIBRARY_WORD > refs_off){goto invalid_xref;}
+	if(refs_off + info->num_refs * XREF_REF_WORDS * MACRO_LIBRARY_WORD > strings_off){goto invalid_xref;}
+	if(strings_off + info->num_strings * MACRO_LIBRARY_WORD > pool_off){goto invalid_xref;}
+	if(info->num_strings == 0 || info->pool_size == 0 || pool_off + info->pool_size != info->size || data[info->size - 1] != '\0'){goto invalid_xref;}
+
+	info->buckets = data + buckets_off;
+	info->symbols = data + symbols_off;
+	info->refs = data + refs_off;
+	info->strings = data + strings_off;
+	info->pool = (const char *)data + pool_off;
+
+	for(i = 0; i < info->num_buckets; i++)
+	{
+		if(read_word(info->buckets + i * MACRO_LIBRARY_WORD) > read_word(info->buckets + (i + 1) * MACRO_LIBRARY_WORD)){goto invalid_xref;}
+	}
+	if(read_word(info->buckets + info->num_buckets * MACRO_LIBRARY_WORD) != info->num_symbols){goto invalid_xref;}
+	for(i = 0; i < info->num_strings; i++)
+	{
+		if(read_word(info->strings + i * MACRO_LIBRARY_WORD) >= info->pool_size){goto invalid_xref;}
+	}
+	for(i = 0; i < info->num_symbols; i++)
+	{
+		entry = info->symbols + i * XREF_SYMBOL_WORDS * MACRO_LIBRARY_WORD;
+		if(read_word(entry + MACRO_LIBRARY_WORD) >= info->pool_size || read_word(entry + 2 * MACRO_LIBRARY_WORD) >= info->num_strings){goto invalid_xref;}
+		if(read_word(entry + 7 * MACRO_LIBRARY_WORD) > info->num_refs || read_word(entry + 8 * MACRO_LIBRARY_WORD) > info->num_refs - read_word(entry + 7 * MACRO_LIBRARY_WORD)){goto invalid_xref;}
+	}
+	return 1;
+
+	invalid_xref:
+		fprintf(stdout, "invalid cross-reference table: %s\n", name);
+		unload_xref(info);
+		return EXIT;
+}
+
+/**
+ * @brief Unmaps a cross-reference table.
+ *
+ * @param info A pointer to the table.
+ */
+void unload_xref(struct xref_info *info)
+{
+	unmap_file(info->data, info->size);
+	memset(info, 0, sizeof(struct xref_info));
+}
+
+/**
+ * @brief Looks a symbol up in a cross-reference table.
+ *
+ * The name is hashed to a bucket, and only the symbols of that bucket whose
+ * hash matches are compared by name.
+ *
+ * @param info A pointer to the table.
+ * @param name The name of the symbol.
+ * @return The symbol's entry in the symbol table, or NULL if it is not there.
+ */
+const unsigned char *find_xref_symbol(const struct xref_info *info, const char *name)
+{
+	const unsigned char *entry;
+	unsigned long hash, b, i, end;
+	hash = hash_string(name);
+	b = hash & (info->num_buckets - 1);
+	end = read_word(info->buckets + (b + 1) * MACRO_LIBRARY_WORD);
+	for(i = read_word(info->buckets + b * MACRO_LIBRARY_WORD); i < end; i++)
+	{
+		entry = info->symbols + i * XREF_SYMBOL_WORDS * MACRO_LIBRARY_WORD;
+		if(read_word(entry) == hash && strcmp(info->pool + read_word(entry + MACRO_LIBRARY_WORD), name) == 0)
+		{
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Prints the definition and references of every symbol given on the command line.
+ *
+ * Every symbol gets one line on stdout: its name, kind, address and
+ * `file:line` of its definition, and `entry` if it is one; then one indented
+ * line per reference, with `file:line` and the address of the word.
+ *
+ * @param name The name of the `.xref` file.
+ * @param symbols The names of the symbols.
+ * @param count The number of names.
+ * @return 1 on success, 0 if a symbol is not in the table, or EXIT if the file cannot be mapped.
+ */
+int print_xref_queries(const char *name, char **symbols, int count)
+{
+	static const char *kinds[] = {"code", "data", "extern"};
+	struct xref_info info;
+	const unsigned char *entry, *ref;
+	unsigned long kind, first, num, r, file;
+	int i, status = 1;
+
+	if(load_xref(name, &info) == EXIT)
+	{
+		return EXIT;
+	}
+	for(i = 0; i < count; i++)
+	{
+		entry = find_xref_symbol(&info, symbols[i]);
+		if(entry == NULL)
+		{
+			fprintf(stdout, "%s\t??\n", symbols[i]);
+			status = 0;
+			continue;
+		}
+		kind = read_word(entry + 5 * MACRO_LIBRARY_WORD);
+		fprintf(stdout, "%s\t%s\t%lu\t%s:%lu%s\n", symbols[i], (kind <= XREF_KIND_EXTERN) ? kinds[kind] : "?", read_word(entry + 4 * MACRO_LIBRARY_WORD), info.pool + read_word(info.strings + read_word(entry + 2 * MACRO_LIBRARY_WORD) * MACRO_LIBRARY_WORD), read_word(entry + 3 * MACRO_LIBRARY_WORD), read_word(entry + 6 * MACRO_LIBRARY_WORD) ? "\tentry" : "");
+		first = read_word(entry + 7 * MACRO_LIBRARY_WORD);
+		num = read_word(entry + 8 * MACRO_LIBRARY_WORD);
+		for(r = first; r < first + num; r++)
+		{
+			ref = info.refs + r * XREF_REF_WORDS * MACRO_LIBRARY_WORD;
+			file = read_word(ref);
+			fprintf(stdout, "\t%s:%lu\t%lu\n", (file < info.num_strings) ? info.pool + read_word(info.strings + file * MACRO_LIBRARY_WORD) : "??", read_word(ref + MACRO_LIBRARY_WORD), read_word(ref + 2 * MACRO_LIBRARY_WORD));
+		}
+	}
+	unload_xref(&info);
+	return status;
+}
@@ -0,0 +1,300 @@
+#ifndef XREF_H
+#define XREF_H
+
+/**
+ * @file xref.h
+ * @brief This header file declares the symbol cross-reference table.
+ *
+ * With `--xref`, every object file gets a `.xref` sidecar that lists every
+ * symbol with its definition (file, line, address, kind, and whether it is an
+ * entry) and every site that refers to it. While `--xref` is on, the first
+ * pass records where every label is defined and `search_and_update` records
+ * every symbolic operand it resolves, in a global recorder like the trace.
+ *
+ * All numbers are 32-bit little-endian, as in a macro library, and all
+ * references are offsets from the start of the file:
+ *
+ * - Header: the magic "XRF1", then the number of buckets, symbols,
+ *   references and strings, the offsets of the bucket table, the symbol
+ *   table, the reference table, the string table and the string pool, and the
+ *   size of the string pool.
+ * - Buckets: the index of the first symbol of every bucket, followed by the
+ *   number of symbols, as in a macro library.
+ * - Symbols: grouped by bucket, `XREF_SYMBOL_WORDS` words each: the hash of
+ *   the name, the pool offset of the name, the string index of the file, the
+ *   line, the address, the kind, the entry flag, the index of the first
+ *   reference and the number of references.
+ * - References: grouped by symbol, `XREF_REF_WORDS` words each: the string
+ *   index of the file, the line and the address of the word.
+ * - Strings: the pool offset of every file name; string 0 is the source file.
+ * - Pool: null-terminated strings.
+ *
+ * A reader maps the file with one `mmap`, hashes the name to its bucket and
+ * compares only the symbols of that bucket; the references of a symbol are
+ * then one contiguous run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data.h"
+#include "code.h"
+#include "pre_assembler.h"
+#include "macrolib.h"
+#include "debug_info.h"
+#include "assembler.h"
+
+/* The blocks of the stable layout are declared in layout.h, the string table in debug_info.h. */
+struct layout_block;
+struct debug_table;
+
+/**
+ * @def END_XREF_FILE_NAME
+ * @brief Suffix for the symbol cross-reference table.
+ */
+#define END_XREF_FILE_NAME ".xref"
+
+/**
+ * @def XREF_MAGIC
+ * @brief The four bytes every cross-reference table starts with.
+ */
+#define XREF_MAGIC "XRF1"
+
+/**
+ * @def XREF_HEADER_WORDS
+ * @brief The number of words in the header, after the magic.
+ */
+#define XREF_HEADER_WORDS 10
+
+/**
+ * @def XREF_SYMBOL_WORDS
+ * @brief The number of words in every entry of the symbol table.
+ */
+#define XREF_SYMBOL_WORDS 9
+
+/**
+ * @def XREF_REF_WORDS
+ * @brief The number of words in every entry of the reference table.
+ */
+#define XREF_REF_WORDS 3
+
+/**
+ * @def XREF_KIND_CODE
+ * @brief A symbol defined on an instruction.
+ */
+#define XREF_KIND_CODE 0
+
+/**
+ * @def XREF_KIND_DATA
+ * @brief A symbol defined on a data directive.
+ */
+#define XREF_KIND_DATA 1
+
+/**
+ * @def XREF_KIND_EXTERN
+ * @brief A symbol declared `.extern`.
+ */
+#define XREF_KIND_EXTERN 2
+
+/**
+ * @struct xref_site
+ * @brief A line that defines or refers to a symbol.
+ *
+ * - `name`: The name of the symbol.
+ * - `line`: The index of the expanded line.
+ * - `address`: The address of the word that refers to the symbol; unused for a definition.
+ */
+struct xref_site
+{
+	char name[MAX_SIZE_LABEL + 1];
+	int line;
+	int address;
+};
+
+/**
+ * @struct xref_recorder
+ * @brief The definitions and references of the current file.
+ *
+ * - `enabled`: Non-zero while sites are recorded.
+ * - `definitions`: The lines that define a label or declare it `.extern`.
+ * - `num_definitions`, `definitions_capacity`: The used and allocated number of definitions.
+ * - `references`: The symbolic operands resolved by the second pass.
+ * - `num_references`, `references_capacity`: The used and allocated number of references.
+ */
+struct xref_recorder
+{
+	int enabled;
+	struct xref_site *definitions;
+	int num_definitions;
+	int definitions_capacity;
+	struct xref_site *references;
+	int num_references;
+	int references_capacity;
+};
+
+/**
+ * @struct xref_info
+ * @brief A cross-reference table mapped into memory.
+ *
+ * - `data`: The mapped file.
+ * - `size`: The size of the file.
+ * - `num_buckets`, `num_symbols`, `num_refs`, `num_strings`: The sizes of the tables.
+ * - `buckets`: The bucket table.
+ * - `symbols`: The symbol table.
+ * - `refs`: The reference table.
+ * - `strings`: The string table.
+ * - `pool`: The string pool.
+ * - `pool_size`: The size of the string pool.
+ */
+struct xref_info
+{
+	const unsigned char *data;
+	size_t size;
+	unsigned long num_buckets;
+	unsigned long num_symbols;
+	unsigned long num_refs;
+	unsigned long num_strings;
+	const unsigned char *buckets;
+	const unsigned char *symbols;
+	const unsigned char *refs;
+	const unsigned char *strings;
+	const char *pool;
+	unsigned long pool_size;
+};
+
+/**
+ * @brief The definitions and references of the current file.
+ */
+extern struct xref_recorder XREF;
+
+/**
+ * @brief Starts recording definitions and references.
+ */
+void xref_open(void);
+
+/**
+ * @brief Forgets the sites of the previous file.
+ */
+void xref_reset(void);
+
+/**
+ * @brief Stops recording and frees the sites.
+ */
+void xref_close(void);
+
+/**
+ * @brief Appends a site to one of the recorder's arrays.
+ * @param sites A pointer to the array.
+ * @param count A pointer to the number of sites.
+ * @param capacity A pointer to the allocated number of sites.
+ * @param name The name of the symbol.
+ * @param line The index of the expanded line.
+ * @param address The address of the word, or 0.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int add_xref_site(struct xref_site **sites, int *count, int *capacity, const char *name, int line, int address);
+
+/**
+ * @brief Records the line that defines a label or declares it `.extern`.
+ * @param name The name of the label.
+ * @param line The index of the expanded line.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int xref_define(const char *name, int line);
+
+/**
+ * @brief Records a symbolic operand resolved by the second pass.
+ * @param name The name of the symbol.
+ * @param line The index of the expanded line.
+ * @param address The address of the word that refers to the symbol.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int xref_reference(const char *name, int line, int address);
+
+/**
+ * @brief Orders sites by name, line and address (a `qsort` comparator).
+ * @param a A pointer to the first site.
+ * @param b A pointer to the second site.
+ * @return A negative, zero or positive value.
+ */
+int compare_xref_sites(const void *a, const void *b);
+
+/**
+ * @brief Finds the first site of a name in sorted sites.
+ * @param sites The sites, sorted by `compare_xref_sites`.
+ * @param count The number of sites.
+ * @param name The name.
+ * @return The index of the first site of the name, or `count` if there is none.
+ */
+int first_xref_site(const struct xref_site *sites, int count, const char *name);
+
+/**
+ * @brief Finds the file and line an expanded line came from.
+ * @param files The file names seen so far; only their string table is used.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param line The index of the expanded line.
+ * @param file Receives the string index of the file.
+ * @param file_line Receives the line in the file.
+ * @return 1 on success, or EXIT on a memory allocation failure.
+ */
+int xref_site_origin(struct debug_table *files, const char *source, const ExpandedSource *expanded, int line, unsigned long *file, unsigned long *file_line);
+
+/**
+ * @brief Serializes the symbols of a file and the recorded sites into the `.xref` format.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param labeltable A pointer to the label table, with final addresses.
+ * @param lac The number of labels.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @param size Receives the size of the image.
+ * @return The dynamically allocated image, or NULL on a memory allocation failure.
+ */
+unsigned char *build_xref_image(const char *source, const ExpandedSource *expanded, const struct labelMemory *labeltable, int lac, const struct layout_block *placed, int num_placed, size_t *size);
+
+/**
+ * @brief Writes the `.xref` table of a file, if it changed.
+ * @param name The name of the `.xref` file.
+ * @param source The name of the source file.
+ * @param expanded A pointer to the expanded source.
+ * @param labeltable A pointer to the label table, with final addresses.
+ * @param lac The number of labels.
+ * @param placed The blocks of the stable layout, or NULL for the dense layout.
+ * @param num_placed The number of blocks.
+ * @return 1 on success, or EXIT on a file or memory error.
+ */
+int print_xref(const char *name, const char *source, const ExpandedSource *expanded, const struct labelMemory *labeltable, int lac, const struct layout_block *placed, int num_placed);
+
+/**
+ * @brief Maps a `.xref` table into memory and checks its structure.
+ * @param name The name of the `.xref` file.
+ * @param info A pointer to the table to fill.
+ * @return 1 on success, or EXIT if the file cannot be mapped or is not a valid table.
+ */
+int load_xref(const char *name, struct xref_info *info);
+
+/**
+ * @brief Unmaps a cross-reference table.
+ * @param info A pointer to the table.
+ */
+void unload_xref(struct xref_info *info);
+
+/**
+ * @brief Looks a symbol up in a cross-reference table.
+ * @param info A pointer to the table.
+ * @param name The name of the symbol.
+ * @return The symbol's entry in the symbol table, or NULL if it is not there.
+ */
+const unsigned char *find_xref_symbol(const struct xref_info *info, const char *name);
+
+/**
+ * @brief Prints the definition and references of every symbol given on the command line.
+ * @param name The name of the `.xref` file.
+ * @param symbols The names of the symbols.
+ * @param count The number of names.
+ * @return 1 on success, 0 if a symbol is not in the table, or EXIT if the file cannot be mapped.
+ */
+int print_xref_queries(const char *name, char **symbols, int count);
+
+#endif /* XREF_H */